@@ -0,0 +1,100 @@
+#include "artnet_input.hpp"
+#include <cstring>
+#include <esp_log.h>
+
+static const char *LOG_TAG = "ArtNetInput";
+static const uint16_t OP_DMX = 0x5000;
+
+ArtNetInput::ArtNetInput() : sockfd_(-1), firstUniverse_(0)
+{
+    memset(universes_, 0, sizeof(universes_));
+    memset(universeLength_, 0, sizeof(universeLength_));
+}
+
+ArtNetInput::~ArtNetInput() { close(); }
+
+esp_err_t ArtNetInput::open(uint16_t firstUniverse, uint16_t port)
+{
+    firstUniverse_ = firstUniverse;
+
+    sockfd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sockfd_ < 0)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to create socket");
+        return ESP_FAIL;
+    }
+
+    struct sockaddr_in listen_addr;
+    memset(&listen_addr, 0, sizeof(listen_addr));
+    listen_addr.sin_family = AF_INET;
+    listen_addr.sin_port = htons(port);
+    listen_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sockfd_, (struct sockaddr *)&listen_addr, sizeof(listen_addr)) < 0)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to bind to port %d", port);
+        close();
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(LOG_TAG, "Art-Net input listening on port %d, universes %d and %d", port, firstUniverse,
+        firstUniverse + 1);
+    return ESP_OK;
+}
+
+void ArtNetInput::close()
+{
+    if (sockfd_ >= 0)
+    {
+        ::close(sockfd_);
+        sockfd_ = -1;
+    }
+}
+
+void ArtNetInput::poll()
+{
+    if (sockfd_ < 0)
+    {
+        return;
+    }
+
+    ssize_t received;
+    while ((received = recv(sockfd_, packet_, sizeof(packet_), MSG_DONTWAIT)) > 0)
+    {
+        handlePacket(received);
+    }
+}
+
+void ArtNetInput::capture(Messages::PresetEventData &presetData) const
+{
+    presetData.universe1Length = universeLength_[0];
+    memcpy(presetData.universe1Data, universes_[0], universeLength_[0]);
+    presetData.universe2Length = universeLength_[1];
+    memcpy(presetData.universe2Data, universes_[1], universeLength_[1]);
+}
+
+void ArtNetInput::handlePacket(size_t length)
+{
+    // ArtDmx: ID, OpCode (little endian), protocol version, sequence, physical, SubUni, Net, length (big endian)
+    if (length < ARTDMX_HEADER_SIZE || memcmp(packet_, "Art-Net", 8) != 0 ||
+        (packet_[8] | (packet_[9] << 8)) != OP_DMX)
+    {
+        return;
+    }
+
+    uint16_t portAddress = packet_[14] | ((packet_[15] & 0x7F) << 8);
+    if (portAddress < firstUniverse_ || portAddress > firstUniverse_ + 1)
+    {
+        return;
+    }
+
+    uint16_t dataLength = (packet_[16] << 8) | packet_[17];
+    if (dataLength > DMX_UNIVERSE_SIZE || dataLength > length - ARTDMX_HEADER_SIZE)
+    {
+        ESP_LOGW(LOG_TAG, "Invalid ArtDmx length %d", dataLength);
+        return;
+    }
+
+    uint8_t universe = portAddress - firstUniverse_;
+    memcpy(universes_[universe], packet_ + ARTDMX_HEADER_SIZE, dataLength);
+    universeLength_[universe] = dataLength;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "dmx_frame.hpp"
+#include "messages.hpp"
+#include <esp_err.h>
+#include <lwip/sockets.h>
+#include <stdint.h>
+
+// Art-Net input, keeping the latest ArtDmx data of two consecutive universes (e.g. from a lighting console),
+// so it can be captured into a preset. Not a task of its own: the owner polls it without blocking.
+class ArtNetInput
+{
+  public:
+    ArtNetInput();
+    ~ArtNetInput();
+
+    // Listen for universes firstUniverse and firstUniverse + 1 (15-bit Art-Net port-addresses)
+    esp_err_t open(uint16_t firstUniverse, uint16_t port);
+    void close();
+
+    // Read all pending packets, keeping the latest data per universe
+    void poll();
+
+    bool hasData() const { return universeLength_[0] > 0 || universeLength_[1] > 0; }
+
+    // Copy the latest data into preset data (universes never received get length 0)
+    void capture(Messages::PresetEventData &presetData) const;
+
+  private:
+    static const size_t ARTDMX_HEADER_SIZE = 18;
+    static const size_t MAX_PACKET_SIZE = ARTDMX_HEADER_SIZE + DMX_UNIVERSE_SIZE;
+
+    int sockfd_;
+    uint16_t firstUniverse_;
+    uint8_t universes_[2][DMX_UNIVERSE_SIZE];
+    uint16_t universeLength_[2];
+    uint8_t packet_[MAX_PACKET_SIZE];
+
+    void handlePacket(size_t length);
+};
@@ -1,14 +1,18 @@
 #include "artnet_sender.hpp"
 #include <cstring>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <lwip/inet.h>
 #include <messages.hpp>
 
 static const char *LOG_TAG = "ArtNetSender";
 static const int QUEUE_CAPACITY = 20;
 static const int TASK_PRIORITY = 5;
+static const int FRAME_PERIOD_MS = 25; // Output refresh rate (40 frames per second)
 
-ArtNetSender::ArtNetSender() : RtosTask(), sockfd_(-1), sequence_counter_(0)
+ArtNetSender::ArtNetSender()
+    : RtosTask(), sockfd_(-1), sequence_counter_(0), worstOverrideLatencyUs_(0), currentPresetNumber_(0),
+      stackHighWaterMark_(0)
 {
     memset(&dest_addr_, 0, sizeof(dest_addr_));
 }
@@ -19,12 +23,13 @@ void ArtNetSender::taskEntry(void *param) { static_cast<ArtNetSender *>(param)->
 
 esp_err_t ArtNetSender::init(QueueHandle_t dmxControllerEventQueue, const char *dest_ip, uint16_t dest_port)
 {
-    if (RtosTask::init("ArtNetSenderTask", 2048, TASK_PRIORITY, QUEUE_CAPACITY, sizeof(Messages::Event),
+    if (RtosTask::init("ArtNetSenderTask", 4096, TASK_PRIORITY, QUEUE_CAPACITY, sizeof(Messages::Event),
             dmxControllerEventQueue) != ESP_OK)
     {
         ESP_LOGE(LOG_TAG, "Failed to initialize ArtNetSenderTask");
         return ESP_FAIL;
     }
+    liveOverrides_.init(eventQueue_);
 
     if (!dest_ip)
     {
@@ -57,6 +62,12 @@ esp_err_t ArtNetSender::init(QueueHandle_t dmxControllerEventQueue, const char *
         ESP_LOGW(LOG_TAG, "Failed to set broadcast option");
     }
 
+    // Art-Net input is only needed for capturing presets, so the sender works without it
+    if (artnetInput_.open(ARTNET_INPUT_UNIVERSE, ARTNET_PORT) != ESP_OK)
+    {
+        ESP_LOGW(LOG_TAG, "Art-Net input not available");
+    }
+
     initialized_ = true;
     ESP_LOGI(LOG_TAG, "Art-Net sender initialized, destination: %s:%d", dest_ip, dest_port);
     return ESP_OK;
@@ -65,32 +76,262 @@ esp_err_t ArtNetSender::init(QueueHandle_t dmxControllerEventQueue, const char *
 void ArtNetSender::taskLoop()
 {
     Messages::Event event;
+    const TickType_t framePeriod = pdMS_TO_TICKS(FRAME_PERIOD_MS);
+    TickType_t nextFrameTick = xTaskGetTickCount() + framePeriod;
     while (true)
     {
-        if (xQueueReceive(eventQueue_, &event, portMAX_DELAY) == pdTRUE)
+        // Wait for an event at most until the next frame is due; a steady stream of events (a fader being dragged)
+        // must not hold the frames back, so the deadline is checked after every event as well
+        TickType_t now = xTaskGetTickCount();
+        TickType_t timeout = (int32_t)(nextFrameTick - now) > 0 ? nextFrameTick - now : 0;
+        bool received = xQueueReceive(eventQueue_, &event, timeout) == pdTRUE;
+
+        // Keep the latest input data, the socket buffer would otherwise hold stale packets
+        artnetInput_.poll();
+
+        if (received)
         {
-            switch (event.type)
+            handleEvent(event);
+            logStackHighWaterMark();
+        }
+
+        now = xTaskGetTickCount();
+        if ((int32_t)(nextFrameTick - now) <= 0)
+        {
+            sendFrame();
+            nextFrameTick += framePeriod;
+            if ((int32_t)(nextFrameTick - now) <= 0)
             {
-            case Messages::SEND_PRESET_DATA:
-                sendUniverses(event.data.presetData.universe1Data, event.data.presetData.universe1Length,
-                    event.data.presetData.universe2Data, event.data.presetData.universe2Length);
-
-                // Send response back to DmxController (no response needed, but can be used for logging)
-                Messages::Event responseEvent;
-                responseEvent.type = Messages::EventType::SEND_PRESET_DATA_RESPONSE;
-                // TODO: Fill ack/nack
-                if (xQueueSend(getDmxControllerEventQueue(), &responseEvent, 0) != pdPASS)
-                {
-                    ESP_LOGE(LOG_TAG, "Failed to send preset data sent response to DmxController");
-                }
-                break;
+                // Fell behind by more than a frame: do not send a burst to catch up
+                nextFrameTick = now + framePeriod;
+            }
+        }
+    }
+}
+
+void ArtNetSender::handleEvent(Messages::Event &event)
+{
+    switch (event.type)
+    {
+    case Messages::SEND_PRESET_DATA:
+    {
+        outputStage_.setPreset(event.data.presetData);
+        currentPresetNumber_ = event.data.presetData.presetNumber;
+        sendFrame();
+
+        // Send response back to DmxController (no response needed, but can be used for logging). The event itself
+        // is the response, the stack has no room for a second one; it keeps the preset number.
+        event.type = Messages::EventType::SEND_PRESET_DATA_RESPONSE;
+        // TODO: Fill ack/nack
+        if (xQueueSend(getDmxControllerEventQueue(), &event, 0) != pdPASS)
+        {
+            ESP_LOGE(LOG_TAG, "Failed to send preset data sent response to DmxController");
+        }
+    }
+    break;
+
+    case Messages::DEFINE_GROUP:
+    case Messages::SET_GROUP_CHANNELS:
+    case Messages::SET_GROUP_LEVEL:
+    case Messages::SET_GRAND_MASTER:
+        handleMasterEvent(event);
+        break;
 
-            default:
-                // Ignore others.
+    case Messages::APPLY_LIVE_OVERRIDES:
+        // Send right away instead of waiting for the next frame period
+        sendFrame();
+        break;
+
+    case Messages::SET_LAYER_CHANNELS:
+    case Messages::RELEASE_LAYER_CHANNELS:
+    case Messages::SET_LAYER_MODE:
+        handleLayerEvent(event);
+        break;
+
+    case Messages::SET_EFFECT:
+    case Messages::SET_EFFECT_CHANNELS:
+    case Messages::STOP_EFFECT:
+        handleEffectEvent(event);
+        break;
+
+    case Messages::CAPTURE_PRESET:
+        capturePreset(event);
+        break;
+
+    case Messages::SET_CHANNEL_CURVE:
+        outputStage_.getCurves().setChannelCurve(event.data.curveData.firstChannel,
+            event.data.curveData.channelCount, (DmxCurves::CurveType)event.data.curveData.curveType,
+            event.data.curveData.table);
+        break;
+
+    default:
+        // Ignore others.
+        break;
+    }
+}
+
+// Logs the stack left unused, whenever it is less than before
+void ArtNetSender::logStackHighWaterMark()
+{
+    UBaseType_t unused = uxTaskGetStackHighWaterMark(nullptr);
+    if (stackHighWaterMark_ == 0 || unused < stackHighWaterMark_)
+    {
+        stackHighWaterMark_ = unused;
+        ESP_LOGI(LOG_TAG, "Stack high water mark: %u bytes unused", (unsigned)unused);
+    }
+}
+
+void ArtNetSender::handleMasterEvent(const Messages::Event &event)
+{
+    DmxMasters &masters = outputStage_.getMasters();
+    const Messages::MasterEventData &data = event.data.masterData;
+    switch (event.type)
+    {
+    case Messages::DEFINE_GROUP:
+        masters.setGroup(data.group, data.name);
+        break;
+
+    case Messages::SET_GROUP_CHANNELS:
+        masters.setGroupChannels(data.group, data.firstChannel, data.channelCount, data.member);
+        break;
+
+    case Messages::SET_GROUP_LEVEL:
+        masters.setGroupLevel(data.group, data.level);
+        break;
+
+    case Messages::SET_GRAND_MASTER:
+        masters.setGrandMaster(data.level);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void ArtNetSender::handleLayerEvent(const Messages::Event &event)
+{
+    DmxLayerStack &layers = outputStage_.getLayers();
+    const Messages::LayerEventData &data = event.data.layerData;
+    DmxLayerStack::Layer layer = (DmxLayerStack::Layer)data.layer;
+    switch (event.type)
+    {
+    case Messages::SET_LAYER_CHANNELS:
+        layers.setChannels(layer, data.firstChannel, data.values,
+            data.channelCount > sizeof(data.values) ? sizeof(data.values) : data.channelCount);
+        break;
+
+    case Messages::RELEASE_LAYER_CHANNELS:
+        layers.releaseChannels(layer, data.firstChannel, data.channelCount);
+        break;
+
+    case Messages::SET_LAYER_MODE:
+        layers.setLayerMode(layer, data.priority, (DmxLayerStack::MergeMode)data.mergeMode);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void ArtNetSender::handleEffectEvent(const Messages::Event &event)
+{
+    DmxEffects &effects = outputStage_.getEffects();
+    const Messages::EffectEventData &data = event.data.effectData;
+    switch (event.type)
+    {
+    case Messages::SET_EFFECT:
+    {
+        DmxEffects::Parameters parameters;
+        parameters.waveform = (DmxEffects::Waveform)data.waveform;
+        parameters.rateMilliHz = data.rateMilliHz;
+        parameters.phaseSpread = data.phaseSpread;
+        parameters.depth = data.depth;
+        parameters.offset = data.offset;
+        parameters.width = data.width;
+        parameters.fixtureChannels = data.fixtureChannels;
+        effects.setEffect(data.effect, parameters);
+    }
+    break;
+
+    case Messages::SET_EFFECT_CHANNELS:
+        if (data.group != Messages::NO_GROUP)
+        {
+            // Group membership is copied, later changes to the group do not affect the effect
+            const uint32_t *members = outputStage_.getMasters().getGroupMembers(data.group);
+            if (!members)
+            {
+                ESP_LOGE(LOG_TAG, "Group %d not defined", data.group);
                 break;
             }
+            effects.addEffectMembers(data.effect, members);
+        }
+        else
+        {
+            effects.setEffectChannels(data.effect, data.firstChannel, data.channelCount, data.member);
+        }
+        break;
+
+    case Messages::STOP_EFFECT:
+        effects.stopEffect(data.effect);
+        break;
+
+    default:
+        break;
+    }
+}
+
+void ArtNetSender::capturePreset(Messages::Event &event)
+{
+    Messages::CaptureEventData capture = event.data.captureData;
+    uint8_t presetNumber =
+        capture.presetNumber == Messages::CURRENT_PRESET ? currentPresetNumber_ : capture.presetNumber;
+
+    // The request event is reused for the captured data, so the frame is copied only once
+    event.type = Messages::PRESET_CAPTURED;
+    event.data.presetData.presetNumber = presetNumber;
+    event.data.presetData.name[0] = '\0';
+    if (capture.source == Messages::CAPTURE_ARTNET_INPUT)
+    {
+        if (!artnetInput_.hasData())
+        {
+            ESP_LOGE(LOG_TAG, "No Art-Net input received, nothing to capture");
+            return;
+        }
+        artnetInput_.capture(event.data.presetData);
+    }
+    else
+    {
+        outputStage_.capture(event.data.presetData);
+    }
+
+    if (xQueueSend(getDmxControllerEventQueue(), &event, 0) != pdPASS)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to send captured preset %d to DmxController", presetNumber);
+        return;
+    }
+    ESP_LOGI(LOG_TAG, "Captured %s into preset %d",
+        capture.source == Messages::CAPTURE_ARTNET_INPUT ? "Art-Net input" : "output", presetNumber);
+}
+
+void ArtNetSender::sendFrame()
+{
+    int64_t overridesSinceUs = liveOverrides_.getPendingSinceUs();
+    liveOverrides_.apply(outputStage_.getLayers());
+
+    const DmxFrame &frame = outputStage_.render();
+    sendUniverses(frame.universe(0), frame.universeLength[0], frame.universe(1), frame.universeLength[1]);
+
+    if (overridesSinceUs != 0)
+    {
+        uint32_t latencyUs = (uint32_t)(esp_timer_get_time() - overridesSinceUs);
+        if (latencyUs > worstOverrideLatencyUs_)
+        {
+            worstOverrideLatencyUs_ = latencyUs;
+            ESP_LOGI(LOG_TAG, "Worst live override latency: %lu us", (unsigned long)worstOverrideLatencyUs_);
         }
     }
+    ESP_LOGD(LOG_TAG, "Frame rendered in %lu us (worst %lu us)", (unsigned long)outputStage_.getLastRenderUs(),
+        (unsigned long)outputStage_.getWorstRenderUs());
 }
 
 esp_err_t ArtNetSender::sendUniverse(uint16_t universe, const uint8_t *data, uint16_t length)
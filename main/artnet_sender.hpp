@@ -9,6 +9,7 @@
 
 #define ARTNET_PORT 6454
 #define ARTNET_MAX_UNIVERSES 2
+#define ARTNET_INPUT_UNIVERSE 0 // First of the two Art-Net input universes that can be captured
 
 extern "C"
 {
@@ -16,6 +17,10 @@ extern "C"
 #include <freertos/queue.h>
 #include <freertos/task.h>
 }
+#include "artnet_input.hpp"
+#include "dmx_output_stage.hpp"
+#include "live_overrides.hpp"
+#include "messages.hpp"
 #include "rtos_task.hpp"
 
 class ArtNetSender : public RtosTask
@@ -49,13 +54,31 @@ class ArtNetSender : public RtosTask
     esp_err_t sendUniverses(
         const uint8_t *universe_1_data, uint16_t len_1, const uint8_t *universe_2_data, uint16_t len_2);
 
+    // Live channel overrides, applied to the output with the next frame
+    LiveOverrides &getLiveOverrides() { return liveOverrides_; }
+
   private:
     int sockfd_;
     struct sockaddr_in dest_addr_;
     uint8_t sequence_counter_;
 
+    DmxOutputStage outputStage_;
+    LiveOverrides liveOverrides_;
+    uint32_t worstOverrideLatencyUs_;
+    ArtNetInput artnetInput_;
+    uint8_t currentPresetNumber_;
+    UBaseType_t stackHighWaterMark_; // Least stack left unused so far, 0 until first measured
+
     void taskEntry(void *param) override;
     void taskLoop();
 
+    void handleEvent(Messages::Event &event);
+    void handleMasterEvent(const Messages::Event &event);
+    void handleLayerEvent(const Messages::Event &event);
+    void handleEffectEvent(const Messages::Event &event);
+    void capturePreset(Messages::Event &event);
+    void logStackHighWaterMark();
+    void sendFrame();
+
     void createDmxPacket(ArtNetDmxPacket &packet, uint16_t universe, const uint8_t *data, uint16_t length);
 };
\ No newline at end of file
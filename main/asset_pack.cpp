@@ -0,0 +1,150 @@
+#include "asset_pack.hpp"
+#include <cstring>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+
+static const char *LOG_TAG = "AssetPack";
+
+AssetPack::AssetPack() : pack_(nullptr), size_(0), count_(0), mmapHandle_(0), mapped_(false) {}
+
+AssetPack::~AssetPack()
+{
+    if (mapped_)
+    {
+        esp_partition_munmap(mmapHandle_);
+    }
+}
+
+esp_err_t AssetPack::init(const char *partitionLabel)
+{
+    const esp_partition_t *partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partitionLabel);
+    if (!partition)
+    {
+        ESP_LOGE(LOG_TAG, "Partition '%s' not found", partitionLabel);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    const void *mapped = nullptr;
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &mapped, &mmapHandle_);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to map partition '%s': %s", partitionLabel, esp_err_to_name(err));
+        return err;
+    }
+    mapped_ = true;
+
+    err = attach(static_cast<const uint8_t *>(mapped), partition->size);
+    if (err != ESP_OK)
+    {
+        esp_partition_munmap(mmapHandle_);
+        mapped_ = false;
+        return err;
+    }
+    ESP_LOGI(LOG_TAG, "%d assets, %lu bytes", count_, (unsigned long)size_);
+    return ESP_OK;
+}
+
+esp_err_t AssetPack::attach(const uint8_t *pack, size_t size)
+{
+    pack_ = nullptr;
+    count_ = 0;
+    if (size < HEADER_SIZE || memcmp(pack, "DMXA", 4) != 0)
+    {
+        // Also an erased partition
+        ESP_LOGW(LOG_TAG, "No asset pack");
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    uint16_t version = readUint16(pack + 4);
+    uint16_t count = readUint16(pack + 6);
+    uint32_t packSize = readUint32(pack + 8);
+    if (version != VERSION || packSize > size || packSize < HEADER_SIZE + (uint32_t)count * ENTRY_SIZE)
+    {
+        ESP_LOGE(LOG_TAG, "Unsupported asset pack (version %d, %lu bytes)", version, (unsigned long)packSize);
+        return ESP_ERR_INVALID_VERSION;
+    }
+    if (esp_rom_crc32_le(0, pack + HEADER_SIZE, packSize - HEADER_SIZE) != readUint32(pack + 12))
+    {
+        ESP_LOGE(LOG_TAG, "Asset pack CRC mismatch");
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    // Every offset within the pack, so lookups need no checks; paths ascending, so a binary search finds them
+    const char *previous = nullptr;
+    for (uint16_t index = 0; index < count; index++)
+    {
+        const uint8_t *e = pack + HEADER_SIZE + index * ENTRY_SIZE;
+        uint32_t gzipEtag = readUint32(e + 12);
+        const char *path = reinterpret_cast<const char *>(pack + readUint32(e));
+        if (!isString(pack, packSize, readUint32(e)) || !isString(pack, packSize, readUint32(e + 4)) ||
+            !isString(pack, packSize, readUint32(e + 8)) || (gzipEtag != 0 && !isString(pack, packSize, gzipEtag)) ||
+            !isRange(packSize, readUint32(e + 16), readUint32(e + 20)) ||
+            !isRange(packSize, readUint32(e + 24), readUint32(e + 28)) || path[0] != '/' ||
+            (previous && comparePath(previous, path, strlen(path)) >= 0))
+        {
+            ESP_LOGE(LOG_TAG, "Asset pack entry %d is invalid", index);
+            return ESP_ERR_INVALID_STATE;
+        }
+        previous = path;
+    }
+
+    pack_ = pack;
+    size_ = packSize;
+    count_ = count;
+    return ESP_OK;
+}
+
+bool AssetPack::find(const char *path, size_t pathLength, Asset &asset) const
+{
+    int low = 0;
+    int high = (int)count_ - 1;
+    while (low <= high)
+    {
+        int middle = (low + high) / 2;
+        const uint8_t *e = entry(middle);
+        int order = comparePath(string(readUint32(e)), path, pathLength);
+        if (order < 0)
+        {
+            low = middle + 1;
+        }
+        else if (order > 0)
+        {
+            high = middle - 1;
+        }
+        else
+        {
+            uint32_t gzipEtag = readUint32(e + 12);
+            asset.path = string(readUint32(e));
+            asset.contentType = string(readUint32(e + 4));
+            asset.etag = string(readUint32(e + 8));
+            asset.length = readUint32(e + 20);
+            asset.data = asset.length != 0 || gzipEtag == 0 ? pack_ + readUint32(e + 16) : nullptr;
+            asset.gzipEtag = gzipEtag != 0 ? string(gzipEtag) : nullptr;
+            asset.gzipData = gzipEtag != 0 ? pack_ + readUint32(e + 24) : nullptr;
+            asset.gzipLength = gzipEtag != 0 ? readUint32(e + 28) : 0;
+            return true;
+        }
+    }
+    return false;
+}
+
+// Bytewise (unsigned) order of a NUL-terminated path and a path with a length, as the packer sorts them
+int AssetPack::comparePath(const char *stored, const char *path, size_t pathLength)
+{
+    for (size_t i = 0; i < pathLength; i++)
+    {
+        uint8_t a = stored[i];
+        uint8_t b = path[i];
+        if (a != b || a == '\0')
+        {
+            return a < b ? -1 : 1;
+        }
+    }
+    return stored[pathLength] == '\0' ? 0 : 1;
+}
+
+bool AssetPack::isString(const uint8_t *pack, uint32_t size, uint32_t offset)
+{
+    return offset >= HEADER_SIZE && offset < size && memchr(pack + offset, '\0', size - offset) != nullptr;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <esp_err.h>
+#include <esp_partition.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Static files of the web UI, packed by tools/pack_assets.py into one data partition. The partition is memory
+// mapped, so a request is a binary search over the index and a send straight from flash: no file system lookups and
+// no copies. The pack also holds what the response headers need (content type, ETag, gzip variant).
+//
+// Layout (little endian, offsets from the start of the pack):
+//   header: char magic[4] ("DMXA"), uint16 version, uint16 count, uint32 size, uint32 crc (of bytes HEADER_SIZE..size)
+//   count entries, sorted by path (bytewise):
+//     uint32 path, uint32 contentType, uint32 etag, uint32 gzipEtag (string offsets, gzipEtag 0 without a variant)
+//     uint32 offset, uint32 length, uint32 gzipOffset, uint32 gzipLength (file data; offset and length 0 with a
+//     gzip variant if only that is stored)
+//   NUL-terminated strings (ETags quoted) and file data
+// The whole pack is checked once by init, lookups trust it.
+class AssetPack
+{
+  public:
+    struct Asset
+    {
+        const char *path;
+        const char *contentType;
+        const char *etag; // Quoted
+        const uint8_t *data; // nullptr if only the gzip variant is stored
+        uint32_t length;
+        const char *gzipEtag; // Quoted, nullptr without a gzip variant
+        const uint8_t *gzipData;
+        uint32_t gzipLength;
+    };
+
+    AssetPack();
+    ~AssetPack();
+
+    // Map the partition and check the pack in it
+    esp_err_t init(const char *partitionLabel);
+
+    // Use a pack that is already in memory and stays valid, after checking it
+    esp_err_t attach(const uint8_t *pack, size_t size);
+
+    bool isLoaded() const { return pack_ != nullptr; }
+    uint16_t getNumberOfAssets() const { return count_; }
+
+    // Look up a path (e.g. "/assets/index-BIMoyukT.js", without the query)
+    bool find(const char *path, size_t pathLength, Asset &asset) const;
+
+  private:
+    static const size_t HEADER_SIZE = 16;
+    static const size_t ENTRY_SIZE = 32;
+    static const uint16_t VERSION = 1;
+
+    const uint8_t *pack_;
+    uint32_t size_;
+    uint16_t count_;
+    esp_partition_mmap_handle_t mmapHandle_;
+    bool mapped_;
+
+    static uint16_t readUint16(const uint8_t *data) { return data[0] | (data[1] << 8); }
+    static uint32_t readUint32(const uint8_t *data)
+    {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+    }
+    static int comparePath(const char *stored, const char *path, size_t pathLength);
+    const char *string(uint32_t offset) const { return reinterpret_cast<const char *>(pack_ + offset); }
+    const uint8_t *entry(uint16_t index) const { return pack_ + HEADER_SIZE + index * ENTRY_SIZE; }
+    static bool isString(const uint8_t *pack, uint32_t size, uint32_t offset);
+    static bool isRange(uint32_t size, uint32_t offset, uint32_t length)
+    {
+        return offset <= size && length <= size - offset;
+    }
+};
@@ -5,6 +5,9 @@
 static const char *LOG_TAG = "DmxController";
 static const int QUEUE_CAPACITY = 10;
 static const int TASK_PRIORITY = 5;
+// The Web Server has answered already when it forwards an edit, so a full queue is waited for instead of dropping it;
+// also used at startup, when the other tasks may not have emptied their queues yet
+static const int FORWARD_TIMEOUT_MS = 100;
 
 DmxController::DmxController() : RtosTask() {}
 
@@ -12,10 +15,12 @@ DmxController::~DmxController()
 {
     delete presetChanger;
     delete oscSender;
+    delete oscReceiver;
     delete display;
     delete footSwitch;
     delete artnetSender;
     delete webServer;
+    delete nvsStorage;
 }
 
 void DmxController::printFirmwareInfo()
@@ -29,6 +34,13 @@ void DmxController::printFirmwareInfo()
 esp_err_t DmxController::performOtaUpdate(const char *url)
 {
     printf("Starting OTA update from: %s\n", url);
+
+    // Write edits still held back by the storage task before the (long) download starts
+    if (nvsStorage)
+    {
+        nvsStorage->flush();
+    }
+
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wmissing-field-initializers"
     esp_http_client_config_t config = {
@@ -58,7 +70,7 @@ esp_err_t DmxController::performOtaUpdate(const char *url)
 esp_err_t DmxController::init()
 {
     QueueHandle_t queue = getEventQueue(); // Unused
-    if (RtosTask::init("DmxControllerTask", 2048, TASK_PRIORITY, QUEUE_CAPACITY, sizeof(Messages::Event), queue) !=
+    if (RtosTask::init("DmxControllerTask", 4096, TASK_PRIORITY, QUEUE_CAPACITY, sizeof(Messages::Event), queue) !=
         ESP_OK)
     {
         ESP_LOGE(LOG_TAG, "Failed to initialize DmxControllerTask");
@@ -87,8 +99,15 @@ esp_err_t DmxController::init()
 
 esp_err_t DmxController::init_sub_tasks()
 {
+    nvsStorage = new NvsStorage();
+    if (nvsStorage->init(getEventQueue()) != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to initialize NvsStorage");
+        return ESP_FAIL;
+    }
+
     presetChanger = new DmxPresetChanger();
-    if (presetChanger->init(getEventQueue()) != ESP_OK)
+    if (presetChanger->init(getEventQueue(), nvsStorage) != ESP_OK)
     {
         ESP_LOGE(LOG_TAG, "Failed to initialize DmxPresetChanger");
         return ESP_FAIL;
@@ -123,16 +142,16 @@ esp_err_t DmxController::init_sub_tasks()
     }
 
     webServer = new WebServer();
-    if (webServer->init() != ESP_OK)
+    if (webServer->init(getEventQueue(), &artnetSender->getLiveOverrides(), nvsStorage) != ESP_OK)
     {
         ESP_LOGE(LOG_TAG, "Failed to initialize WebServer");
         return ESP_FAIL;
     }
 
-    nvsStorage = new NvsStorage();
-    if (nvsStorage->init(getEventQueue()) != ESP_OK)
+    oscReceiver = new OscReceiver();
+    if (oscReceiver->init(getEventQueue(), &artnetSender->getLiveOverrides()) != ESP_OK)
     {
-        ESP_LOGE(LOG_TAG, "Failed to initialize NvsStorage");
+        ESP_LOGE(LOG_TAG, "Failed to initialize OscReceiver");
         return ESP_FAIL;
     }
 
@@ -144,7 +163,7 @@ esp_err_t DmxController::init_messages()
     // Send a message to NvsStorage to request config
     Messages::Event event = Messages::Event();
     event.type = Messages::REQUEST_CONFIGURATION;
-    if (xQueueSend(nvsStorage->getEventQueue(), &event, 0) != pdPASS)
+    if (xQueueSend(nvsStorage->getEventQueue(), &event, pdMS_TO_TICKS(FORWARD_TIMEOUT_MS)) != pdPASS)
     {
         ESP_LOGE(LOG_TAG, "Failed to send configuration request to NvsStorage");
         return ESP_FAIL;
@@ -162,11 +181,16 @@ esp_err_t DmxController::init_messages()
         return ESP_FAIL;
     }
 
+    WebServer::WebServerEvent webServerEvent = WebServer::WebServerEvent();
+    webServerEvent.type = WebServer::CONFIGURATION_CHANGED;
+    webServerEvent.data.configuration = event.data.configurationData;
+    webServer->postEvent(webServerEvent);
+
     // Send config response to FootSwitch (no response needed)
     Messages::Event footSwitchEvent = Messages::Event();
     footSwitchEvent.type = Messages::SET_CONFIGURATION;
     footSwitchEvent.data.configurationData = event.data.configurationData;
-    if (xQueueSend(footSwitch->getEventQueue(), &footSwitchEvent, 0) != pdPASS)
+    if (xQueueSend(footSwitch->getEventQueue(), &footSwitchEvent, pdMS_TO_TICKS(FORWARD_TIMEOUT_MS)) != pdPASS)
     {
         ESP_LOGE(LOG_TAG, "Failed to send configuration to FootSwitch");
         return ESP_FAIL;
@@ -174,7 +198,7 @@ esp_err_t DmxController::init_messages()
 
     // Send a message to NvsStorage to request presets
     event.type = Messages::REQUEST_PRESETS;
-    if (xQueueSend(nvsStorage->getEventQueue(), &event, 0) != pdPASS)
+    if (xQueueSend(nvsStorage->getEventQueue(), &event, pdMS_TO_TICKS(FORWARD_TIMEOUT_MS)) != pdPASS)
     {
         ESP_LOGE(LOG_TAG, "Failed to send presets request to NvsStorage");
         return ESP_FAIL;
@@ -192,11 +216,15 @@ esp_err_t DmxController::init_messages()
         return ESP_FAIL;
     }
 
+    webServerEvent.type = WebServer::PRESETS_CHANGED;
+    webServerEvent.data.numberOfPresets = event.data.presetsData.numberOfPresets;
+    webServer->postEvent(webServerEvent);
+
     // Send presets to DmxPresetChanger (no response needed)
     Messages::Event presetChangerEvent = Messages::Event();
     presetChangerEvent.type = Messages::SET_PRESETS;
     presetChangerEvent.data.presetsData = event.data.presetsData;
-    if (xQueueSend(presetChanger->getEventQueue(), &presetChangerEvent, 0) != pdPASS)
+    if (xQueueSend(presetChanger->getEventQueue(), &presetChangerEvent, pdMS_TO_TICKS(FORWARD_TIMEOUT_MS)) != pdPASS)
     {
         ESP_LOGE(LOG_TAG, "Failed to send presets to DmxPresetChanger");
         return ESP_FAIL;
@@ -211,9 +239,9 @@ void DmxController::taskLoop()
     {
         // TODO: call performOtaUpdate, etc.
 
-        // Handle next preset event from FootSwitch
+        // Handle events from FootSwitch, DmxPresetChanger, ArtNetSender and WebServer
         Messages::Event event;
-        if (xQueueReceive(getEventQueue(), &event, 0) == pdTRUE)
+        if (xQueueReceive(getEventQueue(), &event, portMAX_DELAY) == pdTRUE)
         {
             switch (event.type)
             {
@@ -247,10 +275,7 @@ void DmxController::taskLoop()
                 Messages::Event artNetEvent = Messages::Event();
                 artNetEvent.type = Messages::EventType::SEND_PRESET_DATA;
                 artNetEvent.data.presetData = event.data.presetData;
-                if (xQueueSend(artnetSender->getEventQueue(), &artNetEvent, 0) != pdPASS)
-                {
-                    ESP_LOGE(LOG_TAG, "Failed to forward preset data to ArtNetSender");
-                }
+                forwardEdit(artnetSender->getEventQueue(), artNetEvent, "ArtNetSender");
             }
             break;
 
@@ -264,6 +289,83 @@ void DmxController::taskLoop()
                 {
                     ESP_LOGE(LOG_TAG, "Failed to forward preset index to SevenSegmentDisplay");
                 }
+
+                WebServer::WebServerEvent webServerEvent = WebServer::WebServerEvent();
+                webServerEvent.type = WebServer::PRESET_SELECTED;
+                webServerEvent.data.presetNumber = event.data.presetData.presetNumber;
+                webServer->postEvent(webServerEvent);
+            }
+            break;
+
+            case Messages::EventType::DEFINE_GROUP:
+            case Messages::EventType::SET_GROUP_CHANNELS:
+            case Messages::EventType::SET_GROUP_LEVEL:
+            case Messages::EventType::SET_GRAND_MASTER:
+            case Messages::EventType::SET_CHANNEL_CURVE:
+            case Messages::EventType::SET_LAYER_CHANNELS:
+            case Messages::EventType::RELEASE_LAYER_CHANNELS:
+            case Messages::EventType::SET_LAYER_MODE:
+            case Messages::EventType::SET_EFFECT:
+            case Messages::EventType::SET_EFFECT_CHANNELS:
+            case Messages::EventType::STOP_EFFECT:
+            case Messages::EventType::CAPTURE_PRESET:
+            {
+                // Forward to ArtNetSender, which owns the output stage; it empties its queue at least every frame
+                forwardEdit(artnetSender->getEventQueue(), event, "ArtNetSender");
+            }
+            break;
+
+            case Messages::EventType::APPLY_PRESET_DELTA:
+            case Messages::EventType::REPLACE_PRESET:
+            case Messages::EventType::RECALL_PRESET:
+            {
+                // Forward to DmxPresetChanger, which holds the preset to edit or recall
+                forwardEdit(presetChanger->getEventQueue(), event, "DmxPresetChanger");
+            }
+            break;
+
+            case Messages::EventType::SET_CONFIGURATION:
+            {
+                // Imported or edited by the Web Server, which has stored it already
+                forwardEdit(footSwitch->getEventQueue(), event, "FootSwitch");
+
+                WebServer::WebServerEvent webServerEvent = WebServer::WebServerEvent();
+                webServerEvent.type = WebServer::CONFIGURATION_CHANGED;
+                webServerEvent.data.configuration = event.data.configurationData;
+                webServer->postEvent(webServerEvent);
+            }
+            break;
+
+            case Messages::EventType::SET_PRESETS:
+            {
+                // Presets imported by the Web Server are stored already, DmxPresetChanger reloads them
+                forwardEdit(presetChanger->getEventQueue(), event, "DmxPresetChanger");
+
+                WebServer::WebServerEvent webServerEvent = WebServer::WebServerEvent();
+                webServerEvent.type = WebServer::PRESETS_CHANGED;
+                webServerEvent.data.numberOfPresets = event.data.presetsData.numberOfPresets;
+                webServer->postEvent(webServerEvent);
+            }
+            break;
+
+            case Messages::EventType::STORE_PRESET:
+            {
+                event.type = Messages::EventType::SET_PRESET;
+                if (forwardEdit(nvsStorage->getEventQueue(), event, "NvsStorage"))
+                {
+                    WebServer::WebServerEvent webServerEvent = WebServer::WebServerEvent();
+                    webServerEvent.type = WebServer::PRESET_CHANGED;
+                    webServerEvent.data.presetNumber = event.data.presetData.presetNumber;
+                    webServer->postEvent(webServerEvent);
+                }
+            }
+            break;
+
+            case Messages::EventType::PRESET_CAPTURED:
+            {
+                // DmxPresetChanger merges the captured values into the preset and has it stored
+                event.type = Messages::EventType::UPDATE_PRESET;
+                forwardEdit(presetChanger->getEventQueue(), event, "DmxPresetChanger");
             }
             break;
 
@@ -271,10 +373,42 @@ void DmxController::taskLoop()
                 // Ignore other events
                 break;
             }
-
-            vTaskDelay(pdMS_TO_TICKS(100));
         }
     }
 }
 
 void DmxController::taskEntry(void *param) { static_cast<DmxController *>(param)->taskLoop(); }
+
+// Forwards an edit the sender has already confirmed, waiting for room in the queue. An edit that still cannot be
+// forwarded is lost; that is reported to the /ws/state clients, so the web interface does not show it as done.
+bool DmxController::forwardEdit(QueueHandle_t queue, const Messages::Event &event, const char *receiver)
+{
+    if (xQueueSend(queue, &event, pdMS_TO_TICKS(FORWARD_TIMEOUT_MS)) == pdPASS)
+    {
+        return true;
+    }
+    ESP_LOGE(LOG_TAG, "Failed to forward event %d to %s, the change is lost", event.type, receiver);
+
+    WebServer::WebServerEvent webServerEvent = WebServer::WebServerEvent();
+    webServerEvent.type = WebServer::PRESET_EDIT_FAILED;
+    switch (event.type)
+    {
+    case Messages::EventType::APPLY_PRESET_DELTA:
+        webServerEvent.data.presetNumber = event.data.presetDeltaData.presetNumber;
+        break;
+    case Messages::EventType::REPLACE_PRESET:
+    case Messages::EventType::SET_PRESET:
+    case Messages::EventType::UPDATE_PRESET:
+    case Messages::EventType::SEND_PRESET_DATA:
+        webServerEvent.data.presetNumber = event.data.presetData.presetNumber;
+        break;
+    case Messages::EventType::CAPTURE_PRESET:
+        webServerEvent.data.presetNumber = event.data.captureData.presetNumber;
+        break;
+    default:
+        webServerEvent.type = WebServer::EDIT_FAILED;
+        break;
+    }
+    webServer->postEvent(webServerEvent);
+    return false;
+}
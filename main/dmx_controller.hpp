@@ -5,6 +5,7 @@
 #include "driver/gpio.h"
 #include "foot_switch.hpp"
 #include "nvs_storage.hpp"
+#include "osc_receiver.hpp"
 #include "osc_sender.hpp"
 #include "rtos_task.hpp"
 #include "seven_segment_display.hpp"
@@ -42,6 +43,7 @@ class DmxController : public RtosTask
 
     DmxPresetChanger *presetChanger = nullptr;
     OSCSender *oscSender = nullptr;
+    OscReceiver *oscReceiver = nullptr;
     SevenSegmentDisplay *display = nullptr;
     FootSwitch *footSwitch = nullptr;
     ArtNetSender *artnetSender = nullptr;
@@ -51,4 +53,5 @@ class DmxController : public RtosTask
     TickType_t bootTime = 0;
 
     void taskEntry(void *param) override;
+    bool forwardEdit(QueueHandle_t queue, const Messages::Event &event, const char *receiver);
 };
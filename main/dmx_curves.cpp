@@ -0,0 +1,152 @@
+#include "dmx_curves.hpp"
+#include <cstring>
+#include <esp_log.h>
+
+static const char *LOG_TAG = "DmxCurves";
+
+DmxCurves::DmxCurves() : numCurvedChannels_(0)
+{
+    compileTable(LINEAR, tables_[LINEAR_TABLE]);
+    memset(tableUsed_, 0, sizeof(tableUsed_));
+    tableUsed_[LINEAR_TABLE] = true;
+    memset(channelTable_, LINEAR_TABLE, sizeof(channelTable_));
+}
+
+esp_err_t DmxCurves::setChannelCurve(
+    uint16_t firstChannel, uint16_t channelCount, CurveType type, const uint8_t *customTable)
+{
+    if (firstChannel >= DMX_FRAME_CHANNELS || channelCount > DMX_FRAME_CHANNELS - firstChannel)
+    {
+        ESP_LOGE(LOG_TAG, "Channels %d..%d out of range (max %d)", firstChannel, firstChannel + channelCount - 1,
+            DMX_FRAME_CHANNELS - 1);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint8_t table[256];
+    if (type == CUSTOM)
+    {
+        if (!customTable)
+        {
+            ESP_LOGE(LOG_TAG, "Custom curve without table");
+            return ESP_ERR_INVALID_ARG;
+        }
+        memcpy(table, customTable, sizeof(table));
+    }
+    else
+    {
+        compileTable(type, table);
+    }
+
+    int tableIndex = findOrAddTable(table);
+    if (tableIndex < 0)
+    {
+        // Tables may have been freed by earlier reassignments
+        releaseUnusedTables();
+        tableIndex = findOrAddTable(table);
+        if (tableIndex < 0)
+        {
+            ESP_LOGE(LOG_TAG, "No free curve table (max %d)", MAX_CURVE_TABLES);
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    for (uint16_t channel = firstChannel; channel < firstChannel + channelCount; channel++)
+    {
+        if (channelTable_[channel] == LINEAR_TABLE && tableIndex != LINEAR_TABLE)
+        {
+            numCurvedChannels_++;
+        }
+        else if (channelTable_[channel] != LINEAR_TABLE && tableIndex == LINEAR_TABLE)
+        {
+            numCurvedChannels_--;
+        }
+        channelTable_[channel] = (uint8_t)tableIndex;
+    }
+    return ESP_OK;
+}
+
+uint8_t DmxCurves::getNumTables() const
+{
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < MAX_CURVE_TABLES; i++)
+    {
+        count += tableUsed_[i] ? 1 : 0;
+    }
+    return count;
+}
+
+void DmxCurves::apply(DmxFrame &frame) const
+{
+    if (numCurvedChannels_ == 0)
+    {
+        return;
+    }
+
+    // Branch-free pass: linear channels look up the identity table
+    uint8_t *channels = frame.channels();
+    for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+    {
+        channels[channel] = tables_[channelTable_[channel]][channels[channel]];
+    }
+}
+
+void DmxCurves::compileTable(CurveType type, uint8_t *table)
+{
+    for (uint32_t v = 0; v < 256; v++)
+    {
+        switch (type)
+        {
+        case SQUARE_LAW:
+            table[v] = (uint8_t)((v * v + 127) / 255);
+            break;
+
+        case S_CURVE:
+            // Smoothstep 3x^2 - 2x^3 in integer arithmetic (x = v / 255)
+            table[v] = (uint8_t)((v * v * (3 * 255 - 2 * v) + (255 * 255) / 2) / (255 * 255));
+            break;
+
+        case LINEAR:
+        default:
+            table[v] = (uint8_t)v;
+            break;
+        }
+    }
+}
+
+int DmxCurves::findOrAddTable(const uint8_t *table)
+{
+    int freeIndex = -1;
+    for (uint8_t i = 0; i < MAX_CURVE_TABLES; i++)
+    {
+        if (tableUsed_[i] && memcmp(tables_[i], table, 256) == 0)
+        {
+            return i;
+        }
+        if (!tableUsed_[i] && freeIndex < 0)
+        {
+            freeIndex = i;
+        }
+    }
+
+    if (freeIndex >= 0)
+    {
+        memcpy(tables_[freeIndex], table, 256);
+        tableUsed_[freeIndex] = true;
+    }
+    return freeIndex;
+}
+
+void DmxCurves::releaseUnusedTables()
+{
+    bool referenced[MAX_CURVE_TABLES] = {false};
+    referenced[LINEAR_TABLE] = true;
+    for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+    {
+        referenced[channelTable_[channel]] = true;
+    }
+
+    for (uint8_t i = 0; i < MAX_CURVE_TABLES; i++)
+    {
+        tableUsed_[i] = referenced[i];
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "dmx_frame.hpp"
+#include <esp_err.h>
+#include <stdint.h>
+
+// Number of distinct curve tables, including the linear table
+#define MAX_CURVE_TABLES 8
+
+// Per-channel response curves, compiled into 256-entry lookup tables and applied to the output frame
+class DmxCurves
+{
+  public:
+    enum CurveType
+    {
+        LINEAR,
+        SQUARE_LAW,
+        S_CURVE,
+        CUSTOM
+    };
+
+    DmxCurves();
+
+    // Assign a curve to a range of frame channels (0..1023); customTable (256 entries) is only used for CUSTOM.
+    // Identical tables are shared between channels.
+    esp_err_t setChannelCurve(uint16_t firstChannel, uint16_t channelCount, CurveType type, const uint8_t *customTable);
+
+    // Number of distinct tables in use, including the linear table
+    uint8_t getNumTables() const;
+
+    // Map all channel values through their curve
+    void apply(DmxFrame &frame) const;
+
+  private:
+    static const uint8_t LINEAR_TABLE = 0;
+
+    uint8_t tables_[MAX_CURVE_TABLES][256];
+    bool tableUsed_[MAX_CURVE_TABLES];
+    uint8_t channelTable_[DMX_FRAME_CHANNELS]; // Table index per frame channel
+    uint16_t numCurvedChannels_;               // Channels not using the linear table
+
+    static void compileTable(CurveType type, uint8_t *table);
+    int findOrAddTable(const uint8_t *table);
+    void releaseUnusedTables();
+};
@@ -0,0 +1,260 @@
+#include "dmx_effects.hpp"
+#include <cstring>
+#include <esp_log.h>
+#include <esp_random.h>
+
+static const char *LOG_TAG = "DmxEffects";
+
+// Longest time step taken at once, so effects do not jump after a stall
+static const int64_t MAX_STEP_US = 100000;
+
+// One sine cycle, 0..255 centred on 128
+static const uint8_t SINE_TABLE[256] = {
+    128, 131, 134, 137, 140, 143, 146, 149, 152, 155, 158, 162, 165, 167, 170, 173,
+    176, 179, 182, 185, 188, 190, 193, 196, 198, 201, 203, 206, 208, 211, 213, 215,
+    218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 238, 240, 241, 243, 244,
+    245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255,
+    255, 255, 255, 255, 254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
+    245, 244, 243, 241, 240, 238, 237, 235, 234, 232, 230, 228, 226, 224, 222, 220,
+    218, 215, 213, 211, 208, 206, 203, 201, 198, 196, 193, 190, 188, 185, 182, 179,
+    176, 173, 170, 167, 165, 162, 158, 155, 152, 149, 146, 143, 140, 137, 134, 131,
+    128, 124, 121, 118, 115, 112, 109, 106, 103, 100, 97, 93, 90, 88, 85, 82,
+    79, 76, 73, 70, 67, 65, 62, 59, 57, 54, 52, 49, 47, 44, 42, 40,
+    37, 35, 33, 31, 29, 27, 25, 23, 21, 20, 18, 17, 15, 14, 12, 11,
+    10, 9, 7, 6, 5, 5, 4, 3, 2, 2, 1, 1, 1, 0, 0, 0,
+    0, 0, 0, 0, 1, 1, 1, 2, 2, 3, 4, 5, 5, 6, 7, 9,
+    10, 11, 12, 14, 15, 17, 18, 20, 21, 23, 25, 27, 29, 31, 33, 35,
+    37, 40, 42, 44, 47, 49, 52, 54, 57, 59, 62, 65, 67, 70, 73, 76,
+    79, 82, 85, 88, 90, 93, 97, 100, 103, 106, 109, 112, 115, 118, 121, 124,
+};
+
+// Sine with linear interpolation between table entries (phase 2^32 = one cycle)
+static inline uint32_t sineAt(uint32_t phase)
+{
+    uint32_t index = phase >> 24;
+    uint32_t fraction = (phase >> 16) & 0xFF;
+    int32_t a = SINE_TABLE[index];
+    int32_t b = SINE_TABLE[(index + 1) & 0xFF];
+    return (uint32_t)(a + (((b - a) * (int32_t)fraction) >> 8));
+}
+
+// Cheap integer hash, gives each channel its own random value per cycle
+static inline uint32_t randomAt(uint32_t seed, uint32_t cycle, uint16_t channel)
+{
+    uint32_t x = seed ^ (cycle * 0x9E3779B1) ^ (channel * 0x85EBCA6B);
+    x ^= x >> 15;
+    x *= 0x2C1B3C6D;
+    x ^= x >> 12;
+    return x >> 24;
+}
+
+DmxEffects::DmxEffects() : lastApplyUs_(0), layerInUse_(false)
+{
+    memset(effects_, 0, sizeof(effects_));
+    memset(owned_, 0, sizeof(owned_));
+}
+
+esp_err_t DmxEffects::setEffect(uint8_t effect, const Parameters &parameters)
+{
+    if (effect >= MAX_EFFECTS)
+    {
+        ESP_LOGE(LOG_TAG, "Effect %d out of range (max %d)", effect, MAX_EFFECTS - 1);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (parameters.waveform >= NUM_WAVEFORMS || parameters.rateMilliHz > MAX_RATE_MILLI_HZ ||
+        parameters.fixtureChannels == 0)
+    {
+        ESP_LOGE(LOG_TAG, "Invalid effect parameters (waveform %d, rate %lu mHz, %d channels per fixture)",
+            parameters.waveform, (unsigned long)parameters.rateMilliHz, parameters.fixtureChannels);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    Effect &e = effects_[effect];
+    if (!e.used)
+    {
+        memset(e.members, 0, sizeof(e.members));
+        e.phase = 0;
+        e.cycles = 0;
+        e.seed = esp_random();
+        e.used = true;
+    }
+    e.parameters = parameters;
+
+    // 2^32 phase per cycle, 10^9 microseconds per 1000 seconds; fits in 64 bits up to the maximum rate
+    e.phaseStepQ16 = ((uint64_t)parameters.rateMilliHz << 48) / 1000000000ULL;
+    return ESP_OK;
+}
+
+esp_err_t DmxEffects::setEffectChannels(uint8_t effect, uint16_t firstChannel, uint16_t channelCount, bool member)
+{
+    if (effect >= MAX_EFFECTS || !effects_[effect].used)
+    {
+        ESP_LOGE(LOG_TAG, "Effect %d not defined", effect);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (firstChannel >= DMX_FRAME_CHANNELS || channelCount > DMX_FRAME_CHANNELS - firstChannel)
+    {
+        ESP_LOGE(LOG_TAG, "Channels %d..%d out of range (max %d)", firstChannel, firstChannel + channelCount - 1,
+            DMX_FRAME_CHANNELS - 1);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t *members = effects_[effect].members;
+    for (uint16_t channel = firstChannel; channel < firstChannel + channelCount; channel++)
+    {
+        if (member)
+        {
+            members[channel >> 5] |= 1UL << (channel & 31);
+        }
+        else
+        {
+            members[channel >> 5] &= ~(1UL << (channel & 31));
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t DmxEffects::addEffectMembers(uint8_t effect, const uint32_t *members)
+{
+    if (effect >= MAX_EFFECTS || !effects_[effect].used || !members)
+    {
+        ESP_LOGE(LOG_TAG, "Effect %d not defined", effect);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    for (uint16_t i = 0; i < BITMAP_WORDS; i++)
+    {
+        effects_[effect].members[i] |= members[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t DmxEffects::stopEffect(uint8_t effect)
+{
+    if (effect >= MAX_EFFECTS)
+    {
+        ESP_LOGE(LOG_TAG, "Effect %d out of range (max %d)", effect, MAX_EFFECTS - 1);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    memset(&effects_[effect], 0, sizeof(effects_[effect]));
+    return ESP_OK;
+}
+
+uint8_t DmxEffects::getNumActiveEffects() const
+{
+    uint8_t count = 0;
+    for (uint8_t effect = 0; effect < MAX_EFFECTS; effect++)
+    {
+        if (effects_[effect].used)
+        {
+            count++;
+        }
+    }
+    return count;
+}
+
+void DmxEffects::apply(DmxLayerStack &layers, int64_t nowUs)
+{
+    int64_t stepUs = lastApplyUs_ == 0 ? 0 : nowUs - lastApplyUs_;
+    if (stepUs < 0 || stepUs > MAX_STEP_US)
+    {
+        stepUs = MAX_STEP_US;
+    }
+    lastApplyUs_ = nowUs;
+
+    if (getNumActiveEffects() == 0)
+    {
+        // Hand the effect layer back once the last effect has stopped
+        if (layerInUse_)
+        {
+            layers.releaseAll(DmxLayerStack::EFFECT);
+            layerInUse_ = false;
+        }
+        return;
+    }
+
+    uint8_t *values = layers.getValues(DmxLayerStack::EFFECT);
+    memset(owned_, 0, sizeof(owned_));
+    for (uint8_t i = 0; i < MAX_EFFECTS; i++)
+    {
+        Effect &effect = effects_[i];
+        if (!effect.used)
+        {
+            continue;
+        }
+
+        uint64_t phase = (uint64_t)effect.phase + ((effect.phaseStepQ16 * (uint64_t)stepUs) >> 16);
+        effect.cycles += (uint32_t)(phase >> 32);
+        effect.phase = (uint32_t)phase;
+        render(effect, values);
+    }
+
+    layers.setOwnedChannels(DmxLayerStack::EFFECT, owned_);
+    layerInUse_ = true;
+}
+
+void DmxEffects::render(const Effect &effect, uint8_t *values)
+{
+    const Parameters &parameters = effect.parameters;
+    const uint32_t spread = (uint32_t)parameters.phaseSpread << 16;
+    const uint32_t depthScale = parameters.depth + (parameters.depth >> 7);
+    const uint32_t chaseWidth = parameters.width;
+
+    // Member channels are taken in order as fixtures of fixtureChannels each, so the channels of one fixture stay in
+    // step; successive fixtures get successive phase offsets and a wrap of the phase counts as the next cycle
+    uint32_t phase = effect.phase;
+    uint32_t cycle = effect.cycles;
+    uint8_t fixtureChannel = 0;
+    for (uint16_t bitmapIndex = 0; bitmapIndex < BITMAP_WORDS; bitmapIndex++)
+    {
+        uint32_t bits = effect.members[bitmapIndex];
+        while (bits)
+        {
+            uint16_t channel = bitmapIndex * 32 + __builtin_ctz(bits);
+            bits &= bits - 1;
+
+            uint32_t wave;
+            switch (parameters.waveform)
+            {
+            case SINE:
+                wave = sineAt(phase);
+                break;
+            case RAMP:
+                wave = phase >> 24;
+                break;
+            case CHASE:
+                wave = (phase >> 24) < chaseWidth ? 255 : 0;
+                break;
+            default:
+                wave = randomAt(effect.seed, cycle, channel);
+                break;
+            }
+
+            uint32_t value = parameters.offset + ((wave * depthScale) >> 8);
+            if (value > 255)
+            {
+                value = 255;
+            }
+
+            // Channels driven by more than one effect take the highest value
+            uint32_t bit = 1UL << (channel & 31);
+            if (!(owned_[bitmapIndex] & bit) || value > values[channel])
+            {
+                values[channel] = (uint8_t)value;
+            }
+            owned_[bitmapIndex] |= bit;
+
+            if (++fixtureChannel < parameters.fixtureChannels)
+            {
+                continue;
+            }
+            fixtureChannel = 0;
+            uint32_t next = phase + spread;
+            cycle += next < phase ? 1 : 0;
+            phase = next;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "dmx_frame.hpp"
+#include "dmx_layer_stack.hpp"
+#include <esp_err.h>
+#include <stdint.h>
+
+// Number of effect generators that can run at the same time
+#define MAX_EFFECTS 8
+
+// Effect generators (sine, ramp, chase, random) attached to frame channels, rendered into the effect layer.
+// All waveforms are evaluated in fixed point, the cost is linear in the number of attached channels.
+class DmxEffects
+{
+  public:
+    enum Waveform
+    {
+        SINE,
+        RAMP,
+        CHASE,  // On for part of the cycle (see width)
+        RANDOM, // New random value per channel every cycle
+        NUM_WAVEFORMS
+    };
+
+    static const uint16_t BITMAP_WORDS = DMX_FRAME_CHANNELS / 32;
+    static const uint32_t MAX_RATE_MILLI_HZ = 50000;
+
+    struct Parameters
+    {
+        Waveform waveform;
+        uint32_t rateMilliHz;    // Cycles per 1000 seconds (0..50000)
+        uint16_t phaseSpread;    // Phase offset between successive fixtures (65536 = one cycle)
+        uint8_t depth;           // Amplitude (0..255)
+        uint8_t offset;          // Lowest output value
+        uint8_t width;           // Chase only: on part of the cycle in 1/256
+        uint8_t fixtureChannels; // Successive member channels that share one phase, e.g. 3 for RGB fixtures (1..255)
+    };
+
+    DmxEffects();
+
+    // Define or change an effect; its channels are kept
+    esp_err_t setEffect(uint8_t effect, const Parameters &parameters);
+
+    // Attach or detach a range of frame channels (0..1023)
+    esp_err_t setEffectChannels(uint8_t effect, uint16_t firstChannel, uint16_t channelCount, bool member);
+
+    // Attach all channels of a membership bitmap, e.g. those of a group
+    esp_err_t addEffectMembers(uint8_t effect, const uint32_t *members);
+
+    // Stop an effect and detach its channels
+    esp_err_t stopEffect(uint8_t effect);
+
+    uint8_t getNumActiveEffects() const;
+
+    // Advance all effects to the given time and write them into the effect layer
+    void apply(DmxLayerStack &layers, int64_t nowUs);
+
+  private:
+    struct Effect
+    {
+        Parameters parameters;
+        uint32_t members[BITMAP_WORDS]; // Bit n set: frame channel n is driven by this effect
+        uint64_t phaseStepQ16;          // Phase advance per microsecond (16 fractional bits)
+        uint32_t phase;                 // Phase of the first channel (2^32 = one cycle)
+        uint32_t cycles;                // Completed cycles, used to pick new random values
+        uint32_t seed;
+        bool used;
+    };
+
+    Effect effects_[MAX_EFFECTS];
+    uint32_t owned_[BITMAP_WORDS];
+    int64_t lastApplyUs_;
+    bool layerInUse_;
+
+    void render(const Effect &effect, uint8_t *values);
+};
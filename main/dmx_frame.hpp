@@ -0,0 +1,20 @@
+#pragma once
+
+#include "dmx_preset.hpp"
+#include <stdint.h>
+
+// Number of channels in an output frame (both universes back to back)
+const uint16_t DMX_FRAME_CHANNELS = 2 * DMX_UNIVERSE_SIZE;
+const uint16_t DMX_FRAME_WORDS = DMX_FRAME_CHANNELS / 4;
+
+// Output frame, stored as 32-bit words so output kernels can process four channels at a time
+struct DmxFrame
+{
+    uint32_t words[DMX_FRAME_WORDS];
+    uint16_t universeLength[2];
+
+    uint8_t *channels() { return reinterpret_cast<uint8_t *>(words); }
+    const uint8_t *channels() const { return reinterpret_cast<const uint8_t *>(words); }
+    uint8_t *universe(uint8_t universe) { return channels() + universe * DMX_UNIVERSE_SIZE; }
+    const uint8_t *universe(uint8_t universe) const { return channels() + universe * DMX_UNIVERSE_SIZE; }
+};
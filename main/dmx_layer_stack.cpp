@@ -0,0 +1,223 @@
+#include "dmx_layer_stack.hpp"
+#include <cstring>
+#include <esp_log.h>
+
+static const char *LOG_TAG = "DmxLayerStack";
+
+DmxLayerStack::DmxLayerStack()
+{
+    memset(layers_, 0, sizeof(layers_));
+
+    // Parked channels always win, live overrides beat effects, effects are added on top of the preset
+    setLayerMode(BASE, 0, LTP);
+    setLayerMode(EFFECT, 10, HTP);
+    setLayerMode(OVERRIDE, 20, LTP);
+    setLayerMode(PARK, 255, LTP);
+}
+
+esp_err_t DmxLayerStack::setLayerMode(Layer layer, uint8_t priority, MergeMode mergeMode)
+{
+    if (layer >= NUM_LAYERS)
+    {
+        ESP_LOGE(LOG_TAG, "Layer %d out of range", layer);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    layers_[layer].priority = priority;
+    layers_[layer].mergeMode = mergeMode;
+    sortLayers();
+    return ESP_OK;
+}
+
+esp_err_t DmxLayerStack::setChannels(Layer layer, uint16_t firstChannel, const uint8_t *values, uint16_t channelCount)
+{
+    if (layer >= NUM_LAYERS || !values || firstChannel >= DMX_FRAME_CHANNELS ||
+        channelCount > DMX_FRAME_CHANNELS - firstChannel)
+    {
+        ESP_LOGE(LOG_TAG, "Invalid channels %d..%d for layer %d", firstChannel, firstChannel + channelCount - 1, layer);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    LayerData &data = layers_[layer];
+    memcpy(data.values + firstChannel, values, channelCount);
+    for (uint16_t channel = firstChannel; channel < firstChannel + channelCount; channel++)
+    {
+        uint32_t bit = 1UL << (channel & 31);
+        if (!(data.owned[channel >> 5] & bit))
+        {
+            data.owned[channel >> 5] |= bit;
+            data.ownedCount++;
+        }
+    }
+    if (channelCount > 0)
+    {
+        updateLength(data, firstChannel + channelCount - 1);
+    }
+    return ESP_OK;
+}
+
+esp_err_t DmxLayerStack::setChannel(Layer layer, uint16_t channel, uint8_t value)
+{
+    return setChannels(layer, channel, &value, 1);
+}
+
+esp_err_t DmxLayerStack::releaseChannels(Layer layer, uint16_t firstChannel, uint16_t channelCount)
+{
+    if (layer >= NUM_LAYERS || firstChannel >= DMX_FRAME_CHANNELS || channelCount > DMX_FRAME_CHANNELS - firstChannel)
+    {
+        ESP_LOGE(LOG_TAG, "Invalid channels %d..%d for layer %d", firstChannel, firstChannel + channelCount - 1, layer);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    LayerData &data = layers_[layer];
+    for (uint16_t channel = firstChannel; channel < firstChannel + channelCount; channel++)
+    {
+        uint32_t bit = 1UL << (channel & 31);
+        if (data.owned[channel >> 5] & bit)
+        {
+            data.owned[channel >> 5] &= ~bit;
+            data.ownedCount--;
+        }
+    }
+    return ESP_OK;
+}
+
+void DmxLayerStack::releaseAll(Layer layer)
+{
+    if (layer >= NUM_LAYERS)
+    {
+        return;
+    }
+
+    LayerData &data = layers_[layer];
+    memset(data.owned, 0, sizeof(data.owned));
+    data.ownedCount = 0;
+    data.universeLength[0] = 0;
+    data.universeLength[1] = 0;
+}
+
+void DmxLayerStack::setOwnedChannels(Layer layer, const uint32_t *owned)
+{
+    if (layer >= NUM_LAYERS || !owned)
+    {
+        return;
+    }
+
+    LayerData &data = layers_[layer];
+    memcpy(data.owned, owned, sizeof(data.owned));
+    data.ownedCount = 0;
+    data.universeLength[0] = 0;
+    data.universeLength[1] = 0;
+    for (uint16_t bitmapIndex = 0; bitmapIndex < BITMAP_WORDS; bitmapIndex++)
+    {
+        uint32_t bits = owned[bitmapIndex];
+        if (bits)
+        {
+            data.ownedCount += __builtin_popcount(bits);
+            updateLength(data, bitmapIndex * 32 + 31 - __builtin_clz(bits));
+        }
+    }
+}
+
+bool DmxLayerStack::isOwned(Layer layer, uint16_t channel) const
+{
+    return layer < NUM_LAYERS && channel < DMX_FRAME_CHANNELS &&
+           (layers_[layer].owned[channel >> 5] & (1UL << (channel & 31)));
+}
+
+uint8_t DmxLayerStack::getValue(Layer layer, uint16_t channel) const
+{
+    return isOwned(layer, channel) ? layers_[layer].values[channel] : 0;
+}
+
+void DmxLayerStack::composite(DmxFrame &output) const
+{
+    memset(output.words, 0, sizeof(output.words));
+    output.universeLength[0] = 0;
+    output.universeLength[1] = 0;
+
+    uint8_t *out = output.channels();
+    for (uint8_t i = 0; i < NUM_LAYERS; i++)
+    {
+        const LayerData &data = layers_[order_[i]];
+        if (data.ownedCount == 0)
+        {
+            continue;
+        }
+
+        // Only visit the bitmap words with owned channels; fully owned words are merged without bit tests
+        for (uint16_t bitmapIndex = 0; bitmapIndex < BITMAP_WORDS; bitmapIndex++)
+        {
+            uint32_t bits = data.owned[bitmapIndex];
+            if (bits == 0)
+            {
+                continue;
+            }
+
+            uint16_t base = bitmapIndex * 32;
+            if (bits == 0xFFFFFFFF)
+            {
+                if (data.mergeMode == LTP)
+                {
+                    memcpy(out + base, data.values + base, 32);
+                }
+                else
+                {
+                    for (uint16_t channel = base; channel < base + 32; channel++)
+                    {
+                        out[channel] = data.values[channel] > out[channel] ? data.values[channel] : out[channel];
+                    }
+                }
+                continue;
+            }
+
+            while (bits)
+            {
+                uint16_t channel = base + __builtin_ctz(bits);
+                bits &= bits - 1;
+                if (data.mergeMode == LTP || data.values[channel] > out[channel])
+                {
+                    out[channel] = data.values[channel];
+                }
+            }
+        }
+
+        for (uint8_t universe = 0; universe < 2; universe++)
+        {
+            if (data.universeLength[universe] > output.universeLength[universe])
+            {
+                output.universeLength[universe] = data.universeLength[universe];
+            }
+        }
+    }
+}
+
+void DmxLayerStack::sortLayers()
+{
+    // Insertion sort of a handful of layers; equal priorities keep the layer enum order
+    for (uint8_t i = 0; i < NUM_LAYERS; i++)
+    {
+        order_[i] = i;
+    }
+    for (uint8_t i = 1; i < NUM_LAYERS; i++)
+    {
+        uint8_t layer = order_[i];
+        int j = i - 1;
+        while (j >= 0 && layers_[order_[j]].priority > layers_[layer].priority)
+        {
+            order_[j + 1] = order_[j];
+            j--;
+        }
+        order_[j + 1] = layer;
+    }
+}
+
+void DmxLayerStack::updateLength(LayerData &data, uint16_t channel)
+{
+    uint8_t universe = channel / DMX_UNIVERSE_SIZE;
+    uint16_t length = channel % DMX_UNIVERSE_SIZE + 1;
+    if (length > data.universeLength[universe])
+    {
+        data.universeLength[universe] = length;
+    }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "dmx_frame.hpp"
+#include <esp_err.h>
+#include <stdint.h>
+
+// Playback layers composited into the output frame each tick. Each layer only contributes the channels it owns.
+class DmxLayerStack
+{
+  public:
+    enum Layer
+    {
+        BASE,     // Current preset
+        EFFECT,   // Effect generators
+        OVERRIDE, // Live channel overrides
+        PARK,     // Parked channels
+        NUM_LAYERS
+    };
+
+    enum MergeMode
+    {
+        HTP, // Highest takes precedence
+        LTP  // Latest (higher priority) takes precedence
+    };
+
+    static const uint16_t BITMAP_WORDS = DMX_FRAME_CHANNELS / 32;
+
+    DmxLayerStack();
+
+    // Priority (higher is merged later) and merge mode of a layer
+    esp_err_t setLayerMode(Layer layer, uint8_t priority, MergeMode mergeMode);
+
+    // Set channel values of a layer and take ownership of those frame channels
+    esp_err_t setChannels(Layer layer, uint16_t firstChannel, const uint8_t *values, uint16_t channelCount);
+    esp_err_t setChannel(Layer layer, uint16_t channel, uint8_t value);
+
+    // Give up ownership of frame channels, so lower layers show through again
+    esp_err_t releaseChannels(Layer layer, uint16_t firstChannel, uint16_t channelCount);
+    void releaseAll(Layer layer);
+
+    // Direct access for generators that rewrite a whole layer every frame: write the values, then replace the
+    // ownership bitmap (BITMAP_WORDS words)
+    uint8_t *getValues(Layer layer) { return layers_[layer].values; }
+    void setOwnedChannels(Layer layer, const uint32_t *owned);
+
+    bool isOwned(Layer layer, uint16_t channel) const;
+    uint8_t getValue(Layer layer, uint16_t channel) const;
+
+    // Merge all layers, in priority order, into the output frame
+    void composite(DmxFrame &output) const;
+
+  private:
+    struct LayerData
+    {
+        uint8_t values[DMX_FRAME_CHANNELS];
+        uint32_t owned[BITMAP_WORDS]; // Bit n set: frame channel n is owned by this layer
+        uint16_t ownedCount;
+        uint16_t universeLength[2]; // Highest owned channel + 1 per universe
+        uint8_t priority;
+        MergeMode mergeMode;
+    };
+
+    LayerData layers_[NUM_LAYERS];
+    uint8_t order_[NUM_LAYERS]; // Layers sorted by ascending priority
+
+    void sortLayers();
+    void updateLength(LayerData &data, uint16_t channel);
+};
@@ -0,0 +1,157 @@
+#include "dmx_masters.hpp"
+#include <cstring>
+#include <esp_log.h>
+
+static const char *LOG_TAG = "DmxMasters";
+
+// Byte masks for the four channels of a frame word, indexed by four membership bits (little endian)
+static const uint32_t BYTE_MASKS[16] = {0x00000000, 0x000000FF, 0x0000FF00, 0x0000FFFF, 0x00FF0000, 0x00FF00FF,
+    0x00FFFF00, 0x00FFFFFF, 0xFF000000, 0xFF0000FF, 0xFF00FF00, 0xFF00FFFF, 0xFFFF0000, 0xFFFF00FF, 0xFFFFFF00,
+    0xFFFFFFFF};
+
+// Convert a level (0..255) to a multiplier (0..256), so full level leaves values unchanged
+static inline uint32_t levelToScale(uint8_t level) { return level + (level >> 7); }
+
+// Scale four packed channel bytes at once: even and odd bytes are multiplied in separate 16-bit lanes,
+// which cannot overflow since 255 * 256 < 65536, and the high byte of each lane is the scaled value
+static inline uint32_t scale4(uint32_t word, uint32_t scale)
+{
+    uint32_t even = (((word & 0x00FF00FF) * scale) >> 8) & 0x00FF00FF;
+    uint32_t odd = (((word >> 8) & 0x00FF00FF) * scale) & 0xFF00FF00;
+    return even | odd;
+}
+
+DmxMasters::DmxMasters() : grandMaster_(255) { memset(groups_, 0, sizeof(groups_)); }
+
+esp_err_t DmxMasters::setGroup(uint8_t group, const char *name)
+{
+    if (group >= MAX_CHANNEL_GROUPS)
+    {
+        ESP_LOGE(LOG_TAG, "Group %d out of range (max %d)", group, MAX_CHANNEL_GROUPS - 1);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    Group &g = groups_[group];
+    memset(&g, 0, sizeof(g));
+    if (name)
+    {
+        strncpy(g.name, name, sizeof(g.name) - 1);
+    }
+    g.level = 255;
+    g.used = true;
+    return ESP_OK;
+}
+
+const char *DmxMasters::getGroupName(uint8_t group) const
+{
+    return (group < MAX_CHANNEL_GROUPS && groups_[group].used) ? groups_[group].name : nullptr;
+}
+
+const uint32_t *DmxMasters::getGroupMembers(uint8_t group) const
+{
+    return (group < MAX_CHANNEL_GROUPS && groups_[group].used) ? groups_[group].members : nullptr;
+}
+
+esp_err_t DmxMasters::setGroupChannels(uint8_t group, uint16_t firstChannel, uint16_t channelCount, bool member)
+{
+    if (group >= MAX_CHANNEL_GROUPS || !groups_[group].used)
+    {
+        ESP_LOGE(LOG_TAG, "Group %d not defined", group);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    if (firstChannel >= DMX_FRAME_CHANNELS || channelCount > DMX_FRAME_CHANNELS - firstChannel)
+    {
+        ESP_LOGE(LOG_TAG, "Channels %d..%d out of range (max %d)", firstChannel, firstChannel + channelCount - 1,
+            DMX_FRAME_CHANNELS - 1);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t *members = groups_[group].members;
+    for (uint16_t channel = firstChannel; channel < firstChannel + channelCount; channel++)
+    {
+        if (member)
+        {
+            members[channel >> 5] |= 1UL << (channel & 31);
+        }
+        else
+        {
+            members[channel >> 5] &= ~(1UL << (channel & 31));
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t DmxMasters::setGroupLevel(uint8_t group, uint8_t level)
+{
+    if (group >= MAX_CHANNEL_GROUPS || !groups_[group].used)
+    {
+        ESP_LOGE(LOG_TAG, "Group %d not defined", group);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    groups_[group].level = level;
+    return ESP_OK;
+}
+
+uint8_t DmxMasters::getGroupLevel(uint8_t group) const
+{
+    return (group < MAX_CHANNEL_GROUPS && groups_[group].used) ? groups_[group].level : 255;
+}
+
+void DmxMasters::apply(DmxFrame &frame) const
+{
+    // Groups at full level are skipped, so the cost only depends on the number of dimmed groups
+    for (uint8_t group = 0; group < MAX_CHANNEL_GROUPS; group++)
+    {
+        const Group &g = groups_[group];
+        if (g.used && g.level != 255)
+        {
+            applyGroup(frame.words, g.members, levelToScale(g.level));
+        }
+    }
+
+    if (grandMaster_ != 255)
+    {
+        applyAll(frame.words, levelToScale(grandMaster_));
+    }
+}
+
+void DmxMasters::applyGroup(uint32_t *words, const uint32_t *members, uint32_t scale)
+{
+    // Each bitmap word covers 32 channels, i.e. 8 frame words
+    for (uint16_t bitmapIndex = 0; bitmapIndex < BITMAP_WORDS; bitmapIndex++, words += 8)
+    {
+        uint32_t bits = members[bitmapIndex];
+        if (bits == 0)
+        {
+            continue;
+        }
+
+        if (bits == 0xFFFFFFFF)
+        {
+            for (uint8_t i = 0; i < 8; i++)
+            {
+                words[i] = scale4(words[i], scale);
+            }
+            continue;
+        }
+
+        for (uint8_t i = 0; i < 8; i++, bits >>= 4)
+        {
+            uint32_t mask = BYTE_MASKS[bits & 0xF];
+            if (mask)
+            {
+                words[i] = (scale4(words[i], scale) & mask) | (words[i] & ~mask);
+            }
+        }
+    }
+}
+
+void DmxMasters::applyAll(uint32_t *words, uint32_t scale)
+{
+    for (uint16_t i = 0; i < DMX_FRAME_WORDS; i++)
+    {
+        words[i] = scale4(words[i], scale);
+    }
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "dmx_frame.hpp"
+#include <esp_err.h>
+#include <stdint.h>
+
+// Number of channel groups with their own submaster
+#define MAX_CHANNEL_GROUPS 16
+
+// Group masters and grand master, applied to the output frame each tick
+class DmxMasters
+{
+  public:
+    static const uint8_t GROUP_NAME_SIZE = 16;
+    static const uint16_t BITMAP_WORDS = DMX_FRAME_CHANNELS / 32;
+
+    DmxMasters();
+
+    // Define a group (clears its members and sets its level to full)
+    esp_err_t setGroup(uint8_t group, const char *name);
+    const char *getGroupName(uint8_t group) const;
+
+    // Membership bitmap of a group (BITMAP_WORDS words), nullptr if not defined
+    const uint32_t *getGroupMembers(uint8_t group) const;
+
+    // Add or remove a range of frame channels (0..1023) to/from a group
+    esp_err_t setGroupChannels(uint8_t group, uint16_t firstChannel, uint16_t channelCount, bool member);
+
+    // Set submaster level of a group (0..255, 255 = no scaling)
+    esp_err_t setGroupLevel(uint8_t group, uint8_t level);
+    uint8_t getGroupLevel(uint8_t group) const;
+
+    // Set grand master level (0..255, 255 = no scaling)
+    void setGrandMaster(uint8_t level) { grandMaster_ = level; }
+    uint8_t getGrandMaster() const { return grandMaster_; }
+
+    // Scale the frame by all group masters and the grand master
+    void apply(DmxFrame &frame) const;
+
+  private:
+    struct Group
+    {
+        char name[GROUP_NAME_SIZE];
+        uint32_t members[BITMAP_WORDS]; // Bit n set: frame channel n is a member
+        uint8_t level;
+        bool used;
+    };
+
+    Group groups_[MAX_CHANNEL_GROUPS];
+    uint8_t grandMaster_;
+
+    static void applyGroup(uint32_t *words, const uint32_t *members, uint32_t scale);
+    static void applyAll(uint32_t *words, uint32_t scale);
+};
@@ -0,0 +1,45 @@
+#include "dmx_output_stage.hpp"
+#include <cstring>
+#include <esp_timer.h>
+
+DmxOutputStage::DmxOutputStage() : lastRenderUs_(0), worstRenderUs_(0)
+{
+    memset(&output_, 0, sizeof(output_));
+}
+
+void DmxOutputStage::setPreset(const Messages::PresetEventData &presetData)
+{
+    uint16_t length1 = presetData.universe1Length > DMX_UNIVERSE_SIZE ? DMX_UNIVERSE_SIZE : presetData.universe1Length;
+    uint16_t length2 = presetData.universe2Length > DMX_UNIVERSE_SIZE ? DMX_UNIVERSE_SIZE : presetData.universe2Length;
+
+    layers_.releaseAll(DmxLayerStack::BASE);
+    layers_.setChannels(DmxLayerStack::BASE, 0, presetData.universe1Data, length1);
+    layers_.setChannels(DmxLayerStack::BASE, DMX_UNIVERSE_SIZE, presetData.universe2Data, length2);
+}
+
+void DmxOutputStage::capture(Messages::PresetEventData &presetData)
+{
+    // The output frame is rebuilt by the next render(), so it can hold the merged layers meanwhile
+    layers_.composite(output_);
+    presetData.universe1Length = output_.universeLength[0];
+    memcpy(presetData.universe1Data, output_.universe(0), output_.universeLength[0]);
+    presetData.universe2Length = output_.universeLength[1];
+    memcpy(presetData.universe2Data, output_.universe(1), output_.universeLength[1]);
+}
+
+const DmxFrame &DmxOutputStage::render()
+{
+    int64_t startUs = esp_timer_get_time();
+
+    effects_.apply(layers_, startUs);
+    layers_.composite(output_);
+    masters_.apply(output_);
+    curves_.apply(output_); // Curves describe the fixture response, so they come after the masters
+
+    lastRenderUs_ = (uint32_t)(esp_timer_get_time() - startUs);
+    if (lastRenderUs_ > worstRenderUs_)
+    {
+        worstRenderUs_ = lastRenderUs_;
+    }
+    return output_;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "dmx_curves.hpp"
+#include "dmx_effects.hpp"
+#include "dmx_frame.hpp"
+#include "dmx_layer_stack.hpp"
+#include "dmx_masters.hpp"
+#include "messages.hpp"
+#include <esp_err.h>
+#include <stdint.h>
+
+// Builds the output frame each tick: the playback layers followed by the output processing passes
+class DmxOutputStage
+{
+  public:
+    DmxOutputStage();
+
+    // Use preset data as the base layer of the output frame
+    void setPreset(const Messages::PresetEventData &presetData);
+
+    // Playback layers (base preset, effects, live overrides, parked channels)
+    DmxLayerStack &getLayers() { return layers_; }
+
+    // Effect generators, rendered into the effect layer
+    DmxEffects &getEffects() { return effects_; }
+
+    // Group masters and grand master
+    DmxMasters &getMasters() { return masters_; }
+
+    // Per-channel response curves
+    DmxCurves &getCurves() { return curves_; }
+
+    // Build the output frame from the base frame and all output passes
+    const DmxFrame &render();
+
+    // Copy the merged playback layers into preset data. Masters and curves are left out, since they are applied
+    // again when the preset is played back.
+    void capture(Messages::PresetEventData &presetData);
+
+    // Render time statistics
+    uint32_t getLastRenderUs() const { return lastRenderUs_; }
+    uint32_t getWorstRenderUs() const { return worstRenderUs_; }
+
+  private:
+    DmxLayerStack layers_;
+    DmxEffects effects_;
+    DmxFrame output_;
+
+    DmxMasters masters_;
+    DmxCurves curves_;
+
+    uint32_t lastRenderUs_;
+    uint32_t worstRenderUs_;
+};
@@ -126,6 +126,16 @@ const uint8_t *DmxPreset::getUniverseData(uint8_t universe) const
     }
 }
 
+uint8_t *DmxPreset::getUniverseBuffer(uint8_t universe)
+{
+    if (universe > 1)
+    {
+        ESP_LOGE(TAG, "Universe %d out of range (max 1)", universe);
+        return nullptr;
+    }
+    return universe == 0 ? universe1_ : universe2_;
+}
+
 uint16_t DmxPreset::getUniverseLength(uint8_t universe) const
 {
     if (universe == 0)
@@ -143,6 +153,30 @@ uint16_t DmxPreset::getUniverseLength(uint8_t universe) const
     }
 }
 
+void DmxPreset::setUniverseRange(uint8_t universe, uint16_t firstChannel, const uint8_t *data, uint16_t count)
+{
+    if (!data || universe > 1 || firstChannel >= DMX_UNIVERSE_SIZE || count > DMX_UNIVERSE_SIZE - firstChannel)
+    {
+        ESP_LOGE(TAG, "Invalid range %d..%d of universe %d", firstChannel, firstChannel + count - 1, universe);
+        return;
+    }
+
+    memcpy((universe == 0 ? universe1_ : universe2_) + firstChannel, data, count);
+}
+
+void DmxPreset::setUniverseLength(uint8_t universe, uint16_t length)
+{
+    if (universe > 1 || length > DMX_UNIVERSE_SIZE)
+    {
+        ESP_LOGE(TAG, "Invalid length %d of universe %d", length, universe);
+        return;
+    }
+
+    uint8_t *data = universe == 0 ? universe1_ : universe2_;
+    memset(data + length, 0, DMX_UNIVERSE_SIZE - length);
+    (universe == 0 ? universe1Length_ : universe2Length_) = length;
+}
+
 void DmxPreset::clear()
 {
     memset(name_, 0, sizeof(name_));
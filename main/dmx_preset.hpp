@@ -6,6 +6,7 @@
 #include <string>
 // DMX Universe size
 const uint16_t DMX_UNIVERSE_SIZE = 512;
+const uint8_t DMX_PRESET_NAME_SIZE = 32; // Including the terminating null
 
 class DmxPreset
 {
@@ -27,8 +28,16 @@ class DmxPreset
     // Set entire universe data
     void setUniverseData(uint8_t universe, const uint8_t *data, size_t length);
     const uint8_t *getUniverseData(uint8_t universe) const;
+
+    // Writable universe data (DMX_UNIVERSE_SIZE bytes, nullptr for an invalid universe), to decode straight into
+    // the preset; set the length afterwards with setUniverseLength
+    uint8_t *getUniverseBuffer(uint8_t universe);
     uint16_t getUniverseLength(uint8_t universe) const;
 
+    // Change part of a universe, or its length (values beyond the length are cleared)
+    void setUniverseRange(uint8_t universe, uint16_t firstChannel, const uint8_t *data, uint16_t count);
+    void setUniverseLength(uint8_t universe, uint16_t length);
+
     // Clear/reset preset
     void clear();
 
@@ -37,7 +46,7 @@ class DmxPreset
 
   private:
     uint8_t index_;
-    char name_[32];                        // Preset name (max 31 chars + null)
+    char name_[DMX_PRESET_NAME_SIZE];      // Preset name (max 31 chars + null)
     uint8_t universe1_[DMX_UNIVERSE_SIZE]; // Universe 1 data (512 channels)
     uint16_t universe1Length_;
     uint8_t universe2_[DMX_UNIVERSE_SIZE]; // Universe 2 data (512 channels)
@@ -1,18 +1,41 @@
 #include "dmx_preset_changer.hpp"
 #include "messages.hpp"
+#include <cstring>
 #include <esp_log.h>
+#include <esp_timer.h>
 
 static const char *LOG_TAG = "DmxPresetChanger";
 static const int QUEUE_CAPACITY = 10;
 static const int TASK_PRIORITY = 5;
+// Edits and preset data for the output are waited for instead of dropped when DmxController's queue is full
+static const int FORWARD_TIMEOUT_MS = 100;
+// An edit that could not be handed on for storing is offered again after this long
+static const int STORE_RETRY_MS = 200;
+// Neighbours are prefetched after this long without events, once the output of a switch has gone out
+static const int PREFETCH_DELAY_MS = 20;
 
-DmxPresetChanger::DmxPresetChanger() : RtosTask() {}
+DmxPresetChanger::DmxPresetChanger() : RtosTask(), worstSwitchLatencyUs_(0), prefetchPending_(false)
+{
+    memset(unstoredPresets_, 0, sizeof(unstoredPresets_));
+}
 
 DmxPresetChanger::~DmxPresetChanger() {}
 
-esp_err_t DmxPresetChanger::init(QueueHandle_t dmxControllerEventQueue)
+esp_err_t DmxPresetChanger::init(QueueHandle_t dmxControllerEventQueue, DmxPresetLoader *presetLoader)
 {
-    if (RtosTask::init("DmxPresetChangerTask", 2048, TASK_PRIORITY, QUEUE_CAPACITY, sizeof(Messages::Event),
+    if (dmxPresets_.init(presetLoader) != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to initialize DmxPresets");
+        return ESP_FAIL;
+    }
+
+    // Not fatal: without it the show starts at the first preset after a reboot
+    if (resumeLog_.init(RESUME_PARTITION_LABEL) != ESP_OK)
+    {
+        ESP_LOGW(LOG_TAG, "Resume log not available, current preset will not survive a reboot");
+    }
+
+    if (RtosTask::init("DmxPresetChangerTask", 4096, TASK_PRIORITY, QUEUE_CAPACITY, sizeof(Messages::Event),
             dmxControllerEventQueue) != ESP_OK)
     {
         ESP_LOGE(LOG_TAG, "Failed to initialize DmxPresetChangerTask");
@@ -30,7 +53,21 @@ void DmxPresetChanger::taskLoop()
     Messages::Event event;
     while (true)
     {
-        if (xQueueReceive(eventQueue_, &event, portMAX_DELAY) == pdTRUE)
+        // Before the next event, which may load other presets and push an unstored edit out of the cache
+        retryUnstoredPresets();
+        TickType_t wait = prefetchPending_     ? pdMS_TO_TICKS(PREFETCH_DELAY_MS)
+                          : hasUnstoredPresets() ? pdMS_TO_TICKS(STORE_RETRY_MS)
+                                                 : portMAX_DELAY;
+        if (xQueueReceive(eventQueue_, &event, wait) != pdTRUE)
+        {
+            if (prefetchPending_)
+            {
+                // Nothing waiting: the flash reads no longer delay a switch, and the next one finds its preset cached
+                prefetchPending_ = false;
+                dmxPresets_.prefetchNeighbours();
+            }
+        }
+        else
         {
             switch (event.type)
             {
@@ -40,50 +77,36 @@ void DmxPresetChanger::taskLoop()
 
             case Messages::EventType::SELECT_NEXT_PRESET:
             {
+                int64_t switchStartUs = esp_timer_get_time();
                 dmxPresets_.selectNextPreset();
-                Messages::Event dmxControllerEvent = Messages::Event();
-                dmxControllerEvent.type = Messages::EventType::USE_PRESET_DATA;
-                DmxPreset &currentPreset = dmxPresets_.getCurrentPreset();
-                dmxControllerEvent.data.presetData.presetNumber = currentPreset.getIndex();
-                dmxControllerEvent.data.presetData.name = currentPreset.getName();
-                dmxControllerEvent.data.presetData.universe1Length = currentPreset.getUniverseLength(0);
-                memcpy(dmxControllerEvent.data.presetData.universe1Data, currentPreset.getUniverseData(0),
-                    dmxControllerEvent.data.presetData.universe1Length);
-                dmxControllerEvent.data.presetData.universe2Length = currentPreset.getUniverseLength(1);
-                memcpy(dmxControllerEvent.data.presetData.universe2Data, currentPreset.getUniverseData(1),
-                    dmxControllerEvent.data.presetData.universe2Length);
-
-                if (xQueueSend(getDmxControllerEventQueue(), &dmxControllerEvent, 0) != pdPASS)
-                {
-                    ESP_LOGE(LOG_TAG, "Failed to forward current preset data to DmxController");
-                }
-                ESP_LOGI(LOG_TAG, "Selected next preset: index=%d", dmxPresets_.getCurrentPresetIndex());
+                useCurrentPreset("next", switchStartUs);
             }
             break;
 
             case Messages::EventType::SELECT_PREVIOUS_PRESET:
             {
+                int64_t switchStartUs = esp_timer_get_time();
                 dmxPresets_.selectPreviousPreset();
-                Messages::Event dmxControllerEvent = Messages::Event();
-                dmxControllerEvent.type = Messages::EventType::USE_PRESET_DATA;
-                DmxPreset &currentPreset = dmxPresets_.getCurrentPreset();
-                dmxControllerEvent.data.presetData.presetNumber = currentPreset.getIndex();
-                dmxControllerEvent.data.presetData.name = currentPreset.getName();
-                dmxControllerEvent.data.presetData.universe1Length = currentPreset.getUniverseLength(0);
-                memcpy(dmxControllerEvent.data.presetData.universe1Data, currentPreset.getUniverseData(0),
-                    dmxControllerEvent.data.presetData.universe1Length);
-                dmxControllerEvent.data.presetData.universe2Length = currentPreset.getUniverseLength(1);
-                memcpy(dmxControllerEvent.data.presetData.universe2Data, currentPreset.getUniverseData(1),
-                    dmxControllerEvent.data.presetData.universe2Length);
-
-                if (xQueueSend(getDmxControllerEventQueue(), &dmxControllerEvent, 0) != pdPASS)
-                {
-                    ESP_LOGE(LOG_TAG, "Failed to forward current preset data to DmxController");
-                }
-                ESP_LOGI(LOG_TAG, "Selected previous preset: index=%d", dmxPresets_.getCurrentPresetIndex());
+                useCurrentPreset("previous", switchStartUs);
             }
             break;
 
+            case Messages::EventType::UPDATE_PRESET:
+                updatePreset(event.data.presetData);
+                break;
+
+            case Messages::EventType::APPLY_PRESET_DELTA:
+                applyPresetDelta(event.data.presetDeltaData);
+                break;
+
+            case Messages::EventType::REPLACE_PRESET:
+                replacePreset(event.data.presetData);
+                break;
+
+            case Messages::EventType::RECALL_PRESET:
+                recallPreset(event.data.presetData.presetNumber);
+                break;
+
             default:
                 // Ignore other events
                 break;
@@ -94,12 +117,181 @@ void DmxPresetChanger::taskLoop()
 
 void DmxPresetChanger::setPresets(const Messages::PresetsEventData &presetsData)
 {
-    dmxPresets_.clearAll();
-    for (size_t i = 0; i < presetsData.numberOfPresets; ++i)
+    // The stored presets replace the cached ones, edits not stored yet included
+    memset(unstoredPresets_, 0, sizeof(unstoredPresets_));
+    prefetchPending_ = false;
+    dmxPresets_.invalidateCache();
+    dmxPresets_.setNumPresets(presetsData.numberOfPresets);
+    ESP_LOGI(LOG_TAG, "Presets updated: number of presets=%d", dmxPresets_.getNumPresets());
+
+    // At boot, continue with the preset that was active before the reboot or power cut
+    ResumeLog::State resumeState;
+    if (resumeLog_.read(resumeState) == ESP_OK && resumeState.presetIndex < dmxPresets_.getNumPresets())
+    {
+        dmxPresets_.setCurrentPresetIndex(resumeState.presetIndex);
+    }
+    useCurrentPreset("restored", esp_timer_get_time());
+}
+
+void DmxPresetChanger::updatePreset(const Messages::PresetEventData &presetData)
+{
+    if (presetData.presetNumber >= dmxPresets_.getNumPresets())
     {
-        dmxPresets_.addPreset(presetsData.presets[i].presetNumber, presetsData.presets[i].name,
-            presetsData.presets[i].universe1Length, presetsData.presets[i].universe1Data,
-            presetsData.presets[i].universe2Length, presetsData.presets[i].universe2Data);
+        ESP_LOGE(LOG_TAG, "Preset %d out of range (max %d)", presetData.presetNumber, dmxPresets_.getNumPresets() - 1);
+        return;
     }
-    ESP_LOGI(LOG_TAG, "Presets updated: number of presets=%d", dmxPresets_.getNumPresets());
-}
\ No newline at end of file
+
+    // Replace the channel values only, so a captured preset keeps its name
+    DmxPreset &preset = dmxPresets_.getPreset(presetData.presetNumber);
+    preset.setUniverseData(0, presetData.universe1Data, presetData.universe1Length);
+    preset.setUniverseData(1, presetData.universe2Data, presetData.universe2Length);
+    storePreset(preset);
+}
+
+void DmxPresetChanger::applyPresetDelta(const Messages::PresetDeltaEventData &deltaData)
+{
+    if (deltaData.presetNumber >= dmxPresets_.getNumPresets())
+    {
+        ESP_LOGE(LOG_TAG, "Preset %d out of range (max %d)", deltaData.presetNumber, dmxPresets_.getNumPresets() - 1);
+        return;
+    }
+
+    // Patch the cached copy (loading it if needed), then store the full preset
+    DmxPreset &preset = dmxPresets_.getPreset(deltaData.presetNumber);
+    if (DmxPresetDelta::apply(preset, deltaData.delta, deltaData.length) != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Invalid delta for preset %d", deltaData.presetNumber);
+        return;
+    }
+
+    storePreset(preset);
+
+    // An edit of the preset on stage is shown right away
+    if (deltaData.presetNumber == dmxPresets_.getCurrentPresetIndex())
+    {
+        useCurrentPreset("edited", esp_timer_get_time());
+    }
+}
+
+void DmxPresetChanger::replacePreset(const Messages::PresetEventData &presetData)
+{
+    if (presetData.presetNumber >= dmxPresets_.getNumPresets())
+    {
+        ESP_LOGE(LOG_TAG, "Preset %d out of range (max %d)", presetData.presetNumber, dmxPresets_.getNumPresets() - 1);
+        return;
+    }
+
+    DmxPreset &preset = dmxPresets_.getPreset(presetData.presetNumber);
+    preset.setName(presetData.name);
+    preset.setUniverseData(0, presetData.universe1Data, presetData.universe1Length);
+    preset.setUniverseData(1, presetData.universe2Data, presetData.universe2Length);
+    storePreset(preset);
+
+    if (presetData.presetNumber == dmxPresets_.getCurrentPresetIndex())
+    {
+        useCurrentPreset("replaced", esp_timer_get_time());
+    }
+}
+
+void DmxPresetChanger::recallPreset(uint8_t presetNumber)
+{
+    if (presetNumber >= dmxPresets_.getNumPresets())
+    {
+        ESP_LOGE(LOG_TAG, "Preset %d out of range (max %d)", presetNumber, dmxPresets_.getNumPresets() - 1);
+        return;
+    }
+
+    int64_t switchStartUs = esp_timer_get_time();
+    dmxPresets_.setCurrentPresetIndex(presetNumber);
+    useCurrentPreset("recalled", switchStartUs);
+}
+
+void DmxPresetChanger::storePreset(const DmxPreset &preset)
+{
+    Messages::Event storeEvent = Messages::Event();
+    storeEvent.type = Messages::EventType::STORE_PRESET;
+    storeEvent.data.presetData.presetNumber = preset.getIndex();
+    strncpy(storeEvent.data.presetData.name, preset.getName(), DMX_PRESET_NAME_SIZE - 1);
+    storeEvent.data.presetData.universe1Length = preset.getUniverseLength(0);
+    memcpy(storeEvent.data.presetData.universe1Data, preset.getUniverseData(0), preset.getUniverseLength(0));
+    storeEvent.data.presetData.universe2Length = preset.getUniverseLength(1);
+    memcpy(storeEvent.data.presetData.universe2Data, preset.getUniverseData(1), preset.getUniverseLength(1));
+    if (xQueueSend(getDmxControllerEventQueue(), &storeEvent, pdMS_TO_TICKS(FORWARD_TIMEOUT_MS)) != pdPASS)
+    {
+        ESP_LOGW(LOG_TAG, "Failed to send preset %d to DmxController for storing, will retry", preset.getIndex());
+        unstoredPresets_[preset.getIndex() / 32] |= 1u << (preset.getIndex() % 32);
+    }
+}
+
+bool DmxPresetChanger::hasUnstoredPresets() const
+{
+    for (uint32_t bits : unstoredPresets_)
+    {
+        if (bits != 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Offers edited presets to DmxController again; stops at the first that still does not fit
+void DmxPresetChanger::retryUnstoredPresets()
+{
+    for (uint16_t index = 0; index < MAX_PRESETS; index++)
+    {
+        uint32_t bit = 1u << (index % 32);
+        if (!(unstoredPresets_[index / 32] & bit))
+        {
+            continue;
+        }
+        unstoredPresets_[index / 32] &= ~bit;
+
+        DmxPreset *preset = dmxPresets_.getCachedPreset(index);
+        if (!preset)
+        {
+            ESP_LOGE(LOG_TAG, "Edit of preset %d lost, it left the cache before it could be stored", index);
+            continue;
+        }
+        storePreset(*preset);
+        if (unstoredPresets_[index / 32] & bit)
+        {
+            return;
+        }
+    }
+}
+
+void DmxPresetChanger::useCurrentPreset(const char *direction, int64_t switchStartUs)
+{
+    Messages::Event dmxControllerEvent = Messages::Event();
+    dmxControllerEvent.type = Messages::EventType::USE_PRESET_DATA;
+    DmxPreset &currentPreset = dmxPresets_.getCurrentPreset();
+    dmxControllerEvent.data.presetData.presetNumber = currentPreset.getIndex();
+    strncpy(dmxControllerEvent.data.presetData.name, currentPreset.getName(), DMX_PRESET_NAME_SIZE - 1);
+    dmxControllerEvent.data.presetData.universe1Length = currentPreset.getUniverseLength(0);
+    memcpy(dmxControllerEvent.data.presetData.universe1Data, currentPreset.getUniverseData(0),
+        dmxControllerEvent.data.presetData.universe1Length);
+    dmxControllerEvent.data.presetData.universe2Length = currentPreset.getUniverseLength(1);
+    memcpy(dmxControllerEvent.data.presetData.universe2Data, currentPreset.getUniverseData(1),
+        dmxControllerEvent.data.presetData.universe2Length);
+
+    if (xQueueSend(getDmxControllerEventQueue(), &dmxControllerEvent, pdMS_TO_TICKS(FORWARD_TIMEOUT_MS)) != pdPASS)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to forward current preset data to DmxController");
+    }
+
+    int64_t switchLatencyUs = esp_timer_get_time() - switchStartUs;
+    if (switchLatencyUs > worstSwitchLatencyUs_)
+    {
+        worstSwitchLatencyUs_ = switchLatencyUs;
+    }
+    ESP_LOGI(LOG_TAG, "Selected %s preset: index=%d, switch=%lld us (worst %lld us), cache hit rate=%d%%", direction,
+        dmxPresets_.getCurrentPresetIndex(), switchLatencyUs, worstSwitchLatencyUs_,
+        dmxPresets_.getCacheHitRatePercent());
+
+    // Output has been sent, so persisting the index no longer delays this switch; the neighbours are loaded by the
+    // task loop once no event is waiting, a quick second press is not held up by them
+    ResumeLog::State resumeState = {dmxPresets_.getCurrentPresetIndex()};
+    resumeLog_.write(resumeState);
+    prefetchPending_ = true;
+}
@@ -13,6 +13,7 @@ extern "C" {
 }
 #include "dmx_presets.hpp"
 #include "messages.hpp"
+#include "resume_log.hpp"
 #include "rtos_task.hpp"
 
 class DmxPresetChanger : public RtosTask {
@@ -20,13 +21,27 @@ class DmxPresetChanger : public RtosTask {
     DmxPresetChanger();
     ~DmxPresetChanger();
 
-    esp_err_t init(QueueHandle_t dmxControllerEventQueue);
+    esp_err_t init(QueueHandle_t dmxControllerEventQueue, DmxPresetLoader *presetLoader);
 
   private:
+    static constexpr const char *RESUME_PARTITION_LABEL = "resume";
+
     DmxPresets dmxPresets_;
+    ResumeLog resumeLog_;
+    int64_t worstSwitchLatencyUs_;
+    uint32_t unstoredPresets_[(MAX_PRESETS + 31) / 32]; // Edited, but DmxController could not take them for storing
+    bool prefetchPending_; // The neighbours of the current preset are loaded once no event is waiting
 
     void taskEntry(void *param) override;
     void taskLoop();
 
     void setPresets(const Messages::PresetsEventData &presetsData);
+    void updatePreset(const Messages::PresetEventData &presetData);
+    void applyPresetDelta(const Messages::PresetDeltaEventData &deltaData);
+    void replacePreset(const Messages::PresetEventData &presetData);
+    void recallPreset(uint8_t presetNumber);
+    void storePreset(const DmxPreset &preset);
+    bool hasUnstoredPresets() const;
+    void retryUnstoredPresets();
+    void useCurrentPreset(const char *direction, int64_t switchStartUs);
 };
\ No newline at end of file
@@ -0,0 +1,161 @@
+#include "dmx_preset_delta.hpp"
+#include <cstring>
+#include <esp_log.h>
+
+static const char *LOG_TAG = "DmxPresetDelta";
+
+// Returned by encodeUniverse when the output buffer is too small
+static const size_t NO_SPACE = (size_t)-1;
+
+esp_err_t DmxPresetDelta::encode(
+    const DmxPreset &from, const DmxPreset &to, uint8_t *out, size_t capacity, size_t &length)
+{
+    length = 0;
+    if (!out || capacity < HEADER_SIZE)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    writeUint16(out, to.getUniverseLength(0));
+    writeUint16(out + 2, to.getUniverseLength(1));
+    size_t used = HEADER_SIZE;
+    for (uint8_t universe = 0; universe < 2; universe++)
+    {
+        // Values beyond the target length are cleared by the length change, so they need no runs
+        uint16_t universeLength = to.getUniverseLength(universe);
+        size_t size = encodeUniverse(universe, from.getUniverseData(universe), to.getUniverseData(universe),
+            universeLength > DMX_UNIVERSE_SIZE ? DMX_UNIVERSE_SIZE : universeLength, out + used, capacity - used);
+        if (size == NO_SPACE)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        used += size;
+    }
+
+    length = used;
+    return ESP_OK;
+}
+
+size_t DmxPresetDelta::encodeUniverse(
+    uint8_t universe, const uint8_t *from, const uint8_t *to, uint16_t length, uint8_t *out, size_t capacity)
+{
+    size_t used = 0;
+    uint16_t channel = 0;
+    while (channel < length)
+    {
+        // Skip equal values, four at a time where possible
+        while (channel + 4 <= length && memcmp(from + channel, to + channel, 4) == 0)
+        {
+            channel += 4;
+        }
+        while (channel < length && from[channel] == to[channel])
+        {
+            channel++;
+        }
+        if (channel == length)
+        {
+            break;
+        }
+
+        // Extend the run until at least a run header's worth of equal values follows
+        uint16_t first = channel;
+        uint16_t last = channel;
+        for (channel++; channel < length && channel <= last + RUN_HEADER_SIZE; channel++)
+        {
+            if (from[channel] != to[channel])
+            {
+                last = channel;
+            }
+        }
+        channel = last + 1;
+
+        uint16_t count = last - first + 1;
+        if (used + RUN_HEADER_SIZE + count > capacity)
+        {
+            return NO_SPACE;
+        }
+        writeUint16(out + used, universe * DMX_UNIVERSE_SIZE + first);
+        writeUint16(out + used + 2, count);
+        memcpy(out + used + RUN_HEADER_SIZE, to + first, count);
+        used += RUN_HEADER_SIZE + count;
+    }
+    return used;
+}
+
+esp_err_t DmxPresetDelta::validate(const uint8_t *delta, size_t length)
+{
+    if (!delta || length < HEADER_SIZE)
+    {
+        ESP_LOGE(LOG_TAG, "Delta too short: %d bytes", (int)length);
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    uint16_t universeLength[2] = {readUint16(delta), readUint16(delta + 2)};
+    for (uint8_t universe = 0; universe < 2; universe++)
+    {
+        // A universe that keeps its length may have runs up to its end
+        universeLength[universe] =
+            universeLength[universe] == KEEP_LENGTH ? DMX_UNIVERSE_SIZE : universeLength[universe];
+    }
+    if (universeLength[0] > DMX_UNIVERSE_SIZE || universeLength[1] > DMX_UNIVERSE_SIZE)
+    {
+        ESP_LOGE(LOG_TAG, "Invalid universe lengths %d, %d", universeLength[0], universeLength[1]);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t offset = HEADER_SIZE;
+    while (offset < length)
+    {
+        if (length - offset < RUN_HEADER_SIZE)
+        {
+            ESP_LOGE(LOG_TAG, "Truncated run header at %d", (int)offset);
+            return ESP_ERR_INVALID_SIZE;
+        }
+
+        uint16_t firstChannel = readUint16(delta + offset);
+        uint16_t count = readUint16(delta + offset + 2);
+        uint8_t universe = firstChannel / DMX_UNIVERSE_SIZE;
+        uint16_t channel = firstChannel % DMX_UNIVERSE_SIZE;
+        if (universe > 1 || count == 0 || channel + count > universeLength[universe] ||
+            length - offset - RUN_HEADER_SIZE < count)
+        {
+            ESP_LOGE(LOG_TAG, "Invalid run: channel %d, count %d", firstChannel, count);
+            return ESP_ERR_INVALID_ARG;
+        }
+        offset += RUN_HEADER_SIZE + count;
+    }
+    return ESP_OK;
+}
+
+esp_err_t DmxPresetDelta::apply(DmxPreset &preset, const uint8_t *delta, size_t length)
+{
+    esp_err_t err = validate(delta, length);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    for (uint8_t universe = 0; universe < 2; universe++)
+    {
+        uint16_t universeLength = readUint16(delta + 2 * universe);
+        if (universeLength != KEEP_LENGTH)
+        {
+            preset.setUniverseLength(universe, universeLength);
+        }
+    }
+    for (size_t offset = HEADER_SIZE; offset < length;)
+    {
+        uint16_t firstChannel = readUint16(delta + offset);
+        uint16_t count = readUint16(delta + offset + 2);
+        uint8_t universe = firstChannel / DMX_UNIVERSE_SIZE;
+        uint16_t channel = firstChannel % DMX_UNIVERSE_SIZE;
+        if (channel + count > preset.getUniverseLength(universe))
+        {
+            // Only with KEEP_LENGTH, the values beyond the length are 0
+            preset.setUniverseLength(universe, channel + count);
+        }
+        preset.setUniverseRange(universe, channel, delta + offset + RUN_HEADER_SIZE, count);
+        offset += RUN_HEADER_SIZE + count;
+    }
+    return ESP_OK;
+}
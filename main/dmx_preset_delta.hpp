@@ -0,0 +1,44 @@
+#pragma once
+
+#include "dmx_preset.hpp"
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Delta encoding between two presets, or two versions of one preset, so an edit can be exchanged without sending
+// the full universes. Layout (little endian):
+//   uint16 universe1Length, uint16 universe2Length
+//   runs: uint16 firstChannel (frame channel, universe 2 starts at 512), uint16 count, count value bytes
+// Runs never cross a universe boundary. An empty run list only changes the lengths. A length of KEEP_LENGTH keeps
+// the current length of the universe, extended as far as its runs reach, for edits made without knowing it.
+class DmxPresetDelta
+{
+  public:
+    static const size_t HEADER_SIZE = 4;
+    static const size_t RUN_HEADER_SIZE = 4;
+    static const uint16_t KEEP_LENGTH = 0xFFFF;
+
+    // Largest possible delta: equal stretches shorter than a run header are merged into the runs, so in the worst
+    // case every universe is one run
+    static const size_t MAX_SIZE = HEADER_SIZE + 2 * (RUN_HEADER_SIZE + DMX_UNIVERSE_SIZE);
+
+    // Encode the changes from one preset to another into out (capacity bytes)
+    static esp_err_t encode(
+        const DmxPreset &from, const DmxPreset &to, uint8_t *out, size_t capacity, size_t &length);
+
+    // Check that a delta is well formed, without applying it
+    static esp_err_t validate(const uint8_t *delta, size_t length);
+
+    // Apply a delta; the preset is not changed if the delta is invalid
+    static esp_err_t apply(DmxPreset &preset, const uint8_t *delta, size_t length);
+
+  private:
+    static size_t encodeUniverse(
+        uint8_t universe, const uint8_t *from, const uint8_t *to, uint16_t length, uint8_t *out, size_t capacity);
+    static uint16_t readUint16(const uint8_t *data) { return data[0] | (data[1] << 8); }
+    static void writeUint16(uint8_t *data, uint16_t value)
+    {
+        data[0] = value & 0xFF;
+        data[1] = value >> 8;
+    }
+};
@@ -0,0 +1,172 @@
+#include "dmx_preset_record.hpp"
+#include "dmx_universe_codec.hpp"
+#include <cstring>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+
+static const char *LOG_TAG = "DmxPresetRecord";
+
+// Field offsets of the legacy blob (Messages::PresetEventData with a 32-bit name pointer, 4-byte aligned)
+static const size_t LEGACY_UNIVERSE1_DATA = 8;
+static const size_t LEGACY_UNIVERSE1_LENGTH = 520;
+static const size_t LEGACY_UNIVERSE2_DATA = 522;
+static const size_t LEGACY_UNIVERSE2_LENGTH = 1034;
+
+static void writeUint16(uint8_t *data, uint16_t value)
+{
+    data[0] = value & 0xFF;
+    data[1] = value >> 8;
+}
+
+static void writeUint32(uint8_t *data, uint32_t value)
+{
+    writeUint16(data, value & 0xFFFF);
+    writeUint16(data + 2, value >> 16);
+}
+
+size_t DmxPresetRecord::encode(const Messages::PresetEventData &preset, uint8_t *out, size_t capacity)
+{
+    return encode(preset.name, preset.universe1Data, preset.universe1Length, preset.universe2Data,
+        preset.universe2Length, out, capacity);
+}
+
+size_t DmxPresetRecord::encode(const DmxPreset &preset, uint8_t *out, size_t capacity)
+{
+    return encode(preset.getName(), preset.getUniverseData(0), preset.getUniverseLength(0), preset.getUniverseData(1),
+        preset.getUniverseLength(1), out, capacity);
+}
+
+size_t DmxPresetRecord::encode(const char *name, const uint8_t *universe1, uint16_t length1, const uint8_t *universe2,
+    uint16_t length2, uint8_t *out, size_t capacity)
+{
+    length1 = length1 > DMX_UNIVERSE_SIZE ? DMX_UNIVERSE_SIZE : length1;
+    length2 = length2 > DMX_UNIVERSE_SIZE ? DMX_UNIVERSE_SIZE : length2;
+    uint8_t nameLength = strnlen(name, DMX_PRESET_NAME_SIZE - 1);
+    size_t size = HEADER_SIZE + nameLength + length1 + length2 + CRC_SIZE;
+    if (!out || size > capacity)
+    {
+        return 0;
+    }
+
+    out[0] = RECORD_VERSION;
+    out[1] = nameLength;
+    writeUint16(out + 2, length1);
+    writeUint16(out + 4, length2);
+    writeUint16(out + 6, 0);
+    uint8_t *p = out + HEADER_SIZE;
+    memcpy(p, name, nameLength);
+    p += nameLength;
+
+    // Packed only when that is smaller than the plain values
+    size_t packed1 = 0;
+    size_t packed2 = 0;
+    size_t plainLength = length1 + length2;
+    if (plainLength > 0 &&
+        DmxUniverseCodec::pack(universe1, length1, p, plainLength - 1, packed1) == ESP_OK &&
+        DmxUniverseCodec::pack(universe2, length2, p + packed1, plainLength - 1 - packed1, packed2) == ESP_OK)
+    {
+        out[0] = PACKED_RECORD_VERSION;
+        p += packed1 + packed2;
+    }
+    else
+    {
+        memcpy(p, universe1, length1);
+        p += length1;
+        memcpy(p, universe2, length2);
+        p += length2;
+    }
+
+    writeUint32(p, esp_rom_crc32_le(0, out, p - out));
+    return p + CRC_SIZE - out;
+}
+
+esp_err_t DmxPresetRecord::decode(const uint8_t *record, size_t length, DmxPreset &preset)
+{
+    if (!record)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (getCrc(record, length) == 0)
+    {
+        ESP_LOGE(LOG_TAG, "Invalid preset record (%d bytes)", (int)length);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    // getCrc() has checked that the header and sizes are consistent
+    uint8_t nameLength = record[1];
+    uint16_t length1 = readUint16(record + 2);
+    uint16_t length2 = readUint16(record + 4);
+    const uint8_t *p = record + HEADER_SIZE;
+
+    char name[DMX_PRESET_NAME_SIZE];
+    memcpy(name, p, nameLength);
+    name[nameLength] = '\0';
+    preset.setName(name);
+    p += nameLength;
+
+    if (record[0] == PACKED_RECORD_VERSION)
+    {
+        size_t packedLength = length - HEADER_SIZE - nameLength - CRC_SIZE;
+        size_t consumed1 = 0;
+        size_t consumed2 = 0;
+        if (DmxUniverseCodec::unpack(p, packedLength, preset.getUniverseBuffer(0), length1, consumed1) != ESP_OK ||
+            DmxUniverseCodec::unpack(
+                p + consumed1, packedLength - consumed1, preset.getUniverseBuffer(1), length2, consumed2) != ESP_OK ||
+            consumed1 + consumed2 != packedLength)
+        {
+            ESP_LOGE(LOG_TAG, "Invalid packed universes in preset record");
+            return ESP_ERR_INVALID_ARG;
+        }
+        preset.setUniverseLength(0, length1);
+        preset.setUniverseLength(1, length2);
+        return ESP_OK;
+    }
+
+    preset.setUniverseData(0, p, length1);
+    p += length1;
+    preset.setUniverseData(1, p, length2);
+    return ESP_OK;
+}
+
+uint32_t DmxPresetRecord::getCrc(const uint8_t *record, size_t length)
+{
+    if (!record || length < HEADER_SIZE + CRC_SIZE ||
+        (record[0] != RECORD_VERSION && record[0] != PACKED_RECORD_VERSION))
+    {
+        return 0;
+    }
+
+    // Packed universes are always smaller than the plain values
+    uint8_t nameLength = record[1];
+    uint16_t length1 = readUint16(record + 2);
+    uint16_t length2 = readUint16(record + 4);
+    size_t plainSize = HEADER_SIZE + nameLength + length1 + length2 + CRC_SIZE;
+    bool sizeValid = record[0] == RECORD_VERSION
+                         ? length == plainSize
+                         : length >= HEADER_SIZE + nameLength + CRC_SIZE && length < plainSize;
+    if (nameLength >= DMX_PRESET_NAME_SIZE || length1 > DMX_UNIVERSE_SIZE || length2 > DMX_UNIVERSE_SIZE ||
+        !sizeValid)
+    {
+        return 0;
+    }
+
+    uint32_t storedCrc = readUint32(record + length - CRC_SIZE);
+    return esp_rom_crc32_le(0, record, length - CRC_SIZE) == storedCrc ? storedCrc : 0;
+}
+
+esp_err_t DmxPresetRecord::decodeLegacy(const uint8_t *blob, size_t length, DmxPreset &preset)
+{
+    // A record can be as long as a legacy blob, its CRC tells them apart
+    if (!blob || length != LEGACY_SIZE || getCrc(blob, length) != 0 ||
+        readUint16(blob + LEGACY_UNIVERSE1_LENGTH) > DMX_UNIVERSE_SIZE ||
+        readUint16(blob + LEGACY_UNIVERSE2_LENGTH) > DMX_UNIVERSE_SIZE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // The stored name pointer is not valid after a reboot
+    preset.setName(nullptr);
+    preset.setUniverseData(0, blob + LEGACY_UNIVERSE1_DATA, readUint16(blob + LEGACY_UNIVERSE1_LENGTH));
+    preset.setUniverseData(1, blob + LEGACY_UNIVERSE2_DATA, readUint16(blob + LEGACY_UNIVERSE2_LENGTH));
+    return ESP_OK;
+}
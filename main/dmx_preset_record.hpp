@@ -0,0 +1,53 @@
+#pragma once
+
+#include "dmx_preset.hpp"
+#include "messages.hpp"
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// On-flash preset record. Layout (little endian, no padding):
+//   uint8  version (RECORD_VERSION or PACKED_RECORD_VERSION)
+//   uint8  nameLength (0..DMX_PRESET_NAME_SIZE - 1)
+//   uint16 universe1Length
+//   uint16 universe2Length
+//   uint16 reserved (0)
+//   name bytes (not null terminated)
+//   RECORD_VERSION: universe 1 values, universe 2 values (trimmed to their lengths)
+//   PACKED_RECORD_VERSION: universe 1 and universe 2 each packed by DmxUniverseCodec
+//   uint32 CRC32 (ROM CRC routine) over all preceding bytes
+// Universes are stored packed when that is smaller, so a record never exceeds MAX_SIZE.
+class DmxPresetRecord
+{
+  public:
+    static const uint8_t RECORD_VERSION = 1;
+    static const uint8_t PACKED_RECORD_VERSION = 2;
+    static const size_t HEADER_SIZE = 8;
+    static const size_t CRC_SIZE = 4;
+    static const size_t MAX_SIZE = HEADER_SIZE + (DMX_PRESET_NAME_SIZE - 1) + 2 * DMX_UNIVERSE_SIZE + CRC_SIZE;
+
+    // Size of the raw Messages::PresetEventData blobs written by older firmware (32-bit name pointer)
+    static const size_t LEGACY_SIZE = 1036;
+
+    // Encode preset data into out (capacity bytes); returns the record size, 0 if it does not fit
+    static size_t encode(const Messages::PresetEventData &preset, uint8_t *out, size_t capacity);
+    static size_t encode(const DmxPreset &preset, uint8_t *out, size_t capacity);
+
+    // Validate a record and decode it straight into a preset, unpacking without a buffer
+    static esp_err_t decode(const uint8_t *record, size_t length, DmxPreset &preset);
+
+    // Decode a blob of older firmware, which has no CRC; only for migrating them, anything else goes through decode()
+    static esp_err_t decodeLegacy(const uint8_t *blob, size_t length, DmxPreset &preset);
+
+    // CRC stored in a valid record, 0 for legacy blobs and invalid records
+    static uint32_t getCrc(const uint8_t *record, size_t length);
+
+  private:
+    static size_t encode(const char *name, const uint8_t *universe1, uint16_t length1, const uint8_t *universe2,
+        uint16_t length2, uint8_t *out, size_t capacity);
+    static uint16_t readUint16(const uint8_t *data) { return data[0] | (data[1] << 8); }
+    static uint32_t readUint32(const uint8_t *data)
+    {
+        return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+    }
+};
@@ -1,18 +1,27 @@
-
 #include "dmx_presets.hpp"
 #include <cstring>
 #include <esp_log.h>
 
 static const char *LOG_TAG = "DmxPresets";
 
-DmxPresets::DmxPresets() : numPresets_(20) // Default to 20 presets
+DmxPresets::DmxPresets()
+    : numPresets_(MIN_PRESETS), currentPresetIndex_(0), loader_(nullptr), useCounter_(0), cacheHits_(0),
+      cacheMisses_(0)
 {
-    presets_.resize(MAX_PRESETS);
+    cache_.resize(PRESET_CACHE_SIZE);
+    invalidateCache();
 }
 
-esp_err_t DmxPresets::init()
+esp_err_t DmxPresets::init(DmxPresetLoader *loader)
 {
-    ESP_LOGI(LOG_TAG, "DmxPresets initialized with %d presets", numPresets_);
+    if (!loader)
+    {
+        ESP_LOGE(LOG_TAG, "Invalid preset loader");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    loader_ = loader;
+    ESP_LOGI(LOG_TAG, "DmxPresets initialized with %d presets, %d cached", numPresets_, PRESET_CACHE_SIZE);
     return ESP_OK;
 }
 
@@ -32,41 +41,36 @@ esp_err_t DmxPresets::setNumPresets(uint8_t numPresets)
         currentPresetIndex_ = 0;
     }
 
-    return ESP_OK; // TODO
+    return ESP_OK;
 }
 
-esp_err_t DmxPresets::addPreset(uint8_t presetNumber, const char *name, uint16_t universe11Length,
-    const uint8_t *universe1Data, uint16_t universe2Length, const uint8_t *universe2Data)
+DmxPreset &DmxPresets::getPreset(uint8_t index)
 {
-    uint8_t index = presets_.size();
     if (index >= numPresets_)
     {
         ESP_LOGE(LOG_TAG, "Preset index %d out of range (max %d)", index, numPresets_ - 1);
-        return ESP_ERR_INVALID_ARG;
+        index = 0;
     }
 
-    if (!name || !universe1Data || !universe2Data)
+    int slot = findCacheSlot(index);
+    if (slot >= 0)
     {
-        ESP_LOGE(LOG_TAG, "Invalid pointer arguments");
-        return ESP_ERR_INVALID_ARG;
+        cacheHits_++;
+    }
+    else
+    {
+        cacheMisses_++;
+        slot = loadIntoCache(index);
     }
 
-    presets_[index].setIndex(presetNumber);
-    presets_[index].setName(name);
-    presets_[index].setUniverseData(0, universe1Data, universe11Length);
-    presets_[index].setUniverseData(1, universe2Data, universe2Length);
-
-    ESP_LOGI(LOG_TAG, "Added preset at index %d: %s", index, name);
-    return ESP_OK;
+    lastUsed_[slot] = ++useCounter_;
+    return cache_[slot];
 }
 
-DmxPreset &DmxPresets::getPreset(uint8_t index)
+DmxPreset *DmxPresets::getCachedPreset(uint8_t index)
 {
-    if (index >= numPresets_)
-    {
-        ESP_LOGE(LOG_TAG, "Preset index %d out of range (max %d)", index, numPresets_ - 1);
-    }
-    return presets_[index];
+    int slot = findCacheSlot(index);
+    return slot >= 0 ? &cache_[slot] : nullptr;
 }
 
 esp_err_t DmxPresets::setPreset(uint8_t index, const DmxPreset &preset)
@@ -77,17 +81,37 @@ esp_err_t DmxPresets::setPreset(uint8_t index, const DmxPreset &preset)
         return ESP_ERR_INVALID_ARG;
     }
 
-    // TODO presets_[index].copyFrom(preset);
-    return ESP_OK; // TODO
+    int slot = findCacheSlot(index);
+    if (slot >= 0)
+    {
+        cache_[slot].copyFrom(preset);
+    }
+    return ESP_OK;
 }
 
-void DmxPresets::clearAll()
+void DmxPresets::invalidateCache()
 {
-    for (auto &preset : presets_)
+    for (uint8_t slot = 0; slot < PRESET_CACHE_SIZE; slot++)
     {
-        preset.clear();
+        cachedIndex_[slot] = NO_PRESET;
+        lastUsed_[slot] = 0;
+    }
+}
+
+void DmxPresets::prefetchNeighbours()
+{
+    uint8_t nextIndex = (currentPresetIndex_ + 1) % numPresets_;
+    uint8_t previousIndex = (currentPresetIndex_ - 1 + numPresets_) % numPresets_;
+
+    // Prefetched presets get a use stamp so they survive until the next switch
+    if (findCacheSlot(nextIndex) < 0)
+    {
+        lastUsed_[loadIntoCache(nextIndex)] = ++useCounter_;
+    }
+    if (findCacheSlot(previousIndex) < 0)
+    {
+        lastUsed_[loadIntoCache(previousIndex)] = ++useCounter_;
     }
-    currentPresetIndex_ = 0;
 }
 
 void DmxPresets::setCurrentPresetIndex(uint8_t index)
@@ -95,7 +119,7 @@ void DmxPresets::setCurrentPresetIndex(uint8_t index)
     if (index < numPresets_)
     {
         currentPresetIndex_ = index;
-        // Note: We don't save to NVRAM here for performance, it will be saved when presets change
+        // Not saved here: DmxPresetChanger appends it to its resume log once the preset has been sent
     }
     else
     {
@@ -113,4 +137,44 @@ uint8_t DmxPresets::selectPreviousPreset()
 {
     currentPresetIndex_ = (currentPresetIndex_ - 1 + numPresets_) % numPresets_;
     return currentPresetIndex_;
-}
\ No newline at end of file
+}
+
+uint8_t DmxPresets::getCacheHitRatePercent() const
+{
+    uint32_t lookups = cacheHits_ + cacheMisses_;
+    return lookups == 0 ? 0 : (uint8_t)((cacheHits_ * 100ULL) / lookups);
+}
+
+int DmxPresets::findCacheSlot(uint8_t index) const
+{
+    for (uint8_t slot = 0; slot < PRESET_CACHE_SIZE; slot++)
+    {
+        if (cachedIndex_[slot] == index)
+        {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+int DmxPresets::loadIntoCache(uint8_t index)
+{
+    // Evict the least recently used slot (empty slots have stamp 0)
+    int slot = 0;
+    for (uint8_t i = 1; i < PRESET_CACHE_SIZE; i++)
+    {
+        if (lastUsed_[i] < lastUsed_[slot])
+        {
+            slot = i;
+        }
+    }
+
+    cachedIndex_[slot] = index;
+    if (!loader_ || loader_->loadPreset(index, cache_[slot]) != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to load preset %d, using empty preset", index);
+        cache_[slot].clear();
+        cache_[slot].setIndex(index);
+    }
+    return slot;
+}
@@ -4,35 +4,51 @@
 #include <esp_err.h>
 #include <vector>
 // Maximum number of presets
-#define MAX_PRESETS 20
+#define MAX_PRESETS 250
 #define MIN_PRESETS 2
 
+// Number of presets kept in RAM (current, next, previous and one spare)
+#define PRESET_CACHE_SIZE 4
+
+// Source of preset data (e.g. flash storage), used to fill the preset cache on demand
+class DmxPresetLoader
+{
+  public:
+    virtual ~DmxPresetLoader() {}
+    virtual esp_err_t loadPreset(uint8_t index, DmxPreset &preset) = 0;
+};
+
 class DmxPresets
 {
   public:
     // Constructor
     DmxPresets();
 
-    // Initialize with NVS storage
-    esp_err_t init();
+    // Initialize with the loader that reads presets from storage
+    esp_err_t init(DmxPresetLoader *loader);
 
-    // Set number of presets (2-20)
+    // Set number of presets (2-250)
     esp_err_t setNumPresets(uint8_t numPresets);
-    esp_err_t addPreset(uint8_t presetNumber, const char *name, uint16_t universe11Length,
-        const uint8_t *universe1Ddata, uint16_t universe2Length, const uint8_t *universe2Data);
 
     // Get number of presets
     uint8_t getNumPresets() const { return numPresets_; }
 
-    // Get preset by index
+    // Get preset by index, loading it into the cache when needed.
+    // The reference stays valid until another preset is loaded.
     DmxPreset &getPreset(uint8_t index);
-    DmxPreset &getCurrentPreset() { return presets_[currentPresetIndex_]; }
+    DmxPreset &getCurrentPreset() { return getPreset(currentPresetIndex_); }
+
+    // Cached copy of a preset, nullptr if not cached (does not load or count as a cache lookup)
+    DmxPreset *getCachedPreset(uint8_t index);
 
-    // Set preset data
+    // Set preset data (updates the cached copy, if any)
     esp_err_t setPreset(uint8_t index, const DmxPreset &preset);
 
-    // Clear all presets
-    void clearAll();
+    // Drop all cached presets, e.g. after the stored presets have been replaced
+    void invalidateCache();
+
+    // Load the next and previous preset of the current one into the cache
+    void prefetchNeighbours();
 
     // Get current preset index
     uint8_t getCurrentPresetIndex() const { return currentPresetIndex_; }
@@ -46,8 +62,25 @@ class DmxPresets
     // Move to previous preset (with wraparound)
     uint8_t selectPreviousPreset();
 
+    // Cache statistics
+    uint32_t getCacheHits() const { return cacheHits_; }
+    uint32_t getCacheMisses() const { return cacheMisses_; }
+    uint8_t getCacheHitRatePercent() const;
+
   private:
+    static const uint8_t NO_PRESET = 0xFF;
+
     uint8_t numPresets_;
     uint8_t currentPresetIndex_;
-    std::vector<DmxPreset> presets_;
-};
\ No newline at end of file
+    DmxPresetLoader *loader_;
+
+    std::vector<DmxPreset> cache_;
+    uint8_t cachedIndex_[PRESET_CACHE_SIZE]; // Preset index per cache slot, NO_PRESET if empty
+    uint32_t lastUsed_[PRESET_CACHE_SIZE];   // Use stamp per cache slot, lowest is least recently used
+    uint32_t useCounter_;
+    uint32_t cacheHits_;
+    uint32_t cacheMisses_;
+
+    int findCacheSlot(uint8_t index) const;
+    int loadIntoCache(uint8_t index);
+};
@@ -0,0 +1,146 @@
+#include "dmx_universe_codec.hpp"
+#include <cstring>
+
+esp_err_t DmxUniverseCodec::pack(
+    const uint8_t *data, uint16_t length, uint8_t *out, size_t capacity, size_t &packedLength)
+{
+    if (!data || !out)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t size = 0;
+    uint16_t literalStart = 0;
+    uint16_t position = 0;
+    while (position <= length)
+    {
+        // Longest run of equal values and longest back reference at this position (greedy)
+        uint16_t runLength = 0;
+        uint16_t matchLength = 0;
+        uint16_t matchDistance = 0;
+        uint16_t maxLength = length - position < MAX_RUN ? length - position : MAX_RUN;
+        if (maxLength >= MIN_RUN)
+        {
+            while (runLength < maxLength && data[position + runLength] == data[position])
+            {
+                runLength++;
+            }
+            uint16_t maxDistance = position < MAX_DISTANCE ? position : MAX_DISTANCE;
+            for (uint16_t distance = 1; distance <= maxDistance && matchLength < maxLength; distance++)
+            {
+                const uint8_t *candidate = data + position - distance;
+                uint16_t candidateLength = 0;
+                while (candidateLength < maxLength && candidate[candidateLength] == data[position + candidateLength])
+                {
+                    candidateLength++;
+                }
+                if (candidateLength > matchLength)
+                {
+                    matchLength = candidateLength;
+                    matchDistance = distance;
+                }
+            }
+        }
+
+        bool isRun = runLength >= MIN_RUN && runLength >= matchLength;
+        bool isMatch = !isRun && matchLength >= MIN_RUN;
+        bool isEnd = position == length;
+
+        // Flush pending literals before a run, a match or the end, or when they fill a token
+        uint16_t literals = position - literalStart;
+        if (literals > 0 && (isRun || isMatch || isEnd || literals == MAX_LITERALS))
+        {
+            if (size + 1 + literals > capacity)
+            {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            out[size++] = literals - 1;
+            memcpy(out + size, data + literalStart, literals);
+            size += literals;
+            literalStart = position;
+        }
+        if (isEnd)
+        {
+            break;
+        }
+
+        if (isRun || isMatch)
+        {
+            if (size + 2 > capacity)
+            {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            uint16_t tokenLength = isRun ? runLength : matchLength;
+            out[size++] = (isRun ? RUN_TOKEN : MATCH_TOKEN) | (tokenLength - MIN_RUN);
+            out[size++] = isRun ? data[position] : matchDistance - 1;
+            position += tokenLength;
+            literalStart = position;
+        }
+        else
+        {
+            position++;
+        }
+    }
+    packedLength = size;
+    return ESP_OK;
+}
+
+esp_err_t DmxUniverseCodec::unpack(
+    const uint8_t *packed, size_t packedLength, uint8_t *out, uint16_t length, size_t &consumed)
+{
+    if (!packed || !out)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t offset = 0;
+    uint16_t position = 0;
+    while (position < length)
+    {
+        if (offset >= packedLength)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        uint8_t token = packed[offset++];
+
+        if (token < RUN_TOKEN)
+        {
+            uint16_t count = token + 1;
+            if (count > length - position || count > packedLength - offset)
+            {
+                return ESP_ERR_INVALID_SIZE;
+            }
+            memcpy(out + position, packed + offset, count);
+            offset += count;
+            position += count;
+            continue;
+        }
+
+        uint16_t count = (token & 0x3F) + MIN_RUN;
+        if (count > length - position || offset >= packedLength)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+        uint8_t operand = packed[offset++];
+        if (token < MATCH_TOKEN)
+        {
+            memset(out + position, operand, count);
+        }
+        else
+        {
+            uint16_t distance = operand + 1;
+            if (distance > position)
+            {
+                return ESP_ERR_INVALID_ARG;
+            }
+            // Byte by byte: the source may overlap the bytes written by this token
+            for (uint16_t i = 0; i < count; i++)
+            {
+                out[position + i] = out[position + i - distance];
+            }
+        }
+        position += count;
+    }
+    consumed = offset;
+    return ESP_OK;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Small LZ77-style codec for DMX universe data. Presets mostly consist of unused (zero) channels, runs of equal
+// values and fixtures with identical settings repeating at the fixture footprint, which runs and back references
+// capture well. A packed universe is a sequence of tokens:
+//   0LLLLLLL           L + 1 literal bytes follow (1..128)
+//   10LLLLLL v         L + 3 times value v (3..66)
+//   11LLLLLL d         copy L + 3 bytes (3..66) from d + 1 bytes back (1..256), may overlap the bytes being written
+// The decoder needs no state or buffer besides the destination, so it unpacks straight into a preset.
+class DmxUniverseCodec
+{
+  public:
+    // Pack length bytes into out (capacity bytes); ESP_ERR_INVALID_SIZE if they do not fit
+    static esp_err_t pack(const uint8_t *data, uint16_t length, uint8_t *out, size_t capacity, size_t &packedLength);
+
+    // Unpack exactly length bytes into out, reading at most packedLength bytes; consumed is set to the number of
+    // packed bytes used. On invalid input out may be partly written.
+    static esp_err_t unpack(
+        const uint8_t *packed, size_t packedLength, uint8_t *out, uint16_t length, size_t &consumed);
+
+  private:
+    static const uint8_t MAX_LITERALS = 128;
+    static const uint8_t MIN_RUN = 3;
+    static const uint8_t MAX_RUN = 66;
+    static const uint16_t MAX_DISTANCE = 256;
+    static const uint8_t RUN_TOKEN = 0x80;
+    static const uint8_t MATCH_TOKEN = 0xC0;
+};
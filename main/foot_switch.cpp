@@ -27,6 +27,7 @@ static void IRAM_ATTR isr_handler(void *arg)
 static const char *LOG_TAG = "FootSwitch";
 static const int QUEUE_CAPACITY = 10;
 static const int TASK_PRIORITY = 5;
+static const uint32_t CAPTURE_PRESS_FACTOR = 3; // Holding for 3 long press thresholds captures the output
 
 FootSwitch::FootSwitch()
     : RtosTask(), pin_(GPIO_NUM_NC), lastPinState_(false), pressStartTime_(0),
@@ -39,7 +40,7 @@ FootSwitch::~FootSwitch() {}
 
 esp_err_t FootSwitch::init(QueueHandle_t dmxControllerEventQueue, gpio_num_t pinNum)
 {
-    if (RtosTask::init("FootSwitchTask", 2048, TASK_PRIORITY, QUEUE_CAPACITY, sizeof(Messages::Event),
+    if (RtosTask::init("FootSwitchTask", 4096, TASK_PRIORITY, QUEUE_CAPACITY, sizeof(Messages::Event),
             dmxControllerEventQueue) != ESP_OK)
     {
         ESP_LOGE(LOG_TAG, "Failed to initialize FootSwitchTask");
@@ -121,18 +122,29 @@ void FootSwitch::taskLoop()
                         // Debouncing finished: switch released
                         TickType_t now = xTaskGetTickCount();
                         TickType_t elapsedMs = (now - pressStartTime_) * portTICK_PERIOD_MS;
-                        if (elapsedMs >= longPressThresholdMs_)
+                        if (elapsedMs >= CAPTURE_PRESS_FACTOR * longPressThresholdMs_)
                         {
-                            ESP_LOGI(LOG_TAG, "Long press detected: %lu ms", elapsedMs);
-                            bool legal = HandleLongPress();
-                            if (!legal)
+                            ESP_LOGI(LOG_TAG, "Capture press detected: %lu ms", elapsedMs);
+                            if (HandleCapturePress() != ESP_OK)
                             {
-                                ESP_LOGW(LOG_TAG, "Long press not legal in current state");
+                                ESP_LOGW(LOG_TAG, "Capture press not legal in current state");
                             }
                         }
-                        if (HandleShortPress() != ESP_OK)
+                        else
                         {
-                            ESP_LOGW(LOG_TAG, "Short press not legal in current state");
+                            if (elapsedMs >= longPressThresholdMs_)
+                            {
+                                ESP_LOGI(LOG_TAG, "Long press detected: %lu ms", elapsedMs);
+                                bool legal = HandleLongPress();
+                                if (!legal)
+                                {
+                                    ESP_LOGW(LOG_TAG, "Long press not legal in current state");
+                                }
+                            }
+                            if (HandleShortPress() != ESP_OK)
+                            {
+                                ESP_LOGW(LOG_TAG, "Short press not legal in current state");
+                            }
                         }
                     }
                 }
@@ -229,4 +241,24 @@ esp_err_t FootSwitch::HandleLongPress()
         return ESP_FAIL;
     }
     return ESP_OK;
+}
+
+esp_err_t FootSwitch::HandleCapturePress()
+{
+    if (state_ != State::NORMAL_OPERATION)
+    {
+        return ESP_FAIL;
+    }
+
+    // Capture the current output into the current preset
+    Messages::Event event;
+    event.type = Messages::CAPTURE_PRESET;
+    event.data.captureData.presetNumber = Messages::CURRENT_PRESET;
+    event.data.captureData.source = Messages::CAPTURE_OUTPUT;
+    if (xQueueSend(getDmxControllerEventQueue(), &event, portMAX_DELAY) != pdPASS)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to send CAPTURE_PRESET event to DMX Controller");
+        return ESP_FAIL;
+    }
+    return ESP_OK;
 }
\ No newline at end of file
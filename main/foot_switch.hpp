@@ -43,4 +43,5 @@ class FootSwitch : public RtosTask {
 
     esp_err_t HandleShortPress();
     esp_err_t HandleLongPress();
+    esp_err_t HandleCapturePress();
 };
\ No newline at end of file
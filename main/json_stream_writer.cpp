@@ -0,0 +1,208 @@
+#include "json_stream_writer.hpp"
+#include <cstring>
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+static const char BASE64_DIGITS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+JsonStreamWriter::JsonStreamWriter(Sink sink, void *context)
+    : sink_(sink), context_(context), error_(ESP_OK), needsComma_(false), used_(0)
+{
+}
+
+void JsonStreamWriter::beginObject()
+{
+    beginValue();
+    put('{');
+    needsComma_ = false;
+}
+
+void JsonStreamWriter::endObject()
+{
+    put('}');
+    needsComma_ = true;
+}
+
+void JsonStreamWriter::beginArray()
+{
+    beginValue();
+    put('[');
+    needsComma_ = false;
+}
+
+void JsonStreamWriter::endArray()
+{
+    put(']');
+    needsComma_ = true;
+}
+
+void JsonStreamWriter::key(const char *name)
+{
+    string(name);
+    put(':');
+    needsComma_ = false;
+}
+
+void JsonStreamWriter::number(int32_t value)
+{
+    beginValue();
+    if (value < 0)
+    {
+        put('-');
+        writeUnsigned(0 - (uint32_t)value);
+    }
+    else
+    {
+        writeUnsigned(value);
+    }
+}
+
+void JsonStreamWriter::boolean(bool value)
+{
+    beginValue();
+    write(value ? "true" : "false", value ? 4 : 5);
+}
+
+void JsonStreamWriter::string(const char *value)
+{
+    beginValue();
+    put('"');
+    for (const char *c = value ? value : ""; *c; c++)
+    {
+        uint8_t ch = *c;
+        if (ch == '"' || ch == '\\')
+        {
+            put('\\');
+            put(ch);
+        }
+        else if (ch < 0x20)
+        {
+            char escaped[6] = {'\\', 'u', '0', '0', HEX_DIGITS[ch >> 4], HEX_DIGITS[ch & 0xF]};
+            write(escaped, sizeof(escaped));
+        }
+        else
+        {
+            put(ch);
+        }
+    }
+    put('"');
+}
+
+void JsonStreamWriter::uint8Array(const uint8_t *values, size_t count)
+{
+    beginArray();
+    for (size_t i = 0; i < count; i++)
+    {
+        // Comma and at most three digits; written directly, this is the bulk of a preset
+        reserve(4);
+        if (i > 0)
+        {
+            buffer_[used_++] = ',';
+        }
+        uint8_t value = values[i];
+        if (value >= 100)
+        {
+            buffer_[used_++] = '0' + value / 100;
+        }
+        if (value >= 10)
+        {
+            buffer_[used_++] = '0' + value / 10 % 10;
+        }
+        buffer_[used_++] = '0' + value % 10;
+    }
+    endArray();
+}
+
+void JsonStreamWriter::base64(const uint8_t *values, size_t count)
+{
+    beginValue();
+    put('"');
+    for (size_t i = 0; i < count; i += 3)
+    {
+        uint32_t bits = values[i] << 16;
+        if (i + 1 < count)
+        {
+            bits |= values[i + 1] << 8;
+        }
+        if (i + 2 < count)
+        {
+            bits |= values[i + 2];
+        }
+        reserve(4);
+        buffer_[used_++] = BASE64_DIGITS[bits >> 18];
+        buffer_[used_++] = BASE64_DIGITS[bits >> 12 & 0x3F];
+        buffer_[used_++] = i + 1 < count ? BASE64_DIGITS[bits >> 6 & 0x3F] : '=';
+        buffer_[used_++] = i + 2 < count ? BASE64_DIGITS[bits & 0x3F] : '=';
+    }
+    put('"');
+}
+
+void JsonStreamWriter::hex(const uint8_t *values, size_t count)
+{
+    beginValue();
+    put('"');
+    for (size_t i = 0; i < count; i++)
+    {
+        reserve(2);
+        buffer_[used_++] = HEX_DIGITS[values[i] >> 4];
+        buffer_[used_++] = HEX_DIGITS[values[i] & 0xF];
+    }
+    put('"');
+}
+
+esp_err_t JsonStreamWriter::flush()
+{
+    if (error_ == ESP_OK && used_ > 0)
+    {
+        error_ = sink_(context_, buffer_, used_);
+    }
+    used_ = 0;
+    return error_;
+}
+
+void JsonStreamWriter::beginValue()
+{
+    if (needsComma_)
+    {
+        put(',');
+    }
+    needsComma_ = true;
+}
+
+void JsonStreamWriter::reserve(size_t length)
+{
+    if (used_ + length > BUFFER_SIZE)
+    {
+        flush();
+    }
+}
+
+void JsonStreamWriter::put(char c)
+{
+    reserve(1);
+    buffer_[used_++] = c;
+}
+
+void JsonStreamWriter::write(const char *data, size_t length)
+{
+    while (length > 0)
+    {
+        reserve(1);
+        size_t count = BUFFER_SIZE - used_ < length ? BUFFER_SIZE - used_ : length;
+        memcpy(buffer_ + used_, data, count);
+        used_ += count;
+        data += count;
+        length -= count;
+    }
+}
+
+void JsonStreamWriter::writeUnsigned(uint32_t value)
+{
+    char digits[10];
+    size_t count = 0;
+    do
+    {
+        digits[sizeof(digits) - ++count] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    write(digits + sizeof(digits) - count, count);
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Writes JSON text through a small fixed buffer that is handed to a sink whenever it fills, so a document of any
+// size is produced without building it in memory and without allocating per value. Commas between values are
+// inserted automatically; the caller is responsible for a well-formed nesting of objects, arrays and keys.
+class JsonStreamWriter
+{
+  public:
+    // Receives each filled part of the buffer; an error stops the writer
+    typedef esp_err_t (*Sink)(void *context, const char *data, size_t length);
+
+    JsonStreamWriter(Sink sink, void *context);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+    void key(const char *name);
+    void number(int32_t value);
+    void boolean(bool value);
+    void string(const char *value);
+    void uint8Array(const uint8_t *values, size_t count); // As an array of numbers
+    void base64(const uint8_t *values, size_t count);     // As a string, RFC 4648 with padding
+    void hex(const uint8_t *values, size_t count);        // As a string, two lowercase digits per value
+
+    // Hand what is left in the buffer to the sink; returns the first error of the sink, if any
+    esp_err_t flush();
+    esp_err_t getError() const { return error_; }
+
+  private:
+    static const size_t BUFFER_SIZE = 512;
+
+    Sink sink_;
+    void *context_;
+    esp_err_t error_;
+    bool needsComma_; // A value was written at the current nesting level
+    size_t used_;
+    char buffer_[BUFFER_SIZE];
+
+    void beginValue();
+    void reserve(size_t length); // Flushes unless length more bytes fit
+    void put(char c);
+    void write(const char *data, size_t length);
+    void writeUnsigned(uint32_t value);
+};
@@ -0,0 +1,139 @@
+#include "live_overrides.hpp"
+#include "messages.hpp"
+#include <cstring>
+#include <esp_log.h>
+#include <esp_timer.h>
+
+static const char *LOG_TAG = "LiveOverrides";
+
+LiveOverrides::LiveOverrides()
+    : lock_(portMUX_INITIALIZER_UNLOCKED), outputEventQueue_(nullptr), releaseAll_(false), pending_(false),
+      pendingSinceUs_(0)
+{
+    memset(values_, 0, sizeof(values_));
+    memset(setMask_, 0, sizeof(setMask_));
+    memset(releaseMask_, 0, sizeof(releaseMask_));
+}
+
+void LiveOverrides::init(QueueHandle_t outputEventQueue) { outputEventQueue_ = outputEventQueue; }
+
+esp_err_t LiveOverrides::setChannel(uint16_t channel, uint8_t value)
+{
+    if (channel >= DMX_FRAME_CHANNELS)
+    {
+        ESP_LOGE(LOG_TAG, "Channel %d out of range (max %d)", channel, DMX_FRAME_CHANNELS - 1);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t bit = 1UL << (channel & 31);
+    taskENTER_CRITICAL(&lock_);
+    values_[channel] = value;
+    setMask_[channel >> 5] |= bit;
+    releaseMask_[channel >> 5] &= ~bit;
+    taskEXIT_CRITICAL(&lock_);
+
+    markPending();
+    return ESP_OK;
+}
+
+esp_err_t LiveOverrides::releaseChannel(uint16_t channel)
+{
+    if (channel >= DMX_FRAME_CHANNELS)
+    {
+        ESP_LOGE(LOG_TAG, "Channel %d out of range (max %d)", channel, DMX_FRAME_CHANNELS - 1);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    uint32_t bit = 1UL << (channel & 31);
+    taskENTER_CRITICAL(&lock_);
+    setMask_[channel >> 5] &= ~bit;
+    releaseMask_[channel >> 5] |= bit;
+    taskEXIT_CRITICAL(&lock_);
+
+    markPending();
+    return ESP_OK;
+}
+
+void LiveOverrides::releaseAll()
+{
+    taskENTER_CRITICAL(&lock_);
+    memset(setMask_, 0, sizeof(setMask_));
+    memset(releaseMask_, 0, sizeof(releaseMask_));
+    releaseAll_ = true;
+    taskEXIT_CRITICAL(&lock_);
+
+    markPending();
+}
+
+void LiveOverrides::apply(DmxLayerStack &layers)
+{
+    uint32_t setMask[BITMAP_WORDS];
+    uint32_t releaseMask[BITMAP_WORDS];
+    bool releaseAll;
+
+    // Only the masks are taken under the lock; values of set channels are read below and may already be newer,
+    // which is fine since only the latest value matters
+    taskENTER_CRITICAL(&lock_);
+    if (!pending_)
+    {
+        taskEXIT_CRITICAL(&lock_);
+        return;
+    }
+    memcpy(setMask, setMask_, sizeof(setMask));
+    memcpy(releaseMask, releaseMask_, sizeof(releaseMask));
+    releaseAll = releaseAll_;
+    memset(setMask_, 0, sizeof(setMask_));
+    memset(releaseMask_, 0, sizeof(releaseMask_));
+    releaseAll_ = false;
+    pending_ = false;
+    pendingSinceUs_ = 0;
+    taskEXIT_CRITICAL(&lock_);
+
+    if (releaseAll)
+    {
+        layers.releaseAll(DmxLayerStack::OVERRIDE);
+    }
+
+    for (uint16_t bitmapIndex = 0; bitmapIndex < BITMAP_WORDS; bitmapIndex++)
+    {
+        uint32_t bits = setMask[bitmapIndex] | releaseMask[bitmapIndex];
+        while (bits)
+        {
+            uint16_t channel = bitmapIndex * 32 + __builtin_ctz(bits);
+            uint32_t bit = bits & -bits;
+            bits &= bits - 1;
+            if (setMask[bitmapIndex] & bit)
+            {
+                layers.setChannel(DmxLayerStack::OVERRIDE, channel, values_[channel]);
+            }
+            else
+            {
+                layers.releaseChannels(DmxLayerStack::OVERRIDE, channel, 1);
+            }
+        }
+    }
+}
+
+void LiveOverrides::markPending()
+{
+    bool wake = false;
+    taskENTER_CRITICAL(&lock_);
+    if (!pending_)
+    {
+        pending_ = true;
+        pendingSinceUs_ = esp_timer_get_time();
+        wake = true;
+    }
+    taskEXIT_CRITICAL(&lock_);
+
+    // One wake-up per frame: later changes are picked up by the same apply()
+    if (wake && outputEventQueue_)
+    {
+        Messages::Event event;
+        event.type = Messages::APPLY_LIVE_OVERRIDES;
+        if (xQueueSend(outputEventQueue_, &event, 0) != pdPASS)
+        {
+            ESP_LOGW(LOG_TAG, "Output queue full, overrides applied with the next frame");
+        }
+    }
+}
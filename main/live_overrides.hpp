@@ -0,0 +1,50 @@
+#pragma once
+
+#include "dmx_frame.hpp"
+#include "dmx_layer_stack.hpp"
+#include <esp_err.h>
+#include <stdint.h>
+
+extern "C"
+{
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+}
+
+// Mailbox for live channel overrides arriving from the web server and OSC.
+// Writers only record the latest value per channel; the output task applies all pending changes once per frame,
+// so a burst of fader messages costs one frame. Overrides are never persisted.
+class LiveOverrides
+{
+  public:
+    static const uint16_t BITMAP_WORDS = DMX_FRAME_CHANNELS / 32;
+
+    LiveOverrides();
+
+    // Queue of the output task, woken when the first change after a frame arrives
+    void init(QueueHandle_t outputEventQueue);
+
+    // Called from any task
+    esp_err_t setChannel(uint16_t channel, uint8_t value);
+    esp_err_t releaseChannel(uint16_t channel);
+    void releaseAll();
+
+    // Called from the output task: move pending changes into the override layer
+    void apply(DmxLayerStack &layers);
+
+    // Arrival time of the oldest change not yet applied (0 if none)
+    int64_t getPendingSinceUs() const { return pendingSinceUs_; }
+
+  private:
+    portMUX_TYPE lock_;
+    QueueHandle_t outputEventQueue_;
+
+    uint8_t values_[DMX_FRAME_CHANNELS];
+    uint32_t setMask_[BITMAP_WORDS];
+    uint32_t releaseMask_[BITMAP_WORDS];
+    bool releaseAll_;
+    bool pending_;
+    volatile int64_t pendingSinceUs_;
+
+    void markPending();
+};
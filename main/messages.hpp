@@ -1,21 +1,22 @@
 #pragma once
 
+#include "dmx_preset_delta.hpp"
+
 class Messages
 {
   public:
-    static const uint8_t MAX_NR_OF_PRESETS = 20;
-
     enum EventType
     {
         // Initialization
         REQUEST_CONFIGURATION,      // DMX Controller -> NVS Storage
         CONFIGURATION_RESPONSE,     // NVS Storage -> DMX Controller
-        SET_CONFIGURATION,          // DMX Controller -> Foot Switch
+        SET_CONFIGURATION,          // DMX Controller -> Foot Switch (also Web Server -> DMX Controller, show import)
         SET_CONFIGURATION_RESPONSE, // Foot Switch -> DMX Controller
         REQUEST_PRESETS,            // DMX Controller -> Preset Changer
         PRESETS_RESPONSE,           // Preset Changer -> DMX Controller
-        SET_PRESETS,
+        SET_PRESETS, // DMX Controller -> Preset Changer (also Web Server -> DMX Controller, show import)
         SET_PRESETS_RESPONSE,
+        SET_PRESET, // -> NVS Storage (stores a single preset)
 
         // Story: Foot switch for next/previous preset
         USER_NEXT_PRESET,          // Foot Switch -> DMX Controller
@@ -25,29 +26,130 @@ class Messages
         USE_PRESET_DATA,           // Preset Changer -> DMX Controller
         SEND_PRESET_DATA,          // DMX Controller -> Art-Net Sender
         SEND_PRESET_DATA_RESPONSE, // Art-Net Sender -> DMX Controller
-        SHOW_PRESET_INDEX          // DMX Controller -> Seven Segment Display
+        SHOW_PRESET_INDEX,         // DMX Controller -> Seven Segment Display
+
+        // Story: Group masters and grand master
+        DEFINE_GROUP,       // Web Server -> DMX Controller -> Art-Net Sender
+        SET_GROUP_CHANNELS, // Web Server -> DMX Controller -> Art-Net Sender
+        SET_GROUP_LEVEL,    // Web Server -> DMX Controller -> Art-Net Sender
+        SET_GRAND_MASTER,   // Web Server -> DMX Controller -> Art-Net Sender
+
+        // Story: Per-channel response curves
+        SET_CHANNEL_CURVE, // Web Server -> DMX Controller -> Art-Net Sender
+
+        // Story: Layered playback (effects, live overrides, parked channels)
+        SET_LAYER_CHANNELS,     // Web Server -> DMX Controller -> Art-Net Sender
+        RELEASE_LAYER_CHANNELS, // Web Server -> DMX Controller -> Art-Net Sender
+        SET_LAYER_MODE,         // Web Server -> DMX Controller -> Art-Net Sender
+
+        // Story: Live channel overrides (WebSocket, OSC)
+        APPLY_LIVE_OVERRIDES, // Live Overrides -> Art-Net Sender (wake-up, no data)
+
+        // Story: Effect generators
+        SET_EFFECT,          // Web Server -> DMX Controller -> Art-Net Sender
+        SET_EFFECT_CHANNELS, // Web Server -> DMX Controller -> Art-Net Sender
+        STOP_EFFECT,         // Web Server -> DMX Controller -> Art-Net Sender
+
+        // Story: Capture output or Art-Net input into a preset
+        CAPTURE_PRESET, // Foot Switch / Web Server / OSC Receiver -> DMX Controller -> Art-Net Sender
+        PRESET_CAPTURED, // Art-Net Sender -> DMX Controller (then UPDATE_PRESET)
+        UPDATE_PRESET,   // DMX Controller -> Preset Changer (then STORE_PRESET, keeps the name)
 
+        // Story: Delta-encoded preset edits
+        APPLY_PRESET_DELTA, // Web Server -> DMX Controller -> Preset Changer
+        STORE_PRESET,       // Preset Changer -> DMX Controller (then SET_PRESET)
+
+        // Story: Single preset endpoints
+        REPLACE_PRESET, // Web Server -> DMX Controller -> Preset Changer (then STORE_PRESET, including the name)
+        RECALL_PRESET   // Web Server -> DMX Controller -> Preset Changer (presetData.presetNumber only)
     };
 
     struct ConfigurationEventData
     {
         bool switchPolarityInverted;
         uint16_t longPressThresholdMs;
+        uint16_t commitWindowMs; // Storage write-behind window, 0 = write immediately
     };
 
     struct PresetEventData
     {
         uint8_t presetNumber;
-        const char *name;
+        char name[DMX_PRESET_NAME_SIZE];
         uint8_t universe1Data[512];
         uint16_t universe1Length;
         uint8_t universe2Data[512];
         uint16_t universe2Length;
     };
+    // Presets are stored individually and loaded on demand, so only the count is exchanged
     struct PresetsEventData
     {
         uint8_t numberOfPresets;
-        PresetEventData presets[MAX_NR_OF_PRESETS];
+    };
+
+    struct MasterEventData
+    {
+        uint8_t group; // Not used for the grand master
+        uint8_t level;
+        uint16_t firstChannel; // Frame channel (0..1023, universe 2 starts at 512)
+        uint16_t channelCount;
+        bool member;
+        char name[16];
+    };
+
+    struct CurveEventData
+    {
+        uint16_t firstChannel; // Frame channel (0..1023, universe 2 starts at 512)
+        uint16_t channelCount;
+        uint8_t curveType; // DmxCurves::CurveType
+        uint8_t table[256]; // Only used for custom curves
+    };
+
+    struct LayerEventData
+    {
+        uint8_t layer; // DmxLayerStack::Layer
+        uint8_t priority;
+        uint8_t mergeMode; // DmxLayerStack::MergeMode
+        uint16_t firstChannel; // Frame channel (0..1023, universe 2 starts at 512)
+        uint16_t channelCount;
+        uint8_t values[512];
+    };
+
+    struct EffectEventData
+    {
+        uint8_t effect;
+        uint8_t waveform; // DmxEffects::Waveform
+        uint8_t depth;
+        uint8_t offset;
+        uint8_t width;
+        uint16_t phaseSpread;
+        uint8_t fixtureChannels; // Channels per fixture, which share one phase
+        uint32_t rateMilliHz;
+        uint8_t group; // Attach the channels of this group, NO_GROUP to use the channel range
+        uint16_t firstChannel; // Frame channel (0..1023, universe 2 starts at 512)
+        uint16_t channelCount;
+        bool member;
+    };
+    static const uint8_t NO_GROUP = 0xFF;
+
+    enum CaptureSource
+    {
+        CAPTURE_OUTPUT,      // Merged playback layers (before masters and curves)
+        CAPTURE_ARTNET_INPUT // Latest Art-Net input universes
+    };
+
+    struct CaptureEventData
+    {
+        uint8_t presetNumber; // CURRENT_PRESET for the preset currently playing
+        uint8_t source;       // CaptureSource
+    };
+    static const uint8_t CURRENT_PRESET = 0xFF;
+
+    // Changes to one preset, see DmxPresetDelta for the layout
+    struct PresetDeltaEventData
+    {
+        uint8_t presetNumber;
+        uint16_t length;
+        uint8_t delta[DmxPresetDelta::MAX_SIZE];
     };
 
     struct Event
@@ -58,6 +160,12 @@ class Messages
             ConfigurationEventData configurationData;
             PresetsEventData presetsData;
             PresetEventData presetData;
+            MasterEventData masterData;
+            CurveEventData curveData;
+            LayerEventData layerData;
+            EffectEventData effectData;
+            CaptureEventData captureData;
+            PresetDeltaEventData presetDeltaData;
         } data;
     };
 };
\ No newline at end of file
@@ -1,15 +1,30 @@
 #include "nvs_storage.hpp"
 #include <cstring>
 #include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <nvs_flash.h>
 
 static const char *LOG_TAG = "NvsStorage";
 static const int QUEUE_CAPACITY = 10;
 static const int TASK_PRIORITY = 5;
+static const uint32_t NVS_ENTRY_SIZE = 32;
+static const uint32_t FLASH_SECTOR_SIZE = 4096;
+
+// Idle time after the last event before the preset log is compacted in the background
+static const TickType_t COMPACTION_IDLE_TICKS = pdMS_TO_TICKS(200);
+
+NvsStorage *NvsStorage::instance_ = nullptr;
 
 NvsStorage::NvsStorage()
-    : RtosTask(), configuration_nvs_handle(0), presets_nvs_handle(0), configuration_namespace_name("configuration"),
-      presets_namespace_name("presets")
+    : RtosTask(), configuration_nvs_handle(0), configuration_namespace_name("configuration"), loadMutex_(nullptr),
+      numPendingPresets_(0), configurationPending_(false), numberOfPresetsPending_(false), firstPendingUs_(0),
+      commitWindowMs_(DEFAULT_COMMIT_WINDOW_MS), numberOfPresets_(0)
 {
+    memset(&pendingConfiguration_, 0, sizeof(pendingConfiguration_));
+    memset(presetCrc_, 0, sizeof(presetCrc_));
+    memset(&stats_, 0, sizeof(stats_));
 }
 
 NvsStorage::~NvsStorage()
@@ -19,15 +34,15 @@ NvsStorage::~NvsStorage()
         nvs_close(configuration_nvs_handle);
     }
 
-    if (presets_nvs_handle != 0)
+    if (loadMutex_)
     {
-        nvs_close(presets_nvs_handle);
+        vSemaphoreDelete(loadMutex_);
     }
 }
 
 esp_err_t NvsStorage::init(QueueHandle_t dmxControllerEventQueue)
 {
-    if (RtosTask::init("NVSStorageTask", 2048, TASK_PRIORITY, QUEUE_CAPACITY, sizeof(Messages::Event),
+    if (RtosTask::init("NVSStorageTask", 4096, TASK_PRIORITY, QUEUE_CAPACITY, sizeof(Messages::Event),
             dmxControllerEventQueue) != ESP_OK)
     {
         ESP_LOGE(LOG_TAG, "Failed to initialize NVSStorageTask");
@@ -40,12 +55,97 @@ esp_err_t NvsStorage::init(QueueHandle_t dmxControllerEventQueue)
         ESP_LOGE(LOG_TAG, "Failed to open configuration NVS namespace: %s", esp_err_to_name(err));
     }
 
-    err = nvs_open(presets_namespace_name, NVS_READWRITE, &presets_nvs_handle);
+    loadMutex_ = xSemaphoreCreateMutex();
+    if (!loadMutex_)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to create preset load mutex");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Presets live in an append-only log on their own raw partition
+    err = presetLog_.init(PRESETS_PARTITION_LABEL);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to initialize presets partition: %s", esp_err_to_name(err));
+        return err;
+    }
+    if (presetLog_.getNumberOfPresets() == 0 && migrateLegacyPresets() != ESP_OK)
+    {
+        // The old presets stay where they are, the next boot tries again
+        ESP_LOGE(LOG_TAG, "Failed to migrate presets, starting with an empty show");
+    }
+
+    // Pending edits are written before a software restart (e.g. after an OTA update)
+    instance_ = this;
+    if (esp_register_shutdown_handler(&NvsStorage::shutdownHandler) != ESP_OK)
+    {
+        ESP_LOGW(LOG_TAG, "Failed to register shutdown handler");
+    }
+    return ESP_OK;
+}
+
+// Firmware before the preset log kept the show in the "presets" namespace of the default NVS partition: the number
+// of presets ("NumberOfPresets") and a raw Messages::PresetEventData blob per preset ("Preset0", ...), see
+// DmxPresetRecord::LEGACY_SIZE. That show (at most 20 presets) is copied into the log as one transaction, then the
+// namespace is erased, so a power cut at any point leaves either the old or the migrated show.
+esp_err_t NvsStorage::migrateLegacyPresets()
+{
+    nvs_handle_t handle;
+    uint8_t numberOfPresets = 0;
+    if (nvs_open(LEGACY_PRESETS_NAMESPACE, NVS_READWRITE, &handle) != ESP_OK)
+    {
+        return ESP_OK; // Never written
+    }
+    if (nvs_get_u8(handle, "NumberOfPresets", &numberOfPresets) != ESP_OK || numberOfPresets == 0)
+    {
+        nvs_close(handle);
+        return ESP_OK;
+    }
+    if (numberOfPresets > MAX_PRESETS)
+    {
+        numberOfPresets = MAX_PRESETS;
+    }
+
+    ESP_LOGW(LOG_TAG, "Migrating %d presets from NVS to the preset log", numberOfPresets);
+    DmxPreset *preset = new DmxPreset();
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    esp_err_t err = presetLog_.beginTransaction();
+    for (uint8_t index = 0; index < numberOfPresets && err == ESP_OK; index++)
+    {
+        char key[16];
+        snprintf(key, sizeof(key), "Preset%d", index);
+        size_t length = sizeof(loadBuffer_);
+        if (nvs_get_blob(handle, key, loadBuffer_, &length) != ESP_OK ||
+            DmxPresetRecord::decodeLegacy(loadBuffer_, length, *preset) != ESP_OK)
+        {
+            // Stays empty, as the old firmware would have failed to load it
+            ESP_LOGW(LOG_TAG, "Preset %d not migrated", index);
+            continue;
+        }
+        size_t size = DmxPresetRecord::encode(*preset, recordBuffer_, sizeof(recordBuffer_));
+        err = size > 0 ? presetLog_.stagePreset(index, recordBuffer_, size) : ESP_ERR_INVALID_SIZE;
+    }
+    if (err == ESP_OK)
+    {
+        err = presetLog_.stageNumberOfPresets(numberOfPresets);
+    }
+    if (err == ESP_OK)
+    {
+        err = presetLog_.commitTransaction();
+    }
     if (err != ESP_OK)
     {
-        ESP_LOGE(LOG_TAG, "Failed to open presets NVS namespace: %s", esp_err_to_name(err));
+        presetLog_.abortTransaction();
     }
+    xSemaphoreGive(loadMutex_);
+    delete preset;
 
+    if (err == ESP_OK && (nvs_erase_all(handle) != ESP_OK || nvs_commit(handle) != ESP_OK))
+    {
+        // Migrated; a later boot finds presets in the log and leaves the namespace alone
+        ESP_LOGW(LOG_TAG, "Failed to erase the migrated presets from NVS");
+    }
+    nvs_close(handle);
     return err;
 }
 
@@ -56,7 +156,27 @@ void NvsStorage::taskLoop()
     Messages::Event event;
     while (true)
     {
-        if (xQueueReceive(eventQueue_, &event, portMAX_DELAY) == pdTRUE)
+        // Wake up when the commit window of the oldest pending edit has passed, or to compact when idle
+        xSemaphoreTake(loadMutex_, portMAX_DELAY);
+        TickType_t wait = presetLog_.needsCompaction() ? COMPACTION_IDLE_TICKS : portMAX_DELAY;
+        if (hasPendingWrites())
+        {
+            int64_t remainingUs = firstPendingUs_ + commitWindowMs_ * 1000LL - esp_timer_get_time();
+            wait = remainingUs > 0 ? pdMS_TO_TICKS(remainingUs / 1000) + 1 : 0;
+        }
+        xSemaphoreGive(loadMutex_);
+
+        if (xQueueReceive(eventQueue_, &event, wait) != pdTRUE)
+        {
+            // One sector at a time, so preset loads from other tasks wait at most one sector erase
+            xSemaphoreTake(loadMutex_, portMAX_DELAY);
+            if (!hasPendingWrites() && presetLog_.needsCompaction())
+            {
+                presetLog_.compact();
+            }
+            xSemaphoreGive(loadMutex_);
+        }
+        else
         {
             ESP_LOGI(LOG_TAG, "NVSStorage event received: %d", event.type);
             switch (event.type)
@@ -77,11 +197,22 @@ void NvsStorage::taskLoop()
                 requestPresets(event.data.presetsData);
                 break;
 
+            case Messages::SET_PRESET:
+                setPreset(event.data.presetData);
+                break;
+
             default:
                 ESP_LOGW(LOG_TAG, "Unknown NVSStorage event type: %d", event.type);
                 break;
             }
         }
+
+        xSemaphoreTake(loadMutex_, portMAX_DELAY);
+        if (hasPendingWrites() && esp_timer_get_time() - firstPendingUs_ >= commitWindowMs_ * 1000LL)
+        {
+            flushPending();
+        }
+        xSemaphoreGive(loadMutex_);
     }
 }
 
@@ -90,27 +221,38 @@ esp_err_t NvsStorage::setConfiguration(const Messages::ConfigurationEventData &c
     if (!configuration_nvs_handle)
         return ESP_ERR_INVALID_STATE;
 
-    if (nvs_set_u8(configuration_nvs_handle, "SwitchPolarityInv", configurationData.switchPolarityInverted) != ESP_OK)
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    if (configurationPending_)
     {
-        ESP_LOGE(LOG_TAG, "Failed to set switch polarity inverted");
-        return ESP_FAIL;
+        stats_.coalescedWrites++;
     }
+    pendingConfiguration_ = configurationData;
+    configurationPending_ = true;
+    commitWindowMs_ = configurationData.commitWindowMs;
+    markPending();
+    xSemaphoreGive(loadMutex_);
+    return ESP_OK;
+}
 
-    if (nvs_set_u16(configuration_nvs_handle, "LongPressThreshold", configurationData.longPressThresholdMs) != ESP_OK)
+esp_err_t NvsStorage::requestConfiguration(Messages::ConfigurationEventData &configurationData)
+{
+    esp_err_t err = readConfiguration(configurationData);
+    if (err != ESP_OK)
     {
-        ESP_LOGE(LOG_TAG, "Failed to set long press threshold");
-        return ESP_FAIL;
+        return err;
     }
+    commitWindowMs_ = configurationData.commitWindowMs;
+
+    // Send configuration response message
+    Messages::Event responseEvent;
+    responseEvent.type = Messages::CONFIGURATION_RESPONSE;
+    responseEvent.data.configurationData = configurationData;
+    xQueueSend(getDmxControllerEventQueue(), &responseEvent, portMAX_DELAY);
 
-    if (nvs_commit(configuration_nvs_handle) != ESP_OK)
-    {
-        ESP_LOGE(LOG_TAG, "Failed to commit configuration data");
-        return ESP_FAIL;
-    }
     return ESP_OK;
 }
 
-esp_err_t NvsStorage::requestConfiguration(Messages::ConfigurationEventData &configurationData)
+esp_err_t NvsStorage::readConfiguration(Messages::ConfigurationEventData &configurationData) const
 {
     if (!configuration_nvs_handle)
         return ESP_ERR_INVALID_STATE;
@@ -131,77 +273,223 @@ esp_err_t NvsStorage::requestConfiguration(Messages::ConfigurationEventData &con
     }
     configurationData.longPressThresholdMs = long_press_threshold_ms;
 
-    // Send configuration response message
-    Messages::Event responseEvent;
-    responseEvent.type = Messages::CONFIGURATION_RESPONSE;
-    responseEvent.data.configurationData = configurationData;
-    xQueueSend(getDmxControllerEventQueue(), &responseEvent, portMAX_DELAY);
+    // Optional, not stored by older firmware
+    uint16_t commit_window_ms = DEFAULT_COMMIT_WINDOW_MS;
+    nvs_get_u16(configuration_nvs_handle, "CommitWindowMs", &commit_window_ms);
+    configurationData.commitWindowMs = commit_window_ms;
 
+    // An edit that has not been written yet is newer than the stored configuration
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    if (configurationPending_)
+    {
+        configurationData = pendingConfiguration_;
+    }
+    xSemaphoreGive(loadMutex_);
     return ESP_OK;
 }
 
 esp_err_t NvsStorage::setPresets(const Messages::PresetsEventData &presetsData)
 {
-    if (!presets_nvs_handle)
+    if (!presetLog_.isOpen())
         return ESP_ERR_INVALID_STATE;
 
-    if (nvs_set_u8(presets_nvs_handle, "NumberOfPresets", presetsData.numberOfPresets) != ESP_OK)
+    // Preset data is saved per preset through setPreset(), so only the count is written here
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    if (presetsData.numberOfPresets != numberOfPresets_)
     {
-        ESP_LOGE(LOG_TAG, "Failed to set number of presets");
-        return ESP_FAIL;
+        if (numberOfPresetsPending_)
+        {
+            stats_.coalescedWrites++;
+        }
+        numberOfPresets_ = presetsData.numberOfPresets;
+        numberOfPresetsPending_ = true;
+        markPending();
     }
+    xSemaphoreGive(loadMutex_);
+    return ESP_OK;
+}
 
-    for (uint8_t i = 0; i < presetsData.numberOfPresets; ++i)
+esp_err_t NvsStorage::setPreset(const Messages::PresetEventData &preset)
+{
+    if (!presetLog_.isOpen())
+        return ESP_ERR_INVALID_STATE;
+
+    if (preset.presetNumber >= MAX_PRESETS)
     {
-        const Messages::PresetEventData &preset = presetsData.presets[i];
-        char key[16];
-        snprintf(key, sizeof(key), "Preset%d", i);
-        if (nvs_set_blob(presets_nvs_handle, key, &preset, sizeof(Messages::PresetEventData)) != ESP_OK)
+        ESP_LOGE(LOG_TAG, "Preset %d out of range (max %d)", preset.presetNumber, MAX_PRESETS - 1);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    size_t size = DmxPresetRecord::encode(preset, recordBuffer_, sizeof(recordBuffer_));
+    return storePresetRecord(preset.presetNumber, recordBuffer_, size);
+}
+
+esp_err_t NvsStorage::storePresetRecord(uint8_t index, const uint8_t *record, size_t size)
+{
+    if (!presetLog_.isOpen() || !loadMutex_)
+        return ESP_ERR_INVALID_STATE;
+
+    uint32_t crc = DmxPresetRecord::getCrc(record, size);
+    if (index >= MAX_PRESETS || crc == UNKNOWN_CRC)
+    {
+        ESP_LOGE(LOG_TAG, "Invalid record for preset %d", index);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // One locked section, so a flush from another task cannot change what the check below is based on
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    stats_.presetSaves++;
+    int slot = findPendingPreset(index);
+    bool unchanged = slot >= 0 && pendingPresets_[slot].crc == crc;
+
+    // Rewriting an unchanged preset would only wear the flash
+    if (unchanged || isStored(index, crc))
+    {
+        if (!unchanged && slot >= 0)
         {
-            ESP_LOGE(LOG_TAG, "Failed to set preset %d", i);
-            return ESP_FAIL;
+            // Edited back to the stored content before the pending write happened
+            removePendingPreset(slot);
+            stats_.coalescedWrites++;
         }
+        stats_.presetsUnchanged++;
+        xSemaphoreGive(loadMutex_);
+        ESP_LOGD(LOG_TAG, "Preset %d unchanged, not written", index);
+        return ESP_OK;
     }
 
-    if (nvs_commit(presets_nvs_handle) != ESP_OK)
+    esp_err_t err = ESP_OK;
+    if (slot >= 0)
     {
-        ESP_LOGE(LOG_TAG, "Failed to commit presets data");
-        return ESP_FAIL;
+        stats_.coalescedWrites++;
     }
-    return ESP_OK;
+    else
+    {
+        if (numPendingPresets_ == MAX_PENDING_PRESETS)
+        {
+            err = flushPending();
+        }
+        slot = numPendingPresets_++;
+    }
+
+    PendingPreset &pending = pendingPresets_[slot];
+    pending.index = index;
+    pending.size = size;
+    pending.crc = crc;
+    memcpy(pending.record, record, size);
+    markPending();
+    xSemaphoreGive(loadMutex_);
+    return err;
 }
 
-esp_err_t NvsStorage::requestPresets(Messages::PresetsEventData &presetsData)
+esp_err_t NvsStorage::beginShowImport()
 {
-    if (!presets_nvs_handle)
+    if (!presetLog_.isOpen() || !loadMutex_)
         return ESP_ERR_INVALID_STATE;
 
-    uint8_t number_of_presets;
-    if (nvs_get_u8(presets_nvs_handle, "NumberOfPresets", &number_of_presets) != ESP_OK)
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    esp_err_t err = presetLog_.beginTransaction();
+    xSemaphoreGive(loadMutex_);
+    if (err != ESP_OK)
     {
-        ESP_LOGE(LOG_TAG, "Failed to get number of presets");
-        return ESP_FAIL;
+        ESP_LOGE(LOG_TAG, "Failed to start show import: %s", esp_err_to_name(err));
     }
+    return err;
+}
 
-    presetsData.numberOfPresets = number_of_presets;
+esp_err_t NvsStorage::importPresetRecord(uint8_t index, const uint8_t *record, size_t size)
+{
+    if (!presetLog_.isOpen() || !loadMutex_)
+        return ESP_ERR_INVALID_STATE;
 
-    for (uint8_t i = 0; i < number_of_presets; ++i)
+    if (index >= MAX_PRESETS || DmxPresetRecord::getCrc(record, size) == UNKNOWN_CRC)
     {
-        char key[16];
-        snprintf(key, sizeof(key), "Preset%d", i);
-        Messages::PresetEventData &preset = presetsData.presets[i];
-        size_t length = sizeof(Messages::PresetEventData); // Length is not used in this case since
-                                                           // we expect a fixed size blob
-        esp_err_t err = nvs_get_blob(presets_nvs_handle, key, &preset, &length);
-        if (err != ESP_OK)
+        ESP_LOGE(LOG_TAG, "Invalid record for preset %d", index);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    esp_err_t err = presetLog_.stagePreset(index, record, size);
+    if (err == ESP_OK)
+    {
+        stats_.presetWrites++;
+        stats_.payloadBytes += size;
+        stats_.flashBytes += PresetLogStore::entrySize(size);
+    }
+    xSemaphoreGive(loadMutex_);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to import preset %d: %s", index, esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t NvsStorage::commitShowImport(uint8_t numberOfPresets)
+{
+    if (!presetLog_.isOpen() || !loadMutex_)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    esp_err_t err = numberOfPresets > 0 ? presetLog_.stageNumberOfPresets(numberOfPresets) : ESP_OK;
+    if (err == ESP_OK)
+    {
+        err = presetLog_.commitTransaction();
+    }
+    if (err == ESP_OK)
+    {
+        stats_.commits++;
+        stats_.coalescedWrites += numPendingPresets_;
+        numPendingPresets_ = 0;
+        if (numberOfPresets > 0)
+        {
+            numberOfPresetsPending_ = false;
+            numberOfPresets_ = presetLog_.getNumberOfPresets();
+        }
+        if (!hasPendingWrites())
         {
-            ESP_LOGE(LOG_TAG, "Failed to get preset %d", i);
-            return err;
+            firstPendingUs_ = 0;
         }
-        presetsData.presets[i] = preset;
+        memset(presetCrc_, 0, sizeof(presetCrc_)); // UNKNOWN_CRC: the presets may all have changed
     }
+    xSemaphoreGive(loadMutex_);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to commit show import: %s", esp_err_to_name(err));
+    }
+    return err;
+}
 
-    // Send configuration response message
+void NvsStorage::abortShowImport()
+{
+    if (!presetLog_.isOpen() || !loadMutex_)
+        return;
+
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    presetLog_.abortTransaction();
+    xSemaphoreGive(loadMutex_);
+}
+
+esp_err_t NvsStorage::requestPresets(Messages::PresetsEventData &presetsData)
+{
+    if (!presetLog_.isOpen())
+        return ESP_ERR_INVALID_STATE;
+
+    uint8_t number_of_presets = presetLog_.getNumberOfPresets();
+    if (number_of_presets == 0)
+    {
+        ESP_LOGW(LOG_TAG, "Number of presets not stored, using %d", MIN_PRESETS);
+        number_of_presets = MIN_PRESETS;
+    }
+
+    // Preset data itself is loaded on demand through loadPreset(); a pending count is newer than the stored one
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    if (!numberOfPresetsPending_)
+    {
+        numberOfPresets_ = number_of_presets;
+    }
+    presetsData.numberOfPresets = numberOfPresets_;
+    xSemaphoreGive(loadMutex_);
+
+    // Send presets response message
     Messages::Event responseEvent;
     responseEvent.type = Messages::PRESETS_RESPONSE;
     responseEvent.data.presetsData = presetsData;
@@ -209,3 +497,279 @@ esp_err_t NvsStorage::requestPresets(Messages::PresetsEventData &presetsData)
 
     return ESP_OK;
 }
+
+esp_err_t NvsStorage::loadPreset(uint8_t index, DmxPreset &preset)
+{
+    if (!presetLog_.isOpen() || !loadMutex_)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    int slot = findPendingPreset(index);
+    if (slot >= 0)
+    {
+        // Not written yet, the pending record is the latest version
+        esp_err_t err = DmxPresetRecord::decode(pendingPresets_[slot].record, pendingPresets_[slot].size, preset);
+        preset.setIndex(index);
+        xSemaphoreGive(loadMutex_);
+        return err;
+    }
+
+    // Decoded in place from flash, only the preset cache holds a copy
+    const uint8_t *record = nullptr;
+    size_t length = 0;
+    esp_err_t err = readPresetBlob(index, record, length);
+    if (err == ESP_OK)
+    {
+        err = DmxPresetRecord::decode(record, length, preset);
+    }
+    if (err == ESP_OK)
+    {
+        preset.setIndex(index);
+        if (index < MAX_PRESETS)
+        {
+            presetCrc_[index] = DmxPresetRecord::getCrc(record, length);
+        }
+    }
+    xSemaphoreGive(loadMutex_);
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to get preset %d: %s", index, esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t NvsStorage::readPresetRecord(uint8_t index, uint8_t *record, size_t capacity, size_t &size) const
+{
+    if (!presetLog_.isOpen() || !loadMutex_)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    esp_err_t err;
+    int slot = findPendingPreset(index);
+    if (slot < 0)
+    {
+        err = presetLog_.readPreset(index, record, capacity, size);
+    }
+    else if (pendingPresets_[slot].size > capacity)
+    {
+        err = ESP_ERR_INVALID_SIZE;
+    }
+    else
+    {
+        size = pendingPresets_[slot].size;
+        memcpy(record, pendingPresets_[slot].record, size);
+        err = ESP_OK;
+    }
+    xSemaphoreGive(loadMutex_);
+    return err;
+}
+
+esp_err_t NvsStorage::readPresetBlob(uint8_t index, const uint8_t *&record, size_t &length)
+{
+    esp_err_t err = presetLog_.mapPreset(index, record, length);
+    if (err != ESP_ERR_NOT_SUPPORTED)
+    {
+        return err;
+    }
+    record = loadBuffer_;
+    return presetLog_.readPreset(index, loadBuffer_, sizeof(loadBuffer_), length);
+}
+
+NvsStorage::Stats NvsStorage::getStats() const
+{
+    if (!loadMutex_)
+        return stats_;
+
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    Stats stats = stats_;
+    stats.pendingWrites = numPendingPresets_ + configurationPending_ + numberOfPresetsPending_;
+    stats.log = presetLog_.getStats();
+    xSemaphoreGive(loadMutex_);
+    stats.estimatedSectorErases = stats.flashBytes / FLASH_SECTOR_SIZE;
+
+    int64_t uptimeUs = esp_timer_get_time();
+    stats.commitsPerHour = uptimeUs > 0 ? (uint32_t)(stats.commits * 3600000000LL / uptimeUs) : 0;
+    return stats;
+}
+
+esp_err_t NvsStorage::flush()
+{
+    if (!loadMutex_)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    esp_err_t err = flushPending();
+    xSemaphoreGive(loadMutex_);
+    return err;
+}
+
+esp_err_t NvsStorage::writeConfiguration(const Messages::ConfigurationEventData &configurationData)
+{
+    if (!configuration_nvs_handle || !loadMutex_)
+        return ESP_ERR_INVALID_STATE;
+
+    xSemaphoreTake(loadMutex_, portMAX_DELAY);
+    esp_err_t err = storeConfiguration(configurationData);
+    if (err == ESP_OK)
+    {
+        configurationPending_ = false;
+        commitWindowMs_ = configurationData.commitWindowMs;
+        if (!hasPendingWrites())
+        {
+            firstPendingUs_ = 0;
+        }
+    }
+    xSemaphoreGive(loadMutex_);
+    return err;
+}
+
+// Caller holds loadMutex_
+esp_err_t NvsStorage::storeConfiguration(const Messages::ConfigurationEventData &configurationData)
+{
+    if (nvs_set_u8(configuration_nvs_handle, "SwitchPolarityInv", configurationData.switchPolarityInverted) != ESP_OK ||
+        nvs_set_u16(configuration_nvs_handle, "LongPressThreshold", configurationData.longPressThresholdMs) !=
+            ESP_OK ||
+        nvs_set_u16(configuration_nvs_handle, "CommitWindowMs", configurationData.commitWindowMs) != ESP_OK ||
+        nvs_commit(configuration_nvs_handle) != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to commit configuration data");
+        return ESP_FAIL;
+    }
+    stats_.flashBytes += 3 * NVS_ENTRY_SIZE;
+    stats_.commits++;
+    return ESP_OK;
+}
+
+esp_err_t NvsStorage::flushPending()
+{
+    if (firstPendingUs_ == 0)
+    {
+        return ESP_OK;
+    }
+
+    int64_t startUs = esp_timer_get_time();
+    esp_err_t err = ESP_OK;
+
+    if (configurationPending_)
+    {
+        err = storeConfiguration(pendingConfiguration_);
+        configurationPending_ = false;
+    }
+
+    // Each log entry commits itself, so a batch only saves the per-write overhead of waking up the task
+    bool presetsWritten = false;
+    if (numberOfPresetsPending_)
+    {
+        if (presetLog_.writeNumberOfPresets(numberOfPresets_) != ESP_OK)
+        {
+            ESP_LOGE(LOG_TAG, "Failed to set number of presets");
+            err = ESP_FAIL;
+        }
+        else
+        {
+            stats_.flashBytes += PresetLogStore::entrySize(sizeof(numberOfPresets_));
+            presetsWritten = true;
+        }
+        numberOfPresetsPending_ = false;
+    }
+
+    for (uint8_t slot = 0; slot < numPendingPresets_; slot++)
+    {
+        const PendingPreset &pending = pendingPresets_[slot];
+        if (presetLog_.writePreset(pending.index, pending.record, pending.size) != ESP_OK)
+        {
+            ESP_LOGE(LOG_TAG, "Failed to set preset %d", pending.index);
+            presetCrc_[pending.index] = UNKNOWN_CRC;
+            err = ESP_FAIL;
+            continue;
+        }
+        presetCrc_[pending.index] = pending.crc;
+        stats_.presetWrites++;
+        stats_.payloadBytes += pending.size;
+        stats_.flashBytes += PresetLogStore::entrySize(pending.size);
+        presetsWritten = true;
+    }
+    numPendingPresets_ = 0;
+    if (presetsWritten)
+    {
+        stats_.commits++;
+    }
+
+    int64_t endUs = esp_timer_get_time();
+    uint32_t delayMs = (endUs - firstPendingUs_) / 1000;
+    stats_.batches++;
+    stats_.lastCommitUs = endUs - startUs;
+    stats_.totalCommitUs += stats_.lastCommitUs;
+    stats_.maxCommitUs = stats_.lastCommitUs > stats_.maxCommitUs ? stats_.lastCommitUs : stats_.maxCommitUs;
+    stats_.maxWriteDelayMs = delayMs > stats_.maxWriteDelayMs ? delayMs : stats_.maxWriteDelayMs;
+    firstPendingUs_ = 0;
+    return err;
+}
+
+int NvsStorage::findPendingPreset(uint8_t index) const
+{
+    for (uint8_t slot = 0; slot < numPendingPresets_; slot++)
+    {
+        if (pendingPresets_[slot].index == index)
+        {
+            return slot;
+        }
+    }
+    return -1;
+}
+
+void NvsStorage::removePendingPreset(int slot)
+{
+    numPendingPresets_--;
+    if (slot != numPendingPresets_)
+    {
+        PendingPreset &last = pendingPresets_[numPendingPresets_];
+        PendingPreset &pending = pendingPresets_[slot];
+        pending.index = last.index;
+        pending.size = last.size;
+        pending.crc = last.crc;
+        memcpy(pending.record, last.record, last.size);
+    }
+    if (!hasPendingWrites())
+    {
+        firstPendingUs_ = 0;
+    }
+}
+
+void NvsStorage::markPending()
+{
+    if (firstPendingUs_ == 0)
+    {
+        firstPendingUs_ = esp_timer_get_time();
+    }
+}
+
+bool NvsStorage::hasPendingWrites() const
+{
+    return numPendingPresets_ > 0 || configurationPending_ || numberOfPresetsPending_;
+}
+
+void NvsStorage::shutdownHandler()
+{
+    if (instance_)
+    {
+        instance_->flush();
+    }
+}
+
+bool NvsStorage::isStored(uint8_t index, uint32_t crc)
+{
+    if (presetCrc_[index] == UNKNOWN_CRC)
+    {
+        // Not loaded or written since boot: reading the stored preset once is much cheaper than a needless write
+        const uint8_t *record = nullptr;
+        size_t length = 0;
+        if (readPresetBlob(index, record, length) == ESP_OK)
+        {
+            presetCrc_[index] = DmxPresetRecord::getCrc(record, length);
+        }
+    }
+    return presetCrc_[index] == crc;
+}
+
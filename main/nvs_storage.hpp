@@ -9,30 +9,138 @@
 extern "C" {
 #include <freertos/FreeRTOS.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 #include <freertos/task.h>
 }
+#include "dmx_preset_record.hpp"
 #include "dmx_presets.hpp"
 #include "messages.hpp"
+#include "preset_log_store.hpp"
 #include "rtos_task.hpp"
 
-class NvsStorage : public RtosTask {
+class NvsStorage : public RtosTask, public DmxPresetLoader {
   public:
+    // Flash write statistics of the presets partition, for diagnostics
+    struct Stats
+    {
+        uint32_t presetSaves;      // Presets offered for saving
+        uint32_t presetWrites;     // Presets actually written because their content changed
+        uint32_t presetsUnchanged; // Saves skipped because the stored content was the same
+        uint32_t payloadBytes;     // Record bytes of the written presets
+        uint32_t flashBytes;       // Estimated bytes written to flash, including entry headers
+        uint32_t coalescedWrites;  // Edits merged into a write that was still pending
+        uint32_t pendingWrites;    // Presets and settings waiting for the next commit
+        uint32_t commits;
+        uint32_t batches;          // Flushes of pending writes
+        uint32_t commitsPerHour;   // Average since boot
+        uint32_t lastCommitUs;     // Duration of the last batch of writes and commits
+        uint32_t maxCommitUs;
+        uint32_t totalCommitUs;
+        uint32_t maxWriteDelayMs;  // Longest time an edit waited before it was committed
+        uint32_t estimatedSectorErases; // Sectors filled, and eventually erased, by the written bytes
+        PresetLogStore::Stats log;
+    };
+
+    // Default time edits are held back so rapid edits end up in one commit
+    static const uint16_t DEFAULT_COMMIT_WINDOW_MS = 1500;
+
     NvsStorage();
     ~NvsStorage();
 
     esp_err_t init(QueueHandle_t dmxControllerEventQueue);
 
+    // Writes are queued and committed in a batch once the commit window has passed since the first pending edit
+    void setCommitWindow(uint16_t commitWindowMs) { commitWindowMs_ = commitWindowMs; }
+    uint16_t getCommitWindow() const { return commitWindowMs_; }
+
+    // Write all pending edits now, e.g. before an OTA update; safe to call from other tasks
+    esp_err_t flush();
+
     // Synchronous wrappers (for compatibility)
     esp_err_t setConfiguration(const Messages::ConfigurationEventData &config);
     esp_err_t requestConfiguration(Messages::ConfigurationEventData &config);
     esp_err_t setPresets(const Messages::PresetsEventData &presets);
     esp_err_t requestPresets(Messages::PresetsEventData &presets);
+    esp_err_t setPreset(const Messages::PresetEventData &preset);
+
+    // Reads a single preset from flash; safe to call from other tasks
+    esp_err_t loadPreset(uint8_t index, DmxPreset &preset) override;
+
+    // Record level access, e.g. to export and import a show; safe to call from other tasks
+    esp_err_t readConfiguration(Messages::ConfigurationEventData &config) const;
+    uint8_t getNumberOfPresets() const { return numberOfPresets_; }
+    esp_err_t readPresetRecord(uint8_t index, uint8_t *record, size_t capacity, size_t &size) const;
+
+    // Import a show as one transaction: readers keep the current show until commitShowImport() switches to the
+    // imported presets (and number of presets, unless 0) in one step, and a power cut before that leaves the current
+    // show. Preset edits still waiting to be written are dropped by the commit, the imported show replaces them.
+    // Safe to call from other tasks; each call holds the storage for a single flash write at most.
+    esp_err_t beginShowImport();
+    esp_err_t importPresetRecord(uint8_t index, const uint8_t *record, size_t size);
+    esp_err_t commitShowImport(uint8_t numberOfPresets);
+    void abortShowImport();
+    // The configuration is not part of the transaction: a show import writes it right away with this before the
+    // commit, and writes the previous one back if the commit fails. Replaces a configuration edit still pending.
+    esp_err_t writeConfiguration(const Messages::ConfigurationEventData &config);
+
+    // Safe to call from other tasks
+    Stats getStats() const;
 
   private:
+    static constexpr const char *PRESETS_PARTITION_LABEL = "presetlog";
+    // Where firmware before the preset log stored its presets (default NVS partition), migrated once
+    static constexpr const char *LEGACY_PRESETS_NAMESPACE = "presets";
+
     nvs_handle_t configuration_nvs_handle;
-    nvs_handle_t presets_nvs_handle;
     const char *configuration_namespace_name;
-    const char *presets_namespace_name;
+    PresetLogStore presetLog_; // Guarded by loadMutex_
+
+    static const uint32_t UNKNOWN_CRC = 0;
+    static const uint8_t MAX_PENDING_PRESETS = 4;
+
+    // Preset record waiting to be written
+    struct PendingPreset
+    {
+        uint8_t index;
+        uint16_t size;
+        uint32_t crc;
+        uint8_t record[DmxPresetRecord::MAX_SIZE];
+    };
+
+    static NvsStorage *instance_; // For the shutdown handler
+
+    // Guards the buffers and pending writes below, which are also used by loadPreset() and flush()
+    SemaphoreHandle_t loadMutex_;
+    uint8_t loadBuffer_[DmxPresetRecord::MAX_SIZE]; // Only used when the preset log is not memory mapped
+    uint8_t recordBuffer_[DmxPresetRecord::MAX_SIZE]; // Only used by the storage task
+
+    PendingPreset pendingPresets_[MAX_PENDING_PRESETS];
+    uint8_t numPendingPresets_;
+    Messages::ConfigurationEventData pendingConfiguration_;
+    bool configurationPending_;
+    bool numberOfPresetsPending_;
+    int64_t firstPendingUs_; // Time of the oldest pending edit, 0 if nothing is pending
+    volatile uint16_t commitWindowMs_;
+
+    // CRC of the stored record per preset, known once it has been loaded or written since boot
+    uint32_t presetCrc_[MAX_PRESETS];
+    uint8_t numberOfPresets_; // 0 if not known yet
+    Stats stats_;
+
+    esp_err_t migrateLegacyPresets();
+    esp_err_t storePresetRecord(uint8_t index, const uint8_t *record, size_t size);
+    // Caller holds loadMutex_
+    bool isStored(uint8_t index, uint32_t crc);
+    int findPendingPreset(uint8_t index) const;
+    void removePendingPreset(int slot);
+    void markPending();
+    bool hasPendingWrites() const;
+    esp_err_t flushPending();
+    esp_err_t storeConfiguration(const Messages::ConfigurationEventData &config);
+
+    static void shutdownHandler();
+    // Stored record of a preset, in mapped flash or else read into loadBuffer_; caller holds loadMutex_
+    esp_err_t readPresetBlob(uint8_t index, const uint8_t *&record, size_t &length);
 
     void taskEntry(void *param) override;
     void taskLoop();
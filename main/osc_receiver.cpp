@@ -0,0 +1,186 @@
+#include "osc_receiver.hpp"
+#include "dmx_presets.hpp"
+#include "messages.hpp"
+#include <cstring>
+#include <esp_log.h>
+
+static const char *LOG_TAG = "OscReceiver";
+static const int QUEUE_CAPACITY = 2;
+static const int TASK_PRIORITY = 5;
+static const size_t MAX_PACKET_SIZE = 512;
+
+OscReceiver::OscReceiver() : RtosTask(), sockfd_(-1), liveOverrides_(nullptr) {}
+
+OscReceiver::~OscReceiver()
+{
+    if (sockfd_ >= 0)
+    {
+        closesocket(sockfd_);
+    }
+}
+
+esp_err_t OscReceiver::init(QueueHandle_t dmxControllerEventQueue, LiveOverrides *liveOverrides, uint16_t port)
+{
+    if (!liveOverrides)
+    {
+        ESP_LOGE(LOG_TAG, "Invalid live overrides");
+        return ESP_ERR_INVALID_ARG;
+    }
+    liveOverrides_ = liveOverrides;
+
+    sockfd_ = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sockfd_ < 0)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to create socket");
+        return ESP_FAIL;
+    }
+
+    struct sockaddr_in listen_addr;
+    memset(&listen_addr, 0, sizeof(listen_addr));
+    listen_addr.sin_family = AF_INET;
+    listen_addr.sin_port = htons(port);
+    listen_addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sockfd_, (struct sockaddr *)&listen_addr, sizeof(listen_addr)) < 0)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to bind to port %d", port);
+        closesocket(sockfd_);
+        sockfd_ = -1;
+        return ESP_FAIL;
+    }
+
+    // The socket must exist before the task starts receiving
+    if (RtosTask::init("OscReceiverTask", 4096, TASK_PRIORITY, QUEUE_CAPACITY, sizeof(Messages::Event),
+            dmxControllerEventQueue) != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to initialize OscReceiverTask");
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(LOG_TAG, "OSC receiver listening on port %d", port);
+    return ESP_OK;
+}
+
+void OscReceiver::taskEntry(void *param) { static_cast<OscReceiver *>(param)->taskLoop(); }
+
+void OscReceiver::taskLoop()
+{
+    uint8_t buffer[MAX_PACKET_SIZE];
+    while (true)
+    {
+        ssize_t received = recvfrom(sockfd_, buffer, sizeof(buffer), 0, nullptr, nullptr);
+        if (received > 0)
+        {
+            handlePacket(buffer, received);
+        }
+        else
+        {
+            ESP_LOGW(LOG_TAG, "Failed to receive OSC packet");
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+    }
+}
+
+void OscReceiver::handlePacket(const uint8_t *data, size_t length)
+{
+    // Bundles are not supported: messages only
+    if (length < 4 || data[0] != '/')
+    {
+        ESP_LOGD(LOG_TAG, "Ignoring non-message OSC packet");
+        return;
+    }
+
+    // Address pattern (null terminated, padded to 4 bytes)
+    const char *address = reinterpret_cast<const char *>(data);
+    size_t addressLength = strnlen(address, length);
+    if (addressLength == length)
+    {
+        return;
+    }
+    size_t offset = paddedLength(addressLength + 1);
+
+    // Type tag string, optional in old implementations
+    Argument arguments[MAX_ARGUMENTS];
+    uint8_t argumentCount = 0;
+    if (offset < length && data[offset] == ',')
+    {
+        const char *typeTags = reinterpret_cast<const char *>(data + offset + 1);
+        size_t typeTagsLength = strnlen(typeTags, length - offset - 1);
+        offset += paddedLength(typeTagsLength + 2);
+
+        for (size_t i = 0; i < typeTagsLength && argumentCount < MAX_ARGUMENTS; i++)
+        {
+            if (offset + 4 > length)
+            {
+                ESP_LOGW(LOG_TAG, "Truncated OSC message: %s", address);
+                return;
+            }
+
+            Argument &argument = arguments[argumentCount++];
+            argument.type = typeTags[i];
+            argument.intValue = readInt32(data + offset);
+            if (argument.type == 'f')
+            {
+                memcpy(&argument.floatValue, &argument.intValue, sizeof(float));
+            }
+            else if (argument.type != 'i')
+            {
+                ESP_LOGW(LOG_TAG, "Unsupported OSC argument type '%c' in %s", argument.type, address);
+                return;
+            }
+            offset += 4;
+        }
+    }
+
+    handleMessage(address, arguments, argumentCount);
+}
+
+void OscReceiver::handleMessage(const char *address, const Argument *arguments, uint8_t argumentCount)
+{
+    if (strcmp(address, "/dmx/set") == 0 && argumentCount == 2 && arguments[0].type == 'i')
+    {
+        int32_t value = arguments[1].intValue;
+        if (arguments[1].type == 'f')
+        {
+            float level = arguments[1].floatValue;
+            value = level <= 0.0f ? 0 : (level >= 1.0f ? 255 : (int32_t)(level * 255.0f + 0.5f));
+        }
+        liveOverrides_->setChannel((uint16_t)arguments[0].intValue, value < 0 ? 0 : (value > 255 ? 255 : value));
+    }
+    else if (strcmp(address, "/dmx/release") == 0 && argumentCount == 1 && arguments[0].type == 'i')
+    {
+        liveOverrides_->releaseChannel((uint16_t)arguments[0].intValue);
+    }
+    else if (strcmp(address, "/dmx/release/all") == 0)
+    {
+        liveOverrides_->releaseAll();
+    }
+    else if (strcmp(address, "/dmx/capture") == 0 || strcmp(address, "/dmx/capture/input") == 0)
+    {
+        Messages::Event event;
+        event.type = Messages::CAPTURE_PRESET;
+        event.data.captureData.source =
+            strcmp(address, "/dmx/capture") == 0 ? Messages::CAPTURE_OUTPUT : Messages::CAPTURE_ARTNET_INPUT;
+        event.data.captureData.presetNumber = Messages::CURRENT_PRESET;
+        if (argumentCount == 1 && arguments[0].type == 'i' && arguments[0].intValue >= 0 &&
+            arguments[0].intValue < MAX_PRESETS)
+        {
+            event.data.captureData.presetNumber = (uint8_t)arguments[0].intValue;
+        }
+        if (xQueueSend(getDmxControllerEventQueue(), &event, 0) != pdPASS)
+        {
+            ESP_LOGE(LOG_TAG, "Failed to send capture request to DmxController");
+        }
+    }
+    else
+    {
+        ESP_LOGD(LOG_TAG, "Unhandled OSC address: %s", address);
+    }
+}
+
+int32_t OscReceiver::readInt32(const uint8_t *data)
+{
+    // OSC uses big-endian byte order
+    return (int32_t)(((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3]);
+}
+
+size_t OscReceiver::paddedLength(size_t length) { return (length + 3) & ~(size_t)3; }
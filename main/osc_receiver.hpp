@@ -0,0 +1,49 @@
+#pragma once
+
+#include "live_overrides.hpp"
+#include "rtos_task.hpp"
+#include <esp_err.h>
+#include <lwip/sockets.h>
+#include <stdint.h>
+
+// OSC (Open Sound Control) receiver for ESP32
+// Listens for OSC messages over UDP and handles the controller's OSC address space:
+//   /dmx/set <int channel> <int value | float level 0..1>
+//   /dmx/release <int channel>
+//   /dmx/release/all
+//   /dmx/capture [<int preset>]        (current output, default the current preset)
+//   /dmx/capture/input [<int preset>]  (Art-Net input)
+// Channels are frame channels (0..1023, universe 2 starts at 512).
+
+#define OSC_LISTEN_PORT 9000
+
+class OscReceiver : public RtosTask
+{
+  public:
+    OscReceiver();
+    ~OscReceiver();
+
+    esp_err_t init(
+        QueueHandle_t dmxControllerEventQueue, LiveOverrides *liveOverrides, uint16_t port = OSC_LISTEN_PORT);
+
+  private:
+    struct Argument
+    {
+        char type; // 'i' or 'f'
+        int32_t intValue;
+        float floatValue;
+    };
+    static const uint8_t MAX_ARGUMENTS = 4;
+
+    int sockfd_;
+    LiveOverrides *liveOverrides_;
+
+    void taskEntry(void *param) override;
+    void taskLoop();
+
+    void handlePacket(const uint8_t *data, size_t length);
+    void handleMessage(const char *address, const Argument *arguments, uint8_t argumentCount);
+
+    static int32_t readInt32(const uint8_t *data);
+    static size_t paddedLength(size_t length);
+};
@@ -0,0 +1,775 @@
+#include "preset_json_parser.hpp"
+#include "dmx_presets.hpp"
+#include <cstring>
+#include <esp_log.h>
+
+static const char *LOG_TAG = "PresetJsonParser";
+
+static int8_t base64Value(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+        return c - 'A';
+    if (c >= 'a' && c <= 'z')
+        return c - 'a' + 26;
+    if (c >= '0' && c <= '9')
+        return c - '0' + 52;
+    if (c == '+')
+        return 62;
+    if (c == '/')
+        return 63;
+    return -1;
+}
+
+static int8_t hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+PresetJsonParser::PresetJsonParser(Handler &handler, UniverseEncoding encoding, bool singlePreset)
+    : handler_(handler), encoding_(encoding), singlePreset_(singlePreset), lexState_(LEX_NONE),
+      state_(singlePreset ? EXPECT_PRESET : EXPECT_ARRAY), key_(KEY_OTHER), error_(ESP_OK), handlerError_(false),
+      offset_(0), numberOfPresets_(0), universe_(nullptr), channel_(0), textLength_(0), textTruncated_(false),
+      codePoint_(0), hexDigits_(0), highSurrogate_(0), number_(0), numberNegative_(false), numberIsInteger_(false),
+      numberPart_(0), numberDigits_(0), numberLast_(0), bits_(0), bitCount_(0), encodedLength_(0), padding_(0),
+      skipExpect_(SKIP_VALUE), skipDepth_(0), skipArrays_(0)
+{
+    text_[0] = '\0';
+}
+
+esp_err_t PresetJsonParser::feed(const char *data, size_t length)
+{
+    for (size_t i = 0; i < length && state_ != FAILED; i++, offset_++)
+    {
+        // The bulk of an encoded universe is decoded without going through the lexer
+        while (lexState_ == LEX_ENCODED && i < length && data[i] != '"' && data[i] != '\\')
+        {
+            if (decode(data[i]) != ESP_OK)
+            {
+                return error_;
+            }
+            i++;
+            offset_++;
+        }
+        if (i < length)
+        {
+            lex(data[i]);
+        }
+    }
+    return state_ == FAILED ? error_ : ESP_OK;
+}
+
+esp_err_t PresetJsonParser::finish()
+{
+    if (state_ == FAILED)
+    {
+        return error_;
+    }
+    if (state_ != DONE || lexState_ != LEX_NONE)
+    {
+        return fail(ESP_ERR_INVALID_SIZE, "incomplete document");
+    }
+    return ESP_OK;
+}
+
+esp_err_t PresetJsonParser::lex(char c)
+{
+    switch (lexState_)
+    {
+    case LEX_STRING:
+        if (c == '"')
+        {
+            endText();
+            lexState_ = LEX_NONE;
+            return onToken(STRING);
+        }
+        if (c == '\\')
+        {
+            lexState_ = LEX_ESCAPE;
+            return ESP_OK;
+        }
+        if ((uint8_t)c < 0x20)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "control character in string");
+        }
+        appendText(c);
+        return ESP_OK;
+
+    case LEX_ESCAPE:
+    {
+        static const char ESCAPES[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+        lexState_ = LEX_STRING;
+        if (c == 'u')
+        {
+            lexState_ = LEX_UNICODE;
+            codePoint_ = 0;
+            hexDigits_ = 0;
+            return ESP_OK;
+        }
+        for (size_t i = 0; i < sizeof(ESCAPES) - 1; i += 2)
+        {
+            if (ESCAPES[i] == c)
+            {
+                appendText(ESCAPES[i + 1]);
+                return ESP_OK;
+            }
+        }
+        return fail(ESP_ERR_INVALID_ARG, "invalid escape in string");
+    }
+
+    case LEX_UNICODE:
+    {
+        int8_t digit = hexValue(c);
+        if (digit < 0)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "invalid \\u escape in string");
+        }
+        codePoint_ = codePoint_ << 4 | digit;
+        if (++hexDigits_ == 4)
+        {
+            lexState_ = LEX_STRING;
+            appendCodePoint(codePoint_);
+        }
+        return ESP_OK;
+    }
+
+    case LEX_NUMBER:
+        if (c >= '0' && c <= '9')
+        {
+            if (numberPart_ == 0 && numberDigits_ == 1 && numberLast_ == '0')
+            {
+                return fail(ESP_ERR_INVALID_ARG, "leading zero in number");
+            }
+            if (numberPart_ == 0 && numberIsInteger_)
+            {
+                numberIsInteger_ = number_ <= (INT32_MAX - (c - '0')) / 10;
+                number_ = numberIsInteger_ ? number_ * 10 + (c - '0') : number_;
+            }
+            numberDigits_ += numberDigits_ < UINT8_MAX;
+        }
+        else if (c == '.' && numberPart_ == 0 && numberDigits_ > 0)
+        {
+            numberPart_ = 1;
+            numberDigits_ = 0;
+            numberIsInteger_ = false;
+        }
+        else if ((c == 'e' || c == 'E') && numberPart_ != 2 && numberDigits_ > 0)
+        {
+            numberPart_ = 2;
+            numberDigits_ = 0;
+            numberIsInteger_ = false;
+        }
+        else if ((c == '+' || c == '-') && (numberLast_ == 'e' || numberLast_ == 'E'))
+        {
+        }
+        else
+        {
+            // The character after the number belongs to the next token
+            esp_err_t err = endNumber();
+            return err == ESP_OK ? lexNone(c) : err;
+        }
+        numberLast_ = c;
+        return ESP_OK;
+
+    case LEX_LITERAL:
+        if (c >= 'a' && c <= 'z')
+        {
+            if (textLength_ == 5)
+            {
+                return fail(ESP_ERR_INVALID_ARG, "unknown literal");
+            }
+            text_[textLength_++] = c;
+            return ESP_OK;
+        }
+        else
+        {
+            esp_err_t err = endLiteral();
+            return err == ESP_OK ? lexNone(c) : err;
+        }
+
+    case LEX_ENCODED:
+        if (c == '"')
+        {
+            lexState_ = LEX_NONE;
+            return endEncoded();
+        }
+        if (c == '\\')
+        {
+            lexState_ = LEX_ENCODED_ESCAPE;
+            return ESP_OK;
+        }
+        return decode(c);
+
+    case LEX_ENCODED_ESCAPE:
+        // Some encoders escape the '/' of base64
+        if (c != '/')
+        {
+            return fail(ESP_ERR_INVALID_ARG, "invalid escape in encoded universe");
+        }
+        lexState_ = LEX_ENCODED;
+        return decode(c);
+
+    default:
+        return lexNone(c);
+    }
+}
+
+esp_err_t PresetJsonParser::lexNone(char c)
+{
+    switch (c)
+    {
+    case ' ':
+    case '\t':
+    case '\n':
+    case '\r':
+        return ESP_OK;
+    case '{':
+        return onToken(BEGIN_OBJECT);
+    case '}':
+        return onToken(END_OBJECT);
+    case '[':
+        return onToken(BEGIN_ARRAY);
+    case ']':
+        return onToken(END_ARRAY);
+    case ':':
+        return onToken(COLON);
+    case ',':
+        return onToken(COMMA);
+    case '"':
+        if (state_ == EXPECT_VALUE && (key_ == KEY_UNIVERSE1 || key_ == KEY_UNIVERSE2) &&
+            encoding_ != UNIVERSE_ARRAY)
+        {
+            lexState_ = LEX_ENCODED;
+            universe_ = preset_.getUniverseBuffer(key_ == KEY_UNIVERSE1 ? 0 : 1);
+            channel_ = 0;
+            bits_ = 0;
+            bitCount_ = 0;
+            encodedLength_ = 0;
+            padding_ = 0;
+            return ESP_OK;
+        }
+        lexState_ = LEX_STRING;
+        textLength_ = 0;
+        textTruncated_ = false;
+        highSurrogate_ = 0;
+        return ESP_OK;
+    default:
+        break;
+    }
+
+    if (c == '-' || (c >= '0' && c <= '9'))
+    {
+        lexState_ = LEX_NUMBER;
+        numberNegative_ = c == '-';
+        number_ = numberNegative_ ? 0 : c - '0';
+        numberIsInteger_ = true;
+        numberPart_ = 0;
+        numberDigits_ = numberNegative_ ? 0 : 1;
+        numberLast_ = c;
+        return ESP_OK;
+    }
+    if (c >= 'a' && c <= 'z')
+    {
+        lexState_ = LEX_LITERAL;
+        text_[0] = c;
+        textLength_ = 1;
+        return ESP_OK;
+    }
+    return fail(ESP_ERR_INVALID_ARG, "unexpected character");
+}
+
+esp_err_t PresetJsonParser::endNumber()
+{
+    lexState_ = LEX_NONE;
+    if (numberDigits_ == 0)
+    {
+        return fail(ESP_ERR_INVALID_ARG, "incomplete number");
+    }
+    if (numberNegative_)
+    {
+        number_ = -number_;
+    }
+    return onToken(NUMBER);
+}
+
+esp_err_t PresetJsonParser::endLiteral()
+{
+    lexState_ = LEX_NONE;
+    text_[textLength_] = '\0';
+    if (strcmp(text_, "true") != 0 && strcmp(text_, "false") != 0 && strcmp(text_, "null") != 0)
+    {
+        return fail(ESP_ERR_INVALID_ARG, "unknown literal");
+    }
+    return onToken(LITERAL);
+}
+
+esp_err_t PresetJsonParser::onToken(Token token)
+{
+    switch (state_)
+    {
+    case EXPECT_ARRAY:
+        if (token != BEGIN_ARRAY)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "not an array of presets");
+        }
+        state_ = EXPECT_PRESET_OR_END;
+        return ESP_OK;
+
+    case EXPECT_PRESET_OR_END:
+    case EXPECT_PRESET:
+        if (token == END_ARRAY && state_ == EXPECT_PRESET_OR_END)
+        {
+            break;
+        }
+        if (token != BEGIN_OBJECT)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "preset is not an object");
+        }
+        if (numberOfPresets_ == MAX_PRESETS)
+        {
+            return fail(ESP_ERR_INVALID_SIZE, "too many presets");
+        }
+        preset_.clear();
+        preset_.setIndex(numberOfPresets_);
+        state_ = EXPECT_KEY_OR_END;
+        return ESP_OK;
+
+    case AFTER_PRESET:
+        if (token == COMMA)
+        {
+            state_ = EXPECT_PRESET;
+            return ESP_OK;
+        }
+        if (token == END_ARRAY)
+        {
+            break;
+        }
+        return fail(ESP_ERR_INVALID_ARG, "expected , or ] after a preset");
+
+    case EXPECT_KEY_OR_END:
+    case EXPECT_KEY:
+        if (token == END_OBJECT && state_ == EXPECT_KEY_OR_END)
+        {
+            return endPreset();
+        }
+        if (token != STRING)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "expected a key");
+        }
+        // A truncated key or one with an embedded \u0000 is none of the known ones
+        key_ = textTruncated_ || strlen(text_) != textLength_ ? KEY_OTHER
+               : strcmp(text_, "index") == 0                  ? KEY_INDEX
+               : strcmp(text_, "name") == 0                   ? KEY_NAME
+               : strcmp(text_, "universe1") == 0              ? KEY_UNIVERSE1
+               : strcmp(text_, "universe2") == 0              ? KEY_UNIVERSE2
+                                                              : KEY_OTHER;
+        state_ = EXPECT_COLON;
+        return ESP_OK;
+
+    case EXPECT_COLON:
+        if (token != COLON)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "expected : after a key");
+        }
+        state_ = EXPECT_VALUE;
+        return ESP_OK;
+
+    case EXPECT_VALUE:
+        return onValue(token);
+
+    case AFTER_VALUE:
+        if (token == COMMA)
+        {
+            state_ = EXPECT_KEY;
+            return ESP_OK;
+        }
+        if (token == END_OBJECT)
+        {
+            return endPreset();
+        }
+        return fail(ESP_ERR_INVALID_ARG, "expected , or } after a value");
+
+    case EXPECT_CHANNEL_OR_END:
+    case EXPECT_CHANNEL:
+        if (token == END_ARRAY && state_ == EXPECT_CHANNEL_OR_END)
+        {
+            endUniverse();
+            return ESP_OK;
+        }
+        if (token != NUMBER)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "channel value is not a number");
+        }
+        return onChannel();
+
+    case AFTER_CHANNEL:
+        if (token == COMMA)
+        {
+            state_ = EXPECT_CHANNEL;
+            return ESP_OK;
+        }
+        if (token == END_ARRAY)
+        {
+            endUniverse();
+            return ESP_OK;
+        }
+        return fail(ESP_ERR_INVALID_ARG, "expected , or ] after a channel value");
+
+    case SKIPPING:
+        return skip(token);
+
+    case DONE:
+        return fail(ESP_ERR_INVALID_SIZE, "data after the presets");
+
+    default:
+        return error_;
+    }
+
+    // The array of presets closed
+    if (numberOfPresets_ < MIN_PRESETS)
+    {
+        return fail(ESP_ERR_INVALID_SIZE, "too few presets");
+    }
+    state_ = DONE;
+    return ESP_OK;
+}
+
+esp_err_t PresetJsonParser::onValue(Token token)
+{
+    switch (key_)
+    {
+    case KEY_INDEX:
+        // Presets are stored at their position in the array, the index is informational
+        if (token != NUMBER)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "index is not a number");
+        }
+        break;
+
+    case KEY_NAME:
+        if (token != STRING)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "name is not a string");
+        }
+        preset_.setName(text_);
+        break;
+
+    case KEY_UNIVERSE1:
+    case KEY_UNIVERSE2:
+        if (token != BEGIN_ARRAY)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "universe is not an array");
+        }
+        universe_ = preset_.getUniverseBuffer(key_ == KEY_UNIVERSE1 ? 0 : 1);
+        channel_ = 0;
+        state_ = EXPECT_CHANNEL_OR_END;
+        return ESP_OK;
+
+    default:
+        if (token == BEGIN_OBJECT || token == BEGIN_ARRAY)
+        {
+            skipDepth_ = 0;
+            skipExpect_ = SKIP_VALUE;
+            state_ = SKIPPING;
+            return skip(token);
+        }
+        if (token != STRING && token != NUMBER && token != LITERAL)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "expected a value");
+        }
+        break;
+    }
+    state_ = AFTER_VALUE;
+    return ESP_OK;
+}
+
+esp_err_t PresetJsonParser::onChannel()
+{
+    if (!numberIsInteger_ || number_ < 0 || number_ > 255)
+    {
+        return fail(ESP_ERR_INVALID_ARG, "channel value is not an integer 0..255");
+    }
+    if (channel_ == DMX_UNIVERSE_SIZE)
+    {
+        return fail(ESP_ERR_INVALID_SIZE, "too many channel values");
+    }
+    universe_[channel_++] = number_;
+    state_ = AFTER_CHANNEL;
+    return ESP_OK;
+}
+
+esp_err_t PresetJsonParser::skip(Token token)
+{
+    // The value is not kept but still checked to be valid JSON
+    bool inArray = skipDepth_ > 0 && ((skipArrays_ >> (skipDepth_ - 1)) & 1);
+    switch (skipExpect_)
+    {
+    case SKIP_VALUE_OR_END:
+    case SKIP_VALUE:
+        if (token == END_ARRAY && skipExpect_ == SKIP_VALUE_OR_END && inArray)
+        {
+            break;
+        }
+        if (token == BEGIN_OBJECT || token == BEGIN_ARRAY)
+        {
+            if (skipDepth_ == MAX_SKIP_DEPTH)
+            {
+                return fail(ESP_ERR_INVALID_SIZE, "value nested too deeply");
+            }
+            skipArrays_ = token == BEGIN_ARRAY ? skipArrays_ | 1u << skipDepth_ : skipArrays_ & ~(1u << skipDepth_);
+            skipDepth_++;
+            skipExpect_ = token == BEGIN_ARRAY ? SKIP_VALUE_OR_END : SKIP_KEY_OR_END;
+            return ESP_OK;
+        }
+        if (token != STRING && token != NUMBER && token != LITERAL)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "expected a value");
+        }
+        skipExpect_ = SKIP_AFTER_VALUE;
+        return ESP_OK;
+
+    case SKIP_KEY_OR_END:
+    case SKIP_KEY:
+        if (token == END_OBJECT && skipExpect_ == SKIP_KEY_OR_END)
+        {
+            break;
+        }
+        if (token != STRING)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "expected a key");
+        }
+        skipExpect_ = SKIP_COLON;
+        return ESP_OK;
+
+    case SKIP_COLON:
+        if (token != COLON)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "expected : after a key");
+        }
+        skipExpect_ = SKIP_VALUE;
+        return ESP_OK;
+
+    default:
+        if (token == COMMA)
+        {
+            skipExpect_ = inArray ? SKIP_VALUE : SKIP_KEY;
+            return ESP_OK;
+        }
+        if (token != (inArray ? END_ARRAY : END_OBJECT))
+        {
+            return fail(ESP_ERR_INVALID_ARG, inArray ? "expected , or ] in array" : "expected , or } in object");
+        }
+        break;
+    }
+
+    // The innermost object or array closed
+    skipDepth_--;
+    skipExpect_ = SKIP_AFTER_VALUE;
+    if (skipDepth_ == 0)
+    {
+        state_ = AFTER_VALUE;
+    }
+    return ESP_OK;
+}
+
+esp_err_t PresetJsonParser::decode(char c)
+{
+    int8_t value;
+    if (encoding_ == UNIVERSE_HEX)
+    {
+        value = hexValue(c);
+        if (value < 0)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "invalid hex digit in universe");
+        }
+        bits_ = bits_ << 4 | value;
+        bitCount_ += 4;
+    }
+    else
+    {
+        value = base64Value(c);
+        if (value < 0 && c == '=' && padding_ < 2 && encodedLength_ % 4 >= 2)
+        {
+            padding_++;
+            return ESP_OK;
+        }
+        if (value < 0)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "invalid base64 character in universe");
+        }
+        if (padding_ > 0)
+        {
+            return fail(ESP_ERR_INVALID_ARG, "base64 after padding");
+        }
+        bits_ = bits_ << 6 | value;
+        bitCount_ += 6;
+    }
+    encodedLength_++;
+
+    if (bitCount_ >= 8)
+    {
+        if (channel_ == DMX_UNIVERSE_SIZE)
+        {
+            return fail(ESP_ERR_INVALID_SIZE, "too many channel values");
+        }
+        bitCount_ -= 8;
+        universe_[channel_++] = bits_ >> bitCount_;
+        bits_ &= (1u << bitCount_) - 1;
+    }
+    return ESP_OK;
+}
+
+esp_err_t PresetJsonParser::endEncoded()
+{
+    // Hex needs two digits per value, base64 at least two characters per last value and padding up to a full group
+    bool complete = encoding_ == UNIVERSE_HEX ? bitCount_ == 0
+                                              : encodedLength_ % 4 != 1 &&
+                                                    (padding_ == 0 || (encodedLength_ + padding_) % 4 == 0);
+    if (!complete)
+    {
+        return fail(ESP_ERR_INVALID_ARG, "incomplete encoded universe");
+    }
+    endUniverse();
+    return ESP_OK;
+}
+
+void PresetJsonParser::endUniverse()
+{
+    // Channels not sent are 0, the universe always has all channels (as the GET response has)
+    memset(universe_ + channel_, 0, DMX_UNIVERSE_SIZE - channel_);
+    preset_.setUniverseLength(key_ == KEY_UNIVERSE1 ? 0 : 1, DMX_UNIVERSE_SIZE);
+    state_ = AFTER_VALUE;
+}
+
+esp_err_t PresetJsonParser::endPreset()
+{
+    esp_err_t err = handler_.onPreset(numberOfPresets_, preset_);
+    if (err != ESP_OK)
+    {
+        handlerError_ = true;
+        return fail(err, "preset rejected");
+    }
+    numberOfPresets_++;
+    state_ = singlePreset_ ? DONE : AFTER_PRESET;
+    return ESP_OK;
+}
+
+void PresetJsonParser::appendText(char c)
+{
+    if (highSurrogate_)
+    {
+        // Not followed by its low surrogate
+        highSurrogate_ = 0;
+        appendCodePoint(0xFFFD);
+    }
+    // Once a character is dropped, everything after it is too
+    if (textTruncated_ || textLength_ == MAX_TEXT_LENGTH)
+    {
+        textTruncated_ = true;
+        return;
+    }
+    text_[textLength_++] = c;
+}
+
+void PresetJsonParser::appendCodePoint(uint32_t codePoint)
+{
+    if (codePoint >= 0xDC00 && codePoint <= 0xDFFF && highSurrogate_)
+    {
+        codePoint = 0x10000 + ((highSurrogate_ - 0xD800) << 10) + (codePoint - 0xDC00);
+        highSurrogate_ = 0;
+    }
+    else if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+    {
+        if (highSurrogate_)
+        {
+            highSurrogate_ = 0;
+            appendCodePoint(0xFFFD);
+        }
+        highSurrogate_ = codePoint;
+        return;
+    }
+    else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF)
+    {
+        codePoint = 0xFFFD;
+    }
+    else if (highSurrogate_)
+    {
+        highSurrogate_ = 0;
+        appendCodePoint(0xFFFD);
+    }
+
+    char utf8[4];
+    uint8_t length;
+    if (codePoint < 0x80)
+    {
+        utf8[0] = codePoint;
+        length = 1;
+    }
+    else if (codePoint < 0x800)
+    {
+        utf8[0] = 0xC0 | codePoint >> 6;
+        utf8[1] = 0x80 | (codePoint & 0x3F);
+        length = 2;
+    }
+    else if (codePoint < 0x10000)
+    {
+        utf8[0] = 0xE0 | codePoint >> 12;
+        utf8[1] = 0x80 | (codePoint >> 6 & 0x3F);
+        utf8[2] = 0x80 | (codePoint & 0x3F);
+        length = 3;
+    }
+    else
+    {
+        utf8[0] = 0xF0 | codePoint >> 18;
+        utf8[1] = 0x80 | (codePoint >> 12 & 0x3F);
+        utf8[2] = 0x80 | (codePoint >> 6 & 0x3F);
+        utf8[3] = 0x80 | (codePoint & 0x3F);
+        length = 4;
+    }
+    // A character that does not fit as a whole is dropped
+    if (textTruncated_ || textLength_ + length > MAX_TEXT_LENGTH)
+    {
+        textTruncated_ = true;
+        return;
+    }
+    memcpy(text_ + textLength_, utf8, length);
+    textLength_ += length;
+}
+
+void PresetJsonParser::endText()
+{
+    if (highSurrogate_)
+    {
+        highSurrogate_ = 0;
+        appendCodePoint(0xFFFD);
+    }
+    if (textTruncated_ && textLength_ > 0)
+    {
+        // Raw UTF-8 may have been cut within a character: drop its first bytes too
+        uint8_t start = textLength_ - 1;
+        while (start > 0 && (text_[start] & 0xC0) == 0x80)
+        {
+            start--;
+        }
+        uint8_t lead = text_[start];
+        uint8_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+        if (textLength_ - start < length)
+        {
+            textLength_ = start;
+        }
+    }
+    text_[textLength_] = '\0';
+}
+
+esp_err_t PresetJsonParser::fail(esp_err_t err, const char *reason)
+{
+    ESP_LOGE(LOG_TAG, "Invalid presets at byte %u: %s", (unsigned)offset_, reason);
+    state_ = FAILED;
+    error_ = err;
+    return err;
+}
@@ -0,0 +1,177 @@
+#pragma once
+
+#include "dmx_preset.hpp"
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Parses the preset list of /api/presets, fed in pieces of any size:
+//   [{"index": 0, "name": "...", "universe1": [0, 255, ...], "universe2": [...]}, ...]
+// With a string encoding a universe may also be a string of its channel values (base64 or hex), as the GET response
+// sends them for ?universes=base64|hex; an array of numbers is always accepted.
+// Channel values are written straight into a single preset that is handed to a handler once its object closes, so
+// the memory used does not depend on the size of the upload. The document is validated while it is read: values must
+// be integers 0..255, at most DMX_UNIVERSE_SIZE per universe, MIN_PRESETS..MAX_PRESETS presets. Presets are numbered
+// by their position in the array ("index" is checked but not used), unknown keys are skipped whatever their value and
+// names are truncated to DMX_PRESET_NAME_SIZE - 1 bytes on a UTF-8 character boundary.
+// For a single preset (/api/presets/{i}) the document is one preset object instead of the array.
+class PresetJsonParser
+{
+  public:
+    class Handler
+    {
+      public:
+        virtual ~Handler() {}
+        // Called for every complete preset; an error stops parsing
+        virtual esp_err_t onPreset(uint8_t position, const DmxPreset &preset) = 0;
+    };
+
+    // How universes are written in JSON
+    enum UniverseEncoding
+    {
+        UNIVERSE_ARRAY,  // Array of numbers
+        UNIVERSE_BASE64, // String, RFC 4648 (padding optional)
+        UNIVERSE_HEX     // String, two digits per channel
+    };
+
+    explicit PresetJsonParser(
+        Handler &handler, UniverseEncoding encoding = UNIVERSE_ARRAY, bool singlePreset = false);
+
+    // Parse the next piece of the document; an error is final
+    esp_err_t feed(const char *data, size_t length);
+
+    // Call after the last piece: checks that the document is complete
+    esp_err_t finish();
+
+    // Presets handed to the handler so far
+    uint8_t getNumberOfPresets() const { return numberOfPresets_; }
+
+    // The handler returned an error (as opposed to the document being invalid)
+    bool isHandlerError() const { return handlerError_; }
+
+  private:
+    static const size_t MAX_TEXT_LENGTH = DMX_PRESET_NAME_SIZE - 1; // Longer strings are truncated
+    static const uint8_t MAX_SKIP_DEPTH = 32;                        // Nesting within skipped values
+
+    enum Token
+    {
+        BEGIN_OBJECT,
+        END_OBJECT,
+        BEGIN_ARRAY,
+        END_ARRAY,
+        COLON,
+        COMMA,
+        STRING,
+        NUMBER,
+        LITERAL // true, false or null
+    };
+
+    enum LexState
+    {
+        LEX_NONE,
+        LEX_STRING,
+        LEX_ESCAPE,
+        LEX_UNICODE,
+        LEX_NUMBER,
+        LEX_LITERAL,
+        LEX_ENCODED,       // String of an encoded universe, decoded while it is read
+        LEX_ENCODED_ESCAPE // Only \/ can occur in one
+    };
+
+    enum State
+    {
+        EXPECT_ARRAY,
+        EXPECT_PRESET_OR_END,
+        EXPECT_PRESET,
+        AFTER_PRESET,
+        EXPECT_KEY_OR_END,
+        EXPECT_KEY,
+        EXPECT_COLON,
+        EXPECT_VALUE,
+        AFTER_VALUE,
+        EXPECT_CHANNEL_OR_END,
+        EXPECT_CHANNEL,
+        AFTER_CHANNEL,
+        SKIPPING,
+        DONE,
+        FAILED
+    };
+
+    enum SkipExpect
+    {
+        SKIP_VALUE_OR_END,
+        SKIP_VALUE,
+        SKIP_KEY_OR_END,
+        SKIP_KEY,
+        SKIP_COLON,
+        SKIP_AFTER_VALUE
+    };
+
+    enum Key
+    {
+        KEY_INDEX,
+        KEY_NAME,
+        KEY_UNIVERSE1,
+        KEY_UNIVERSE2,
+        KEY_OTHER
+    };
+
+    Handler &handler_;
+    UniverseEncoding encoding_;
+    bool singlePreset_;
+    LexState lexState_;
+    State state_;
+    Key key_;
+    esp_err_t error_;
+    bool handlerError_;
+    uint32_t offset_; // Of the current byte in the document, for error messages
+    uint8_t numberOfPresets_;
+    uint8_t *universe_; // Channel values of the current universe
+    uint16_t channel_;  // Next channel of the current universe
+
+    // Current string or literal
+    char text_[MAX_TEXT_LENGTH + 1];
+    uint8_t textLength_;
+    bool textTruncated_;
+    uint32_t codePoint_;     // Of a \u escape
+    uint8_t hexDigits_;      // Read of the \u escape
+    uint16_t highSurrogate_; // Waiting for its low surrogate, 0 if none
+
+    // Current number: integers are accumulated, anything else is only checked for syntax
+    int32_t number_;
+    bool numberNegative_;
+    bool numberIsInteger_; // No fraction or exponent and within int32
+    uint8_t numberPart_;   // 0: integer, 1: fraction, 2: exponent
+    uint8_t numberDigits_; // In the current part
+    char numberLast_;      // Previous character of the number
+
+    // Current encoded universe
+    uint32_t bits_;          // Decoded, not yet a whole channel value
+    uint8_t bitCount_;       // In bits_
+    uint16_t encodedLength_; // Characters, without padding
+    uint8_t padding_;        // Base64 '=' characters
+
+    // Value of an unknown key, read only to find where it ends
+    SkipExpect skipExpect_;
+    uint8_t skipDepth_;
+    uint32_t skipArrays_; // Bit per nesting level: set for an array, clear for an object
+
+    DmxPreset preset_;
+
+    esp_err_t lex(char c);
+    esp_err_t decode(char c);
+    esp_err_t endEncoded();
+    esp_err_t lexNone(char c);
+    esp_err_t endNumber();
+    esp_err_t endLiteral();
+    esp_err_t onToken(Token token);
+    esp_err_t onValue(Token token);
+    esp_err_t onChannel();
+    esp_err_t skip(Token token);
+    void endUniverse();
+    esp_err_t endPreset();
+    void appendText(char c);
+    void appendCodePoint(uint32_t codePoint);
+    void endText();
+    esp_err_t fail(esp_err_t err, const char *reason);
+};
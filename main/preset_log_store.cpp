@@ -0,0 +1,877 @@
+#include "preset_log_store.hpp"
+#include <cstring>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_timer.h>
+
+static const char *LOG_TAG = "PresetLogStore";
+
+PresetLogStore::PresetLogStore()
+    : partition_(nullptr), mapped_(nullptr), mmapHandle_(0), numSectors_(0), headSector_(NO_SECTOR), nextSequence_(1),
+      countOffset_(NO_OFFSET), numberOfPresets_(0), countBackup_(false), openTransaction_(NO_TRANSACTION),
+      nextTransaction_(1), committedTransaction_(0), commitOffset_(NO_OFFSET), stagedCountOffset_(NO_OFFSET),
+      stagedNumberOfPresets_(0), compacting_(false), compactions_(0), entriesScanned_(0), bootScanUs_(0)
+{
+    memset(sectorSequence_, 0, sizeof(sectorSequence_));
+    memset(sectorUsed_, 0, sizeof(sectorUsed_));
+    memset(sectorLive_, 0, sizeof(sectorLive_));
+    memset(sectorTransaction_, 0xFF, sizeof(sectorTransaction_));
+    memset(presetOffset_, 0xFF, sizeof(presetOffset_));
+    memset(presetLength_, 0, sizeof(presetLength_));
+    memset(presetBackup_, 0, sizeof(presetBackup_));
+    memset(stagedOffset_, 0xFF, sizeof(stagedOffset_));
+    memset(stagedLength_, 0, sizeof(stagedLength_));
+}
+
+PresetLogStore::~PresetLogStore()
+{
+    if (mapped_)
+    {
+        esp_partition_munmap(mmapHandle_);
+    }
+}
+
+esp_err_t PresetLogStore::init(const char *partitionLabel)
+{
+    int64_t startUs = esp_timer_get_time();
+    partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partitionLabel);
+    if (!partition_ || partition_->size < 2 * SECTOR_SIZE)
+    {
+        ESP_LOGE(LOG_TAG, "Partition '%s' not found or too small", partitionLabel);
+        partition_ = nullptr;
+        return ESP_ERR_NOT_FOUND;
+    }
+    numSectors_ = partition_->size / SECTOR_SIZE > MAX_SECTORS ? MAX_SECTORS : partition_->size / SECTOR_SIZE;
+
+    const void *mapped = nullptr;
+    esp_err_t err = esp_partition_mmap(
+        partition_, 0, numSectors_ * SECTOR_SIZE, ESP_PARTITION_MMAP_DATA, &mapped, &mmapHandle_);
+    if (err == ESP_OK)
+    {
+        mapped_ = static_cast<const uint8_t *>(mapped);
+    }
+    else
+    {
+        ESP_LOGW(LOG_TAG, "Failed to map partition, reading presets from flash: %s", esp_err_to_name(err));
+    }
+
+    // Classify the sectors by their header; a torn or foreign header means no entry in it can be trusted
+    uint16_t order[MAX_SECTORS];
+    uint16_t numUsed = 0;
+    for (uint16_t sector = 0; sector < numSectors_; sector++)
+    {
+        SectorHeader header;
+        err = read(sector * SECTOR_SIZE, &header, sizeof(header));
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(LOG_TAG, "Failed to read sector %d: %s", sector, esp_err_to_name(err));
+            return err;
+        }
+
+        if (header.magic == 0xFFFFFFFF && header.sequence == 0xFFFFFFFF && header.crc == 0xFFFFFFFF)
+        {
+            continue;
+        }
+        if (header.magic != SECTOR_MAGIC || header.crc != sectorHeaderCrc(header) || header.sequence == 0)
+        {
+            ESP_LOGW(LOG_TAG, "Sector %d has no valid header, erasing it", sector);
+            if (eraseSector(sector) != ESP_OK)
+            {
+                return ESP_FAIL;
+            }
+            continue;
+        }
+
+        // Insertion sort by sequence, so entries are replayed oldest first
+        sectorSequence_[sector] = header.sequence;
+        uint16_t i = numUsed++;
+        for (; i > 0 && sectorSequence_[order[i - 1]] > header.sequence; i--)
+        {
+            order[i] = order[i - 1];
+        }
+        order[i] = sector;
+    }
+
+    // First find the latest committed transaction, then replay the entries that are valid with it
+    nextTransaction_ = NO_TRANSACTION; // Not known until the log has been scanned
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (uint16_t i = 0; i < numUsed; i++)
+        {
+            err = scanSector(order[i], pass == 1);
+            if (err != ESP_OK)
+            {
+                return err;
+            }
+        }
+    }
+    if (nextTransaction_ == NO_TRANSACTION)
+    {
+        nextTransaction_ = (committedTransaction_ + 1) % TRANSACTION_IDS;
+    }
+
+    if (numUsed > 0)
+    {
+        headSector_ = order[numUsed - 1];
+        nextSequence_ = sectorSequence_[headSector_] + 1;
+    }
+    err = rewriteBackups();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    bootScanUs_ = esp_timer_get_time() - startUs;
+    Stats stats = getStats();
+    ESP_LOGI(LOG_TAG, "Scanned %lu entries in %lu us: %lu of %lu sectors free, %lu live bytes",
+        (unsigned long)entriesScanned_, (unsigned long)bootScanUs_, (unsigned long)stats.freeSectors,
+        (unsigned long)stats.totalSectors, (unsigned long)stats.liveBytes);
+    return ESP_OK;
+}
+
+esp_err_t PresetLogStore::scanSector(uint16_t sector, bool indexing)
+{
+    uint32_t base = sector * SECTOR_SIZE;
+    uint32_t offset = SECTOR_HEADER_SIZE;
+    while (offset + ENTRY_HEADER_SIZE <= SECTOR_SIZE)
+    {
+        EntryHeader header;
+        esp_err_t err = read(base + offset, &header, sizeof(header));
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(LOG_TAG, "Failed to read entry at 0x%lx: %s", (unsigned long)(base + offset),
+                esp_err_to_name(err));
+            return err;
+        }
+
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&header);
+        bool erased = true;
+        for (size_t i = 0; i < sizeof(header) && erased; i++)
+        {
+            erased = bytes[i] == 0xFF;
+        }
+        if (erased)
+        {
+            break;
+        }
+
+        if (header.magic != ENTRY_MAGIC || header.length > SECTOR_SIZE - offset - ENTRY_HEADER_SIZE)
+        {
+            // Torn header: nothing after it can be located, so the sector takes no more entries
+            if (indexing)
+            {
+                ESP_LOGW(LOG_TAG, "Invalid entry at 0x%lx, closing sector %d", (unsigned long)(base + offset), sector);
+            }
+            offset = SECTOR_SIZE;
+            break;
+        }
+
+        uint8_t payload[2] = {0, 0};
+        if ((header.type == ENTRY_COUNT || header.type == ENTRY_COMMIT) && header.length <= sizeof(payload))
+        {
+            read(base + offset + ENTRY_HEADER_SIZE, payload, header.length);
+        }
+
+        if (!indexing)
+        {
+            // The header of a torn entry may be torn too
+            if (header.commit != 0xFF && header.transaction != NO_TRANSACTION)
+            {
+                noteTransaction(sector, header.transaction & ~BACKUP_OF);
+            }
+            // Ids wrap around, so the latest commit is the one latest in the log (compaction copies only that one)
+            if (header.type == ENTRY_COMMIT && header.commit == COMMITTED && header.length == 2 &&
+                header.transaction == NO_TRANSACTION)
+            {
+                committedTransaction_ = payload[0] | (payload[1] << 8);
+                noteTransaction(NO_SECTOR, committedTransaction_);
+            }
+        }
+        else if (header.transaction == NO_TRANSACTION)
+        {
+            entriesScanned_++;
+            if (header.commit == COMMITTED)
+            {
+                indexEntry(header.type, header.id, base + offset, header.length, payload, INDEX_CURRENT);
+            }
+        }
+        else if (header.transaction & BACKUP_OF)
+        {
+            entriesScanned_++;
+            uint16_t transaction = header.transaction & ~BACKUP_OF;
+            if (header.commit == COMMITTED && isNewerTransaction(transaction, committedTransaction_))
+            {
+                indexEntry(header.type, header.id, base + offset, header.length, payload, INDEX_BACKUP);
+            }
+        }
+        else
+        {
+            entriesScanned_++;
+            if (header.commit == STAGED && !isNewerTransaction(header.transaction, committedTransaction_))
+            {
+                indexEntry(header.type, header.id, base + offset, header.length, payload, INDEX_CURRENT);
+            }
+            else if (header.commit == STAGED)
+            {
+                // Would become valid with the next commit
+                ESP_LOGW(LOG_TAG, "Discarding entry of unfinished transaction %d", header.transaction);
+                esp_err_t err = discardEntry(base + offset);
+                if (err != ESP_OK)
+                {
+                    return err;
+                }
+            }
+        }
+        offset += entrySize(header.length);
+    }
+
+    sectorUsed_[sector] = offset > SECTOR_SIZE ? SECTOR_SIZE : offset;
+    return ESP_OK;
+}
+
+esp_err_t PresetLogStore::readPreset(uint8_t index, uint8_t *record, size_t capacity, size_t &size) const
+{
+    if (!partition_)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (!hasPreset(index))
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    if (presetLength_[index] > capacity)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    size = presetLength_[index];
+    return read(presetOffset_[index] + ENTRY_HEADER_SIZE, record, size);
+}
+
+esp_err_t PresetLogStore::mapPreset(uint8_t index, const uint8_t *&record, size_t &size) const
+{
+    if (!mapped_)
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+    if (!hasPreset(index))
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    record = mapped_ + presetOffset_[index] + ENTRY_HEADER_SIZE;
+    size = presetLength_[index];
+    return ESP_OK;
+}
+
+esp_err_t PresetLogStore::writePreset(uint8_t index, const uint8_t *record, size_t size)
+{
+    if (index >= MAX_PRESETS || !record || size > DmxPresetRecord::MAX_SIZE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return appendEntry(ENTRY_PRESET, index, record, size, NO_TRANSACTION);
+}
+
+esp_err_t PresetLogStore::writeNumberOfPresets(uint8_t numberOfPresets)
+{
+    return appendEntry(ENTRY_COUNT, 0, &numberOfPresets, sizeof(numberOfPresets), NO_TRANSACTION);
+}
+
+esp_err_t PresetLogStore::beginTransaction()
+{
+    if (!partition_ || openTransaction_ != NO_TRANSACTION)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    esp_err_t err = retireOldTransactions();
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    openTransaction_ = nextTransaction_;
+    nextTransaction_ = (nextTransaction_ + 1) % TRANSACTION_IDS;
+    return ESP_OK;
+}
+
+esp_err_t PresetLogStore::retireOldTransactions()
+{
+    // The latest commit moves up with an empty transaction, nothing is staged that it could make valid
+    if (transactionAge(committedTransaction_, nextTransaction_) >= TRANSACTION_WINDOW)
+    {
+        openTransaction_ = nextTransaction_;
+        nextTransaction_ = (nextTransaction_ + 1) % TRANSACTION_IDS;
+        esp_err_t err = commitTransaction();
+        if (err != ESP_OK)
+        {
+            abortTransaction();
+            return err;
+        }
+    }
+
+    // Compaction rewrites the surviving entries of a sector without their transaction id (no transaction is open)
+    for (uint16_t sector = 0; sector < numSectors_; sector++)
+    {
+        if (sectorSequence_[sector] == 0 || sectorTransaction_[sector] == NO_TRANSACTION ||
+            transactionAge(sectorTransaction_[sector], nextTransaction_) < TRANSACTION_WINDOW)
+        {
+            continue;
+        }
+        esp_err_t err = reserveFreeSector();
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        if (sectorSequence_[sector] == 0)
+        {
+            continue; // Compacted while making room
+        }
+        if (sector == headSector_)
+        {
+            // Copies go to a new head sector
+            sectorUsed_[sector] = SECTOR_SIZE;
+            headSector_ = NO_SECTOR;
+        }
+        err = compactSector(sector);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t PresetLogStore::stagePreset(uint8_t index, const uint8_t *record, size_t size)
+{
+    if (index >= MAX_PRESETS || !record || size > DmxPresetRecord::MAX_SIZE)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    if (openTransaction_ == NO_TRANSACTION)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return appendEntry(ENTRY_PRESET, index, record, size, openTransaction_);
+}
+
+esp_err_t PresetLogStore::stageNumberOfPresets(uint8_t numberOfPresets)
+{
+    if (openTransaction_ == NO_TRANSACTION)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    return appendEntry(ENTRY_COUNT, 0, &numberOfPresets, sizeof(numberOfPresets), openTransaction_);
+}
+
+esp_err_t PresetLogStore::commitTransaction()
+{
+    if (openTransaction_ == NO_TRANSACTION)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Once this entry is complete the transaction survives a power cut; on failure it stays open to be aborted
+    uint8_t payload[2] = {(uint8_t)(openTransaction_ & 0xFF), (uint8_t)(openTransaction_ >> 8)};
+    esp_err_t err = appendEntry(ENTRY_COMMIT, 0, payload, sizeof(payload), NO_TRANSACTION);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    committedTransaction_ = openTransaction_;
+
+    for (uint8_t index = 0; index < MAX_PRESETS; index++)
+    {
+        applyStaged(presetOffset_[index], presetLength_[index], presetBackup_[index], stagedOffset_[index],
+            stagedLength_[index]);
+    }
+    uint32_t countOffset = countOffset_;
+    uint16_t countLength = 1;
+    applyStaged(countOffset_, countLength, countBackup_, stagedCountOffset_, 1);
+    if (countOffset_ != countOffset)
+    {
+        numberOfPresets_ = stagedNumberOfPresets_;
+    }
+
+    memset(stagedOffset_, 0xFF, sizeof(stagedOffset_));
+    stagedCountOffset_ = NO_OFFSET;
+    openTransaction_ = NO_TRANSACTION;
+    return ESP_OK;
+}
+
+void PresetLogStore::abortTransaction()
+{
+    if (openTransaction_ == NO_TRANSACTION)
+    {
+        return;
+    }
+
+    // A failed discard is repeated by the next init, as long as no later transaction commits first
+    for (uint8_t index = 0; index < MAX_PRESETS; index++)
+    {
+        if (stagedOffset_[index] != NO_OFFSET)
+        {
+            discardEntry(stagedOffset_[index]);
+            releaseEntry(stagedOffset_[index], stagedLength_[index]);
+            stagedOffset_[index] = NO_OFFSET;
+        }
+    }
+    if (stagedCountOffset_ != NO_OFFSET)
+    {
+        discardEntry(stagedCountOffset_);
+        releaseEntry(stagedCountOffset_, 1);
+        stagedCountOffset_ = NO_OFFSET;
+    }
+    openTransaction_ = NO_TRANSACTION;
+    rewriteBackups();
+}
+
+esp_err_t PresetLogStore::appendEntry(
+    uint8_t type, uint8_t id, const uint8_t *payload, uint16_t length, uint16_t transaction)
+{
+    if (!partition_)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    uint32_t size = entrySize(length);
+    esp_err_t err = makeRoom(size);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    // Header with the commit byte still erased, then the payload, then the commit byte
+    uint32_t offset = headSector_ * SECTOR_SIZE + sectorUsed_[headSector_];
+    EntryHeader header = {ENTRY_MAGIC, type, id, 0xFF, length, transaction};
+    sectorUsed_[headSector_] += size; // Also on failure, a partly written entry cannot be reused
+    err = esp_partition_write(partition_, offset, &header, sizeof(header));
+    if (err == ESP_OK)
+    {
+        err = esp_partition_write(partition_, offset + ENTRY_HEADER_SIZE, payload, length);
+    }
+    if (err == ESP_OK)
+    {
+        uint8_t commit = transaction == NO_TRANSACTION || (transaction & BACKUP_OF) ? COMMITTED : STAGED;
+        err = esp_partition_write(partition_, offset + offsetof(EntryHeader, commit), &commit, sizeof(commit));
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to write entry at 0x%lx: %s", (unsigned long)offset, esp_err_to_name(err));
+        return err;
+    }
+
+    if (transaction != NO_TRANSACTION)
+    {
+        noteTransaction(offset / SECTOR_SIZE, transaction & ~BACKUP_OF);
+    }
+    IndexTarget target = transaction == NO_TRANSACTION ? INDEX_CURRENT
+                         : transaction & BACKUP_OF     ? INDEX_BACKUP
+                                                       : INDEX_STAGED;
+    indexEntry(type, id, offset, length, payload, target);
+    return ESP_OK;
+}
+
+esp_err_t PresetLogStore::copyEntry(uint8_t type, uint8_t id, bool staged, uint16_t transaction)
+{
+    bool isPreset = type == ENTRY_PRESET;
+    uint16_t length = !isPreset ? 1 : staged ? stagedLength_[id] : presetLength_[id];
+
+    // Making room may compact, which moves entries and uses copyBuffer_, so the entry is looked up after it
+    esp_err_t err = makeRoom(entrySize(length));
+    uint32_t offset = isPreset ? (staged ? stagedOffset_[id] : presetOffset_[id])
+                               : (staged ? stagedCountOffset_ : countOffset_);
+    // Copied through RAM, the flash driver cannot write from a mapped (cache disabled) source
+    if (err == ESP_OK)
+    {
+        err = read(offset + ENTRY_HEADER_SIZE, copyBuffer_, length);
+    }
+    if (err == ESP_OK)
+    {
+        err = appendEntry(type, id, copyBuffer_, length, transaction);
+    }
+    return err;
+}
+
+esp_err_t PresetLogStore::rewriteBackups()
+{
+    // Backups of a transaction that did not commit hold the current show; as normal entries they stay valid when a
+    // later transaction commits
+    esp_err_t err = ESP_OK;
+    for (uint8_t index = 0; index < MAX_PRESETS && err == ESP_OK; index++)
+    {
+        if (presetBackup_[index])
+        {
+            err = copyEntry(ENTRY_PRESET, index, false, NO_TRANSACTION);
+        }
+    }
+    if (err == ESP_OK && countBackup_)
+    {
+        err = copyEntry(ENTRY_COUNT, 0, false, NO_TRANSACTION);
+    }
+    return err;
+}
+
+esp_err_t PresetLogStore::makeRoom(uint32_t size)
+{
+    if (headSector_ != NO_SECTOR && sectorUsed_[headSector_] + size <= SECTOR_SIZE)
+    {
+        return ESP_OK;
+    }
+
+    // Compaction itself may use the reserved sector
+    esp_err_t err = compacting_ ? ESP_OK : reserveFreeSector();
+    if (err == ESP_OK && (headSector_ == NO_SECTOR || sectorUsed_[headSector_] + size > SECTOR_SIZE))
+    {
+        err = openSector();
+    }
+    return err;
+}
+
+esp_err_t PresetLogStore::discardEntry(uint32_t offset)
+{
+    uint8_t commit = DISCARDED;
+    esp_err_t err = esp_partition_write(partition_, offset + offsetof(EntryHeader, commit), &commit, sizeof(commit));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to discard entry at 0x%lx: %s", (unsigned long)offset, esp_err_to_name(err));
+    }
+    return err;
+}
+
+esp_err_t PresetLogStore::reserveFreeSector()
+{
+    // Keep a sector free, so compaction always has room to copy live entries to
+    for (uint16_t attempt = 0; countFreeSectors() <= RESERVED_FREE_SECTORS; attempt++)
+    {
+        if (attempt == numSectors_ || findCompactionVictim() < 0)
+        {
+            ESP_LOGE(LOG_TAG, "Preset log full");
+            return ESP_ERR_NO_MEM;
+        }
+        esp_err_t err = compact();
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t PresetLogStore::openSector()
+{
+    uint16_t sector = 0;
+    while (sector < numSectors_ && sectorSequence_[sector] != 0)
+    {
+        sector++;
+    }
+    if (sector == numSectors_)
+    {
+        ESP_LOGE(LOG_TAG, "No free sector");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // An erase cut short by a power loss can leave an erased header in front of old data
+    // (copyBuffer_ may hold an entry being compacted, so a small buffer of its own is used)
+    uint8_t chunk[128];
+    bool erased = true;
+    esp_err_t err = ESP_OK;
+    for (uint32_t offset = 0; offset < SECTOR_SIZE && erased && err == ESP_OK; offset += sizeof(chunk))
+    {
+        err = read(sector * SECTOR_SIZE + offset, chunk, sizeof(chunk));
+        for (size_t i = 0; i < sizeof(chunk) && erased; i++)
+        {
+            erased = chunk[i] == 0xFF;
+        }
+    }
+    if (err == ESP_OK && !erased)
+    {
+        err = eraseSector(sector);
+    }
+
+    SectorHeader header = {SECTOR_MAGIC, nextSequence_, 0, 0xFFFFFFFF};
+    header.crc = sectorHeaderCrc(header);
+    if (err == ESP_OK)
+    {
+        err = esp_partition_write(partition_, sector * SECTOR_SIZE, &header, sizeof(header));
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to open sector %d: %s", sector, esp_err_to_name(err));
+        return err;
+    }
+
+    if (headSector_ != NO_SECTOR)
+    {
+        sectorUsed_[headSector_] = SECTOR_SIZE;
+    }
+    sectorSequence_[sector] = nextSequence_++;
+    sectorUsed_[sector] = SECTOR_HEADER_SIZE;
+    sectorLive_[sector] = 0;
+    headSector_ = sector;
+    return ESP_OK;
+}
+
+bool PresetLogStore::needsCompaction() const
+{
+    return partition_ && countFreeSectors() < COMPACTION_FREE_SECTORS && findCompactionVictim() >= 0;
+}
+
+esp_err_t PresetLogStore::compact()
+{
+    int victim = findCompactionVictim();
+    return victim < 0 ? ESP_OK : compactSector(victim);
+}
+
+esp_err_t PresetLogStore::compactSector(uint16_t victim)
+{
+    // Copy the entries the index still points to; a power cut before the erase leaves duplicates, and the copies
+    // in the newer sector win when the log is scanned. Staged entries stay in the open transaction, and a current
+    // entry a staged one replaces becomes a backup, so the copy does not win over the staged entry after the commit.
+    uint32_t base = victim * SECTOR_SIZE;
+    uint16_t backup = BACKUP_OF | openTransaction_;
+    esp_err_t err = ESP_OK;
+    compacting_ = true;
+    for (uint8_t index = 0; index < MAX_PRESETS && err == ESP_OK; index++)
+    {
+        if (presetOffset_[index] != NO_OFFSET && presetOffset_[index] / SECTOR_SIZE == (uint32_t)victim)
+        {
+            bool replaced = stagedOffset_[index] != NO_OFFSET &&
+                            (presetBackup_[index] || isLater(stagedOffset_[index], presetOffset_[index]));
+            err = copyEntry(ENTRY_PRESET, index, false, replaced ? backup : NO_TRANSACTION);
+        }
+        if (err == ESP_OK && stagedOffset_[index] != NO_OFFSET &&
+            stagedOffset_[index] / SECTOR_SIZE == (uint32_t)victim)
+        {
+            err = copyEntry(ENTRY_PRESET, index, true, openTransaction_);
+        }
+    }
+    if (err == ESP_OK && countOffset_ != NO_OFFSET && countOffset_ / SECTOR_SIZE == (uint32_t)victim)
+    {
+        bool replaced =
+            stagedCountOffset_ != NO_OFFSET && (countBackup_ || isLater(stagedCountOffset_, countOffset_));
+        err = copyEntry(ENTRY_COUNT, 0, false, replaced ? backup : NO_TRANSACTION);
+    }
+    if (err == ESP_OK && stagedCountOffset_ != NO_OFFSET && stagedCountOffset_ / SECTOR_SIZE == (uint32_t)victim)
+    {
+        err = copyEntry(ENTRY_COUNT, 0, true, openTransaction_);
+    }
+    if (err == ESP_OK && commitOffset_ != NO_OFFSET && commitOffset_ / SECTOR_SIZE == (uint32_t)victim)
+    {
+        uint8_t payload[2] = {(uint8_t)(committedTransaction_ & 0xFF), (uint8_t)(committedTransaction_ >> 8)};
+        err = appendEntry(ENTRY_COMMIT, 0, payload, sizeof(payload), NO_TRANSACTION);
+    }
+    compacting_ = false;
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    err = eraseSector(victim);
+    if (err == ESP_OK)
+    {
+        compactions_++;
+        ESP_LOGD(LOG_TAG, "Compacted sector %d (at 0x%lx)", victim, (unsigned long)base);
+    }
+    return err;
+}
+
+esp_err_t PresetLogStore::read(uint32_t offset, void *data, size_t length) const
+{
+    if (mapped_)
+    {
+        memcpy(data, mapped_ + offset, length);
+        return ESP_OK;
+    }
+    return esp_partition_read(partition_, offset, data, length);
+}
+
+esp_err_t PresetLogStore::eraseSector(uint16_t sector)
+{
+    esp_err_t err = esp_partition_erase_range(partition_, sector * SECTOR_SIZE, SECTOR_SIZE);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to erase sector %d: %s", sector, esp_err_to_name(err));
+        return err;
+    }
+
+    sectorSequence_[sector] = 0;
+    sectorUsed_[sector] = 0;
+    sectorLive_[sector] = 0;
+    sectorTransaction_[sector] = NO_TRANSACTION;
+    if (headSector_ == sector)
+    {
+        headSector_ = NO_SECTOR;
+    }
+    return ESP_OK;
+}
+
+uint16_t PresetLogStore::countFreeSectors() const
+{
+    uint16_t free = 0;
+    for (uint16_t sector = 0; sector < numSectors_; sector++)
+    {
+        free += sectorSequence_[sector] == 0;
+    }
+    return free;
+}
+
+int PresetLogStore::findCompactionVictim() const
+{
+    // The sector with the most superseded bytes; the head sector is still being filled
+    int victim = -1;
+    uint32_t mostDead = 0;
+    for (uint16_t sector = 0; sector < numSectors_; sector++)
+    {
+        if (sectorSequence_[sector] == 0 || sector == headSector_)
+        {
+            continue;
+        }
+        uint32_t dead = sectorUsed_[sector] - SECTOR_HEADER_SIZE - sectorLive_[sector];
+        if (dead > mostDead)
+        {
+            mostDead = dead;
+            victim = sector;
+        }
+    }
+    return victim;
+}
+
+void PresetLogStore::indexEntry(
+    uint8_t type, uint8_t id, uint32_t offset, uint16_t length, const uint8_t *payload, IndexTarget target)
+{
+    // A replaced staged entry is discarded right away: after an abort it would otherwise count once a later
+    // transaction commits
+    bool staged = target == INDEX_STAGED;
+    if (type == ENTRY_PRESET && id < MAX_PRESETS)
+    {
+        uint32_t &entryOffset = staged ? stagedOffset_[id] : presetOffset_[id];
+        uint16_t &entryLength = staged ? stagedLength_[id] : presetLength_[id];
+        if (staged && entryOffset != NO_OFFSET)
+        {
+            discardEntry(entryOffset);
+        }
+        releaseEntry(entryOffset, entryLength);
+        entryOffset = offset;
+        entryLength = length;
+        if (!staged)
+        {
+            presetBackup_[id] = target == INDEX_BACKUP;
+        }
+    }
+    else if (type == ENTRY_COUNT && length == 1)
+    {
+        uint32_t &entryOffset = staged ? stagedCountOffset_ : countOffset_;
+        if (staged && entryOffset != NO_OFFSET)
+        {
+            discardEntry(entryOffset);
+        }
+        releaseEntry(entryOffset, 1);
+        entryOffset = offset;
+        (staged ? stagedNumberOfPresets_ : numberOfPresets_) = payload[0];
+        if (!staged)
+        {
+            countBackup_ = target == INDEX_BACKUP;
+        }
+    }
+    else if (type == ENTRY_COMMIT && length == 2 && target == INDEX_CURRENT)
+    {
+        // Only the latest commit entry is kept
+        releaseEntry(commitOffset_, 2);
+        commitOffset_ = offset;
+    }
+    else
+    {
+        // Unknown entry types (from newer firmware) only take space
+        return;
+    }
+    sectorLive_[offset / SECTOR_SIZE] += entrySize(length);
+}
+
+void PresetLogStore::releaseEntry(uint32_t offset, uint16_t length)
+{
+    if (offset != NO_OFFSET)
+    {
+        sectorLive_[offset / SECTOR_SIZE] -= entrySize(length);
+    }
+}
+
+void PresetLogStore::applyStaged(
+    uint32_t &offset, uint16_t &length, bool &backup, uint32_t stagedOffset, uint16_t stagedLength)
+{
+    bool isBackup = backup;
+    backup = false;
+    if (stagedOffset == NO_OFFSET)
+    {
+        return;
+    }
+    // Same outcome as replaying the log: backups no longer count, otherwise the entry latest in the log wins
+    if (offset == NO_OFFSET || isBackup || isLater(stagedOffset, offset))
+    {
+        releaseEntry(offset, length);
+        offset = stagedOffset;
+        length = stagedLength;
+    }
+    else
+    {
+        releaseEntry(stagedOffset, stagedLength);
+    }
+}
+
+bool PresetLogStore::isLater(uint32_t offset, uint32_t otherOffset) const
+{
+    uint32_t sequence = sectorSequence_[offset / SECTOR_SIZE];
+    uint32_t otherSequence = sectorSequence_[otherOffset / SECTOR_SIZE];
+    return sequence != otherSequence ? sequence > otherSequence : offset > otherOffset;
+}
+
+void PresetLogStore::noteTransaction(uint16_t sector, uint16_t transaction)
+{
+    if (sector != NO_SECTOR &&
+        (sectorTransaction_[sector] == NO_TRANSACTION || isNewerTransaction(sectorTransaction_[sector], transaction)))
+    {
+        sectorTransaction_[sector] = transaction;
+    }
+    uint16_t next = (transaction + 1) % TRANSACTION_IDS;
+    if (nextTransaction_ == NO_TRANSACTION || isNewerTransaction(next, nextTransaction_))
+    {
+        nextTransaction_ = next;
+    }
+}
+
+// How many ids transaction was handed out before newer
+uint16_t PresetLogStore::transactionAge(uint16_t transaction, uint16_t newer)
+{
+    return (newer + TRANSACTION_IDS - transaction) % TRANSACTION_IDS;
+}
+
+// Serial number comparison, only meaningful for ids within half of TRANSACTION_IDS of each other
+bool PresetLogStore::isNewerTransaction(uint16_t transaction, uint16_t other)
+{
+    uint16_t age = transactionAge(other, transaction);
+    return age != 0 && age < TRANSACTION_IDS / 2;
+}
+
+PresetLogStore::Stats PresetLogStore::getStats() const
+{
+    Stats stats = {};
+    stats.totalSectors = numSectors_;
+    for (uint16_t sector = 0; sector < numSectors_; sector++)
+    {
+        if (sectorSequence_[sector] == 0)
+        {
+            stats.freeSectors++;
+            continue;
+        }
+        stats.usedBytes += sectorUsed_[sector] - SECTOR_HEADER_SIZE;
+        stats.liveBytes += sectorLive_[sector];
+    }
+    stats.compactions = compactions_;
+    stats.entriesScanned = entriesScanned_;
+    stats.bootScanUs = bootScanUs_;
+    return stats;
+}
+
+uint32_t PresetLogStore::sectorHeaderCrc(const SectorHeader &header)
+{
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&header), offsetof(SectorHeader, crc));
+}
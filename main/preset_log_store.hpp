@@ -0,0 +1,199 @@
+#pragma once
+
+#include "dmx_preset_record.hpp"
+#include "dmx_presets.hpp"
+#include <esp_err.h>
+#include <esp_partition.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Append-only preset store on a raw data partition. Every write appends an entry to the head sector; an in-RAM
+// index maps each preset to its latest entry, so a read is a single flash read. Sectors whose entries have been
+// superseded are compacted (live entries copied to the head, sector erased) in the background.
+//
+// Sector layout: header (magic, sequence, CRC), then entries, 4-byte aligned:
+//   uint8  magic (ENTRY_MAGIC)
+//   uint8  type (ENTRY_PRESET, ENTRY_COUNT or ENTRY_COMMIT)
+//   uint8  id (preset index)
+//   uint8  commit (0xFF while written, COMMITTED once the payload is complete, STAGED in a transaction)
+//   uint16 payload length
+//   uint16 transaction (NO_TRANSACTION outside a transaction, BACKUP_OF | id for a backup)
+//   payload (a DmxPresetRecord, the number of presets, or the uint16 id of a committed transaction)
+// The commit byte is programmed last, so an entry torn by a power cut is never used.
+//
+// A transaction stages a whole show next to the current one: its entries carry the transaction id and only count
+// once a commit entry with that id (or a later one) is in the log, so writing the commit entry switches from the old
+// to the new show in one step. Entries of a transaction that never committed (aborted, or cut short by a power loss)
+// are discarded by clearing their commit byte, on abort or at the next init. Compaction keeps the latest commit
+// entry. Transaction ids wrap around and are compared as serial numbers, which holds while every id in the log is
+// within TRANSACTION_WINDOW of the next one: beginTransaction() compacts a sector holding an older id, which rewrites
+// its surviving entries without one, and commits an empty transaction when the latest commit is older. Entries
+// written outside the transaction while it is open stay valid; per preset the entry latest in the log wins, both at
+// commit and when the log is scanned. Compaction would move a current entry that a staged one replaces behind it, so
+// such a copy is written as a backup: it only counts while its transaction is not committed, and is rewritten as a
+// normal entry when the transaction is aborted or unfinished.
+//
+// The partition is memory mapped, so presets are decoded straight from flash (the flash driver invalidates the cache
+// for written and erased ranges). Only esp_partition_* calls are used, so the store also runs on the linux target,
+// where the mapping is the file-backed flash image; without a mapping it falls back to flash reads.
+// Not thread safe: the owner serializes access, also while it uses a mapped record.
+class PresetLogStore
+{
+  public:
+    struct Stats
+    {
+        uint32_t totalSectors;
+        uint32_t freeSectors;
+        uint32_t usedBytes; // Bytes of all entries, including superseded ones
+        uint32_t liveBytes; // Bytes of the latest entries
+        uint32_t compactions;
+        uint32_t entriesScanned;
+        uint32_t bootScanUs;
+    };
+
+    PresetLogStore();
+    ~PresetLogStore();
+
+    // Find the partition and build the index from the entry headers
+    esp_err_t init(const char *partitionLabel);
+    bool isOpen() const { return partition_ != nullptr; }
+
+    // Flash bytes taken by an entry with a payload of the given length
+    static uint32_t entrySize(uint16_t length) { return (ENTRY_HEADER_SIZE + length + 3) & ~3UL; }
+
+    bool hasPreset(uint8_t index) const { return index < MAX_PRESETS && presetOffset_[index] != NO_OFFSET; }
+
+    // Read the latest record of a preset
+    esp_err_t readPreset(uint8_t index, uint8_t *record, size_t capacity, size_t &size) const;
+
+    // Latest record of a preset in mapped flash, valid until the next write or compaction;
+    // ESP_ERR_NOT_SUPPORTED if the partition is not mapped
+    esp_err_t mapPreset(uint8_t index, const uint8_t *&record, size_t &size) const;
+
+    // Append a preset record; compacts first when the log is full
+    esp_err_t writePreset(uint8_t index, const uint8_t *record, size_t size);
+
+    // Number of presets, 0 if never written
+    uint8_t getNumberOfPresets() const { return numberOfPresets_; }
+    esp_err_t writeNumberOfPresets(uint8_t numberOfPresets);
+
+    // Stage presets and the number of presets in a transaction; readers keep seeing the current show until
+    // commitTransaction(). One transaction at a time; the staged entries need room in the log next to the current ones.
+    esp_err_t beginTransaction();
+    esp_err_t stagePreset(uint8_t index, const uint8_t *record, size_t size);
+    esp_err_t stageNumberOfPresets(uint8_t numberOfPresets);
+    esp_err_t commitTransaction();
+    void abortTransaction();
+    bool isTransactionOpen() const { return openTransaction_ != NO_TRANSACTION; }
+
+    // Compaction is worthwhile when free sectors run low and some sector holds superseded entries
+    bool needsCompaction() const;
+
+    // Compact a single sector (erases one flash sector, so it takes tens of milliseconds)
+    esp_err_t compact();
+
+    Stats getStats() const;
+
+  private:
+    static const uint32_t SECTOR_SIZE = 4096;
+    static const uint32_t MAX_SECTORS = 128;
+    static const uint32_t SECTOR_HEADER_SIZE = 16;
+    static const uint32_t ENTRY_HEADER_SIZE = 8;
+    static const uint32_t SECTOR_MAGIC = 0x31474C50; // "PLG1"
+    static const uint8_t ENTRY_MAGIC = 0xA5;
+    static const uint8_t ENTRY_PRESET = 1;
+    static const uint8_t ENTRY_COUNT = 2;
+    static const uint8_t ENTRY_COMMIT = 3;
+    static const uint8_t COMMITTED = 0x00;
+    static const uint8_t STAGED = 0x0F;    // Complete entry of a transaction
+    static const uint8_t DISCARDED = 0x00; // STAGED entry of a transaction that never committed
+    static const uint16_t NO_TRANSACTION = 0xFFFF;
+    static const uint16_t BACKUP_OF = 0x8000; // Flag in the transaction field, ids stay below it
+    // Ids run from 0 to 0x7FFE and wrap around; BACKUP_OF | 0x7FFF would be NO_TRANSACTION
+    static const uint16_t TRANSACTION_IDS = 0x7FFF;
+    static const uint16_t TRANSACTION_WINDOW = 0x2000; // Less than half of TRANSACTION_IDS
+    static const uint32_t NO_OFFSET = 0xFFFFFFFF;
+    static const uint16_t NO_SECTOR = 0xFFFF;
+    static const uint32_t COMPACTION_FREE_SECTORS = 4; // Compact in the background below this
+    // Kept free for compaction; two, so a power cut during a compaction still leaves one for the next
+    static const uint32_t RESERVED_FREE_SECTORS = 2;
+
+    enum IndexTarget
+    {
+        INDEX_CURRENT,
+        INDEX_STAGED,
+        INDEX_BACKUP
+    };
+
+    struct SectorHeader
+    {
+        uint32_t magic;
+        uint32_t sequence;
+        uint32_t crc;
+        uint32_t reserved;
+    };
+
+    struct EntryHeader
+    {
+        uint8_t magic;
+        uint8_t type;
+        uint8_t id;
+        uint8_t commit;
+        uint16_t length;
+        uint16_t transaction;
+    };
+
+    const esp_partition_t *partition_;
+    const uint8_t *mapped_; // nullptr if the partition could not be mapped
+    esp_partition_mmap_handle_t mmapHandle_;
+    uint16_t numSectors_;
+    uint32_t sectorSequence_[MAX_SECTORS]; // 0 = erased
+    uint16_t sectorUsed_[MAX_SECTORS];     // End of the last entry, SECTOR_SIZE once a sector is closed
+    uint16_t sectorLive_[MAX_SECTORS];     // Bytes of entries still referenced by the index
+    uint16_t sectorTransaction_[MAX_SECTORS]; // Oldest transaction id in the sector, NO_TRANSACTION if none
+    uint16_t headSector_;
+    uint32_t nextSequence_;
+    uint32_t presetOffset_[MAX_PRESETS]; // Entry offset in the partition
+    uint16_t presetLength_[MAX_PRESETS];
+    uint32_t countOffset_;
+    uint8_t numberOfPresets_;
+    bool presetBackup_[MAX_PRESETS]; // Index points to a backup, to be rewritten if the transaction does not commit
+    bool countBackup_;
+    uint16_t openTransaction_;      // NO_TRANSACTION if none is open
+    uint16_t nextTransaction_;      // Newer than every id in the log
+    uint16_t committedTransaction_; // Latest committed id, 0 if none
+    uint32_t commitOffset_;
+    uint32_t stagedOffset_[MAX_PRESETS]; // Entries of the open transaction
+    uint16_t stagedLength_[MAX_PRESETS];
+    uint32_t stagedCountOffset_;
+    uint8_t stagedNumberOfPresets_;
+    bool compacting_;
+    uint32_t compactions_;
+    uint32_t entriesScanned_;
+    uint32_t bootScanUs_;
+    uint8_t copyBuffer_[DmxPresetRecord::MAX_SIZE];
+
+    esp_err_t read(uint32_t offset, void *data, size_t length) const;
+    esp_err_t scanSector(uint16_t sector, bool indexing);
+    esp_err_t appendEntry(uint8_t type, uint8_t id, const uint8_t *payload, uint16_t length, uint16_t transaction);
+    esp_err_t discardEntry(uint32_t offset);
+    esp_err_t makeRoom(uint32_t size);
+    esp_err_t reserveFreeSector();
+    esp_err_t copyEntry(uint8_t type, uint8_t id, bool staged, uint16_t transaction);
+    esp_err_t rewriteBackups();
+    esp_err_t openSector();
+    esp_err_t eraseSector(uint16_t sector);
+    esp_err_t compactSector(uint16_t sector);
+    esp_err_t retireOldTransactions();
+    void noteTransaction(uint16_t sector, uint16_t transaction);
+    uint16_t countFreeSectors() const;
+    int findCompactionVictim() const;
+    void indexEntry(
+        uint8_t type, uint8_t id, uint32_t offset, uint16_t length, const uint8_t *payload, IndexTarget target);
+    void releaseEntry(uint32_t offset, uint16_t length);
+    void applyStaged(uint32_t &offset, uint16_t &length, bool &backup, uint32_t stagedOffset, uint16_t stagedLength);
+    bool isLater(uint32_t offset, uint32_t otherOffset) const;
+    static uint16_t transactionAge(uint16_t transaction, uint16_t newer);
+    static bool isNewerTransaction(uint16_t transaction, uint16_t other);
+    static uint32_t sectorHeaderCrc(const SectorHeader &header);
+};
@@ -0,0 +1,167 @@
+#include "resume_log.hpp"
+#include <cstring>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+
+static const char *LOG_TAG = "ResumeLog";
+
+ResumeLog::ResumeLog() : partition_(nullptr), writeOffset_(0), sequence_(0), writes_(0)
+{
+    memset(&state_, 0, sizeof(state_));
+}
+
+esp_err_t ResumeLog::init(const char *partitionLabel)
+{
+    partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, partitionLabel);
+    if (!partition_ || partition_->size < NUM_SECTORS * SECTOR_SIZE)
+    {
+        ESP_LOGE(LOG_TAG, "Partition '%s' not found or smaller than %d bytes", partitionLabel,
+            (int)(NUM_SECTORS * SECTOR_SIZE));
+        partition_ = nullptr;
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    // Find the latest valid record and the last used slot of the sector holding it
+    size_t latestOffset = 0;
+    size_t lastUsed[NUM_SECTORS] = {};
+    bool used[NUM_SECTORS] = {};
+    Record records[SCAN_CHUNK_RECORDS];
+    for (size_t offset = 0; offset < NUM_SECTORS * SECTOR_SIZE; offset += sizeof(records))
+    {
+        esp_err_t err = esp_partition_read(partition_, offset, records, sizeof(records));
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(LOG_TAG, "Failed to read partition: %s", esp_err_to_name(err));
+            return err;
+        }
+
+        for (size_t i = 0; i < SCAN_CHUNK_RECORDS; i++)
+        {
+            const Record &record = records[i];
+            size_t recordOffset = offset + i * RECORD_SIZE;
+            if (isErased(record))
+            {
+                continue;
+            }
+
+            size_t sector = recordOffset / SECTOR_SIZE;
+            used[sector] = true;
+            lastUsed[sector] = recordOffset;
+            if (record.crc == recordCrc(record) && record.sequence != 0xFFFFFFFF && record.sequence > sequence_)
+            {
+                sequence_ = record.sequence;
+                latestOffset = recordOffset;
+                state_.presetIndex = record.presetIndex;
+            }
+        }
+    }
+
+    if (sequence_ == 0)
+    {
+        // Blank, or only torn or foreign data: start over
+        for (size_t sector = 0; sector < NUM_SECTORS; sector++)
+        {
+            if (used[sector] && eraseSector(sector) != ESP_OK)
+            {
+                return ESP_FAIL;
+            }
+        }
+        writeOffset_ = 0;
+        ESP_LOGI(LOG_TAG, "No resume state stored");
+        return ESP_OK;
+    }
+
+    // Continue after the last used slot of the active sector (a torn slot cannot be rewritten)
+    size_t activeSector = latestOffset / SECTOR_SIZE;
+    writeOffset_ = lastUsed[activeSector] + RECORD_SIZE;
+    if (writeOffset_ == (activeSector + 1) * SECTOR_SIZE)
+    {
+        writeOffset_ = ((activeSector + 1) % NUM_SECTORS) * SECTOR_SIZE;
+    }
+
+    // The sector that will be written next must be erased, it may still hold old records or a torn erase
+    size_t nextSector = writeOffset_ / SECTOR_SIZE;
+    if (nextSector != activeSector && used[nextSector] && eraseSector(nextSector) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    ESP_LOGI(LOG_TAG, "Resume state: preset %d (record %lu)", state_.presetIndex, (unsigned long)sequence_);
+    return ESP_OK;
+}
+
+esp_err_t ResumeLog::read(State &state) const
+{
+    if (sequence_ == 0)
+    {
+        return ESP_ERR_NOT_FOUND;
+    }
+    state = state_;
+    return ESP_OK;
+}
+
+esp_err_t ResumeLog::write(const State &state)
+{
+    if (!partition_)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+    if (sequence_ != 0 && state.presetIndex == state_.presetIndex)
+    {
+        return ESP_OK;
+    }
+
+    Record record;
+    memset(&record, 0xFF, sizeof(record));
+    record.sequence = sequence_ + 1;
+    record.presetIndex = state.presetIndex;
+    record.crc = recordCrc(record);
+
+    esp_err_t err = esp_partition_write(partition_, writeOffset_, &record, sizeof(record));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to write record at 0x%x: %s", (unsigned)writeOffset_, esp_err_to_name(err));
+        return err;
+    }
+    sequence_ = record.sequence;
+    state_ = state;
+    writes_++;
+
+    // When a sector is full, erase the other one right away so the next write does not have to wait for it.
+    // Its records are older than all records in the full sector, so a power cut during the erase loses nothing.
+    writeOffset_ += RECORD_SIZE;
+    if (writeOffset_ % SECTOR_SIZE == 0)
+    {
+        writeOffset_ %= NUM_SECTORS * SECTOR_SIZE;
+        err = eraseSector(writeOffset_ / SECTOR_SIZE);
+    }
+    return err;
+}
+
+esp_err_t ResumeLog::eraseSector(size_t sector)
+{
+    esp_err_t err = esp_partition_erase_range(partition_, sector * SECTOR_SIZE, SECTOR_SIZE);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(LOG_TAG, "Failed to erase sector %d: %s", (int)sector, esp_err_to_name(err));
+    }
+    return err;
+}
+
+uint32_t ResumeLog::recordCrc(const Record &record)
+{
+    return esp_rom_crc32_le(0, reinterpret_cast<const uint8_t *>(&record), offsetof(Record, crc));
+}
+
+bool ResumeLog::isErased(const Record &record)
+{
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(&record);
+    for (size_t i = 0; i < sizeof(record); i++)
+    {
+        if (bytes[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
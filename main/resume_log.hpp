@@ -0,0 +1,60 @@
+#pragma once
+
+#include <esp_err.h>
+#include <esp_partition.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Wear-levelled ring of small records in a raw data partition, holding the state needed to resume a show after a
+// power cut (currently the active preset index). Every change appends one record without an NVS commit; a flash
+// sector is only erased once the other one is full. Records with a bad CRC (torn writes) are skipped.
+class ResumeLog
+{
+  public:
+    struct State
+    {
+        uint8_t presetIndex;
+    };
+
+    ResumeLog();
+
+    // Find the partition and the latest record; erases sectors that cannot be used
+    esp_err_t init(const char *partitionLabel);
+
+    // Latest stored state, ESP_ERR_NOT_FOUND if nothing has been stored yet
+    esp_err_t read(State &state) const;
+
+    // Append a record (nothing is written if the state did not change)
+    esp_err_t write(const State &state);
+
+    // Records written since boot, for diagnostics
+    uint32_t getWrites() const { return writes_; }
+
+  private:
+    static const size_t RECORD_SIZE = 16;
+    static const size_t SECTOR_SIZE = 4096;
+    static const size_t NUM_SECTORS = 2;
+    static const size_t RECORDS_PER_SECTOR = SECTOR_SIZE / RECORD_SIZE;
+    static const size_t SCAN_CHUNK_RECORDS = 16;
+
+    // Layout (little endian): sequence, preset index, 7 reserved bytes (0xFF), CRC32 over the first 12 bytes.
+    // An erased slot reads as all 0xFF; sequence 0xFFFFFFFF is never written.
+    struct Record
+    {
+        uint32_t sequence;
+        uint8_t presetIndex;
+        uint8_t reserved[7];
+        uint32_t crc;
+    };
+    static_assert(sizeof(Record) == RECORD_SIZE, "Record must fill a slot");
+
+    const esp_partition_t *partition_;
+    size_t writeOffset_; // Next free slot
+    uint32_t sequence_;  // Sequence of the latest valid record, 0 if none
+    State state_;
+    uint32_t writes_;
+
+    esp_err_t eraseSector(size_t sector);
+    static uint32_t recordCrc(const Record &record);
+    static bool isErased(const Record &record);
+};
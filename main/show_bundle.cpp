@@ -0,0 +1,185 @@
+#include "show_bundle.hpp"
+#include <cstring>
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+
+static const char *LOG_TAG = "ShowBundle";
+
+static void writeUint16(uint8_t *data, uint16_t value)
+{
+    data[0] = value & 0xFF;
+    data[1] = value >> 8;
+}
+
+static void writeUint32(uint8_t *data, uint32_t value)
+{
+    writeUint16(data, value & 0xFFFF);
+    writeUint16(data + 2, value >> 16);
+}
+
+static uint16_t readUint16(const uint8_t *data) { return data[0] | (data[1] << 8); }
+
+static uint32_t readUint32(const uint8_t *data) { return readUint16(data) | ((uint32_t)readUint16(data + 2) << 16); }
+
+void ShowBundle::encodeConfiguration(const Messages::ConfigurationEventData &config, uint8_t *out)
+{
+    out[0] = config.switchPolarityInverted;
+    writeUint16(out + 1, config.longPressThresholdMs);
+    writeUint16(out + 3, config.commitWindowMs);
+}
+
+esp_err_t ShowBundle::decodeConfiguration(
+    const uint8_t *payload, uint16_t length, Messages::ConfigurationEventData &config)
+{
+    // Newer files may append fields
+    if (!payload || length < CONFIGURATION_SIZE)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    config.switchPolarityInverted = payload[0] != 0;
+    config.longPressThresholdMs = readUint16(payload + 1);
+    config.commitWindowMs = readUint16(payload + 3);
+    return ESP_OK;
+}
+
+size_t ShowBundleWriter::writeHeader(uint8_t *out, size_t capacity)
+{
+    if (!out || capacity < ShowBundle::HEADER_SIZE)
+    {
+        return 0;
+    }
+
+    writeUint32(out, ShowBundle::MAGIC);
+    out[4] = ShowBundle::VERSION;
+    memset(out + 5, 0, ShowBundle::HEADER_SIZE - 5);
+    crc_ = esp_rom_crc32_le(0, out, ShowBundle::HEADER_SIZE);
+    return ShowBundle::HEADER_SIZE;
+}
+
+size_t ShowBundleWriter::writeRecord(
+    uint8_t type, uint8_t id, const uint8_t *payload, uint16_t length, uint8_t *out, size_t capacity)
+{
+    size_t size = ShowBundle::RECORD_HEADER_SIZE + length;
+    if (!out || (length > 0 && !payload) || length > ShowBundle::MAX_PAYLOAD_SIZE || size > capacity)
+    {
+        return 0;
+    }
+
+    out[0] = type;
+    out[1] = id;
+    writeUint16(out + 2, length);
+    memcpy(out + ShowBundle::RECORD_HEADER_SIZE, payload, length);
+    crc_ = esp_rom_crc32_le(crc_, out, size);
+    return size;
+}
+
+size_t ShowBundleWriter::writeEnd(uint8_t *out, size_t capacity)
+{
+    uint8_t crc[4];
+    writeUint32(crc, crc_);
+    return writeRecord(ShowBundle::END, 0, crc, sizeof(crc), out, capacity);
+}
+
+ShowBundleReader::ShowBundleReader(Handler &handler)
+    : handler_(handler), state_(READING_HEADER), crc_(0), needed_(ShowBundle::HEADER_SIZE), filled_(0)
+{
+}
+
+esp_err_t ShowBundleReader::feed(const uint8_t *data, size_t length)
+{
+    if (state_ == FAILED)
+    {
+        return ESP_FAIL;
+    }
+
+    while (length > 0)
+    {
+        if (state_ == COMPLETE)
+        {
+            return fail(ESP_ERR_INVALID_SIZE, "data after the end record");
+        }
+
+        size_t count = needed_ - filled_ < length ? needed_ - filled_ : length;
+        memcpy(buffer_ + filled_, data, count);
+        filled_ += count;
+        data += count;
+        length -= count;
+
+        if (filled_ == needed_)
+        {
+            esp_err_t err = handlePart();
+            if (err != ESP_OK)
+            {
+                return err;
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t ShowBundleReader::handlePart()
+{
+    switch (state_)
+    {
+    case READING_HEADER:
+        if (readUint32(buffer_) != ShowBundle::MAGIC || buffer_[4] != ShowBundle::VERSION)
+        {
+            return fail(ESP_ERR_INVALID_VERSION, "not a show file of a supported version");
+        }
+        crc_ = esp_rom_crc32_le(0, buffer_, ShowBundle::HEADER_SIZE);
+        state_ = READING_RECORD_HEADER;
+        needed_ = ShowBundle::RECORD_HEADER_SIZE;
+        filled_ = 0;
+        return ESP_OK;
+
+    case READING_RECORD_HEADER:
+    {
+        uint16_t length = readUint16(buffer_ + 2);
+        if (length > ShowBundle::MAX_PAYLOAD_SIZE)
+        {
+            return fail(ESP_ERR_INVALID_SIZE, "record too large");
+        }
+        state_ = READING_PAYLOAD;
+        needed_ = ShowBundle::RECORD_HEADER_SIZE + length;
+        // A record without payload is complete already
+        return needed_ == filled_ ? handlePart() : ESP_OK;
+    }
+
+    case READING_PAYLOAD:
+    {
+        uint8_t type = buffer_[0];
+        uint16_t length = needed_ - ShowBundle::RECORD_HEADER_SIZE;
+        const uint8_t *payload = buffer_ + ShowBundle::RECORD_HEADER_SIZE;
+        if (type == ShowBundle::END)
+        {
+            if (length != 4 || readUint32(payload) != crc_)
+            {
+                return fail(ESP_ERR_INVALID_CRC, "CRC mismatch");
+            }
+            state_ = COMPLETE;
+            return ESP_OK;
+        }
+
+        esp_err_t err = handler_.onRecord(type, buffer_[1], payload, length);
+        if (err != ESP_OK)
+        {
+            return fail(err, "record rejected");
+        }
+        crc_ = esp_rom_crc32_le(crc_, buffer_, needed_);
+        state_ = READING_RECORD_HEADER;
+        needed_ = ShowBundle::RECORD_HEADER_SIZE;
+        filled_ = 0;
+        return ESP_OK;
+    }
+
+    default:
+        return ESP_FAIL;
+    }
+}
+
+esp_err_t ShowBundleReader::fail(esp_err_t err, const char *reason)
+{
+    ESP_LOGE(LOG_TAG, "Invalid show file: %s", reason);
+    state_ = FAILED;
+    return err;
+}
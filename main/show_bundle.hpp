@@ -0,0 +1,97 @@
+#pragma once
+
+#include "dmx_preset_record.hpp"
+#include "messages.hpp"
+#include <esp_err.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary show file, written and read one record at a time so a show of any size needs constant memory.
+// Layout (little endian):
+//   uint32 magic (MAGIC), uint8 version (VERSION), 3 reserved bytes (0)
+//   records: uint8 type, uint8 id, uint16 payload length, payload
+//     CONFIGURATION: uint8 switchPolarityInverted, uint16 longPressThresholdMs, uint16 commitWindowMs
+//     PRESET_COUNT:  uint8 number of presets
+//     PRESET:        id = preset index, payload = DmxPresetRecord (has its own CRC)
+//     END:           uint32 CRC32 over all preceding bytes of the file, always the last record
+// Readers skip record types they do not know, so newer files (e.g. with curves) can still be imported.
+class ShowBundle
+{
+  public:
+    static const uint32_t MAGIC = 0x53584D44; // "DMXS"
+    static const uint8_t VERSION = 1;
+    static const size_t HEADER_SIZE = 8;
+    static const size_t RECORD_HEADER_SIZE = 4;
+    static const size_t MAX_PAYLOAD_SIZE = DmxPresetRecord::MAX_SIZE;
+    static const size_t MAX_RECORD_SIZE = RECORD_HEADER_SIZE + MAX_PAYLOAD_SIZE;
+
+    enum RecordType
+    {
+        CONFIGURATION = 1,
+        PRESET_COUNT = 2,
+        PRESET = 3,
+        END = 0xFF
+    };
+    static const size_t CONFIGURATION_SIZE = 5;
+
+    static void encodeConfiguration(const Messages::ConfigurationEventData &config, uint8_t *out);
+    static esp_err_t decodeConfiguration(
+        const uint8_t *payload, uint16_t length, Messages::ConfigurationEventData &config);
+};
+
+// Produces a show file into caller buffers: header, then one record per call, then the end record
+class ShowBundleWriter
+{
+  public:
+    ShowBundleWriter() : crc_(0) {}
+
+    // Each returns the number of bytes written to out, 0 if the record does not fit in capacity
+    size_t writeHeader(uint8_t *out, size_t capacity);
+    size_t writeRecord(uint8_t type, uint8_t id, const uint8_t *payload, uint16_t length, uint8_t *out,
+        size_t capacity);
+    size_t writeEnd(uint8_t *out, size_t capacity);
+
+  private:
+    uint32_t crc_;
+};
+
+// Parses a show file fed in pieces of any size and hands every complete record to a handler
+class ShowBundleReader
+{
+  public:
+    class Handler
+    {
+      public:
+        virtual ~Handler() {}
+        // Called for every record except END; an error stops reading
+        virtual esp_err_t onRecord(uint8_t type, uint8_t id, const uint8_t *payload, uint16_t length) = 0;
+    };
+
+    explicit ShowBundleReader(Handler &handler);
+
+    // Parse the next piece of the file; an error is final
+    esp_err_t feed(const uint8_t *data, size_t length);
+
+    // True once the end record has been read and its CRC matched
+    bool isComplete() const { return state_ == COMPLETE; }
+
+  private:
+    enum State
+    {
+        READING_HEADER,
+        READING_RECORD_HEADER,
+        READING_PAYLOAD,
+        COMPLETE,
+        FAILED
+    };
+
+    Handler &handler_;
+    State state_;
+    uint32_t crc_;  // Over all bytes before the current record
+    size_t needed_; // Bytes the current part needs in buffer_
+    size_t filled_;
+    uint8_t buffer_[ShowBundle::MAX_RECORD_SIZE];
+
+    esp_err_t handlePart();
+    esp_err_t fail(esp_err_t err, const char *reason);
+};
@@ -1,10 +1,20 @@
 #include "web_server.hpp"
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <lwip/sockets.h>
 
+#include "dmx_curves.hpp"
+#include "dmx_effects.hpp"
+#include "dmx_layer_stack.hpp"
+#include "dmx_masters.hpp"
 #include "foot_switch.hpp"
+#include "json_stream_writer.hpp"
+#include "show_bundle.hpp"
 #include <cJSON.h>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
-#include <esp_spiffs.h>
+#include <memory>
 #include <vector>
 
 static const char *TAG = "WebServer";
@@ -211,10 +221,33 @@ class DMXController {
 const app = new DMXController();
 )js";
 
-WebServer::WebServer() : server_(nullptr)
+WebServer::WebServer()
+    : server_(nullptr), initialized_(false), dmxControllerEventQueue_(nullptr), liveOverrides_(nullptr),
+      storage_(nullptr), stateMutex_(xSemaphoreCreateMutex()), selectedPreset_(0), numberOfPresets_(0),
+      configuration_(), statePushQueued_(false), stateBacklog_(false)
 {
     instance_ = this;
-    eventQueue_ = xQueueCreate(4, sizeof(WebServerEvent));
+    for (StateClient &client : stateClients_)
+    {
+        client.socket = -1;
+    }
+    for (TaskHandle_t &worker : asyncWorkers_)
+    {
+        worker = nullptr;
+    }
+    asyncQueue_ = xQueueCreate(ASYNC_QUEUE_CAPACITY, sizeof(AsyncRequest));
+    if (asyncQueue_)
+    {
+        for (TaskHandle_t &worker : asyncWorkers_)
+        {
+            if (xTaskCreate(asyncWorkerEntry, "WebServerWorker", 4096, this, ASYNC_WORKER_PRIORITY, &worker) != pdPASS)
+            {
+                ESP_LOGE(TAG, "Failed to create WebServer worker");
+                worker = nullptr;
+            }
+        }
+    }
+    eventQueue_ = xQueueCreate(EVENT_QUEUE_CAPACITY, sizeof(WebServerEvent));
     if (eventQueue_)
     {
         xTaskCreate(taskEntry, "WebServerTask", 4096, this, 5, &taskHandle_);
@@ -236,24 +269,110 @@ WebServer::~WebServer()
     {
         vQueueDelete(eventQueue_);
     }
+    for (TaskHandle_t worker : asyncWorkers_)
+    {
+        if (worker)
+        {
+            vTaskDelete(worker);
+        }
+    }
+    if (asyncQueue_)
+    {
+        vQueueDelete(asyncQueue_);
+    }
+    if (stateMutex_)
+    {
+        vSemaphoreDelete(stateMutex_);
+    }
 }
 
 void WebServer::postEvent(const WebServerEvent &event)
 {
-    if (eventQueue_)
+    if (eventQueue_ && xQueueSend(eventQueue_, &event, 0) != pdPASS)
     {
-        xQueueSend(eventQueue_, &event, 0);
+        ESP_LOGW(TAG, "Event queue full, event %d dropped", event.type);
     }
 }
 
 void WebServer::taskEntry(void *param) { static_cast<WebServer *>(param)->taskLoop(); }
 
+void WebServer::asyncWorkerEntry(void *param) { static_cast<WebServer *>(param)->asyncWorkerLoop(); }
+
+void WebServer::asyncWorkerLoop()
+{
+    AsyncRequest request;
+    while (true)
+    {
+        if (xQueueReceive(asyncQueue_, &request, portMAX_DELAY) == pdTRUE)
+        {
+            // A handler failing here cannot have httpd close the connection by its return value
+            if (request.handler(request.req) != ESP_OK && server_)
+            {
+                httpd_sess_trigger_close(server_, httpd_req_to_sockfd(request.req));
+            }
+            esp_err_t err = httpd_req_async_handler_complete(request.req);
+            if (err != ESP_OK)
+            {
+                ESP_LOGE(TAG, "Failed to complete async request: %s", esp_err_to_name(err));
+            }
+        }
+    }
+}
+
+bool WebServer::is_async_worker() const
+{
+    TaskHandle_t current = xTaskGetCurrentTaskHandle();
+    for (TaskHandle_t worker : asyncWorkers_)
+    {
+        if (worker && worker == current)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Hands the request to a worker, which calls the handler again; the httpd task returns at once and serves the next
+// request. With every worker busy and the queue full the client is told to retry: better than stalling the API.
+esp_err_t WebServer::submit_async(httpd_req_t *req, RequestHandler handler)
+{
+    if (asyncQueue_ && uxQueueSpacesAvailable(asyncQueue_) > 0)
+    {
+        AsyncRequest request = {nullptr, handler};
+        esp_err_t err = httpd_req_async_handler_begin(req, &request.req);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to start async request: %s", esp_err_to_name(err));
+            return err;
+        }
+        // Only the httpd task queues, so the space checked above is still there
+        if (xQueueSend(asyncQueue_, &request, 0) == pdPASS)
+        {
+            return ESP_OK;
+        }
+        httpd_req_async_handler_complete(request.req);
+    }
+
+    ESP_LOGW(TAG, "All workers busy, %s refused", req->uri);
+    return send_busy_response(req, "Busy, retry later");
+}
+
 void WebServer::taskLoop()
 {
     WebServerEvent event;
     while (true)
     {
-        if (xQueueReceive(eventQueue_, &event, portMAX_DELAY) == pdTRUE)
+        // Frames a client could not take yet are sent on by pushing again, until the client takes them or times out
+        xSemaphoreTake(stateMutex_, portMAX_DELAY);
+        TickType_t wait = stateBacklog_ ? pdMS_TO_TICKS(STATE_RETRY_MS) : portMAX_DELAY;
+        xSemaphoreGive(stateMutex_);
+        if (xQueueReceive(eventQueue_, &event, wait) != pdTRUE)
+        {
+            xSemaphoreTake(stateMutex_, portMAX_DELAY);
+            queue_state_push();
+            xSemaphoreGive(stateMutex_);
+        }
+        else
         {
             switch (event.type)
             {
@@ -267,39 +386,380 @@ void WebServer::taskLoop()
                 stop();
                 start();
                 break;
+            default:
+                // State changes arrive in bursts (e.g. an import), merge them all before pushing
+                xSemaphoreTake(stateMutex_, portMAX_DELAY);
+                handle_state_event(event);
+                while (xQueueReceive(eventQueue_, &event, 0) == pdTRUE)
+                {
+                    if (event.type == START_SERVER || event.type == STOP_SERVER || event.type == RESTART_SERVER)
+                    {
+                        xQueueSendToFront(eventQueue_, &event, 0);
+                        break;
+                    }
+                    handle_state_event(event);
+                }
+                queue_state_push();
+                xSemaphoreGive(stateMutex_);
+                break;
             }
         }
     }
 }
 
-void WebServer::init_spiffs()
+// Records the change and marks it unsent for every /ws/state client; called with stateMutex_ taken
+void WebServer::handle_state_event(const WebServerEvent &event)
 {
-    esp_vfs_spiffs_conf_t conf = {
-        .base_path = "/spiffs", .partition_label = NULL, .max_files = 8, .format_if_mount_failed = true};
-    esp_err_t ret = esp_vfs_spiffs_register(&conf);
-    if (ret != ESP_OK)
+    switch (event.type)
+    {
+    case PRESET_SELECTED:
+        selectedPreset_ = event.data.presetNumber;
+        for (StateClient &client : stateClients_)
+        {
+            client.presetSelected = true;
+        }
+        break;
+
+    case PRESET_CHANGED:
+        for (StateClient &client : stateClients_)
+        {
+            client.changedPresets[event.data.presetNumber / 32] |= 1u << (event.data.presetNumber % 32);
+        }
+        break;
+
+    case PRESETS_CHANGED:
+        // Clients reload all presets, which includes the ones edited before
+        numberOfPresets_ = event.data.numberOfPresets;
+        for (StateClient &client : stateClients_)
+        {
+            client.presetsChanged = true;
+            memset(client.changedPresets, 0, sizeof(client.changedPresets));
+        }
+        break;
+
+    case CONFIGURATION_CHANGED:
+        configuration_ = event.data.configuration;
+        for (StateClient &client : stateClients_)
+        {
+            client.configurationChanged = true;
+        }
+        break;
+
+    case PRESET_EDIT_FAILED:
+    {
+        // Clients are told, and reload the preset to see what it holds
+        uint8_t presetNumber =
+            event.data.presetNumber == Messages::CURRENT_PRESET ? selectedPreset_ : event.data.presetNumber;
+        for (StateClient &client : stateClients_)
+        {
+            client.failedPresets[presetNumber / 32] |= 1u << (presetNumber % 32);
+            client.changedPresets[presetNumber / 32] |= 1u << (presetNumber % 32);
+        }
+    }
+    break;
+
+    case EDIT_FAILED:
+        for (StateClient &client : stateClients_)
+        {
+            client.editFailed = true;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+// Called by the /ws/state handler on the httpd task once the handshake is done
+void WebServer::register_state_client(int socket)
+{
+    xSemaphoreTake(stateMutex_, portMAX_DELAY);
+    StateClient *slot = nullptr;
+    for (StateClient &client : stateClients_)
+    {
+        if (client.socket < 0 || httpd_ws_get_fd_info(server_, client.socket) != HTTPD_WS_CLIENT_WEBSOCKET)
+        {
+            slot = &client;
+            break;
+        }
+    }
+    if (slot)
+    {
+        // A new client starts with the complete state
+        slot->socket = socket;
+        slot->frame.clear();
+        slot->frameSent = 0;
+        slot->stalledSinceUs = 0;
+        slot->editFailed = false;
+        memset(slot->changedPresets, 0, sizeof(slot->changedPresets));
+        memset(slot->failedPresets, 0, sizeof(slot->failedPresets));
+        slot->presetSelected = true;
+        slot->presetsChanged = true;
+        slot->configurationChanged = true;
+        queue_state_push();
+    }
+    xSemaphoreGive(stateMutex_);
+
+    if (!slot)
+    {
+        ESP_LOGW(TAG, "Too many state clients, closing socket %d", socket);
+        httpd_sess_trigger_close(server_, socket);
+    }
+}
+
+// Has the httpd task send the state: the sockets belong to it, sending from another task races with it. At most one
+// push is queued; changes made before it runs are part of it, later ones queue the next. Called with stateMutex_ taken.
+void WebServer::queue_state_push()
+{
+    if (statePushQueued_ || !server_)
+    {
+        return;
+    }
+    esp_err_t err = httpd_queue_work(server_, push_state_work, this);
+    if (err != ESP_OK)
     {
-        ESP_LOGE(TAG, "Failed to mount SPIFFS (%s)", esp_err_to_name(ret));
+        // The changes stay marked unsent and go out with the next one
+        ESP_LOGW(TAG, "Failed to queue state push: %s", esp_err_to_name(err));
+        return;
+    }
+    statePushQueued_ = true;
+}
+
+void WebServer::push_state_work(void *param) { static_cast<WebServer *>(param)->push_state(); }
+
+// Unmasked, unfragmented text frame, as a server sends it
+static void make_text_frame(const std::string &payload, std::string &frame)
+{
+    frame.clear();
+    frame.push_back((char)0x81); // FIN, text
+    if (payload.size() < 126)
+    {
+        frame.push_back((char)payload.size());
     }
     else
     {
-        ESP_LOGI(TAG, "SPIFFS mounted successfully");
+        // State messages stay far below 64 KB
+        frame.push_back((char)126);
+        frame.push_back((char)(payload.size() >> 8));
+        frame.push_back((char)(payload.size() & 0xFF));
+    }
+    frame.append(payload);
+}
+
+// Runs on the httpd task and never waits for a client: frames go out with non-blocking sends, and what a client's
+// socket cannot take now goes out with a later push. Frames are built with stateMutex_ taken, so the web server task
+// never waits for a client either. A client whose socket closed is dropped, one whose send fails or that takes
+// nothing for STATE_CLIENT_TIMEOUT_MS is also closed.
+void WebServer::push_state()
+{
+    int sockets[MAX_STATE_CLIENTS];
+    bool inFlight[MAX_STATE_CLIENTS];
+    xSemaphoreTake(stateMutex_, portMAX_DELAY);
+    statePushQueued_ = false;
+    for (size_t i = 0; i < MAX_STATE_CLIENTS; i++)
+    {
+        // Changes made while a frame is in flight are merged and go out in the frame after it
+        StateClient &client = stateClients_[i];
+        sockets[i] = client.socket;
+        inFlight[i] = !client.frame.empty();
+        std::string message;
+        if (sockets[i] >= 0 && !inFlight[i] && build_state_message(client, message))
+        {
+            make_text_frame(message, client.frame);
+            client.frameSent = 0;
+        }
+    }
+    xSemaphoreGive(stateMutex_);
+
+    bool backlog = false;
+    for (size_t i = 0; i < MAX_STATE_CLIENTS; i++)
+    {
+        if (sockets[i] < 0)
+        {
+            continue;
+        }
+        bool open = httpd_ws_get_fd_info(server_, sockets[i]) == HTTPD_WS_CLIENT_WEBSOCKET;
+        if (open && send_state_frame(stateClients_[i], sockets[i]) == ESP_OK)
+        {
+            // Once a frame that was in flight is done, another push sends what was merged meanwhile
+            backlog = backlog || inFlight[i] || !stateClients_[i].frame.empty();
+            continue;
+        }
+
+        ESP_LOGI(TAG, "State client on socket %d gone", sockets[i]);
+        xSemaphoreTake(stateMutex_, portMAX_DELAY);
+        if (stateClients_[i].socket == sockets[i])
+        {
+            stateClients_[i].socket = -1;
+        }
+        xSemaphoreGive(stateMutex_);
+        if (open)
+        {
+            httpd_sess_trigger_close(server_, sockets[i]);
+        }
+    }
+
+    xSemaphoreTake(stateMutex_, portMAX_DELAY);
+    stateBacklog_ = backlog;
+    xSemaphoreGive(stateMutex_);
+}
+
+static esp_err_t append_to_string(void *message, const char *data, size_t length)
+{
+    static_cast<std::string *>(message)->append(data, length);
+    return ESP_OK;
+}
+
+// One text frame with all unsent changes of the client, e.g.
+//   {"selected":3,"presets":20,"changed":[1,5],"config":{"switchPolarityInverted":false,...}}
+// Only the changed keys are present. "presets" means all presets were reloaded, "changed" lists edited presets
+// (fetch them with GET /api/presets/{i}). "failed" lists presets whose edit was lost after it had been answered (they
+// are in "changed" too) and "editFailed": true means an output, configuration or show change was lost that way. The
+// changes count as sent once the message is built; false if there are none. Called with stateMutex_ taken.
+bool WebServer::build_state_message(StateClient &client, std::string &message)
+{
+    bool changed = false;
+    bool failed = false;
+    for (uint16_t i = 0; i < sizeof(client.changedPresets) / sizeof(client.changedPresets[0]); i++)
+    {
+        changed = changed || client.changedPresets[i] != 0;
+        failed = failed || client.failedPresets[i] != 0;
+    }
+    if (!client.presetSelected && !client.presetsChanged && !client.configurationChanged && !client.editFailed &&
+        !changed)
+    {
+        return false;
+    }
+
+    JsonStreamWriter json(append_to_string, &message);
+    json.beginObject();
+    if (client.presetSelected)
+    {
+        json.key("selected");
+        json.number(selectedPreset_);
+    }
+    if (client.presetsChanged)
+    {
+        json.key("presets");
+        json.number(numberOfPresets_);
+    }
+    if (changed)
+    {
+        json.key("changed");
+        json.beginArray();
+        for (uint16_t index = 0; index < MAX_PRESETS; index++)
+        {
+            if (client.changedPresets[index / 32] & (1u << (index % 32)))
+            {
+                json.number(index);
+            }
+        }
+        json.endArray();
+    }
+    if (failed)
+    {
+        json.key("failed");
+        json.beginArray();
+        for (uint16_t index = 0; index < MAX_PRESETS; index++)
+        {
+            if (client.failedPresets[index / 32] & (1u << (index % 32)))
+            {
+                json.number(index);
+            }
+        }
+        json.endArray();
+    }
+    if (client.editFailed)
+    {
+        json.key("editFailed");
+        json.boolean(true);
+    }
+    if (client.configurationChanged)
+    {
+        json.key("config");
+        json.beginObject();
+        json.key("switchPolarityInverted");
+        json.boolean(configuration_.switchPolarityInverted);
+        json.key("longPressThresholdMs");
+        json.number(configuration_.longPressThresholdMs);
+        json.key("commitWindowMs");
+        json.number(configuration_.commitWindowMs);
+        json.endObject();
+    }
+    json.endObject();
+    json.flush();
+
+    client.presetSelected = false;
+    client.presetsChanged = false;
+    client.configurationChanged = false;
+    client.editFailed = false;
+    memset(client.changedPresets, 0, sizeof(client.changedPresets));
+    memset(client.failedPresets, 0, sizeof(client.failedPresets));
+    return true;
+}
+
+// Sends as much of the client's frame as its socket takes without waiting; ESP_OK also when some is left for later.
+// On the httpd task only.
+esp_err_t WebServer::send_state_frame(StateClient &client, int socket)
+{
+    if (client.frame.empty())
+    {
+        return ESP_OK;
+    }
+
+    int ret = httpd_socket_send(
+        server_, socket, client.frame.data() + client.frameSent, client.frame.size() - client.frameSent, MSG_DONTWAIT);
+    if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+    {
+        // Socket buffer full
+        int64_t now = esp_timer_get_time();
+        if (client.stalledSinceUs == 0)
+        {
+            client.stalledSinceUs = now;
+        }
+        else if (now - client.stalledSinceUs >= STATE_CLIENT_TIMEOUT_MS * 1000LL)
+        {
+            ESP_LOGW(TAG, "State client on socket %d stalled", socket);
+            return ESP_ERR_TIMEOUT;
+        }
+        return ESP_OK;
+    }
+    if (ret <= 0)
+    {
+        ESP_LOGW(TAG, "Failed to push state to socket %d: %d", socket, ret);
+        return ESP_FAIL;
+    }
+
+    client.stalledSinceUs = 0;
+    client.frameSent += ret;
+    if (client.frameSent == client.frame.size())
+    {
+        client.frame.clear();
+        client.frameSent = 0;
     }
+    return ESP_OK;
 }
 
-esp_err_t WebServer::init()
+esp_err_t WebServer::init(
+    QueueHandle_t dmxControllerEventQueue, LiveOverrides *liveOverrides, NvsStorage *storage)
 {
+    dmxControllerEventQueue_ = dmxControllerEventQueue;
+    liveOverrides_ = liveOverrides;
+    storage_ = storage;
+
     if (initialized_)
     {
         return ESP_OK;
     }
 
-    // Mount SPIFFS
-    init_spiffs();
+    // Without the pack the API still works
+    assets_.init("assets");
 
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.server_port = 80;
-    config.max_uri_handlers = 8;
+    config.max_uri_handlers = 24;
+    // Templates ending in * match any path with that prefix, e.g. /api/presets/{i} and the static files under /*
+    config.uri_match_fn = httpd_uri_match_wildcard;
 
     esp_err_t ret = httpd_start(&server_, &config);
     if (ret != ESP_OK)
@@ -320,6 +780,31 @@ esp_err_t WebServer::init()
         .uri = "/api/presets", .method = HTTP_POST, .handler = api_presets_handler, .user_ctx = nullptr};
     httpd_register_uri_handler(server_, &api_presets_post_uri);
 
+    httpd_uri_t api_preset_delta_post_uri = {
+        .uri = "/api/presets/delta", .method = HTTP_POST, .handler = api_preset_delta_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_preset_delta_post_uri);
+
+    // After /api/presets/delta, the first matching handler is used
+    httpd_uri_t api_preset_uri = {
+        .uri = "/api/presets/*", .method = HTTP_GET, .handler = api_preset_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_preset_uri);
+
+    httpd_uri_t api_preset_put_uri = {
+        .uri = "/api/presets/*", .method = HTTP_PUT, .handler = api_preset_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_preset_put_uri);
+
+    httpd_uri_t api_preset_delete_uri = {
+        .uri = "/api/presets/*", .method = HTTP_DELETE, .handler = api_preset_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_preset_delete_uri);
+
+    httpd_uri_t api_preset_patch_uri = {
+        .uri = "/api/presets/*", .method = HTTP_PATCH, .handler = api_preset_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_preset_patch_uri);
+
+    httpd_uri_t api_preset_recall_uri = {
+        .uri = "/api/presets/*", .method = HTTP_POST, .handler = api_preset_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_preset_recall_uri);
+
     httpd_uri_t api_config_uri = {
         .uri = "/api/config", .method = HTTP_GET, .handler = api_config_handler, .user_ctx = nullptr};
     httpd_register_uri_handler(server_, &api_config_uri);
@@ -328,6 +813,46 @@ esp_err_t WebServer::init()
         .uri = "/api/config", .method = HTTP_POST, .handler = api_config_handler, .user_ctx = nullptr};
     httpd_register_uri_handler(server_, &api_config_post_uri);
 
+    httpd_uri_t api_masters_post_uri = {
+        .uri = "/api/masters", .method = HTTP_POST, .handler = api_masters_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_masters_post_uri);
+
+    httpd_uri_t api_curves_post_uri = {
+        .uri = "/api/curves", .method = HTTP_POST, .handler = api_curves_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_curves_post_uri);
+
+    httpd_uri_t api_layers_post_uri = {
+        .uri = "/api/layers", .method = HTTP_POST, .handler = api_layers_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_layers_post_uri);
+
+    httpd_uri_t api_effects_post_uri = {
+        .uri = "/api/effects", .method = HTTP_POST, .handler = api_effects_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_effects_post_uri);
+
+    httpd_uri_t api_capture_post_uri = {
+        .uri = "/api/capture", .method = HTTP_POST, .handler = api_capture_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_capture_post_uri);
+
+    httpd_uri_t api_diagnostics_uri = {
+        .uri = "/api/diagnostics", .method = HTTP_GET, .handler = api_diagnostics_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_diagnostics_uri);
+
+    httpd_uri_t api_show_uri = {
+        .uri = "/api/show", .method = HTTP_GET, .handler = api_show_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_show_uri);
+
+    httpd_uri_t api_show_put_uri = {
+        .uri = "/api/show", .method = HTTP_PUT, .handler = api_show_handler, .user_ctx = nullptr};
+    httpd_register_uri_handler(server_, &api_show_put_uri);
+
+    httpd_uri_t ws_live_uri = {
+        .uri = "/ws/live", .method = HTTP_GET, .handler = ws_live_handler, .user_ctx = nullptr, .is_websocket = true};
+    httpd_register_uri_handler(server_, &ws_live_uri);
+
+    httpd_uri_t ws_state_uri = {
+        .uri = "/ws/state", .method = HTTP_GET, .handler = ws_state_handler, .user_ctx = nullptr, .is_websocket = true};
+    httpd_register_uri_handler(server_, &ws_state_uri);
+
     httpd_uri_t static_file_uri = {
         .uri = "/*", .method = HTTP_GET, .handler = static_file_handler, .user_ctx = nullptr};
     httpd_register_uri_handler(server_, &static_file_uri);
@@ -341,7 +866,7 @@ esp_err_t WebServer::start()
 {
     if (!initialized_)
     {
-        return init();
+        return init(dmxControllerEventQueue_, liveOverrides_, storage_);
     }
     return ESP_OK;
 }
@@ -353,35 +878,76 @@ esp_err_t WebServer::stop()
         httpd_stop(server_);
         server_ = nullptr;
         initialized_ = false;
+
+        // Work still queued on the stopped server is dropped with it
+        xSemaphoreTake(stateMutex_, portMAX_DELAY);
+        statePushQueued_ = false;
+        xSemaphoreGive(stateMutex_);
     }
     return ESP_OK;
 }
 
 esp_err_t WebServer::root_handler(httpd_req_t *req)
 {
-    if (!instance_)
+    // index.html, with the same caching as the other static files
+    return static_file_handler(req);
+}
+
+// The header (e.g. Accept, Content-Type) lists the media type
+static bool has_media_type(httpd_req_t *req, const char *field, const char *mediaType)
+{
+    // A longer value is truncated, the media types of interest come first
+    char value[128];
+    esp_err_t err = httpd_req_get_hdr_value_str(req, field, value, sizeof(value));
+    return (err == ESP_OK || err == ESP_ERR_HTTPD_RESULT_TRUNC) && strstr(value, mediaType) != nullptr;
+}
+
+// Without an Accept-Encoding header any coding is acceptable; "gzip;q=0" refuses gzip, "*" accepts it
+static bool accepts_gzip(httpd_req_t *req)
+{
+    char value[128];
+    esp_err_t err = httpd_req_get_hdr_value_str(req, "Accept-Encoding", value, sizeof(value));
+    if (err == ESP_ERR_NOT_FOUND)
     {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not initialized");
-        return ESP_FAIL;
+        return true;
     }
-    // Serve index.html from SPIFFS
-    const char *filepath = "/spiffs/index.html";
-    FILE *file = fopen(filepath, "r");
-    if (!file)
+    if (err != ESP_OK && err != ESP_ERR_HTTPD_RESULT_TRUNC)
     {
-        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "index.html not found");
-        return ESP_FAIL;
+        return false;
     }
-    httpd_resp_set_type(req, "text/html");
-    char buffer[1024];
-    size_t read_bytes;
-    while ((read_bytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    const char *coding = strstr(value, "gzip");
+    coding = coding ? coding : strchr(value, '*');
+    if (!coding)
     {
-        httpd_resp_send_chunk(req, buffer, read_bytes);
+        return false;
     }
-    fclose(file);
-    httpd_resp_send_chunk(req, NULL, 0);
-    return ESP_OK;
+    const char *end = strchr(coding, ',');
+    const char *quality = strstr(coding, "q=");
+    return !quality || (end && quality > end) || strtod(quality + 2, nullptr) > 0;
+}
+
+// JSON universes as arrays of numbers, or as strings with ?universes=base64 or ?universes=hex
+static esp_err_t get_universe_encoding(httpd_req_t *req, PresetJsonParser::UniverseEncoding &encoding)
+{
+    char query[64];
+    char value[16];
+    encoding = PresetJsonParser::UNIVERSE_ARRAY;
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) != ESP_OK ||
+        httpd_query_key_value(query, "universes", value, sizeof(value)) != ESP_OK || strcmp(value, "array") == 0)
+    {
+        return ESP_OK;
+    }
+    if (strcmp(value, "base64") == 0)
+    {
+        encoding = PresetJsonParser::UNIVERSE_BASE64;
+        return ESP_OK;
+    }
+    if (strcmp(value, "hex") == 0)
+    {
+        encoding = PresetJsonParser::UNIVERSE_HEX;
+        return ESP_OK;
+    }
+    return ESP_ERR_INVALID_ARG;
 }
 
 esp_err_t WebServer::api_presets_handler(httpd_req_t *req)
@@ -392,36 +958,56 @@ esp_err_t WebServer::api_presets_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
+    // The list and its upload take seconds for a large show
+    if (!instance_->is_async_worker())
+    {
+        return instance_->submit_async(req, api_presets_handler);
+    }
+
+    PresetJsonParser::UniverseEncoding encoding;
+    if (get_universe_encoding(req, encoding) != ESP_OK)
+    {
+        return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "Unknown universe encoding");
+    }
+
+    // Packed binary (the show file without configuration) when asked for, JSON otherwise
     if (req->method == HTTP_GET)
     {
-        // Return presets as JSON
-        std::string json = instance_->presets_to_json();
-        return instance_->send_json_response(req, json.c_str());
+        httpd_resp_set_hdr(req, "Vary", "Accept");
+        return has_media_type(req, "Accept", "application/octet-stream") ? instance_->send_show(req, false)
+                                                                         : instance_->send_presets(req, encoding);
     }
     else if (req->method == HTTP_POST)
     {
-        // Parse JSON and update presets
-        char content[4096];
-        int ret = httpd_req_recv(req, content, sizeof(content));
-        if (ret <= 0)
+        return has_media_type(req, "Content-Type", "application/octet-stream")
+                   ? instance_->receive_show(req, false)
+                   : instance_->receive_presets(req, encoding);
+    }
+
+    return instance_->send_error_response(req, HTTPD_405_METHOD_NOT_ALLOWED, "Method not allowed");
+}
+
+// Reads exactly length bytes of the body; a receive timeout only means they have not all arrived yet
+static bool receive_exact(httpd_req_t *req, char *buffer, size_t length)
+{
+    for (size_t received = 0; received < length;)
+    {
+        int ret = httpd_req_recv(req, buffer + received, length - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT)
         {
-            return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "No data received");
+            continue;
         }
-        content[ret] = '\0';
-
-        esp_err_t err = instance_->json_to_presets(content);
-        if (err != ESP_OK)
+        if (ret <= 0)
         {
-            return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+            return false;
         }
-
-        return instance_->send_json_response(req, "{\"status\":\"ok\"}");
+        received += ret;
     }
-
-    return instance_->send_error_response(req, HTTPD_405_METHOD_NOT_ALLOWED, "Method not allowed");
+    return true;
 }
 
-esp_err_t WebServer::api_config_handler(httpd_req_t *req)
+// Body (application/octet-stream): preset number byte followed by a DmxPresetDelta
+esp_err_t WebServer::api_preset_delta_handler(httpd_req_t *req)
 {
     if (!instance_)
     {
@@ -429,28 +1015,150 @@ esp_err_t WebServer::api_config_handler(httpd_req_t *req)
         return ESP_FAIL;
     }
 
-    if (req->method == HTTP_GET)
+    // About 1 KB, too much for the stack of the HTTP server task
+    std::unique_ptr<Messages::Event> event(new Messages::Event());
+    Messages::PresetDeltaEventData &data = event->data.presetDeltaData;
+    if (req->content_len < 1 + DmxPresetDelta::HEADER_SIZE || req->content_len > 1 + sizeof(data.delta))
     {
-        // Return config as JSON
-        std::string json = instance_->config_to_json();
-        return instance_->send_json_response(req, json.c_str());
+        return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid delta size");
     }
-    else if (req->method == HTTP_POST)
+
+    uint8_t presetNumber;
+    size_t length = req->content_len - 1;
+    if (!receive_exact(req, reinterpret_cast<char *>(&presetNumber), 1) ||
+        !receive_exact(req, reinterpret_cast<char *>(data.delta), length))
     {
-        // Parse JSON and update config
-        char content[1024];
-        int ret = httpd_req_recv(req, content, sizeof(content));
-        if (ret <= 0)
-        {
-            return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "No data received");
-        }
-        content[ret] = '\0';
+        return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "Incomplete delta");
+    }
 
-        esp_err_t err = ESP_OK; // TODO esp_err_t err = instance_->json_to_config(content);
-        if (err != ESP_OK)
-        {
+    if (presetNumber >= MAX_PRESETS || DmxPresetDelta::validate(data.delta, length) != ESP_OK)
+    {
+        return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid delta");
+    }
+
+    event->type = Messages::APPLY_PRESET_DELTA;
+    data.presetNumber = presetNumber;
+    data.length = (uint16_t)length;
+    if (instance_->send_controller_event(*event) != ESP_OK)
+    {
+        return instance_->send_busy_response(req, "Controller busy");
+    }
+    return instance_->send_json_response(req, "{\"status\":\"ok\"}");
+}
+
+// /api/presets/{i}: GET, PUT (one preset object as in the list, or a DmxPresetRecord as application/octet-stream),
+// DELETE (clears the preset, the numbers of the others do not change) and PATCH (channel ranges of one universe).
+// POST /api/presets/{i}/recall outputs the preset. Only the addressed preset is read or written.
+esp_err_t WebServer::api_preset_handler(httpd_req_t *req)
+{
+    if (!instance_ || !instance_->storage_)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not initialized");
+        return ESP_FAIL;
+    }
+
+    // Digits only, optionally followed by /recall; the query is not part of the path
+    const char *path = req->uri + strlen("/api/presets/");
+    char *end = const_cast<char *>(path);
+    unsigned long index = isdigit((unsigned char)*path) ? strtoul(path, &end, 10) : 0;
+    bool recall = strncmp(end, "/recall", 7) == 0;
+    if (recall)
+    {
+        end += 7;
+    }
+    if (end == path || (*end != '\0' && *end != '?') || index >= instance_->storage_->getNumberOfPresets())
+    {
+        return instance_->send_error_response(req, HTTPD_404_NOT_FOUND, "Preset not found");
+    }
+
+    PresetJsonParser::UniverseEncoding encoding;
+    if (get_universe_encoding(req, encoding) != ESP_OK)
+    {
+        return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "Unknown universe encoding");
+    }
+
+    if (recall && req->method == HTTP_POST)
+    {
+        std::unique_ptr<Messages::Event> event(new Messages::Event());
+        event->type = Messages::RECALL_PRESET;
+        event->data.presetData.presetNumber = (uint8_t)index;
+        if (instance_->send_controller_event(*event) != ESP_OK)
+        {
+            return instance_->send_busy_response(req, "Controller busy");
+        }
+        return instance_->send_json_response(req, "{\"status\":\"ok\"}");
+    }
+    else if (recall)
+    {
+        return instance_->send_error_response(req, HTTPD_405_METHOD_NOT_ALLOWED, "Method not allowed");
+    }
+
+    if (req->method == HTTP_GET)
+    {
+        httpd_resp_set_hdr(req, "Vary", "Accept");
+        return instance_->send_preset(req, (uint8_t)index, encoding);
+    }
+    else if (req->method == HTTP_PUT)
+    {
+        return instance_->receive_preset(req, (uint8_t)index, encoding);
+    }
+    else if (req->method == HTTP_PATCH)
+    {
+        return instance_->patch_preset(req, (uint8_t)index);
+    }
+    else if (req->method == HTTP_DELETE)
+    {
+        // Stored as an empty preset: no name, both universes of length 0
+        std::unique_ptr<Messages::Event> event(new Messages::Event());
+        event->type = Messages::REPLACE_PRESET;
+        event->data.presetData.presetNumber = (uint8_t)index;
+        if (instance_->send_controller_event(*event) != ESP_OK)
+        {
+            return instance_->send_busy_response(req, "Controller busy");
+        }
+        return instance_->send_json_response(req, "{\"status\":\"ok\"}");
+    }
+
+    return instance_->send_error_response(req, HTTPD_405_METHOD_NOT_ALLOWED, "Method not allowed");
+}
+
+esp_err_t WebServer::api_config_handler(httpd_req_t *req)
+{
+    if (!instance_)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not initialized");
+        return ESP_FAIL;
+    }
+
+    if (req->method == HTTP_GET)
+    {
+        // Return config as JSON
+        std::string json = instance_->config_to_json();
+        return instance_->send_json_response(req, json.c_str());
+    }
+    else if (req->method == HTTP_POST)
+    {
+        // Parse JSON and update config
+        char content[256];
+        if (instance_->receive_body(req, content, sizeof(content)) != ESP_OK)
+        {
+            return ESP_FAIL;
+        }
+
+        esp_err_t err = instance_->json_to_config(content);
+        if (err == ESP_ERR_TIMEOUT)
+        {
+            return instance_->send_busy_response(req, "Controller busy");
+        }
+        else if (err == ESP_ERR_INVALID_ARG)
+        {
             return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
         }
+        else if (err != ESP_OK)
+        {
+            return instance_->send_error_response(
+                req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to store configuration");
+        }
 
         return instance_->send_json_response(req, "{\"status\":\"ok\"}");
     }
@@ -458,289 +1166,1688 @@ esp_err_t WebServer::api_config_handler(httpd_req_t *req)
     return instance_->send_error_response(req, HTTPD_405_METHOD_NOT_ALLOWED, "Method not allowed");
 }
 
-esp_err_t WebServer::static_file_handler(httpd_req_t *req)
+esp_err_t WebServer::api_masters_handler(httpd_req_t *req)
+{
+    if (!instance_)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not initialized");
+        return ESP_FAIL;
+    }
+
+    // Large enough for all groups with a few channel ranges each
+    std::vector<char> content(4096);
+    if (instance_->receive_body(req, content.data(), content.size()) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = instance_->json_to_masters(content.data());
+    if (err == ESP_ERR_TIMEOUT)
+    {
+        return instance_->send_busy_response(req, "Controller busy");
+    }
+    else if (err != ESP_OK)
+    {
+        return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+    }
+
+    return instance_->send_json_response(req, "{\"status\":\"ok\"}");
+}
+
+esp_err_t WebServer::api_curves_handler(httpd_req_t *req)
+{
+    if (!instance_)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not initialized");
+        return ESP_FAIL;
+    }
+
+    // Large enough for a few custom tables of 256 values
+    std::vector<char> content(8192);
+    if (instance_->receive_body(req, content.data(), content.size()) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = instance_->json_to_curves(content.data());
+    if (err == ESP_ERR_TIMEOUT)
+    {
+        return instance_->send_busy_response(req, "Controller busy");
+    }
+    else if (err != ESP_OK)
+    {
+        return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+    }
+
+    return instance_->send_json_response(req, "{\"status\":\"ok\"}");
+}
+
+esp_err_t WebServer::api_layers_handler(httpd_req_t *req)
+{
+    if (!instance_)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not initialized");
+        return ESP_FAIL;
+    }
+
+    // Large enough for a full universe of values
+    std::vector<char> content(4096);
+    if (instance_->receive_body(req, content.data(), content.size()) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = instance_->json_to_layer(content.data());
+    if (err == ESP_ERR_TIMEOUT)
+    {
+        return instance_->send_busy_response(req, "Controller busy");
+    }
+    else if (err != ESP_OK)
+    {
+        return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+    }
+
+    return instance_->send_json_response(req, "{\"status\":\"ok\"}");
+}
+
+esp_err_t WebServer::api_effects_handler(httpd_req_t *req)
+{
+    if (!instance_)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not initialized");
+        return ESP_FAIL;
+    }
+
+    char content[512];
+    if (instance_->receive_body(req, content, sizeof(content)) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = instance_->json_to_effect(content);
+    if (err == ESP_ERR_TIMEOUT)
+    {
+        return instance_->send_busy_response(req, "Controller busy");
+    }
+    else if (err != ESP_OK)
+    {
+        return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+    }
+
+    return instance_->send_json_response(req, "{\"status\":\"ok\"}");
+}
+
+esp_err_t WebServer::api_capture_handler(httpd_req_t *req)
+{
+    if (!instance_)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not initialized");
+        return ESP_FAIL;
+    }
+
+    // An empty body captures the output into the current preset; a body that cannot be read captures nothing
+    char content[128] = "{}";
+    if (req->content_len > 0 && instance_->receive_body(req, content, sizeof(content)) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    esp_err_t err = instance_->json_to_capture(content);
+    if (err == ESP_ERR_TIMEOUT)
+    {
+        return instance_->send_busy_response(req, "Controller busy");
+    }
+    else if (err != ESP_OK)
+    {
+        return instance_->send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+    }
+
+    return instance_->send_json_response(req, "{\"status\":\"ok\"}");
+}
+
+esp_err_t WebServer::api_diagnostics_handler(httpd_req_t *req)
+{
+    if (!instance_)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not initialized");
+        return ESP_FAIL;
+    }
+
+    std::string json = instance_->diagnostics_to_json();
+    return instance_->send_json_response(req, json.c_str());
+}
+
+// Show file (application/octet-stream, see ShowBundle): GET exports the stored show, PUT imports one
+esp_err_t WebServer::api_show_handler(httpd_req_t *req)
+{
+    if (!instance_ || !instance_->storage_)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not initialized");
+        return ESP_FAIL;
+    }
+    if (!instance_->is_async_worker())
+    {
+        return instance_->submit_async(req, api_show_handler);
+    }
+
+    if (req->method == HTTP_GET)
+    {
+        return instance_->send_show(req, true);
+    }
+    else if (req->method == HTTP_PUT)
+    {
+        return instance_->receive_show(req, true);
+    }
+
+    return instance_->send_error_response(req, HTTPD_405_METHOD_NOT_ALLOWED, "Method not allowed");
+}
+
+// If-None-Match lists the ETag (weak comparison, so W/"..." matches too) or is *
+static bool is_not_modified(httpd_req_t *req, const char *etag)
+{
+    char value[256];
+    esp_err_t err = httpd_req_get_hdr_value_str(req, "If-None-Match", value, sizeof(value));
+    return (err == ESP_OK || err == ESP_ERR_HTTPD_RESULT_TRUNC) &&
+           (strcmp(value, "*") == 0 || strstr(value, etag) != nullptr);
+}
+
+// Files from the asset pack; unknown paths get index.html, the routes of the single page app. Files under /assets/
+// have the content hash in their name, so browsers may keep them for good; everything else is revalidated with its
+// ETag, which costs a 304 without a body. The gzip variant is sent to clients accepting gzip.
+esp_err_t WebServer::static_file_handler(httpd_req_t *req)
+{
+    if (!instance_)
+    {
+        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not initialized");
+        return ESP_FAIL;
+    }
+    // Sending a bundle to a slow client takes as long as the client wants
+    if (!instance_->is_async_worker())
+    {
+        return instance_->submit_async(req, static_file_handler);
+    }
+
+    AssetPack::Asset asset;
+    const AssetPack &assets = instance_->assets_;
+    if (!assets.find(req->uri, strcspn(req->uri, "?"), asset) && !assets.find("/index.html", 11, asset))
+    {
+        httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "Web UI not installed");
+        return ESP_FAIL;
+    }
+
+    // Header values point into the mapped pack, they stay valid. Compressible files are normally only stored gzipped
+    // (see tools/pack_assets.py); a client that does not accept gzip gets 406 for those, unless the pack was built
+    // with --identity. With both stored, only a client naming gzip gets it.
+    bool gzip = asset.gzipData && accepts_gzip(req) && (!asset.data || has_media_type(req, "Accept-Encoding", "gzip"));
+    if (asset.gzipData)
+    {
+        httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    }
+    if (!gzip && !asset.data)
+    {
+        static const char *MESSAGE = "Only available gzip encoded";
+        httpd_resp_set_status(req, "406 Not Acceptable");
+        httpd_resp_set_type(req, "text/plain");
+        return httpd_resp_send(req, MESSAGE, strlen(MESSAGE));
+    }
+    const char *etag = gzip ? asset.gzipEtag : asset.etag;
+    httpd_resp_set_type(req, asset.contentType);
+    httpd_resp_set_hdr(req, "Cache-Control",
+        strncmp(asset.path, "/assets/", 8) == 0 ? "public, max-age=31536000, immutable" : "no-cache");
+    httpd_resp_set_hdr(req, "ETag", etag);
+    if (is_not_modified(req, etag))
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, nullptr, 0);
+    }
+    if (gzip)
+    {
+        httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    }
+
+    // In one call straight from flash, with a Content-Length; the server writes it to the socket as it drains
+    return httpd_resp_send(req, reinterpret_cast<const char *>(gzip ? asset.gzipData : asset.data),
+        gzip ? asset.gzipLength : asset.length);
+}
+
+esp_err_t WebServer::ws_live_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET)
+    {
+        // WebSocket handshake done
+        return ESP_OK;
+    }
+
+    if (!instance_ || !instance_->liveOverrides_)
+    {
+        return ESP_FAIL;
+    }
+
+    // Get the frame length first, then receive the payload into a fixed buffer
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to get WebSocket frame length: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    char payload[512];
+    if (frame.len >= sizeof(payload))
+    {
+        ESP_LOGW(TAG, "WebSocket frame too large: %d bytes", (int)frame.len);
+        return ESP_ERR_INVALID_SIZE;
+    }
+    frame.payload = reinterpret_cast<uint8_t *>(payload);
+    err = httpd_ws_recv_frame(req, &frame, frame.len);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to receive WebSocket frame: %s", esp_err_to_name(err));
+        return err;
+    }
+    payload[frame.len] = '\0';
+
+    if (frame.type != HTTPD_WS_TYPE_TEXT)
+    {
+        return ESP_OK;
+    }
+    return instance_->handle_live_commands(payload);
+}
+
+// Pushes the controller state (see build_state_message): the complete state after connecting, then every change.
+// Nothing is expected from the client, frames it sends are discarded.
+esp_err_t WebServer::ws_state_handler(httpd_req_t *req)
+{
+    if (!instance_)
+    {
+        return ESP_FAIL;
+    }
+
+    if (req->method == HTTP_GET)
+    {
+        // Handshake done
+        instance_->register_state_client(httpd_req_to_sockfd(req));
+        return ESP_OK;
+    }
+
+    httpd_ws_frame_t frame;
+    memset(&frame, 0, sizeof(frame));
+    esp_err_t err = httpd_ws_recv_frame(req, &frame, 0);
+    if (err != ESP_OK || frame.len == 0)
+    {
+        return err;
+    }
+    uint8_t payload[64];
+    if (frame.len > sizeof(payload))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    frame.payload = payload;
+    return httpd_ws_recv_frame(req, &frame, frame.len);
+}
+
+// Live override commands, one per line: "set <channel> <value>", "release <channel>" or "release all".
+// Channels are frame channels (0..1023). Nothing is stored in NVS.
+esp_err_t WebServer::handle_live_commands(char *commands)
+{
+    esp_err_t result = ESP_OK;
+    char *savePtr = nullptr;
+    for (char *line = strtok_r(commands, "\n", &savePtr); line; line = strtok_r(nullptr, "\n", &savePtr))
+    {
+        unsigned channel;
+        unsigned value;
+        esp_err_t err;
+        if (sscanf(line, "set %u %u", &channel, &value) == 2)
+        {
+            err = liveOverrides_->setChannel(channel, value > 255 ? 255 : value);
+        }
+        else if (strncmp(line, "release all", 11) == 0)
+        {
+            liveOverrides_->releaseAll();
+            err = ESP_OK;
+        }
+        else if (sscanf(line, "release %u", &channel) == 1)
+        {
+            err = liveOverrides_->releaseChannel(channel);
+        }
+        else
+        {
+            ESP_LOGW(TAG, "Unknown live command: %s", line);
+            err = ESP_ERR_INVALID_ARG;
+        }
+
+        if (err != ESP_OK)
+        {
+            result = err;
+        }
+    }
+
+    // An invalid command must not close the socket
+    return result == ESP_ERR_INVALID_ARG ? ESP_OK : result;
+}
+
+esp_err_t WebServer::send_json_response(httpd_req_t *req, const char *json)
+{
+    httpd_resp_set_type(req, "application/json");
+    httpd_resp_send(req, json, strlen(json));
+    return ESP_OK;
+}
+
+esp_err_t WebServer::send_error_response(httpd_req_t *req, int status, const char *message)
+{
+    httpd_resp_send_err(req, (httpd_err_code_t)status, message);
+    return ESP_OK;
+}
+
+// 503: the request was valid but could not be handed on now, the client may repeat it
+esp_err_t WebServer::send_busy_response(httpd_req_t *req, const char *message)
+{
+    httpd_resp_set_status(req, "503 Service Unavailable");
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Retry-After", "1");
+    return httpd_resp_send(req, message, strlen(message));
+}
+
+// Reads the whole body of a request into body and terminates it. One httpd_req_recv only returns what has arrived so
+// far, a body of several TCP segments takes several. On an error the client has been answered (if it still can be) and
+// the handler returns ESP_FAIL, which closes the connection with whatever is left of the body.
+esp_err_t WebServer::receive_body(httpd_req_t *req, char *body, size_t capacity)
+{
+    if (req->content_len == 0)
+    {
+        send_error_response(req, HTTPD_400_BAD_REQUEST, "No data received");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    if (req->content_len >= capacity)
+    {
+        send_error_response(req, HTTPD_413_CONTENT_TOO_LARGE, "Request too large");
+        return ESP_ERR_INVALID_SIZE;
+    }
+    for (size_t received = 0; received < req->content_len;)
+    {
+        int ret = httpd_req_recv(req, body + received, req->content_len - received);
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            ESP_LOGE(TAG, "%s: body incomplete, %d of %d bytes", req->uri, (int)received, (int)req->content_len);
+            send_error_response(req, HTTPD_400_BAD_REQUEST, "Incomplete body");
+            return ESP_FAIL;
+        }
+        received += ret;
+    }
+    body[req->content_len] = '\0';
+    return ESP_OK;
+}
+
+static esp_err_t send_response_chunk(void *req, const char *data, size_t length)
+{
+    return httpd_resp_send_chunk(static_cast<httpd_req_t *>(req), data, length);
+}
+
+// Reads a stored preset; a preset never stored (or not decodable) is empty
+static void load_preset(NvsStorage &storage, uint8_t index, uint8_t *record, size_t capacity, DmxPreset &preset)
+{
+    size_t size = 0;
+    preset.clear();
+    if (storage.readPresetRecord(index, record, capacity, size) == ESP_OK &&
+        DmxPresetRecord::decode(record, size, preset) != ESP_OK)
+    {
+        ESP_LOGW(TAG, "Preset %d could not be decoded, sent empty", index);
+        preset.clear();
+    }
+}
+
+// {"index": 0, "name": "...", "universe1": ..., "universe2": ...} with the universes in the requested encoding
+static void write_preset_json(
+    JsonStreamWriter &json, uint8_t index, const DmxPreset &preset, PresetJsonParser::UniverseEncoding encoding)
+{
+    json.beginObject();
+    json.key("index");
+    json.number(index);
+    json.key("name");
+    json.string(preset.getName());
+    for (uint8_t universe = 0; universe < 2; universe++)
+    {
+        json.key(universe == 0 ? "universe1" : "universe2");
+        switch (encoding)
+        {
+        case PresetJsonParser::UNIVERSE_BASE64:
+            json.base64(preset.getUniverseData(universe), DMX_UNIVERSE_SIZE);
+            break;
+        case PresetJsonParser::UNIVERSE_HEX:
+            json.hex(preset.getUniverseData(universe), DMX_UNIVERSE_SIZE);
+            break;
+        default:
+            json.uint8Array(preset.getUniverseData(universe), DMX_UNIVERSE_SIZE);
+            break;
+        }
+    }
+    json.endObject();
+}
+
+// Presets as a JSON array, streamed one preset at a time through a small buffer: a cJSON tree would take a heap
+// object per channel, more than the heap holds for a larger show
+esp_err_t WebServer::send_presets(httpd_req_t *req, PresetJsonParser::UniverseEncoding encoding)
+{
+    struct PresetsJson
+    {
+        explicit PresetsJson(httpd_req_t *req) : json(send_response_chunk, req) {}
+
+        JsonStreamWriter json;
+        uint8_t record[DmxPresetRecord::MAX_SIZE];
+        DmxPreset preset;
+    };
+    std::unique_ptr<PresetsJson> presets(new PresetsJson(req));
+    JsonStreamWriter &json = presets->json;
+
+    httpd_resp_set_type(req, "application/json");
+    json.beginArray();
+    uint8_t numberOfPresets = storage_ ? storage_->getNumberOfPresets() : 0;
+    for (uint8_t index = 0; index < numberOfPresets && json.getError() == ESP_OK; index++)
+    {
+        load_preset(*storage_, index, presets->record, sizeof(presets->record), presets->preset);
+        write_preset_json(json, index, presets->preset, encoding);
+    }
+    json.endArray();
+
+    // The status line has been sent with the first chunk, a failure can only close the connection
+    esp_err_t err = json.flush();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to send presets: %s", esp_err_to_name(err));
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Stores every parsed preset as soon as its object closes, staged in the import transaction
+class PresetImporter : public PresetJsonParser::Handler
+{
+  public:
+    PresetImporter(NvsStorage &storage, PresetJsonParser::UniverseEncoding encoding)
+        : parser(*this, encoding), storeError(ESP_OK), storage_(storage)
+    {
+    }
+
+    esp_err_t onPreset(uint8_t position, const DmxPreset &preset) override
+    {
+        size_t size = DmxPresetRecord::encode(preset, record_, sizeof(record_));
+        storeError = size > 0 ? storage_.importPresetRecord(position, record_, size) : ESP_ERR_INVALID_SIZE;
+        return storeError;
+    }
+
+    PresetJsonParser parser;
+    esp_err_t storeError; // The storage failed, e.g. no room for the uploaded presets next to the current ones
+
+  private:
+    NvsStorage &storage_;
+    uint8_t record_[DmxPresetRecord::MAX_SIZE];
+};
+
+// Presets as a JSON array (as sent by GET), parsed while the body arrives: a body of 250 presets is over 1 MB of text,
+// far more than the heap holds, so only the preset being parsed is kept in memory
+esp_err_t WebServer::receive_presets(httpd_req_t *req, PresetJsonParser::UniverseEncoding encoding)
+{
+    // The HTTP server needs the body length, chunked request bodies are not supported
+    if (req->content_len == 0)
+    {
+        return send_error_response(req, HTTPD_411_LENGTH_REQUIRED, "Content-Length required");
+    }
+
+    // Staged as one transaction, so the stored presets switch to the uploaded ones only once all of them arrived
+    if (storage_->beginShowImport() != ESP_OK)
+    {
+        return send_error_response(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Presets upload not possible");
+    }
+
+    std::unique_ptr<PresetImporter> importer(new PresetImporter(*storage_, encoding));
+    std::vector<char> chunk(1024);
+    size_t remaining = req->content_len;
+    esp_err_t err = ESP_OK;
+    while (remaining > 0 && err == ESP_OK)
+    {
+        int ret = httpd_req_recv(req, chunk.data(), remaining < chunk.size() ? remaining : chunk.size());
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            ESP_LOGE(TAG, "Presets upload aborted with %d bytes left", (int)remaining);
+            storage_->abortShowImport();
+            return ESP_FAIL;
+        }
+        remaining -= ret;
+        err = importer->parser.feed(chunk.data(), ret);
+    }
+
+    uint8_t numberOfPresets = importer->parser.getNumberOfPresets();
+    if (err == ESP_OK)
+    {
+        err = importer->parser.finish();
+    }
+    if (err == ESP_OK)
+    {
+        err = storage_->commitShowImport(numberOfPresets);
+        importer->storeError = err;
+    }
+    if (err != ESP_OK)
+    {
+        // Nothing of the stored presets has changed
+        storage_->abortShowImport();
+        ESP_LOGE(TAG, "Presets upload failed after %d presets", numberOfPresets);
+        return importer->storeError != ESP_OK
+                   ? send_error_response(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to store presets")
+                   : send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+    }
+
+    // Already stored by the commit
+    std::unique_ptr<Messages::Event> event(new Messages::Event());
+    event->data.presetsData.numberOfPresets = numberOfPresets;
+    event->type = Messages::SET_PRESETS;
+    send_controller_event(*event);
+
+    ESP_LOGI(TAG, "Received %d presets", numberOfPresets);
+    return send_json_response(req, "{\"status\":\"ok\"}");
+}
+
+// One preset as in the list, or its stored record for application/octet-stream (the layout of PUT)
+esp_err_t WebServer::send_preset(httpd_req_t *req, uint8_t index, PresetJsonParser::UniverseEncoding encoding)
+{
+    struct PresetJson
+    {
+        explicit PresetJson(httpd_req_t *req) : json(send_response_chunk, req) {}
+
+        JsonStreamWriter json;
+        uint8_t record[DmxPresetRecord::MAX_SIZE];
+        DmxPreset preset;
+    };
+    std::unique_ptr<PresetJson> response(new PresetJson(req));
+
+    if (has_media_type(req, "Accept", "application/octet-stream"))
+    {
+        // As stored, a preset never stored as an empty record
+        size_t size = 0;
+        if (storage_->readPresetRecord(index, response->record, sizeof(response->record), size) != ESP_OK)
+        {
+            response->preset.clear();
+            size = DmxPresetRecord::encode(response->preset, response->record, sizeof(response->record));
+        }
+        httpd_resp_set_type(req, "application/octet-stream");
+        return httpd_resp_send(req, reinterpret_cast<const char *>(response->record), size);
+    }
+
+    load_preset(*storage_, index, response->record, sizeof(response->record), response->preset);
+    httpd_resp_set_type(req, "application/json");
+    write_preset_json(response->json, index, response->preset, encoding);
+    esp_err_t err = response->json.flush();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Failed to send preset %d: %s", index, esp_err_to_name(err));
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Keeps the one preset of a PUT body
+class PresetReader : public PresetJsonParser::Handler
+{
+  public:
+    explicit PresetReader(PresetJsonParser::UniverseEncoding encoding) : parser(*this, encoding, true) {}
+
+    esp_err_t onPreset(uint8_t, const DmxPreset &received) override
+    {
+        preset.copyFrom(received);
+        return ESP_OK;
+    }
+
+    PresetJsonParser parser;
+    DmxPreset preset;
+    uint8_t record[DmxPresetRecord::MAX_SIZE]; // Body of an application/octet-stream PUT
+    Messages::Event event;
+};
+
+// Replaces one preset: a JSON preset object as in the list (its "index" is not used), or a DmxPresetRecord as
+// application/octet-stream. The preset changer stores just this preset and outputs it again when it is current.
+esp_err_t WebServer::receive_preset(httpd_req_t *req, uint8_t index, PresetJsonParser::UniverseEncoding encoding)
+{
+    if (req->content_len == 0)
+    {
+        return send_error_response(req, HTTPD_411_LENGTH_REQUIRED, "Content-Length required");
+    }
+
+    std::unique_ptr<PresetReader> reader(new PresetReader(encoding));
+    esp_err_t err = ESP_OK;
+    if (has_media_type(req, "Content-Type", "application/octet-stream"))
+    {
+        if (req->content_len > sizeof(reader->record))
+        {
+            return send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid preset record");
+        }
+        for (size_t received = 0; received < req->content_len;)
+        {
+            int ret = httpd_req_recv(
+                req, reinterpret_cast<char *>(reader->record) + received, req->content_len - received);
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+            {
+                continue;
+            }
+            if (ret <= 0)
+            {
+                ESP_LOGE(TAG, "Preset %d upload aborted", index);
+                return ESP_FAIL;
+            }
+            received += ret;
+        }
+        if (DmxPresetRecord::decode(reader->record, req->content_len, reader->preset) != ESP_OK)
+        {
+            return send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid preset record");
+        }
+    }
+    else
+    {
+        // Parsed while it arrives, like the list; the record buffer serves as receive buffer
+        char *chunk = reinterpret_cast<char *>(reader->record);
+        const size_t chunkSize = sizeof(reader->record);
+        size_t remaining = req->content_len;
+        while (remaining > 0 && err == ESP_OK)
+        {
+            int ret = httpd_req_recv(req, chunk, remaining < chunkSize ? remaining : chunkSize);
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+            {
+                continue;
+            }
+            if (ret <= 0)
+            {
+                ESP_LOGE(TAG, "Preset %d upload aborted with %d bytes left", index, (int)remaining);
+                return ESP_FAIL;
+            }
+            remaining -= ret;
+            err = reader->parser.feed(chunk, ret);
+        }
+        if (err == ESP_OK)
+        {
+            err = reader->parser.finish();
+        }
+        if (err != ESP_OK)
+        {
+            return send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        }
+    }
+
+    Messages::Event &event = reader->event;
+    event = Messages::Event();
+    event.type = Messages::REPLACE_PRESET;
+    Messages::PresetEventData &data = event.data.presetData;
+    data.presetNumber = index;
+    strncpy(data.name, reader->preset.getName(), sizeof(data.name) - 1);
+    memcpy(data.universe1Data, reader->preset.getUniverseData(0), sizeof(data.universe1Data));
+    data.universe1Length = reader->preset.getUniverseLength(0);
+    memcpy(data.universe2Data, reader->preset.getUniverseData(1), sizeof(data.universe2Data));
+    data.universe2Length = reader->preset.getUniverseLength(1);
+    if (send_controller_event(event) != ESP_OK)
+    {
+        return send_busy_response(req, "Controller busy");
+    }
+    return send_json_response(req, "{\"status\":\"ok\"}");
+}
+
+// Changes channel ranges of one preset without sending the rest of it: a DmxPresetDelta as application/octet-stream
+// (as for /api/presets/delta, without the preset number), or JSON for one universe (see json_to_preset_delta)
+esp_err_t WebServer::patch_preset(httpd_req_t *req, uint8_t index)
+{
+    std::unique_ptr<Messages::Event> event(new Messages::Event());
+    Messages::PresetDeltaEventData &data = event->data.presetDeltaData;
+    size_t length = 0;
+    if (has_media_type(req, "Content-Type", "application/octet-stream"))
+    {
+        if (req->content_len < DmxPresetDelta::HEADER_SIZE || req->content_len > sizeof(data.delta))
+        {
+            return send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid delta size");
+        }
+        length = req->content_len;
+        if (!receive_exact(req, reinterpret_cast<char *>(data.delta), length))
+        {
+            return send_error_response(req, HTTPD_400_BAD_REQUEST, "Incomplete delta");
+        }
+    }
+    else
+    {
+        // A handful of ranges; larger edits are better sent as a delta
+        if (req->content_len == 0 || req->content_len > 4095)
+        {
+            return send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid content length");
+        }
+        std::vector<char> content(req->content_len + 1, 0);
+        if (!receive_exact(req, content.data(), req->content_len))
+        {
+            return send_error_response(req, HTTPD_400_BAD_REQUEST, "No data received");
+        }
+        if (json_to_preset_delta(content.data(), data.delta, sizeof(data.delta), length) != ESP_OK)
+        {
+            return send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid JSON");
+        }
+    }
+
+    if (DmxPresetDelta::validate(data.delta, length) != ESP_OK)
+    {
+        return send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid delta");
+    }
+
+    event->type = Messages::APPLY_PRESET_DELTA;
+    data.presetNumber = index;
+    data.length = (uint16_t)length;
+    if (send_controller_event(*event) != ESP_OK)
+    {
+        return send_busy_response(req, "Controller busy");
+    }
+    return send_json_response(req, "{\"status\":\"ok\"}");
+}
+
+static void write_uint16(uint8_t *data, uint16_t value)
+{
+    data[0] = value & 0xFF;
+    data[1] = value >> 8;
+}
+
+// Appends a run for {"first": channel, "values": [0..255, ...]} within one universe
+static esp_err_t append_delta_run(
+    const cJSON *range, uint8_t universe, uint8_t *delta, size_t capacity, size_t &length)
+{
+    cJSON *first = cJSON_GetObjectItem(range, "first");
+    cJSON *values = cJSON_GetObjectItem(range, "values");
+    if (!first || !cJSON_IsNumber(first) || first->valuedouble != first->valueint || !values ||
+        !cJSON_IsArray(values))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    int count = cJSON_GetArraySize(values);
+    if (first->valueint < 0 || count == 0 || first->valueint + count > DMX_UNIVERSE_SIZE ||
+        length + DmxPresetDelta::RUN_HEADER_SIZE + count > capacity)
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    write_uint16(delta + length, universe * DMX_UNIVERSE_SIZE + first->valueint);
+    write_uint16(delta + length + 2, count);
+    uint8_t *out = delta + length + DmxPresetDelta::RUN_HEADER_SIZE;
+    cJSON *value;
+    cJSON_ArrayForEach(value, values)
+    {
+        if (!cJSON_IsNumber(value) || value->valuedouble != value->valueint || value->valueint < 0 ||
+            value->valueint > 255)
+        {
+            return ESP_ERR_INVALID_ARG;
+        }
+        *out++ = (uint8_t)value->valueint;
+    }
+    length += DmxPresetDelta::RUN_HEADER_SIZE + count;
+    return ESP_OK;
+}
+
+// {"universe": 1, "first": 0, "values": [255, 128]}                            one range
+// {"universe": 2, "ranges": [{"first": 0, "values": [...]}, {"first": 100, "values": [...]}]}  several ranges
+// Channels are 0..511 within the universe. The universe keeps its length, extended to the last changed channel.
+esp_err_t WebServer::json_to_preset_delta(const char *json, uint8_t *delta, size_t capacity, size_t &length)
+{
+    cJSON *root = cJSON_Parse(json);
+    cJSON *universe = root ? cJSON_GetObjectItem(root, "universe") : nullptr;
+    if (!universe || !cJSON_IsNumber(universe) || (universe->valueint != 1 && universe->valueint != 2) ||
+        capacity < DmxPresetDelta::HEADER_SIZE)
+    {
+        ESP_LOGE(TAG, "Invalid JSON: no universe");
+        if (root)
+            cJSON_Delete(root);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    write_uint16(delta, DmxPresetDelta::KEEP_LENGTH);
+    write_uint16(delta + 2, DmxPresetDelta::KEEP_LENGTH);
+    length = DmxPresetDelta::HEADER_SIZE;
+
+    esp_err_t err = ESP_OK;
+    cJSON *ranges = cJSON_GetObjectItem(root, "ranges");
+    if (ranges && cJSON_IsArray(ranges))
+    {
+        cJSON *range;
+        cJSON_ArrayForEach(range, ranges)
+        {
+            err = append_delta_run(range, universe->valueint - 1, delta, capacity, length);
+            if (err != ESP_OK)
+            {
+                break;
+            }
+        }
+    }
+    else
+    {
+        err = append_delta_run(root, universe->valueint - 1, delta, capacity, length);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Invalid channel range: %s", esp_err_to_name(err));
+    }
+
+    cJSON_Delete(root);
+    return err;
+}
+
+std::string WebServer::config_to_json()
+{
+    Messages::ConfigurationEventData config;
+    if (storage_->readConfiguration(config) != ESP_OK)
+    {
+        return "{}";
+    }
+
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+    {
+        return "{}";
+    }
+
+    cJSON_AddBoolToObject(root, "switchPolarityInverted", config.switchPolarityInverted);
+    cJSON_AddNumberToObject(root, "longPressThresholdMs", config.longPressThresholdMs);
+    cJSON_AddNumberToObject(root, "commitWindowMs", config.commitWindowMs);
+
+    char *json_str = cJSON_Print(root);
+    std::string result = json_str ? json_str : "{}";
+    cJSON_free(json_str);
+    cJSON_Delete(root);
+
+    return result;
+}
+
+// An integer (no fraction) within min..max
+static bool get_int(const cJSON *item, int min, int max, int &value)
+{
+    if (!item || !cJSON_IsNumber(item) || item->valuedouble != item->valueint || item->valueint < min ||
+        item->valueint > max)
+    {
+        return false;
+    }
+    value = item->valueint;
+    return true;
+}
+
+// [first, count] of frame channels
+static bool get_channel_range(const cJSON *range, uint16_t &firstChannel, uint16_t &channelCount)
+{
+    int first;
+    int count;
+    if (!cJSON_IsArray(range) || cJSON_GetArraySize(range) != 2 ||
+        !get_int(cJSON_GetArrayItem(range, 0), 0, DMX_FRAME_CHANNELS - 1, first) ||
+        !get_int(cJSON_GetArrayItem(range, 1), 0, DMX_FRAME_CHANNELS - first, count))
+    {
+        return false;
+    }
+    firstChannel = (uint16_t)first;
+    channelCount = (uint16_t)count;
+    return true;
+}
+
+// An array of at most capacity channel values (0..255)
+static bool get_channel_values(const cJSON *array, uint8_t *values, size_t capacity, uint16_t &count)
+{
+    if (!cJSON_IsArray(array) || cJSON_GetArraySize(array) > (int)capacity)
+    {
+        return false;
+    }
+    count = 0;
+    const cJSON *item;
+    cJSON_ArrayForEach(item, array)
+    {
+        int value;
+        if (!get_int(item, 0, 255, value))
+        {
+            return false;
+        }
+        values[count++] = (uint8_t)value;
+    }
+    return true;
+}
+
+esp_err_t WebServer::send_controller_event(const Messages::Event &event)
+{
+    if (!dmxControllerEventQueue_ || xQueueSend(dmxControllerEventQueue_, &event, pdMS_TO_TICKS(100)) != pdPASS)
+    {
+        ESP_LOGE(TAG, "Failed to send event %d to DmxController", event.type);
+        return ESP_ERR_TIMEOUT;
+    }
+    return ESP_OK;
+}
+
+// Expected format: {"switchPolarityInverted": false, "longPressThresholdMs": 1000, "commitWindowMs": 1500}
+// Fields left out keep their current value.
+esp_err_t WebServer::json_to_config(const char *json)
 {
-    if (!instance_)
+    Messages::ConfigurationEventData config;
+    esp_err_t err = storage_->readConfiguration(config);
+    if (err != ESP_OK)
     {
-        httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Server not initialized");
-        return ESP_FAIL;
+        return err;
     }
 
-    // Map URI to SPIFFS file path
-    std::string path = "/spiffs";
-    if (strcmp(req->uri, "/") == 0)
+    cJSON *root = cJSON_Parse(json);
+    if (!root || !cJSON_IsObject(root))
     {
-        path += "/index.html";
+        ESP_LOGE(TAG, "Invalid JSON: not an object");
+        if (root)
+            cJSON_Delete(root);
+        return ESP_ERR_INVALID_ARG;
     }
-    else
+
+    int value;
+    cJSON *polarity = cJSON_GetObjectItem(root, "switchPolarityInverted");
+    cJSON *longPress = cJSON_GetObjectItem(root, "longPressThresholdMs");
+    cJSON *commitWindow = cJSON_GetObjectItem(root, "commitWindowMs");
+    if (polarity)
     {
-        path += req->uri;
+        err = cJSON_IsBool(polarity) ? ESP_OK : ESP_ERR_INVALID_ARG;
+        config.switchPolarityInverted = cJSON_IsTrue(polarity);
     }
-
-    FILE *file = fopen(path.c_str(), "rb");
-    if (!file)
+    if (longPress && err == ESP_OK)
     {
-        // fallback: serve index.html for unknown routes (SPA)
-        file = fopen("/spiffs/index.html", "rb");
-        if (!file)
-        {
-            httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "File not found");
-            return ESP_FAIL;
-        }
-        httpd_resp_set_type(req, "text/html");
+        err = get_int(longPress, 1, UINT16_MAX, value) ? ESP_OK : ESP_ERR_INVALID_ARG;
+        config.longPressThresholdMs = (uint16_t)value;
     }
-    else
+    if (commitWindow && err == ESP_OK)
     {
-        // Set content type based on file extension
-        if (strstr(path.c_str(), ".html"))
-            httpd_resp_set_type(req, "text/html");
-        else if (strstr(path.c_str(), ".js"))
-            httpd_resp_set_type(req, "application/javascript");
-        else if (strstr(path.c_str(), ".css"))
-            httpd_resp_set_type(req, "text/css");
-        else if (strstr(path.c_str(), ".json"))
-            httpd_resp_set_type(req, "application/json");
-        else if (strstr(path.c_str(), ".png"))
-            httpd_resp_set_type(req, "image/png");
-        else if (strstr(path.c_str(), ".jpg") || strstr(path.c_str(), ".jpeg"))
-            httpd_resp_set_type(req, "image/jpeg");
-        else if (strstr(path.c_str(), ".svg"))
-            httpd_resp_set_type(req, "image/svg+xml");
-        else
-            httpd_resp_set_type(req, "application/octet-stream");
+        err = get_int(commitWindow, 0, UINT16_MAX, value) ? ESP_OK : ESP_ERR_INVALID_ARG;
+        config.commitWindowMs = (uint16_t)value;
+    }
+    cJSON_Delete(root);
+    if (err != ESP_OK)
+    {
+        return err;
     }
 
-    char buffer[1024];
-    size_t read_bytes;
-    while ((read_bytes = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    // Stored here, DmxController forwards it to the FootSwitch and the state clients
+    err = storage_->setConfiguration(config);
+    if (err != ESP_OK)
     {
-        httpd_resp_send_chunk(req, buffer, read_bytes);
+        return err;
     }
-    fclose(file);
-    httpd_resp_send_chunk(req, NULL, 0);
-    return ESP_OK;
+    std::unique_ptr<Messages::Event> event(new Messages::Event());
+    event->type = Messages::SET_CONFIGURATION;
+    event->data.configurationData = config;
+    err = send_controller_event(*event);
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG, "Configuration updated from JSON");
+    }
+    return err;
 }
 
-esp_err_t WebServer::send_json_response(httpd_req_t *req, const char *json)
+// Expected format:
+// {"grandMaster": 255, "groups": [{"id": 0, "name": "Front", "level": 200, "channels": [[0, 24], [512, 8]]}]}
+// A group with "channels" is (re)defined with exactly those channel ranges (frame channels 0..1023).
+esp_err_t WebServer::json_to_masters(const char *json)
 {
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, json, strlen(json));
-    return ESP_OK;
-}
+    cJSON *root = cJSON_Parse(json);
+    if (!root || !cJSON_IsObject(root))
+    {
+        ESP_LOGE(TAG, "Invalid JSON: not an object");
+        if (root)
+            cJSON_Delete(root);
+        return ESP_ERR_INVALID_ARG;
+    }
 
-esp_err_t WebServer::send_error_response(httpd_req_t *req, int status, const char *message)
-{
-    httpd_resp_send_err(req, (httpd_err_code_t)status, message);
-    return ESP_OK;
-}
+    // Validated as a whole before anything is sent, so an invalid payload changes nothing
+    esp_err_t err = ESP_OK;
+    cJSON *groups = cJSON_GetObjectItem(root, "groups");
+    groups = groups && cJSON_IsArray(groups) ? groups : nullptr;
+    for (int i = 0; i < cJSON_GetArraySize(groups) && err == ESP_OK; i++)
+    {
+        cJSON *group = cJSON_GetArrayItem(groups, i);
+        cJSON *level = cJSON_GetObjectItem(group, "level");
+        int id = 0;
+        int levelValue = 0;
+        if (!get_int(cJSON_GetObjectItem(group, "id"), 0, MAX_CHANNEL_GROUPS - 1, id) ||
+            (level && !get_int(level, 0, 255, levelValue)))
+        {
+            ESP_LOGE(TAG, "Invalid group at index %d", i);
+            err = ESP_ERR_INVALID_ARG;
+        }
 
-std::string WebServer::presets_to_json()
-{
-    DmxPresets *dmxPresets_ = nullptr; // TODO: Set somewhere
-    if (!dmxPresets_)
+        cJSON *channels = cJSON_GetObjectItem(group, "channels");
+        for (int j = 0; j < cJSON_GetArraySize(channels) && err == ESP_OK && cJSON_IsArray(channels); j++)
+        {
+            uint16_t firstChannel;
+            uint16_t channelCount;
+            if (!get_channel_range(cJSON_GetArrayItem(channels, j), firstChannel, channelCount))
+            {
+                ESP_LOGE(TAG, "Invalid channel range %d of group %d", j, id);
+                err = ESP_ERR_INVALID_ARG;
+            }
+        }
+    }
+    cJSON *grandMaster = cJSON_GetObjectItem(root, "grandMaster");
+    int grandMasterLevel = 0;
+    if (err == ESP_OK && grandMaster && !get_int(grandMaster, 0, 255, grandMasterLevel))
     {
-        return "[]";
+        ESP_LOGE(TAG, "Invalid grand master level");
+        err = ESP_ERR_INVALID_ARG;
     }
 
-    cJSON *root = cJSON_CreateArray();
-    if (!root)
+    std::unique_ptr<Messages::Event> event(new Messages::Event());
+    for (int i = 0; i < cJSON_GetArraySize(groups) && err == ESP_OK; i++)
     {
-        return "[]";
+        cJSON *group = cJSON_GetArrayItem(groups, i);
+        cJSON *level = cJSON_GetObjectItem(group, "level");
+        int id = 0;
+        int levelValue = 0;
+        get_int(cJSON_GetObjectItem(group, "id"), 0, MAX_CHANNEL_GROUPS - 1, id);
+        *event = Messages::Event();
+        event->data.masterData.group = (uint8_t)id;
+
+        cJSON *channels = cJSON_GetObjectItem(group, "channels");
+        if (channels && cJSON_IsArray(channels))
+        {
+            event->type = Messages::DEFINE_GROUP;
+            cJSON *name = cJSON_GetObjectItem(group, "name");
+            if (name && cJSON_IsString(name))
+            {
+                strncpy(event->data.masterData.name, name->valuestring, sizeof(event->data.masterData.name) - 1);
+            }
+            err = send_controller_event(*event);
+
+            for (int j = 0; j < cJSON_GetArraySize(channels) && err == ESP_OK; j++)
+            {
+                get_channel_range(cJSON_GetArrayItem(channels, j), event->data.masterData.firstChannel,
+                    event->data.masterData.channelCount);
+                event->type = Messages::SET_GROUP_CHANNELS;
+                event->data.masterData.member = true;
+                err = send_controller_event(*event);
+            }
+        }
+
+        if (err == ESP_OK && level && get_int(level, 0, 255, levelValue))
+        {
+            event->type = Messages::SET_GROUP_LEVEL;
+            event->data.masterData.level = (uint8_t)levelValue;
+            err = send_controller_event(*event);
+        }
     }
 
-    for (uint8_t i = 0; i < dmxPresets_->getNumPresets(); i++)
+    if (err == ESP_OK && grandMaster)
     {
-        const DmxPreset &preset = dmxPresets_->getPreset(i);
+        *event = Messages::Event();
+        event->type = Messages::SET_GRAND_MASTER;
+        event->data.masterData.level = (uint8_t)grandMasterLevel;
+        err = send_controller_event(*event);
+    }
 
-        cJSON *preset_obj = cJSON_CreateObject();
-        if (!preset_obj)
-            continue;
+    cJSON_Delete(root);
+    return err;
+}
 
-        cJSON_AddNumberToObject(preset_obj, "index", preset.getIndex());
-        cJSON_AddStringToObject(preset_obj, "name", preset.getName());
+// Expected format:
+// {"curves": [{"channels": [0, 24], "type": "square"}, {"channels": [24, 4], "type": "custom", "table": [...256]}]}
+// Types: "linear", "square", "s-curve", "custom". Channels are frame channels (0..1023).
+esp_err_t WebServer::json_to_curves(const char *json)
+{
+    cJSON *root = cJSON_Parse(json);
+    cJSON *curves = root ? cJSON_GetObjectItem(root, "curves") : nullptr;
+    if (!curves || !cJSON_IsArray(curves))
+    {
+        ESP_LOGE(TAG, "Invalid JSON: no curves array");
+        if (root)
+            cJSON_Delete(root);
+        return ESP_ERR_INVALID_ARG;
+    }
 
-        // Universe 1
-        cJSON *universe1 = cJSON_CreateArray();
-        const uint8_t *u1_data = preset.getUniverseData(0);
-        for (int j = 0; j < DMX_UNIVERSE_SIZE; j++)
+    esp_err_t err = ESP_OK;
+    std::unique_ptr<Messages::Event> event(new Messages::Event());
+    for (int i = 0; i < cJSON_GetArraySize(curves) && err == ESP_OK; i++)
+    {
+        cJSON *curve = cJSON_GetArrayItem(curves, i);
+        cJSON *channels = cJSON_GetObjectItem(curve, "channels");
+        cJSON *type = cJSON_GetObjectItem(curve, "type");
+        *event = Messages::Event();
+        event->type = Messages::SET_CHANNEL_CURVE;
+        if (!get_channel_range(channels, event->data.curveData.firstChannel, event->data.curveData.channelCount) ||
+            !type || !cJSON_IsString(type))
         {
-            cJSON_AddItemToArray(universe1, cJSON_CreateNumber(u1_data[j]));
+            ESP_LOGE(TAG, "Invalid curve at index %d", i);
+            err = ESP_ERR_INVALID_ARG;
+            break;
         }
-        cJSON_AddItemToObject(preset_obj, "universe1", universe1);
 
-        // Universe 2
-        cJSON *universe2 = cJSON_CreateArray();
-        const uint8_t *u2_data = preset.getUniverseData(1);
-        for (int j = 0; j < DMX_UNIVERSE_SIZE; j++)
+        if (strcmp(type->valuestring, "linear") == 0)
+        {
+            event->data.curveData.curveType = DmxCurves::LINEAR;
+        }
+        else if (strcmp(type->valuestring, "square") == 0)
+        {
+            event->data.curveData.curveType = DmxCurves::SQUARE_LAW;
+        }
+        else if (strcmp(type->valuestring, "s-curve") == 0)
         {
-            cJSON_AddItemToArray(universe2, cJSON_CreateNumber(u2_data[j]));
+            event->data.curveData.curveType = DmxCurves::S_CURVE;
+        }
+        else if (strcmp(type->valuestring, "custom") == 0)
+        {
+            cJSON *table = cJSON_GetObjectItem(curve, "table");
+            uint16_t count;
+            if (!get_channel_values(table, event->data.curveData.table, sizeof(event->data.curveData.table), count) ||
+                count != sizeof(event->data.curveData.table))
+            {
+                ESP_LOGE(TAG, "Custom curve at index %d needs a table of 256 values (0..255)", i);
+                err = ESP_ERR_INVALID_ARG;
+                break;
+            }
+            event->data.curveData.curveType = DmxCurves::CUSTOM;
+        }
+        else
+        {
+            ESP_LOGE(TAG, "Unknown curve type: %s", type->valuestring);
+            err = ESP_ERR_INVALID_ARG;
+            break;
         }
-        cJSON_AddItemToObject(preset_obj, "universe2", universe2);
 
-        cJSON_AddItemToArray(root, preset_obj);
+        err = send_controller_event(*event);
     }
 
-    char *json_str = cJSON_Print(root);
-    std::string result = json_str ? json_str : "[]";
-    cJSON_free(json_str);
     cJSON_Delete(root);
-
-    return result;
+    return err;
 }
 
-esp_err_t WebServer::json_to_presets(const char *json)
+// Expected format, one of:
+// {"layer": "park", "first": 700, "values": [255, 128]}   set and own channels 700..701
+// {"layer": "park", "first": 700, "release": 2}            release channels 700..701
+// {"layer": "effect", "priority": 10, "merge": "htp"}      set priority and merge mode ("htp" or "ltp")
+// Layers: "effect", "override", "park". Channels are frame channels (0..1023).
+esp_err_t WebServer::json_to_layer(const char *json)
 {
-    DmxPresets *dmxPresets_ = nullptr; // TODO: Set somewhere
-    if (!dmxPresets_ || !json)
-    {
-        return ESP_ERR_INVALID_ARG;
-    }
-
     cJSON *root = cJSON_Parse(json);
-    if (!root || !cJSON_IsArray(root))
+    cJSON *layer = root ? cJSON_GetObjectItem(root, "layer") : nullptr;
+    if (!layer || !cJSON_IsString(layer))
     {
-        ESP_LOGE(TAG, "Invalid JSON: not an array");
+        ESP_LOGE(TAG, "Invalid JSON: no layer");
         if (root)
             cJSON_Delete(root);
         return ESP_ERR_INVALID_ARG;
     }
 
-    int num_presets = cJSON_GetArraySize(root);
-    if (num_presets < 2 || num_presets > 20)
+    std::unique_ptr<Messages::Event> event(new Messages::Event());
+    if (strcmp(layer->valuestring, "effect") == 0)
     {
-        ESP_LOGE(TAG, "Invalid number of presets: %d", num_presets);
+        event->data.layerData.layer = DmxLayerStack::EFFECT;
+    }
+    else if (strcmp(layer->valuestring, "override") == 0)
+    {
+        event->data.layerData.layer = DmxLayerStack::OVERRIDE;
+    }
+    else if (strcmp(layer->valuestring, "park") == 0)
+    {
+        event->data.layerData.layer = DmxLayerStack::PARK;
+    }
+    else
+    {
+        // The base layer is driven by the preset changer
+        ESP_LOGE(TAG, "Unknown layer: %s", layer->valuestring);
         cJSON_Delete(root);
         return ESP_ERR_INVALID_ARG;
     }
 
-    // Set number of presets
-    esp_err_t ret = dmxPresets_->setNumPresets(num_presets);
-    if (ret != ESP_OK)
+    // Values and releases must fit the frame, at most one universe of values per request
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    Messages::LayerEventData &data = event->data.layerData;
+    cJSON *values = cJSON_GetObjectItem(root, "values");
+    cJSON *release = cJSON_GetObjectItem(root, "release");
+    cJSON *merge = cJSON_GetObjectItem(root, "merge");
+    int first;
+    int count;
+    int priority;
+    bool hasFirst = get_int(cJSON_GetObjectItem(root, "first"), 0, DMX_FRAME_CHANNELS - 1, first);
+    if (hasFirst && values)
     {
-        cJSON_Delete(root);
-        return ret;
+        if (get_channel_values(values, data.values, sizeof(data.values), data.channelCount) &&
+            first + data.channelCount <= DMX_FRAME_CHANNELS)
+        {
+            event->type = Messages::SET_LAYER_CHANNELS;
+            data.firstChannel = (uint16_t)first;
+            err = send_controller_event(*event);
+        }
     }
-
-    // Load each preset
-    for (int i = 0; i < num_presets; i++)
+    else if (hasFirst && release)
     {
-        cJSON *preset_obj = cJSON_GetArrayItem(root, i);
-        if (!preset_obj || !cJSON_IsObject(preset_obj))
+        if (get_int(release, 0, DMX_FRAME_CHANNELS - first, count))
         {
-            ESP_LOGE(TAG, "Invalid preset object at index %d", i);
-            continue;
+            event->type = Messages::RELEASE_LAYER_CHANNELS;
+            data.firstChannel = (uint16_t)first;
+            data.channelCount = (uint16_t)count;
+            err = send_controller_event(*event);
         }
+    }
+    else if (get_int(cJSON_GetObjectItem(root, "priority"), 0, 255, priority) && merge && cJSON_IsString(merge) &&
+             (strcmp(merge->valuestring, "htp") == 0 || strcmp(merge->valuestring, "ltp") == 0))
+    {
+        event->type = Messages::SET_LAYER_MODE;
+        data.priority = (uint8_t)priority;
+        data.mergeMode = strcmp(merge->valuestring, "htp") == 0 ? DmxLayerStack::HTP : DmxLayerStack::LTP;
+        err = send_controller_event(*event);
+    }
+    if (err == ESP_ERR_INVALID_ARG)
+    {
+        ESP_LOGE(TAG, "Invalid layer request");
+    }
 
-        DmxPreset preset;
+    cJSON_Delete(root);
+    return err;
+}
+
+// {"effect":0,"waveform":"sine","rate":0.5,"spread":0.125,"depth":255,"offset":0,"width":0.25,"fixtureChannels":3}
+// defines an effect, {"effect":0,"first":0,"count":16,"member":true} or {"effect":0,"group":1} attaches channels,
+// {"effect":0,"stop":true} stops it. Rate is in Hz, spread and width are fractions of a cycle. The spread is applied
+// per fixture of fixtureChannels successive member channels (default 1).
+esp_err_t WebServer::json_to_effect(const char *json)
+{
+    cJSON *root = cJSON_Parse(json);
+    cJSON *effect = root ? cJSON_GetObjectItem(root, "effect") : nullptr;
+    if (!effect || !cJSON_IsNumber(effect) || effect->valueint < 0 || effect->valueint >= MAX_EFFECTS)
+    {
+        ESP_LOGE(TAG, "Invalid JSON: no valid effect");
+        if (root)
+            cJSON_Delete(root);
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    std::unique_ptr<Messages::Event> event(new Messages::Event());
+    Messages::EffectEventData &data = event->data.effectData;
+    data.effect = (uint8_t)effect->valueint;
+    data.group = Messages::NO_GROUP;
+
+    esp_err_t err = ESP_ERR_INVALID_ARG;
+    cJSON *waveform = cJSON_GetObjectItem(root, "waveform");
+    cJSON *first = cJSON_GetObjectItem(root, "first");
+    cJSON *count = cJSON_GetObjectItem(root, "count");
+    cJSON *group = cJSON_GetObjectItem(root, "group");
+    cJSON *stop = cJSON_GetObjectItem(root, "stop");
+    if (waveform && cJSON_IsString(waveform))
+    {
+        static const char *WAVEFORM_NAMES[DmxEffects::NUM_WAVEFORMS] = {"sine", "ramp", "chase", "random"};
+        data.waveform = DmxEffects::NUM_WAVEFORMS;
+        for (uint8_t i = 0; i < DmxEffects::NUM_WAVEFORMS; i++)
+        {
+            if (strcmp(waveform->valuestring, WAVEFORM_NAMES[i]) == 0)
+            {
+                data.waveform = i;
+            }
+        }
 
-        // Index
-        cJSON *index = cJSON_GetObjectItem(preset_obj, "index");
-        if (index && cJSON_IsNumber(index))
+        // Optional, absent ones get their defaults; present ones must be numbers
+        cJSON *rate = cJSON_GetObjectItem(root, "rate");
+        cJSON *spread = cJSON_GetObjectItem(root, "spread");
+        cJSON *depth = cJSON_GetObjectItem(root, "depth");
+        cJSON *offset = cJSON_GetObjectItem(root, "offset");
+        cJSON *width = cJSON_GetObjectItem(root, "width");
+        cJSON *fixtureChannels = cJSON_GetObjectItem(root, "fixtureChannels");
+        double rateHz = rate ? (cJSON_IsNumber(rate) ? rate->valuedouble : -1.0) : 1.0;
+        double spreadCycles = spread ? (cJSON_IsNumber(spread) ? spread->valuedouble : -1.0) : 0.0;
+        double widthCycles = width ? (cJSON_IsNumber(width) ? width->valuedouble : -1.0) : 0.25;
+        int depthValue = 255;
+        int offsetValue = 0;
+        int fixtureChannelsValue = 1;
+        bool validRate = rateHz >= 0 && rateHz * 1000 <= DmxEffects::MAX_RATE_MILLI_HZ;
+        if (data.waveform < DmxEffects::NUM_WAVEFORMS && validRate && spreadCycles >= 0 && widthCycles >= 0 &&
+            (!depth || get_int(depth, 0, 255, depthValue)) && (!offset || get_int(offset, 0, 255, offsetValue)) &&
+            (!fixtureChannels || get_int(fixtureChannels, 1, 255, fixtureChannelsValue)))
+        {
+            event->type = Messages::SET_EFFECT;
+            data.rateMilliHz = (uint32_t)(rateHz * 1000 + 0.5);
+            data.phaseSpread = (uint16_t)((spreadCycles - (int)spreadCycles) * 65536);
+            data.depth = (uint8_t)depthValue;
+            data.offset = (uint8_t)offsetValue;
+            data.width = widthCycles >= 1.0 ? 255 : (uint8_t)(widthCycles * 256);
+            data.fixtureChannels = (uint8_t)fixtureChannelsValue;
+            err = send_controller_event(*event);
+        }
+    }
+    else if (first && count)
+    {
+        cJSON *member = cJSON_GetObjectItem(root, "member");
+        int firstChannel;
+        int channelCount;
+        if (get_int(first, 0, DMX_FRAME_CHANNELS - 1, firstChannel) &&
+            get_int(count, 0, DMX_FRAME_CHANNELS - firstChannel, channelCount))
         {
-            preset.setIndex((uint8_t)index->valuedouble);
+            event->type = Messages::SET_EFFECT_CHANNELS;
+            data.firstChannel = (uint16_t)firstChannel;
+            data.channelCount = (uint16_t)channelCount;
+            data.member = !member || cJSON_IsTrue(member);
+            err = send_controller_event(*event);
         }
-        // Name
-        cJSON *name = cJSON_GetObjectItem(preset_obj, "name");
-        if (name && cJSON_IsString(name))
+    }
+    else if (group)
+    {
+        int groupId;
+        if (get_int(group, 0, MAX_CHANNEL_GROUPS - 1, groupId))
         {
-            preset.setName(name->valuestring);
+            event->type = Messages::SET_EFFECT_CHANNELS;
+            data.group = (uint8_t)groupId;
+            err = send_controller_event(*event);
         }
+    }
+    else if (stop && cJSON_IsTrue(stop))
+    {
+        event->type = Messages::STOP_EFFECT;
+        err = send_controller_event(*event);
+    }
+
+    cJSON_Delete(root);
+    return err;
+}
 
-        // Universe 1
-        cJSON *universe1 = cJSON_GetObjectItem(preset_obj, "universe1");
-        if (universe1 && cJSON_IsArray(universe1))
+// {"preset":3,"source":"input"}: preset defaults to the current preset, source to "output"
+esp_err_t WebServer::json_to_capture(const char *json)
+{
+    cJSON *root = cJSON_Parse(json);
+    if (!root)
+    {
+        ESP_LOGE(TAG, "Invalid JSON");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    std::unique_ptr<Messages::Event> event(new Messages::Event());
+    event->type = Messages::CAPTURE_PRESET;
+    event->data.captureData.presetNumber = Messages::CURRENT_PRESET;
+    event->data.captureData.source = Messages::CAPTURE_OUTPUT;
+
+    esp_err_t err = ESP_OK;
+    cJSON *preset = cJSON_GetObjectItem(root, "preset");
+    cJSON *source = cJSON_GetObjectItem(root, "source");
+    if (preset)
+    {
+        // Only into a preset of the show, a capture must not add a record past its end
+        int presetNumber = 0;
+        int numberOfPresets = storage_ ? storage_->getNumberOfPresets() : 0;
+        if (!get_int(preset, 0, numberOfPresets - 1, presetNumber))
         {
-            uint8_t u1_data[DMX_UNIVERSE_SIZE] = {0};
-            int u1_size = cJSON_GetArraySize(universe1);
-            int copy_size = u1_size < DMX_UNIVERSE_SIZE ? u1_size : DMX_UNIVERSE_SIZE;
-            for (int j = 0; j < copy_size; j++)
-            {
-                cJSON *val = cJSON_GetArrayItem(universe1, j);
-                if (val && cJSON_IsNumber(val))
-                {
-                    u1_data[j] = (uint8_t)val->valuedouble;
-                }
-            }
-            preset.setUniverseData(0, u1_data, DMX_UNIVERSE_SIZE);
+            err = ESP_ERR_INVALID_ARG;
+        }
+        else
+        {
+            event->data.captureData.presetNumber = (uint8_t)presetNumber;
         }
+    }
+    if (source)
+    {
+        if (cJSON_IsString(source) && strcmp(source->valuestring, "input") == 0)
+        {
+            event->data.captureData.source = Messages::CAPTURE_ARTNET_INPUT;
+        }
+        else if (!cJSON_IsString(source) || strcmp(source->valuestring, "output") != 0)
+        {
+            err = ESP_ERR_INVALID_ARG;
+        }
+    }
+
+    if (err == ESP_OK)
+    {
+        err = send_controller_event(*event);
+    }
+    cJSON_Delete(root);
+    return err;
+}
+
+// Stores the records of an uploaded show file as they arrive; the preset count and configuration are only applied
+// once the whole file has been received and its CRC matched
+class ShowImporter : public ShowBundleReader::Handler
+{
+  public:
+    explicit ShowImporter(NvsStorage &storage)
+        : reader(*this), numberOfPresets(0), hasConfiguration(false), presetsStored(0), storeError(ESP_OK),
+          storage_(storage)
+    {
+        memset(&configuration, 0, sizeof(configuration));
+    }
 
-        // Universe 2
-        cJSON *universe2 = cJSON_GetObjectItem(preset_obj, "universe2");
-        if (universe2 && cJSON_IsArray(universe2))
+    esp_err_t onRecord(uint8_t type, uint8_t id, const uint8_t *payload, uint16_t length) override
+    {
+        switch (type)
         {
-            uint8_t u2_data[DMX_UNIVERSE_SIZE] = {0};
-            int u2_size = cJSON_GetArraySize(universe2);
-            int copy_size = u2_size < DMX_UNIVERSE_SIZE ? u2_size : DMX_UNIVERSE_SIZE;
-            for (int j = 0; j < copy_size; j++)
+        case ShowBundle::CONFIGURATION:
+            hasConfiguration = ShowBundle::decodeConfiguration(payload, length, configuration) == ESP_OK;
+            return hasConfiguration ? ESP_OK : ESP_ERR_INVALID_SIZE;
+
+        case ShowBundle::PRESET_COUNT:
+            if (length != 1 || payload[0] < MIN_PRESETS || payload[0] > MAX_PRESETS)
             {
-                cJSON *val = cJSON_GetArrayItem(universe2, j);
-                if (val && cJSON_IsNumber(val))
-                {
-                    u2_data[j] = (uint8_t)val->valuedouble;
-                }
+                ESP_LOGE(TAG, "Invalid number of presets in show file");
+                return ESP_ERR_INVALID_ARG;
             }
-            preset.setUniverseData(1, u2_data, DMX_UNIVERSE_SIZE);
+            numberOfPresets = payload[0];
+            return ESP_OK;
+
+        case ShowBundle::PRESET:
+        {
+            esp_err_t err = storage_.importPresetRecord(id, payload, length);
+            presetsStored += err == ESP_OK;
+            storeError = err == ESP_ERR_INVALID_ARG ? ESP_OK : err; // Invalid records are errors of the file
+            return err;
         }
 
-        // Save preset
-        dmxPresets_->setPreset(i, preset);
+        default:
+            // Written by newer firmware
+            return ESP_OK;
+        }
     }
 
-    cJSON_Delete(root);
-    ESP_LOGI(TAG, "Loaded %d presets from JSON", num_presets);
-    return ESP_OK;
-}
+    ShowBundleReader reader;
+    uint8_t numberOfPresets; // 0 if not in the file
+    bool hasConfiguration;
+    Messages::ConfigurationEventData configuration;
+    uint16_t presetsStored;
+    esp_err_t storeError; // The storage failed, e.g. no room for the imported show next to the current one
 
-std::string WebServer::config_to_json()
+  private:
+    NvsStorage &storage_;
+};
+
+// Without configuration this is the packed binary form of /api/presets
+esp_err_t WebServer::send_show(httpd_req_t *req, bool withConfiguration)
 {
-    // TODO if (!configurator_)
+    // One record at a time, so the memory used does not depend on the size of the show
+    std::vector<uint8_t> chunk(ShowBundle::MAX_RECORD_SIZE);
+    std::vector<uint8_t> record(DmxPresetRecord::MAX_SIZE);
+    ShowBundleWriter writer;
+
+    httpd_resp_set_type(req, "application/octet-stream");
+    if (withConfiguration)
     {
-        return "{}";
+        httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"show.dmxshow\"");
     }
+    size_t size = writer.writeHeader(chunk.data(), chunk.size());
+    esp_err_t err = httpd_resp_send_chunk(req, reinterpret_cast<const char *>(chunk.data()), size);
 
-    cJSON *root = cJSON_CreateObject();
-    if (!root)
+    Messages::ConfigurationEventData configuration;
+    if (err == ESP_OK && withConfiguration && storage_->readConfiguration(configuration) == ESP_OK)
     {
-        return "{}";
+        uint8_t payload[ShowBundle::CONFIGURATION_SIZE];
+        ShowBundle::encodeConfiguration(configuration, payload);
+        size = writer.writeRecord(
+            ShowBundle::CONFIGURATION, 0, payload, sizeof(payload), chunk.data(), chunk.size());
+        err = httpd_resp_send_chunk(req, reinterpret_cast<const char *>(chunk.data()), size);
     }
 
-    // TODO const char *polarity_str = (footSwitch->getFootSwitchPolarity() == FootSwitch::NORMAL) ? "NORMAL" :
-    // "INVERSE";
-    // TODO cJSON_AddStringToObject(root, "footSwitchPolarity", polarity_str);
-    // TODO cJSON_AddNumberToObject(root, "footSwitchLongPressTime", configurator_->getLongPressTimeMs());
+    uint8_t numberOfPresets = storage_->getNumberOfPresets();
+    if (err == ESP_OK)
+    {
+        size = writer.writeRecord(ShowBundle::PRESET_COUNT, 0, &numberOfPresets, sizeof(numberOfPresets),
+            chunk.data(), chunk.size());
+        err = httpd_resp_send_chunk(req, reinterpret_cast<const char *>(chunk.data()), size);
+    }
 
-    char *json_str = cJSON_Print(root);
-    std::string result = json_str ? json_str : "{}";
-    cJSON_free(json_str);
-    cJSON_Delete(root);
+    for (uint8_t index = 0; index < numberOfPresets && err == ESP_OK; index++)
+    {
+        // A preset that was never stored is left out, and is empty after an import
+        size_t length = 0;
+        if (storage_->readPresetRecord(index, record.data(), record.size(), length) != ESP_OK)
+        {
+            continue;
+        }
+        size = writer.writeRecord(ShowBundle::PRESET, index, record.data(), length, chunk.data(), chunk.size());
+        err = httpd_resp_send_chunk(req, reinterpret_cast<const char *>(chunk.data()), size);
+    }
 
-    return result;
+    if (err == ESP_OK)
+    {
+        size = writer.writeEnd(chunk.data(), chunk.size());
+        err = httpd_resp_send_chunk(req, reinterpret_cast<const char *>(chunk.data()), size);
+    }
+    if (err != ESP_OK)
+    {
+        // The response has started, the client sees a truncated file without an end record
+        ESP_LOGE(TAG, "Failed to send show: %s", esp_err_to_name(err));
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, nullptr, 0);
 }
 
-esp_err_t WebServer::json_to_config(const char *json, FootSwitch *footSwitch)
+// Without configuration (the packed binary form of /api/presets) configuration records are ignored and the presets
+// are required
+esp_err_t WebServer::receive_show(httpd_req_t *req, bool withConfiguration)
 {
-    if (!footSwitch || !json)
+    // The HTTP server needs the body length, chunked request bodies are not supported
+    if (req->content_len == 0)
     {
-        return ESP_ERR_INVALID_ARG;
+        return send_error_response(req, HTTPD_411_LENGTH_REQUIRED, "Content-Length required");
     }
 
-    cJSON *root = cJSON_Parse(json);
-    if (!root || !cJSON_IsObject(root))
+    // Staged as one transaction, so the stored show switches to the imported one only once all of it arrived
+    if (storage_->beginShowImport() != ESP_OK)
     {
-        ESP_LOGE(TAG, "Invalid JSON: not an object");
-        if (root)
-            cJSON_Delete(root);
-        return ESP_ERR_INVALID_ARG;
+        return send_error_response(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Show import not possible");
+    }
+
+    // Parsed while it arrives, so the memory used does not depend on the size of the show
+    std::unique_ptr<ShowImporter> importer(new ShowImporter(*storage_));
+    std::vector<char> chunk(1024);
+    size_t remaining = req->content_len;
+    esp_err_t err = ESP_OK;
+    while (remaining > 0 && err == ESP_OK)
+    {
+        int ret = httpd_req_recv(req, chunk.data(), remaining < chunk.size() ? remaining : chunk.size());
+        if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            ESP_LOGE(TAG, "Show upload aborted with %d bytes left", (int)remaining);
+            storage_->abortShowImport();
+            return ESP_FAIL;
+        }
+        remaining -= ret;
+        err = importer->reader.feed(reinterpret_cast<const uint8_t *>(chunk.data()), ret);
+    }
+
+    bool storeConfiguration = importer->hasConfiguration && withConfiguration;
+    if (err == ESP_OK && importer->reader.isComplete() && (withConfiguration || importer->numberOfPresets > 0))
+    {
+        // The configuration is not part of the transaction: it is written before the commit and the previous one is
+        // written back if the commit fails. Only a power cut between the two leaves the new configuration with the
+        // old presets.
+        Messages::ConfigurationEventData previousConfiguration;
+        bool configurationStored = false;
+        if (storeConfiguration)
+        {
+            err = storage_->readConfiguration(previousConfiguration);
+            err = err == ESP_OK ? storage_->writeConfiguration(importer->configuration) : err;
+            configurationStored = err == ESP_OK;
+        }
+        err = err == ESP_OK ? storage_->commitShowImport(importer->numberOfPresets) : err;
+        importer->storeError = err;
+        if (err != ESP_OK && configurationStored && storage_->writeConfiguration(previousConfiguration) != ESP_OK)
+        {
+            ESP_LOGE(TAG, "Failed to restore the configuration after the show import failed");
+        }
+    }
+    else
+    {
+        err = err != ESP_OK ? err : ESP_ERR_INVALID_SIZE;
+    }
+    if (err != ESP_OK)
+    {
+        // Nothing of the stored show has changed
+        storage_->abortShowImport();
+        ESP_LOGE(TAG, "Show import failed after %d presets", importer->presetsStored);
+        return importer->storeError != ESP_OK
+                   ? send_error_response(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Failed to store show")
+                   : send_error_response(req, HTTPD_400_BAD_REQUEST, "Invalid show file");
+    }
+
+    if (storeConfiguration)
+    {
+        // Already stored before the commit
+        std::unique_ptr<Messages::Event> event(new Messages::Event());
+        event->type = Messages::SET_CONFIGURATION;
+        event->data.configurationData = importer->configuration;
+        send_controller_event(*event);
+    }
+    if (importer->numberOfPresets > 0)
+    {
+        // Already stored by the commit
+        std::unique_ptr<Messages::Event> event(new Messages::Event());
+        event->data.presetsData.numberOfPresets = importer->numberOfPresets;
+        event->type = Messages::SET_PRESETS;
+        send_controller_event(*event);
+    }
+
+    ESP_LOGI(TAG, "Imported show with %d presets", importer->presetsStored);
+    return send_json_response(req, "{\"status\":\"ok\"}");
+}
+
+std::string WebServer::diagnostics_to_json()
+{
+    cJSON *root = cJSON_CreateObject();
+    if (!root)
+    {
+        return "{}";
     }
 
-    // Foot switch polarity
-    cJSON *polarity = cJSON_GetObjectItem(root, "footSwitchPolarity");
-    if (polarity && cJSON_IsString(polarity))
+    if (storage_)
     {
-        // TODO Get foot switch polarity and long press threshold
+        NvsStorage::Stats stats = storage_->getStats();
+        cJSON *storage = cJSON_AddObjectToObject(root, "storage");
+        cJSON_AddNumberToObject(storage, "presetSaves", stats.presetSaves);
+        cJSON_AddNumberToObject(storage, "presetWrites", stats.presetWrites);
+        cJSON_AddNumberToObject(storage, "presetsUnchanged", stats.presetsUnchanged);
+        cJSON_AddNumberToObject(storage, "payloadBytes", stats.payloadBytes);
+        cJSON_AddNumberToObject(storage, "flashBytes", stats.flashBytes);
+        // Flash bytes per byte of preset content that actually changed
+        cJSON_AddNumberToObject(storage, "writeAmplification",
+            stats.payloadBytes ? (double)stats.flashBytes / stats.payloadBytes : 0.0);
+        cJSON_AddNumberToObject(storage, "coalescedWrites", stats.coalescedWrites);
+        cJSON_AddNumberToObject(storage, "pendingWrites", stats.pendingWrites);
+        cJSON_AddNumberToObject(storage, "commitWindowMs", storage_->getCommitWindow());
+        cJSON_AddNumberToObject(storage, "commits", stats.commits);
+        cJSON_AddNumberToObject(storage, "batches", stats.batches);
+        cJSON_AddNumberToObject(storage, "commitsPerHour", stats.commitsPerHour);
+        cJSON_AddNumberToObject(storage, "lastCommitUs", stats.lastCommitUs);
+        cJSON_AddNumberToObject(storage, "maxCommitUs", stats.maxCommitUs);
+        cJSON_AddNumberToObject(storage, "averageCommitUs", stats.batches ? stats.totalCommitUs / stats.batches : 0);
+        cJSON_AddNumberToObject(storage, "maxWriteDelayMs", stats.maxWriteDelayMs);
+        cJSON_AddNumberToObject(storage, "estimatedSectorErases", stats.estimatedSectorErases);
+        cJSON *log = cJSON_AddObjectToObject(storage, "presetLog");
+        cJSON_AddNumberToObject(log, "totalSectors", stats.log.totalSectors);
+        cJSON_AddNumberToObject(log, "freeSectors", stats.log.freeSectors);
+        cJSON_AddNumberToObject(log, "usedBytes", stats.log.usedBytes);
+        cJSON_AddNumberToObject(log, "liveBytes", stats.log.liveBytes);
+        cJSON_AddNumberToObject(log, "compactions", stats.log.compactions);
+        cJSON_AddNumberToObject(log, "entriesScanned", stats.log.entriesScanned);
+        cJSON_AddNumberToObject(log, "bootScanUs", stats.log.bootScanUs);
     }
 
+    char *json = cJSON_PrintUnformatted(root);
+    std::string result = json ? json : "{}";
+    cJSON_free(json);
     cJSON_Delete(root);
-    ESP_LOGI(TAG, "Configuration updated from JSON");
-    return ESP_OK;
-}
\ No newline at end of file
+    return result;
+}
@@ -1,15 +1,21 @@
 #pragma once
 #include <esp_http_server.h>
 #include <esp_err.h>
+#include "asset_pack.hpp"
 #include "dmx_presets.hpp"
 #include <string>
 #include "foot_switch.hpp"
+#include "live_overrides.hpp"
+#include "nvs_storage.hpp"
+#include "preset_json_parser.hpp"
+#include "messages.hpp"
 
 extern "C"
 {
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 #include <freertos/queue.h>
+#include <freertos/semphr.h>
 }
 
 class WebServer
@@ -19,45 +25,146 @@ public:
     {
         START_SERVER,
         STOP_SERVER,
-        RESTART_SERVER
+        RESTART_SERVER,
+
+        // Controller state, pushed to the /ws/state clients
+        PRESET_SELECTED,       // data.presetNumber is output
+        PRESET_CHANGED,        // data.presetNumber was edited and stored
+        PRESETS_CHANGED,       // data.numberOfPresets presets were (re)loaded, e.g. after an import
+        CONFIGURATION_CHANGED, // data.configuration
+        PRESET_EDIT_FAILED,    // An edit of data.presetNumber (Messages::CURRENT_PRESET: the selected one) was lost
+        EDIT_FAILED            // An output, configuration or show change was lost after it had been accepted
     };
     struct WebServerEvent
     {
         EventType type;
+        union
+        {
+            uint8_t presetNumber;
+            uint8_t numberOfPresets;
+            Messages::ConfigurationEventData configuration;
+        } data;
     };
 
     WebServer();
     ~WebServer();
 
-    esp_err_t init();
+    esp_err_t init(QueueHandle_t dmxControllerEventQueue, LiveOverrides *liveOverrides, NvsStorage *storage);
     esp_err_t start();
     esp_err_t stop();
 
-    // Post an event to the web server task
+    // Post an event to the web server task; never blocks, the event is dropped when the queue is full
     void postEvent(const WebServerEvent &event);
 
 private:
+    static const size_t EVENT_QUEUE_CAPACITY = 16;
+
+    // Long-running handlers (static files, preset list, show file) run on these workers, so the httpd task stays free
+    // for the API. Their priority is below the output tasks (5), a transfer never delays DMX output.
+    static const size_t ASYNC_WORKERS = 2;
+    static const UBaseType_t ASYNC_WORKER_PRIORITY = 3;
+    static const size_t ASYNC_QUEUE_CAPACITY = 4; // Requests waiting for a worker, more get 503
+    typedef esp_err_t (*RequestHandler)(httpd_req_t *req);
+    struct AsyncRequest
+    {
+        httpd_req_t *req; // Copy from httpd_req_async_handler_begin
+        RequestHandler handler;
+    };
+    static const size_t MAX_STATE_CLIENTS = 4;
+    static const uint32_t STATE_RETRY_MS = 100;           // Next try for a frame a client's socket could not take
+    static const uint32_t STATE_CLIENT_TIMEOUT_MS = 5000; // A client that takes nothing for this long is closed
+
+    // What a /ws/state client has not been sent yet. Changes are merged into these flags rather than queued, so a
+    // slow client needs no more memory however far it falls behind: at most the frame in flight, and the latest state
+    // once that has gone out.
+    struct StateClient
+    {
+        int socket; // -1 for a free slot
+        std::string frame; // WebSocket frame being sent, empty if none; only used on the httpd task
+        size_t frameSent;
+        int64_t stalledSinceUs; // When the socket stopped taking the frame, 0 while it does
+        bool presetSelected;
+        bool presetsChanged;
+        bool configurationChanged;
+        bool editFailed;
+        uint32_t changedPresets[(MAX_PRESETS + 31) / 32];
+        uint32_t failedPresets[(MAX_PRESETS + 31) / 32];
+    };
+
     httpd_handle_t server_;
     bool initialized_;
 
     TaskHandle_t taskHandle_;
     QueueHandle_t eventQueue_;
+    TaskHandle_t asyncWorkers_[ASYNC_WORKERS];
+    QueueHandle_t asyncQueue_;
+    QueueHandle_t dmxControllerEventQueue_;
+    LiveOverrides *liveOverrides_;
+    NvsStorage *storage_;
+
+    AssetPack assets_; // Static files of the web UI
+
+    // Latest controller state: updated by the web server task, sent by the httpd task (which owns the sockets)
+    SemaphoreHandle_t stateMutex_;
+    StateClient stateClients_[MAX_STATE_CLIENTS];
+    uint8_t selectedPreset_;
+    uint8_t numberOfPresets_;
+    Messages::ConfigurationEventData configuration_;
+    bool statePushQueued_; // push_state is queued on the httpd task and has not started yet
+    bool stateBacklog_;    // A client has a frame in flight, the web server task queues another push
 
-    void init_spiffs();
     static void taskEntry(void *param);
     void taskLoop();
+    static void asyncWorkerEntry(void *param);
+    void asyncWorkerLoop();
+    bool is_async_worker() const;
+    esp_err_t submit_async(httpd_req_t *req, RequestHandler handler);
+    void handle_state_event(const WebServerEvent &event);
+    void register_state_client(int socket);
+    void queue_state_push();
+    static void push_state_work(void *param);
+    void push_state();
+    bool build_state_message(StateClient &client, std::string &message);
+    esp_err_t send_state_frame(StateClient &client, int socket);
 
     static esp_err_t root_handler(httpd_req_t *req);
     static esp_err_t api_presets_handler(httpd_req_t *req);
     static esp_err_t api_config_handler(httpd_req_t *req);
+    static esp_err_t api_masters_handler(httpd_req_t *req);
+    static esp_err_t api_curves_handler(httpd_req_t *req);
+    static esp_err_t api_layers_handler(httpd_req_t *req);
+    static esp_err_t api_effects_handler(httpd_req_t *req);
+    static esp_err_t api_capture_handler(httpd_req_t *req);
+    static esp_err_t api_preset_delta_handler(httpd_req_t *req);
+    static esp_err_t api_preset_handler(httpd_req_t *req);
+    static esp_err_t api_diagnostics_handler(httpd_req_t *req);
+    static esp_err_t api_show_handler(httpd_req_t *req);
     static esp_err_t static_file_handler(httpd_req_t *req);
+    static esp_err_t ws_live_handler(httpd_req_t *req);
+    static esp_err_t ws_state_handler(httpd_req_t *req);
 
     esp_err_t send_json_response(httpd_req_t *req, const char *json);
     esp_err_t send_error_response(httpd_req_t *req, int status, const char *message);
-    std::string presets_to_json();
-    esp_err_t json_to_presets(const char *json);
+    esp_err_t send_busy_response(httpd_req_t *req, const char *message);
+    esp_err_t receive_body(httpd_req_t *req, char *body, size_t capacity);
+    esp_err_t send_presets(httpd_req_t *req, PresetJsonParser::UniverseEncoding encoding);
+    esp_err_t receive_presets(httpd_req_t *req, PresetJsonParser::UniverseEncoding encoding);
+    esp_err_t send_preset(httpd_req_t *req, uint8_t index, PresetJsonParser::UniverseEncoding encoding);
+    esp_err_t receive_preset(httpd_req_t *req, uint8_t index, PresetJsonParser::UniverseEncoding encoding);
+    esp_err_t patch_preset(httpd_req_t *req, uint8_t index);
     std::string config_to_json();
-    esp_err_t json_to_config(const char *json, FootSwitch *footSwitch);
+    std::string diagnostics_to_json();
+    esp_err_t send_show(httpd_req_t *req, bool withConfiguration);
+    esp_err_t receive_show(httpd_req_t *req, bool withConfiguration);
+    esp_err_t json_to_config(const char *json);
+    esp_err_t json_to_masters(const char *json);
+    esp_err_t json_to_curves(const char *json);
+    esp_err_t json_to_layer(const char *json);
+    esp_err_t json_to_preset_delta(const char *json, uint8_t *delta, size_t capacity, size_t &length);
+    esp_err_t json_to_effect(const char *json);
+    esp_err_t json_to_capture(const char *json);
+    esp_err_t send_controller_event(const Messages::Event &event);
+    esp_err_t handle_live_commands(char *commands);
 
     static WebServer *instance_;
 };
\ No newline at end of file
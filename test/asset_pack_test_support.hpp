@@ -0,0 +1,114 @@
+#pragma once
+
+#include "asset_pack.hpp"
+#include <algorithm>
+#include <cstring>
+#include <esp_rom_crc.h>
+#include <string>
+#include <vector>
+
+// Shared by the AssetPack test and benchmark: builds packs in memory the way tools/pack_assets.py writes them
+typedef std::vector<uint8_t> Bytes;
+
+struct PackFile
+{
+    std::string path;
+    std::string contentType;
+    Bytes data;    // Empty with gzipOnly
+    Bytes gzip;    // Empty without a gzip variant
+    bool gzipOnly; // Only the gzip variant is stored
+};
+
+class PackBuilder
+{
+  public:
+    static const size_t HEADER_SIZE = 16;
+    static const size_t ENTRY_SIZE = 32;
+
+    // Files in any order, sorted by path as the packer does; the CRC over everything after the header is filled in
+    static Bytes build(std::vector<PackFile> files)
+    {
+        std::sort(files.begin(), files.end(), [](const PackFile &a, const PackFile &b) { return a.path < b.path; });
+        PackBuilder builder(files.size());
+        Bytes index;
+        for (const PackFile &file : files)
+        {
+            uint32_t entry[8] = {builder.addString(file.path), builder.addString(file.contentType),
+                builder.addString("\"" + file.path + "\""), 0, 0, 0, 0, 0};
+            if (!file.gzipOnly)
+            {
+                entry[4] = builder.addData(file.data);
+                entry[5] = file.data.size();
+            }
+            if (!file.gzip.empty())
+            {
+                entry[3] = builder.addString("\"" + file.path + "-gz\"");
+                entry[6] = builder.addData(file.gzip);
+                entry[7] = file.gzip.size();
+            }
+            for (uint32_t value : entry)
+            {
+                appendUint32(index, value);
+            }
+        }
+        builder.align();
+
+        Bytes pack = {'D', 'M', 'X', 'A', 1, 0, (uint8_t)files.size(), (uint8_t)(files.size() >> 8)};
+        appendUint32(pack, HEADER_SIZE + index.size() + builder.body_.size());
+        appendUint32(pack, 0);
+        pack.insert(pack.end(), index.begin(), index.end());
+        pack.insert(pack.end(), builder.body_.begin(), builder.body_.end());
+        updateCrc(pack);
+        return pack;
+    }
+
+    // After changing a pack on purpose, so that the checks behind the CRC are reached
+    static void updateCrc(Bytes &pack)
+    {
+        uint32_t crc = esp_rom_crc32_le(0, pack.data() + HEADER_SIZE, pack.size() - HEADER_SIZE);
+        memcpy(pack.data() + 12, &crc, 4);
+    }
+
+    static void appendUint32(Bytes &bytes, uint32_t value)
+    {
+        for (int shift = 0; shift < 32; shift += 8)
+        {
+            bytes.push_back(value >> shift);
+        }
+    }
+
+  private:
+    explicit PackBuilder(size_t count) : base_(HEADER_SIZE + count * ENTRY_SIZE) {}
+
+    uint32_t addString(const std::string &text)
+    {
+        uint32_t offset = base_ + body_.size();
+        body_.insert(body_.end(), text.begin(), text.end());
+        body_.push_back(0);
+        return offset;
+    }
+
+    uint32_t addData(const Bytes &data)
+    {
+        align();
+        uint32_t offset = base_ + body_.size();
+        body_.insert(body_.end(), data.begin(), data.end());
+        return offset;
+    }
+
+    void align() { body_.resize((body_.size() + 3) & ~3UL); }
+
+    size_t base_;
+    Bytes body_;
+};
+
+// Content of the given length where every file differs
+inline Bytes makeContent(size_t length, uint8_t seed)
+{
+    Bytes data(length);
+    for (size_t i = 0; i < length; i++)
+    {
+        data[i] = seed + i * 7;
+    }
+    return data;
+}
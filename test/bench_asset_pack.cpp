@@ -0,0 +1,36 @@
+#include "asset_pack_test_support.hpp"
+#include "bench_support.hpp"
+#include <cstdio>
+
+// A UI bundle of 40 files (code split chunks, fonts, icons) in a 128 KiB pack, as large as the partition allows
+int main()
+{
+    std::vector<PackFile> files;
+    files.push_back({"/index.html", "text/html", makeContent(700, 0), makeContent(400, 1), false});
+    for (int file = 1; file < 40; file++)
+    {
+        char path[48];
+        snprintf(path, sizeof(path), "/assets/chunk-%02d-%08X.js", file, file * 0x9E3779B1u);
+        files.push_back({path, "application/javascript", Bytes(), makeContent(3000, file), true});
+    }
+    Bytes image = PackBuilder::build(files);
+    image.resize(0x20000);
+    printf("pack: %zu files, %zu bytes\n", files.size(), image.size());
+
+    AssetPack pack;
+    benchReport("attach, CRC and index check", benchNs(200, [&] { pack.attach(image.data(), image.size()); }));
+
+    AssetPack::Asset asset;
+    size_t file = 0;
+    benchReport("find, hit", benchNs(200000, [&] {
+        const std::string &path = files[file].path;
+        pack.find(path.c_str(), path.size(), asset);
+        benchKeep(&asset);
+        file = (file + 1) % files.size();
+    }));
+    benchReport("find, miss", benchNs(200000, [&] {
+        pack.find("/presets/12", 11, asset);
+        benchKeep(&asset);
+    }));
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "bench_support.hpp"
+#include "dmx_curves.hpp"
+
+// Curve evaluated per channel and frame, the way it was done before the lookup tables, kept as the baseline
+static void applyComputed(DmxFrame &frame)
+{
+    uint8_t *channels = frame.channels();
+    for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+    {
+        uint32_t v = channels[channel];
+        channels[channel] = (v * v * (3 * 255 - 2 * v) + (255 * 255) / 2) / (255 * 255);
+    }
+}
+
+static void fillFrame(DmxFrame &frame)
+{
+    for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+        frame.channels()[channel] = channel & 0xFF;
+}
+
+int main()
+{
+    const long calls = 20000;
+    DmxFrame frame;
+    fillFrame(frame);
+
+    DmxCurves curves;
+    benchReport("apply, all channels linear", benchNs(calls, [&] { curves.apply(frame); benchKeep(frame.words); }));
+
+    uint8_t inverted[256];
+    for (int v = 0; v < 256; v++)
+        inverted[v] = 255 - v;
+    curves.setChannelCurve(0, 100, DmxCurves::SQUARE_LAW, nullptr);
+    curves.setChannelCurve(100, 100, DmxCurves::S_CURVE, nullptr);
+    curves.setChannelCurve(200, 100, DmxCurves::CUSTOM, inverted);
+    curves.setChannelCurve(300, 100, DmxCurves::SQUARE_LAW, nullptr);
+    benchReport("apply, 400 channels on 3 tables", benchNs(calls, [&] { curves.apply(frame); benchKeep(frame.words); }));
+
+    curves.setChannelCurve(0, DMX_FRAME_CHANNELS, DmxCurves::S_CURVE, nullptr);
+    benchReport("apply, 1024 channels S-curve", benchNs(calls, [&] { curves.apply(frame); benchKeep(frame.words); }));
+    benchReport("computed S-curve baseline, 1024 channels",
+        benchNs(calls, [&] { applyComputed(frame); benchKeep(frame.words); }));
+
+    DmxCurves setup;
+    benchReport("setChannelCurve, S-curve on 512 channels",
+        benchNs(calls / 10, [&] { setup.setChannelCurve(0, 512, DmxCurves::S_CURVE, nullptr); }));
+    return 0;
+}
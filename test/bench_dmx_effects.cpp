@@ -0,0 +1,36 @@
+#include "bench_support.hpp"
+#include "dmx_effects.hpp"
+#include <cstdio>
+
+// One effect per waveform on 128, 512 and 1024 channels, rendered at 40 frames per second
+int main()
+{
+    static const char *const WAVEFORMS[DmxEffects::NUM_WAVEFORMS] = {"sine", "ramp", "chase", "random"};
+    const long calls = 5000;
+
+    for (int waveform = 0; waveform < DmxEffects::NUM_WAVEFORMS; waveform++)
+    {
+        for (uint16_t channels : {128, 512, 1024})
+        {
+            DmxEffects effects;
+            DmxLayerStack layers;
+            DmxEffects::Parameters parameters = {(DmxEffects::Waveform)waveform, 1500, 1000, 200, 20, 64, 3};
+            effects.setEffect(0, parameters);
+            effects.setEffectChannels(0, 0, channels, true);
+
+            char name[64];
+            snprintf(name, sizeof(name), "apply, %s on %d channels", WAVEFORMS[waveform], channels);
+            int64_t nowUs = 1;
+            benchReport(name, benchNs(calls, [&] {
+                effects.apply(layers, nowUs += 25000);
+                benchKeep(layers.getValues(DmxLayerStack::EFFECT));
+            }));
+        }
+    }
+
+    DmxEffects effects;
+    DmxLayerStack layers;
+    int64_t nowUs = 1;
+    benchReport("apply, no active effects", benchNs(calls, [&] { effects.apply(layers, nowUs += 25000); }));
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include "bench_support.hpp"
+#include "dmx_layer_stack.hpp"
+#include <cstdio>
+#include <cstring>
+
+// Composite with a full preset and 0..3 sparse layers on top
+int main()
+{
+    const long calls = 20000;
+    uint8_t values[DMX_FRAME_CHANNELS];
+    memset(values, 100, sizeof(values));
+
+    for (int layers = 1; layers <= DmxLayerStack::NUM_LAYERS; layers++)
+    {
+        DmxLayerStack stack;
+        stack.setChannels(DmxLayerStack::BASE, 0, values, DMX_FRAME_CHANNELS);
+        if (layers > 1)
+        {
+            for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel += 4)
+                stack.setChannel(DmxLayerStack::EFFECT, channel, 1);
+        }
+        if (layers > 2)
+        {
+            for (uint16_t channel = 0; channel < 64; channel++)
+                stack.setChannel(DmxLayerStack::OVERRIDE, channel * 7, 1);
+        }
+        if (layers > 3)
+        {
+            for (uint16_t channel = 0; channel < 16; channel++)
+                stack.setChannel(DmxLayerStack::PARK, channel * 50, 1);
+        }
+
+        char name[64];
+        snprintf(name, sizeof(name), "composite, preset + %d sparse layers", layers - 1);
+        DmxFrame frame;
+        benchReport(name, benchNs(calls, [&] { stack.composite(frame); benchKeep(frame.words); }));
+    }
+
+    DmxLayerStack stack;
+    stack.setChannels(DmxLayerStack::BASE, 0, values, 100);
+    DmxFrame frame;
+    benchReport("composite, 100 channel preset only",
+        benchNs(calls, [&] { stack.composite(frame); benchKeep(frame.words); }));
+    return 0;
+}
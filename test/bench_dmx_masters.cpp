@@ -0,0 +1,45 @@
+#include "bench_support.hpp"
+#include "dmx_masters.hpp"
+
+// Per channel scaling as it was before the packed kernel, kept here as the baseline
+static void applyPerChannel(DmxFrame &frame, const DmxMasters &masters)
+{
+    uint8_t *channels = frame.channels();
+    for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+    {
+        uint32_t level = masters.getGrandMaster();
+        for (uint8_t group = 0; group < MAX_CHANNEL_GROUPS; group++)
+        {
+            const uint32_t *members = masters.getGroupMembers(group);
+            if (members && (members[channel >> 5] & (1u << (channel & 31))))
+                level = level * masters.getGroupLevel(group) / 255;
+        }
+        channels[channel] = channels[channel] * level / 255;
+    }
+}
+
+int main()
+{
+    const long calls = 20000;
+    DmxFrame frame;
+    for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+        frame.channels()[channel] = channel & 0xFF;
+
+    DmxMasters masters;
+    benchReport("apply, all levels full", benchNs(calls, [&] { masters.apply(frame); benchKeep(frame.words); }));
+
+    masters.setGrandMaster(180);
+    benchReport("apply, grand master only", benchNs(calls, [&] { masters.apply(frame); benchKeep(frame.words); }));
+
+    for (uint8_t group = 0; group < MAX_CHANNEL_GROUPS; group++)
+    {
+        masters.setGroup(group, "group");
+        masters.setGroupChannels(group, group * 61, 90, true);
+        masters.setGroupLevel(group, 200);
+    }
+    benchReport("apply, grand master + 16 groups of 90 channels",
+        benchNs(calls, [&] { masters.apply(frame); benchKeep(frame.words); }));
+    benchReport("per channel baseline, same masters",
+        benchNs(calls / 10, [&] { applyPerChannel(frame, masters); benchKeep(frame.words); }));
+    return 0;
+}
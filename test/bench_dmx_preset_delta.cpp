@@ -0,0 +1,85 @@
+#include "bench_support.hpp"
+#include "dmx_preset_delta.hpp"
+#include <random>
+#include <vector>
+
+// A show of 250 presets where each preset is the next look of the previous one: universe 1 holds 40 RGBWD pars
+// (200 channels), universe 2 holds 24 16-channel moving heads (384 channels)
+static std::vector<DmxPreset> makeShow()
+{
+    std::mt19937 rng(1);
+    std::vector<DmxPreset> show(250);
+    uint8_t pars[200];
+    uint8_t heads[384];
+    for (uint8_t &value : pars)
+        value = rng();
+    for (uint8_t &value : heads)
+        value = rng();
+    for (DmxPreset &preset : show)
+    {
+        for (uint32_t recolour = rng() % 20; recolour > 0; recolour--)
+        {
+            uint32_t fixture = rng() % 40;
+            for (int channel = 0; channel < 4; channel++)
+                pars[fixture * 5 + channel] = rng();
+        }
+        for (uint32_t moved = rng() % 12; moved > 0; moved--)
+        {
+            uint32_t fixture = rng() % 24;
+            for (int channel = 0; channel < 4; channel++)
+                heads[fixture * 16 + channel] = rng();
+        }
+        if (rng() % 3 == 0)
+        {
+            for (int fixture = 0; fixture < 40; fixture++)
+                pars[fixture * 5 + 4] = rng() % 2 ? 255 : 0;
+        }
+        preset.setUniverseData(0, pars, sizeof(pars));
+        preset.setUniverseData(1, heads, sizeof(heads));
+    }
+    return show;
+}
+
+int main()
+{
+    std::vector<DmxPreset> show = makeShow();
+    const size_t steps = show.size() - 1;
+    std::vector<std::vector<uint8_t>> deltas(steps);
+    size_t totalSize = 0;
+    size_t maxSize = 0;
+    for (size_t step = 0; step < steps; step++)
+    {
+        uint8_t out[DmxPresetDelta::MAX_SIZE];
+        size_t length = 0;
+        DmxPresetDelta::encode(show[step], show[step + 1], out, sizeof(out), length);
+        deltas[step].assign(out, out + length);
+        totalSize += length;
+        maxSize = length > maxSize ? length : maxSize;
+    }
+    printf("neighbour deltas: average %zu bytes, largest %zu bytes\n", totalSize / steps, maxSize);
+
+    size_t step = 0;
+    benchReport("encode, neighbour presets", benchNs(20000, [&] {
+        uint8_t out[DmxPresetDelta::MAX_SIZE];
+        size_t length = 0;
+        DmxPresetDelta::encode(show[step], show[step + 1], out, sizeof(out), length);
+        benchKeep(out);
+        step = (step + 1) % steps;
+    }));
+
+    DmxPreset preset;
+    step = 0;
+    benchReport("copyFrom + apply, neighbour presets", benchNs(20000, [&] {
+        preset.copyFrom(show[step]);
+        DmxPresetDelta::apply(preset, deltas[step].data(), deltas[step].size());
+        benchKeep(&preset);
+        step = (step + 1) % steps;
+    }));
+    step = 0;
+    benchReport("copyFrom only, for reference", benchNs(20000, [&] {
+        preset.copyFrom(show[step]);
+        benchKeep(&preset);
+        step = (step + 1) % steps;
+    }));
+    return 0;
+}
@@ -0,0 +1,63 @@
+#include "bench_support.hpp"
+#include "dmx_preset_record.hpp"
+#include <random>
+
+// Encode and decode of a preset with noisy values (stored raw) and of a typical preset (stored packed)
+static void benchPreset(const char *kind, const DmxPreset &preset)
+{
+    uint8_t record[DmxPresetRecord::MAX_SIZE];
+    size_t length = DmxPresetRecord::encode(preset, record, sizeof(record));
+    printf("%s preset: %zu byte record\n", kind, length);
+
+    char name[64];
+    snprintf(name, sizeof(name), "encode, %s preset", kind);
+    benchReport(name, benchNs(20000, [&] {
+        DmxPresetRecord::encode(preset, record, sizeof(record));
+        benchKeep(record);
+    }));
+
+    DmxPreset decoded;
+    snprintf(name, sizeof(name), "decode (CRC checked), %s preset", kind);
+    benchReport(name, benchNs(20000, [&] {
+        DmxPresetRecord::decode(record, length, decoded);
+        benchKeep(&decoded);
+    }));
+}
+
+int main()
+{
+    std::mt19937 rng(1);
+    uint8_t values[DMX_UNIVERSE_SIZE];
+
+    DmxPreset noisy;
+    noisy.setName("Noise");
+    for (uint8_t universe = 0; universe < 2; universe++)
+    {
+        for (uint8_t &value : values)
+            value = rng();
+        noisy.setUniverseData(universe, values, DMX_UNIVERSE_SIZE);
+    }
+    benchPreset("noisy", noisy);
+
+    // 40 RGBWD pars on a few colours and 24 moving heads, the rest of the universes dark
+    DmxPreset typical;
+    typical.setName("Front wash warm");
+    memset(values, 0, sizeof(values));
+    for (int fixture = 0; fixture < 40; fixture++)
+    {
+        values[fixture * 5] = fixture < 20 ? 255 : 180;
+        values[fixture * 5 + 1] = 120;
+        values[fixture * 5 + 4] = 255;
+    }
+    typical.setUniverseData(0, values, DMX_UNIVERSE_SIZE);
+    memset(values, 0, sizeof(values));
+    for (int fixture = 0; fixture < 24; fixture++)
+    {
+        values[fixture * 16] = rng();
+        values[fixture * 16 + 2] = rng();
+        values[fixture * 16 + 5] = 255;
+    }
+    typical.setUniverseData(1, values, DMX_UNIVERSE_SIZE);
+    benchPreset("typical", typical);
+    return 0;
+}
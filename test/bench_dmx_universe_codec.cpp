@@ -0,0 +1,61 @@
+#include "bench_support.hpp"
+#include "dmx_preset.hpp"
+#include "dmx_universe_codec.hpp"
+#include <cstring>
+#include <random>
+
+// Worst case: one literal token per 128 values
+static const size_t PACK_CAPACITY = DMX_UNIVERSE_SIZE + DMX_UNIVERSE_SIZE / 128;
+
+static void benchUniverse(const char *kind, const uint8_t *values)
+{
+    uint8_t packed[PACK_CAPACITY];
+    size_t packedLength = 0;
+    DmxUniverseCodec::pack(values, DMX_UNIVERSE_SIZE, packed, sizeof(packed), packedLength);
+    printf("%s: %zu packed bytes\n", kind, packedLength);
+
+    char name[64];
+    snprintf(name, sizeof(name), "pack, %s", kind);
+    benchReport(name, benchNs(2000, [&] {
+        DmxUniverseCodec::pack(values, DMX_UNIVERSE_SIZE, packed, sizeof(packed), packedLength);
+        benchKeep(packed);
+    }));
+
+    uint8_t unpacked[DMX_UNIVERSE_SIZE];
+    size_t consumed = 0;
+    snprintf(name, sizeof(name), "unpack, %s", kind);
+    benchReport(name, benchNs(20000, [&] {
+        DmxUniverseCodec::unpack(packed, packedLength, unpacked, DMX_UNIVERSE_SIZE, consumed);
+        benchKeep(unpacked);
+    }));
+}
+
+int main()
+{
+    std::mt19937 random(1);
+    uint8_t values[DMX_UNIVERSE_SIZE];
+
+    memset(values, 0, sizeof(values));
+    benchUniverse("512 zero channels", values);
+
+    // 60 RGBWA pars in three colours followed by 12 16-channel heads at different positions, rest unused
+    for (int fixture = 0; fixture < 60; fixture++)
+    {
+        static const uint8_t COLOURS[3][5] = {{255, 0, 0, 40, 255}, {0, 0, 255, 0, 255}, {255, 180, 0, 0, 255}};
+        memcpy(values + fixture * 5, COLOURS[fixture / 20], 5);
+    }
+    for (int fixture = 0; fixture < 12; fixture++)
+    {
+        uint8_t *head = values + 300 + fixture * 16;
+        head[0] = random();
+        head[2] = random();
+        head[5] = 255;
+        head[8] = 128;
+    }
+    benchUniverse("show universe", values);
+
+    for (uint8_t &value : values)
+        value = random();
+    benchUniverse("512 random channels", values);
+    return 0;
+}
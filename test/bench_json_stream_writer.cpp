@@ -0,0 +1,69 @@
+#include "bench_support.hpp"
+#include "dmx_preset.hpp"
+#include "dmx_presets.hpp"
+#include "json_stream_writer.hpp"
+#include <cstdlib>
+
+// Counts what would go out as response chunks
+static esp_err_t countBytes(void *context, const char *data, size_t length)
+{
+    *static_cast<size_t *>(context) += length;
+    benchKeep(data);
+    return ESP_OK;
+}
+
+// GET /api/presets of a full show, written the way write_preset_json() in the web server writes it
+int main()
+{
+    static DmxPreset presets[MAX_PRESETS];
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    for (DmxPreset &preset : presets)
+    {
+        preset.setName("Front wash warm");
+        for (uint8_t universe = 0; universe < 2; universe++)
+        {
+            for (uint8_t &value : values)
+                value = rand();
+            preset.setUniverseData(universe, values, DMX_UNIVERSE_SIZE);
+        }
+    }
+
+    printf("JsonStreamWriter: %zu bytes, the only buffer the response needs\n", sizeof(JsonStreamWriter));
+    static const char *const ENCODINGS[] = {"number arrays", "base64", "hex"};
+    for (int encoding = 0; encoding < 3; encoding++)
+    {
+        size_t bytes = 0;
+        double ns = benchNs(20, [&] {
+            bytes = 0;
+            JsonStreamWriter json(countBytes, &bytes);
+            json.beginArray();
+            for (int index = 0; index < MAX_PRESETS; index++)
+            {
+                const DmxPreset &preset = presets[index];
+                json.beginObject();
+                json.key("index");
+                json.number(index);
+                json.key("name");
+                json.string(preset.getName());
+                for (uint8_t universe = 0; universe < 2; universe++)
+                {
+                    json.key(universe == 0 ? "universe1" : "universe2");
+                    if (encoding == 1)
+                        json.base64(preset.getUniverseData(universe), DMX_UNIVERSE_SIZE);
+                    else if (encoding == 2)
+                        json.hex(preset.getUniverseData(universe), DMX_UNIVERSE_SIZE);
+                    else
+                        json.uint8Array(preset.getUniverseData(universe), DMX_UNIVERSE_SIZE);
+                }
+                json.endObject();
+            }
+            json.endArray();
+            json.flush();
+        });
+        char name[64];
+        snprintf(name, sizeof(name), "250 presets as %s", ENCODINGS[encoding]);
+        benchReport(name, ns);
+        printf("  %zu bytes, %.0f MB/s\n", bytes, bytes / ns * 1000);
+    }
+    return 0;
+}
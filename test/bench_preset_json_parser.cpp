@@ -0,0 +1,79 @@
+#include "bench_support.hpp"
+#include "dmx_presets.hpp"
+#include "json_stream_writer.hpp"
+#include "preset_json_parser.hpp"
+#include <cstdlib>
+#include <string>
+
+static esp_err_t appendToString(void *context, const char *data, size_t length)
+{
+    static_cast<std::string *>(context)->append(data, length);
+    return ESP_OK;
+}
+
+class CountingHandler : public PresetJsonParser::Handler
+{
+  public:
+    esp_err_t onPreset(uint8_t, const DmxPreset &preset) override
+    {
+        benchKeep(&preset);
+        presets++;
+        return ESP_OK;
+    }
+    int presets = 0;
+};
+
+// POST /api/presets of a full show, parsed in the 1024 byte pieces the web server receives
+int main()
+{
+    static const char *const ENCODINGS[] = {"number arrays", "base64", "hex"};
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    printf("PresetJsonParser: %zu bytes, the only state the upload needs\n", sizeof(PresetJsonParser));
+
+    for (int encoding = PresetJsonParser::UNIVERSE_ARRAY; encoding <= PresetJsonParser::UNIVERSE_HEX; encoding++)
+    {
+        std::string body;
+        JsonStreamWriter json(appendToString, &body);
+        json.beginArray();
+        for (int index = 0; index < MAX_PRESETS; index++)
+        {
+            json.beginObject();
+            json.key("index");
+            json.number(index);
+            json.key("name");
+            json.string("Front wash warm");
+            for (uint8_t universe = 0; universe < 2; universe++)
+            {
+                for (uint8_t &value : values)
+                    value = rand();
+                json.key(universe == 0 ? "universe1" : "universe2");
+                if (encoding == PresetJsonParser::UNIVERSE_BASE64)
+                    json.base64(values, DMX_UNIVERSE_SIZE);
+                else if (encoding == PresetJsonParser::UNIVERSE_HEX)
+                    json.hex(values, DMX_UNIVERSE_SIZE);
+                else
+                    json.uint8Array(values, DMX_UNIVERSE_SIZE);
+            }
+            json.endObject();
+        }
+        json.endArray();
+        json.flush();
+
+        int presets = 0;
+        double ns = benchNs(20, [&] {
+            CountingHandler handler;
+            PresetJsonParser parser(handler, (PresetJsonParser::UniverseEncoding)encoding);
+            for (size_t offset = 0; offset < body.size(); offset += 1024)
+            {
+                parser.feed(body.data() + offset, body.size() - offset < 1024 ? body.size() - offset : 1024);
+            }
+            parser.finish();
+            presets = handler.presets;
+        });
+        char name[64];
+        snprintf(name, sizeof(name), "%d presets as %s", presets, ENCODINGS[encoding]);
+        benchReport(name, ns);
+        printf("  %zu bytes, %.0f MB/s\n", body.size(), body.size() / ns * 1000);
+    }
+    return 0;
+}
@@ -0,0 +1,67 @@
+#include "bench_support.hpp"
+#include "fake_flash.hpp"
+#include "preset_log_store.hpp"
+#include <cstdlib>
+#include <vector>
+
+// The partition image is a file here, so flash writes and erases cost a system call instead of flash time; the
+// numbers show the CPU side of the store: scanning, indexing, checksums and compaction bookkeeping
+static const char *const IMAGE = "bench_presetlog.img";
+static const char *const LABEL = "presetlog";
+static const uint32_t PARTITION_SIZE = 0x60000;
+static const size_t RECORD_SIZE = 200; // A typical packed preset record
+
+int main()
+{
+    FakeFlash::create(IMAGE, LABEL, PARTITION_SIZE);
+    std::vector<uint8_t> record(RECORD_SIZE);
+    for (uint8_t &value : record)
+        value = rand();
+
+    PresetLogStore *store = new PresetLogStore();
+    store->init(LABEL);
+    // A show of MAX_PRESETS presets, each edited a few times
+    for (int write = 0; write < 4 * MAX_PRESETS; write++)
+    {
+        record[0] = write;
+        store->writePreset(write % MAX_PRESETS, record.data(), record.size());
+    }
+    store->writeNumberOfPresets(MAX_PRESETS);
+
+    int index = 0;
+    benchReport("writePreset, 200 bytes, compaction included", benchNs(2000, [&] {
+        record[1] = index;
+        store->writePreset(index, record.data(), record.size());
+        index = (index + 7) % MAX_PRESETS;
+    }));
+
+    std::vector<uint8_t> buffer(RECORD_SIZE);
+    size_t size = 0;
+    benchReport("readPreset, 200 bytes", benchNs(20000, [&] {
+        store->readPreset(index, buffer.data(), buffer.size(), size);
+        benchKeep(buffer.data());
+        index = (index + 1) % MAX_PRESETS;
+    }));
+    const uint8_t *mapped = nullptr;
+    benchReport("mapPreset", benchNs(20000, [&] {
+        store->mapPreset(index, mapped, size);
+        benchKeep(mapped);
+        index = (index + 1) % MAX_PRESETS;
+    }));
+    PresetLogStore::Stats stats = store->getStats();
+    printf("%u compactions, %u of %u bytes live\n", (unsigned)stats.compactions, (unsigned)stats.liveBytes,
+        (unsigned)stats.usedBytes);
+    delete store;
+
+    benchReport("init, boot scan of the full log", benchNs(200, [&] {
+        PresetLogStore rebooted;
+        rebooted.init(LABEL);
+        benchKeep(&rebooted);
+    }));
+    PresetLogStore rebooted;
+    rebooted.init(LABEL);
+    printf("boot scan read %u entries\n", (unsigned)rebooted.getStats().entriesScanned);
+    FakeFlash::close();
+    remove(IMAGE);
+    return 0;
+}
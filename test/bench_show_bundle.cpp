@@ -0,0 +1,82 @@
+#include "bench_support.hpp"
+#include "dmx_preset_record.hpp"
+#include "dmx_presets.hpp"
+#include "show_bundle.hpp"
+#include <cstdlib>
+#include <vector>
+
+// Import side that only checks the records, as the web server does before storing them
+class CheckingHandler : public ShowBundleReader::Handler
+{
+  public:
+    esp_err_t onRecord(uint8_t type, uint8_t, const uint8_t *payload, uint16_t length) override
+    {
+        if (type == ShowBundle::PRESET && DmxPresetRecord::getCrc(payload, length) == 0)
+            return ESP_ERR_INVALID_CRC;
+        records++;
+        return ESP_OK;
+    }
+    int records = 0;
+};
+
+// Export and import of a show with MAX_PRESETS full presets of noisy values (the largest show file)
+int main()
+{
+    std::vector<std::vector<uint8_t>> records(MAX_PRESETS);
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    for (int index = 0; index < MAX_PRESETS; index++)
+    {
+        DmxPreset preset;
+        preset.setName("Preset");
+        for (uint8_t universe = 0; universe < 2; universe++)
+        {
+            for (uint8_t &value : values)
+                value = rand();
+            preset.setUniverseData(universe, values, DMX_UNIVERSE_SIZE);
+        }
+        uint8_t record[DmxPresetRecord::MAX_SIZE];
+        records[index].assign(record, record + DmxPresetRecord::encode(preset, record, sizeof(record)));
+    }
+
+    // The same sequence of writes as WebServer::send_show, through one chunk buffer
+    std::vector<uint8_t> file;
+    std::vector<uint8_t> chunk(ShowBundle::MAX_RECORD_SIZE);
+    auto exportShow = [&] {
+        file.clear();
+        ShowBundleWriter writer;
+        size_t size = writer.writeHeader(chunk.data(), chunk.size());
+        file.insert(file.end(), chunk.begin(), chunk.begin() + size);
+        uint8_t count = MAX_PRESETS;
+        size = writer.writeRecord(ShowBundle::PRESET_COUNT, 0, &count, 1, chunk.data(), chunk.size());
+        file.insert(file.end(), chunk.begin(), chunk.begin() + size);
+        for (int index = 0; index < MAX_PRESETS; index++)
+        {
+            size = writer.writeRecord(ShowBundle::PRESET, index, records[index].data(), records[index].size(),
+                chunk.data(), chunk.size());
+            file.insert(file.end(), chunk.begin(), chunk.begin() + size);
+        }
+        size = writer.writeEnd(chunk.data(), chunk.size());
+        file.insert(file.end(), chunk.begin(), chunk.begin() + size);
+    };
+    exportShow();
+    printf("show file: %zu bytes\n", file.size());
+    double ns = benchNs(100, exportShow);
+    benchReport("export, full show", ns);
+    printf("  %.0f MB/s\n", file.size() / ns * 1000);
+
+    // Received in TCP segment sized pieces
+    const size_t PIECE_SIZE = 1436;
+    ns = benchNs(100, [&] {
+        CheckingHandler handler;
+        ShowBundleReader reader(handler);
+        for (size_t offset = 0; offset < file.size(); offset += PIECE_SIZE)
+        {
+            size_t length = file.size() - offset < PIECE_SIZE ? file.size() - offset : PIECE_SIZE;
+            reader.feed(file.data() + offset, length);
+        }
+        benchKeep(&handler);
+    });
+    benchReport("import, full show in 1436 byte pieces", ns);
+    printf("  %.0f MB/s\n", file.size() / ns * 1000);
+    return 0;
+}
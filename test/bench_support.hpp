@@ -0,0 +1,32 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+// Minimal timing for the host benchmarks: the body runs `calls` times per round, the fastest of a few rounds is
+// reported. Host numbers only compare versions of the code with each other, they are not device timings.
+template <typename Body> double benchNs(long calls, Body body)
+{
+    double best = 0;
+    for (int round = 0; round < 5; round++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        for (long call = 0; call < calls; call++)
+            body();
+        double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / calls;
+        if (round == 0 || ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+// Keeps the compiler from dropping work whose result is never read
+template <typename T> inline void benchKeep(const T *data)
+{
+    asm volatile("" : : "r"(data) : "memory");
+}
+
+inline void benchReport(const char *name, double ns)
+{
+    printf("%-56s %10.1f ns\n", name, ns);
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include "fake_flash.hpp"
+#include "preset_log_store.hpp"
+#include "test_support.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Shared by the PresetLogStore tests: a file-backed partition image and a model of what the store should hold
+typedef std::vector<uint8_t> Bytes;
+
+static const char *const IMAGE = "presetlog.img";
+static const char *const LABEL = "presetlog";
+static const uint32_t PARTITION_SIZE = 0x60000;
+
+// What the store should hold: the latest record of every preset and the number of presets
+struct Show
+{
+    std::vector<Bytes> presets = std::vector<Bytes>(MAX_PRESETS);
+    int numberOfPresets = 0;
+
+    bool operator==(const Show &other) const
+    {
+        return presets == other.presets && numberOfPresets == other.numberOfPresets;
+    }
+};
+
+// The store does not look into records, so any bytes will do; the first two identify preset and version
+inline Bytes makeRecord(int index, int version, bool large)
+{
+    size_t size = large ? DmxPresetRecord::MAX_SIZE - rand() % 64 : 16 + rand() % 240;
+    Bytes record(size);
+    for (uint8_t &byte : record)
+    {
+        byte = rand();
+    }
+    record[0] = index;
+    record[1] = version;
+    return record;
+}
+
+// Reads every preset, through the mapping as well when the partition is mapped
+inline Show readShow(const PresetLogStore &store, bool mapped)
+{
+    static uint8_t buffer[DmxPresetRecord::MAX_SIZE];
+    Show show;
+    show.numberOfPresets = store.getNumberOfPresets();
+    for (int index = 0; index < MAX_PRESETS; index++)
+    {
+        size_t size = 0;
+        if (!store.hasPreset(index))
+        {
+            CHECK(store.readPreset(index, buffer, sizeof(buffer), size) != ESP_OK);
+            continue;
+        }
+        CHECK_EQ(store.readPreset(index, buffer, sizeof(buffer), size), ESP_OK);
+        show.presets[index].assign(buffer, buffer + size);
+
+        const uint8_t *record = nullptr;
+        size_t mappedSize = 0;
+        esp_err_t err = store.mapPreset(index, record, mappedSize);
+        if (mapped)
+        {
+            CHECK(err == ESP_OK && mappedSize == size && memcmp(record, buffer, size) == 0);
+        }
+        else
+        {
+            CHECK_EQ(err, ESP_ERR_NOT_SUPPORTED);
+        }
+    }
+    return show;
+}
+
+// Power comes back: a new store instance scans the image
+inline PresetLogStore *reboot(PresetLogStore *store)
+{
+    delete store;
+    FakeFlash::cutPowerAt(-1, 0);
+    store = new PresetLogStore();
+    CHECK_EQ(store->init(LABEL), ESP_OK);
+    return store;
+}
+
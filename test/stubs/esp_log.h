@@ -0,0 +1,10 @@
+#pragma once
+
+// Host build of the ESP-IDF log macros: printed to stderr when DMX_TEST_LOG is set in the environment
+void esp_log_write_host(char level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, format, ...) esp_log_write_host('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) esp_log_write_host('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) esp_log_write_host('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) esp_log_write_host('D', tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) esp_log_write_host('V', tag, format, ##__VA_ARGS__)
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Deterministic on the host, so test runs can be repeated
+uint32_t esp_random(void);
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+// Same CRC as the ROM routine: CRC-32 (IEEE 802.3), crc is the result of the previous call (0 to start)
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len);
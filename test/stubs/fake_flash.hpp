@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+
+// NOR flash image in a file, behind the esp_partition_* stubs. A write can only clear bits and an erase sets a range
+// back to 0xFF, as on the real flash. A power cut can be injected at any write or erase: that operation is only done
+// in part and throws PowerCut, and the test "reboots" by opening the image again.
+class FakeFlash
+{
+  public:
+    struct PowerCut
+    {
+    };
+
+    // Create (or truncate) the image file as one erased data partition with the given label
+    static bool create(const char *path, const char *label, uint32_t size);
+    static void close();
+
+    // Cut the power in the operation-th write or erase from now (0 = the next one), -1 for never
+    static void cutPowerAt(long operation, uint32_t seed);
+    static long getOperations() { return operations_; }
+
+    // Without a mapping the preset log falls back to flash reads
+    static void setMappable(bool mappable) { mappable_ = mappable; }
+
+  private:
+    friend struct FakeFlashAccess;
+
+    static int fd_;
+    static long operations_;
+    static long cutAt_;
+    static uint32_t seed_;
+    static bool mappable_;
+};
@@ -0,0 +1,258 @@
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_random.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "fake_flash.hpp"
+#include <chrono>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <vector>
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    static char name[16];
+    snprintf(name, sizeof(name), "0x%x", code);
+    return name;
+}
+
+void esp_log_write_host(char level, const char *tag, const char *format, ...)
+{
+    static const bool enabled = getenv("DMX_TEST_LOG") != nullptr;
+    if (!enabled)
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    fprintf(stderr, "%c (%s) ", level, tag);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+    static uint32_t table[256];
+    if (table[1] == 0)
+    {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++)
+            {
+                c = (c >> 1) ^ (0xEDB88320 & (0 - (c & 1)));
+            }
+            table[i] = c;
+        }
+    }
+
+    crc = ~crc;
+    while (len--)
+    {
+        crc = table[(crc ^ *buf++) & 0xFF] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+uint32_t esp_random(void)
+{
+    static uint32_t state = 0x12345678;
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+int FakeFlash::fd_ = -1;
+long FakeFlash::operations_ = 0;
+long FakeFlash::cutAt_ = -1;
+uint32_t FakeFlash::seed_ = 1;
+bool FakeFlash::mappable_ = true;
+
+static esp_partition_t partition;
+static std::vector<void *> mappings;
+static std::vector<size_t> mappingSizes;
+
+struct FakeFlashAccess
+{
+    static int fd() { return FakeFlash::fd_; }
+    static bool mappable() { return FakeFlash::mappable_; }
+
+    // Counts the operation; true if the power is cut in it
+    static bool isCut()
+    {
+        return FakeFlash::operations_++ == FakeFlash::cutAt_;
+    }
+
+    // Part of an operation of the given size that is done before the power is gone
+    static size_t cutLength(size_t size)
+    {
+        FakeFlash::seed_ = FakeFlash::seed_ * 1103515245 + 12345;
+        return size ? (FakeFlash::seed_ >> 8) % size : 0;
+    }
+};
+
+bool FakeFlash::create(const char *path, const char *label, uint32_t size)
+{
+    close();
+    fd_ = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+    {
+        return false;
+    }
+
+    std::vector<uint8_t> erased(size, 0xFF);
+    if (pwrite(fd_, erased.data(), size, 0) != (ssize_t)size)
+    {
+        return false;
+    }
+
+    memset(&partition, 0, sizeof(partition));
+    partition.type = ESP_PARTITION_TYPE_DATA;
+    partition.subtype = ESP_PARTITION_SUBTYPE_DATA_UNDEFINED;
+    partition.size = size;
+    partition.erase_size = 4096;
+    strncpy(partition.label, label, sizeof(partition.label) - 1);
+    operations_ = 0;
+    cutAt_ = -1;
+    return true;
+}
+
+void FakeFlash::close()
+{
+    if (fd_ >= 0)
+    {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+void FakeFlash::cutPowerAt(long operation, uint32_t seed)
+{
+    cutAt_ = operation < 0 ? -1 : operations_ + operation;
+    seed_ = seed;
+}
+
+const esp_partition_t *esp_partition_find_first(
+    esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+    if (FakeFlashAccess::fd() < 0 || (type != ESP_PARTITION_TYPE_ANY && type != partition.type) ||
+        (subtype != ESP_PARTITION_SUBTYPE_ANY && subtype != partition.subtype) ||
+        (label && strcmp(label, partition.label) != 0))
+    {
+        return nullptr;
+    }
+    return &partition;
+}
+
+static bool inPartition(const esp_partition_t *p, size_t offset, size_t size)
+{
+    return p == &partition && offset <= partition.size && size <= partition.size - offset;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *p, size_t src_offset, void *dst, size_t size)
+{
+    if (!inPartition(p, src_offset, size))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    return pread(FakeFlashAccess::fd(), dst, size, src_offset) == (ssize_t)size ? ESP_OK : ESP_FAIL;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *p, size_t dst_offset, const void *src, size_t size)
+{
+    if (!inPartition(p, dst_offset, size))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    // Programming can only clear bits
+    std::vector<uint8_t> cells(size);
+    if (pread(FakeFlashAccess::fd(), cells.data(), size, dst_offset) != (ssize_t)size)
+    {
+        return ESP_FAIL;
+    }
+    bool cut = FakeFlashAccess::isCut();
+    size_t length = cut ? FakeFlashAccess::cutLength(size) : size;
+    const uint8_t *data = static_cast<const uint8_t *>(src);
+    for (size_t i = 0; i < length; i++)
+    {
+        cells[i] &= data[i];
+    }
+    if (pwrite(FakeFlashAccess::fd(), cells.data(), length, dst_offset) != (ssize_t)length)
+    {
+        return ESP_FAIL;
+    }
+    if (cut)
+    {
+        throw FakeFlash::PowerCut();
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *p, size_t offset, size_t size)
+{
+    if (!inPartition(p, offset, size) || offset % partition.erase_size || size % partition.erase_size)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    bool cut = FakeFlashAccess::isCut();
+    size_t length = cut ? FakeFlashAccess::cutLength(size) : size;
+    std::vector<uint8_t> erased(length, 0xFF);
+    if (pwrite(FakeFlashAccess::fd(), erased.data(), length, offset) != (ssize_t)length)
+    {
+        return ESP_FAIL;
+    }
+    if (cut)
+    {
+        throw FakeFlash::PowerCut();
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *p, size_t offset, size_t size, esp_partition_mmap_memory_t memory,
+    const void **out_ptr, esp_partition_mmap_handle_t *out_handle)
+{
+    (void)memory;
+    if (!FakeFlashAccess::mappable() || !inPartition(p, offset, size))
+    {
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    // A shared mapping of the image file sees every later write and erase, like the flash cache
+    void *mapped = mmap(nullptr, size, PROT_READ, MAP_SHARED, FakeFlashAccess::fd(), offset);
+    if (mapped == MAP_FAILED)
+    {
+        return ESP_FAIL;
+    }
+    mappings.push_back(mapped);
+    mappingSizes.push_back(size);
+    *out_ptr = mapped;
+    *out_handle = (esp_partition_mmap_handle_t)mappings.size();
+    return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle)
+{
+    if (handle > 0 && handle <= mappings.size() && mappings[handle - 1])
+    {
+        munmap(mappings[handle - 1], mappingSizes[handle - 1]);
+        mappings[handle - 1] = nullptr;
+    }
+}
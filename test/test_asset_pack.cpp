@@ -0,0 +1,149 @@
+#include "asset_pack_test_support.hpp"
+#include "fake_flash.hpp"
+#include "test_support.hpp"
+
+static std::vector<PackFile> makeFiles()
+{
+    return {
+        {"/index.html", "text/html", makeContent(700, 1), makeContent(300, 2), false},
+        {"/assets/index-BIMoyukT.js", "application/javascript", Bytes(), makeContent(5000, 3), true},
+        {"/assets/index-DCQwLo36.css", "text/css", Bytes(), makeContent(900, 4), true},
+        {"/favicon.ico", "image/x-icon", makeContent(200, 5), Bytes(), false},
+    };
+}
+
+static bool find(const AssetPack &pack, const char *path, AssetPack::Asset &asset)
+{
+    return pack.find(path, strlen(path), asset);
+}
+
+static void testLookups()
+{
+    Bytes image = PackBuilder::build(makeFiles());
+    AssetPack pack;
+    CHECK_EQ(pack.attach(image.data(), image.size()), ESP_OK);
+    CHECK(pack.isLoaded());
+    CHECK_EQ(pack.getNumberOfAssets(), 4);
+
+    AssetPack::Asset asset;
+    for (const PackFile &file : makeFiles())
+    {
+        CHECK(find(pack, file.path.c_str(), asset));
+        CHECK(file.path == asset.path);
+        CHECK(file.contentType == asset.contentType);
+        CHECK("\"" + file.path + "\"" == asset.etag);
+        if (file.gzipOnly)
+        {
+            CHECK(asset.data == nullptr);
+        }
+        else
+        {
+            CHECK_EQ(asset.length, file.data.size());
+            CHECK(asset.data && memcmp(asset.data, file.data.data(), asset.length) == 0);
+        }
+        if (file.gzip.empty())
+        {
+            CHECK(asset.gzipEtag == nullptr);
+            CHECK(asset.gzipData == nullptr);
+            CHECK_EQ(asset.gzipLength, 0);
+        }
+        else
+        {
+            CHECK("\"" + file.path + "-gz\"" == asset.gzipEtag);
+            CHECK_EQ(asset.gzipLength, file.gzip.size());
+            CHECK(asset.gzipData && memcmp(asset.gzipData, file.gzip.data(), asset.gzipLength) == 0);
+        }
+    }
+
+    // The length stops the path before the query
+    const char *withQuery = "/index.html?v=2";
+    CHECK(pack.find(withQuery, strcspn(withQuery, "?"), asset));
+    CHECK(strcmp(asset.path, "/index.html") == 0);
+
+    for (const char *missing : {"/", "/index.htm", "/index.html/", "/assets", "/assets/", "/zzz", "/a", ""})
+    {
+        CHECK(!find(pack, missing, asset));
+    }
+
+    // Bytewise order, as the packer sorts: a path starting with a byte above 0x7F sorts last
+    std::vector<PackFile> files = makeFiles();
+    files.push_back({"/\xC3\xA9t\xC3\xA9.txt", "text/plain", makeContent(10, 6), Bytes(), false});
+    files.push_back({"/B.txt", "text/plain", makeContent(10, 7), Bytes(), false});
+    image = PackBuilder::build(files);
+    CHECK_EQ(pack.attach(image.data(), image.size()), ESP_OK);
+    for (const PackFile &file : files)
+    {
+        CHECK(find(pack, file.path.c_str(), asset));
+    }
+}
+
+// Every byte of the header and the index flipped, and some of the rest: rejected, never a lookup on a bad pack
+static void testDamagedPacks()
+{
+    const Bytes image = PackBuilder::build(makeFiles());
+    AssetPack pack;
+    for (size_t offset = 0; offset < image.size(); offset += offset < 256 ? 1 : 97)
+    {
+        Bytes damaged = image;
+        damaged[offset] ^= 1 << (offset % 8);
+        CHECK(pack.attach(damaged.data(), damaged.size()) != ESP_OK);
+        CHECK(!pack.isLoaded());
+        CHECK_EQ(pack.getNumberOfAssets(), 0);
+    }
+
+    // Erased partition, truncated pack, and packs that are consistent but invalid
+    Bytes erased(4096, 0xFF);
+    CHECK_EQ(pack.attach(erased.data(), erased.size()), ESP_ERR_NOT_FOUND);
+    CHECK_EQ(pack.attach(image.data(), 10), ESP_ERR_NOT_FOUND);
+    CHECK_EQ(pack.attach(image.data(), image.size() - 1), ESP_ERR_INVALID_VERSION);
+
+    Bytes unsorted = image;
+    std::swap_ranges(unsorted.begin() + PackBuilder::HEADER_SIZE,
+        unsorted.begin() + PackBuilder::HEADER_SIZE + PackBuilder::ENTRY_SIZE,
+        unsorted.begin() + PackBuilder::HEADER_SIZE + PackBuilder::ENTRY_SIZE);
+    PackBuilder::updateCrc(unsorted);
+    CHECK_EQ(pack.attach(unsorted.data(), unsorted.size()), ESP_ERR_INVALID_STATE);
+
+    Bytes outOfRange = image;
+    uint32_t length = image.size();
+    memcpy(outOfRange.data() + PackBuilder::HEADER_SIZE + 28, &length, 4);
+    PackBuilder::updateCrc(outOfRange);
+    CHECK_EQ(pack.attach(outOfRange.data(), outOfRange.size()), ESP_ERR_INVALID_STATE);
+
+    // A good pack after a bad one
+    CHECK_EQ(pack.attach(image.data(), image.size()), ESP_OK);
+}
+
+// init() maps the partition and checks the pack in it; the partition is larger than the pack
+static void testPartition()
+{
+    const char *image = "assets.img";
+    Bytes pack = PackBuilder::build(makeFiles());
+    CHECK(FakeFlash::create(image, "assets", 0x20000));
+    const esp_partition_t *partition =
+        esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, "assets");
+    CHECK(partition != nullptr);
+
+    {
+        AssetPack erased;
+        CHECK_EQ(erased.init("assets"), ESP_ERR_NOT_FOUND);
+        CHECK_EQ(erased.init("missing"), ESP_ERR_NOT_FOUND);
+    }
+
+    CHECK_EQ(esp_partition_write(partition, 0, pack.data(), pack.size()), ESP_OK);
+    AssetPack assets;
+    CHECK_EQ(assets.init("assets"), ESP_OK);
+    AssetPack::Asset asset;
+    CHECK(find(assets, "/favicon.ico", asset));
+    CHECK(asset.data && memcmp(asset.data, makeContent(200, 5).data(), 200) == 0);
+    FakeFlash::close();
+    remove(image);
+}
+
+int main()
+{
+    testLookups();
+    testDamagedPacks();
+    testPartition();
+    return testResult("AssetPack");
+}
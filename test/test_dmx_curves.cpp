@@ -0,0 +1,114 @@
+#include "dmx_curves.hpp"
+#include "test_support.hpp"
+
+static uint8_t squareLaw(uint32_t v) { return (v * v + 127) / 255; }
+
+static uint8_t sCurve(uint32_t v) { return (v * v * (3 * 255 - 2 * v) + (255 * 255) / 2) / (255 * 255); }
+
+// Every channel of the frame set to value
+static void fillFrame(DmxFrame &frame, uint8_t value)
+{
+    for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+    {
+        frame.channels()[channel] = value;
+    }
+}
+
+static void testCurveTypes()
+{
+    DmxCurves curves;
+    uint8_t inverted[256];
+    for (int v = 0; v < 256; v++)
+    {
+        inverted[v] = 255 - v;
+    }
+    CHECK_EQ(curves.setChannelCurve(0, 100, DmxCurves::SQUARE_LAW, nullptr), ESP_OK);
+    CHECK_EQ(curves.setChannelCurve(100, 100, DmxCurves::S_CURVE, nullptr), ESP_OK);
+    CHECK_EQ(curves.setChannelCurve(200, 100, DmxCurves::CUSTOM, inverted), ESP_OK);
+    CHECK_EQ(curves.setChannelCurve(1000, 24, DmxCurves::SQUARE_LAW, nullptr), ESP_OK);
+    CHECK_EQ(curves.getNumTables(), 4);
+
+    for (int v = 0; v < 256; v++)
+    {
+        DmxFrame frame;
+        fillFrame(frame, v);
+        curves.apply(frame);
+        CHECK_EQ(frame.channels()[0], squareLaw(v));
+        CHECK_EQ(frame.channels()[99], squareLaw(v));
+        CHECK_EQ(frame.channels()[100], sCurve(v));
+        CHECK_EQ(frame.channels()[250], 255 - v);
+        CHECK_EQ(frame.channels()[300], v);
+        CHECK_EQ(frame.channels()[999], v);
+        CHECK_EQ(frame.channels()[1023], squareLaw(v));
+    }
+
+    // The curves keep their end points and are monotonic
+    for (int v = 1; v < 256; v++)
+    {
+        CHECK(squareLaw(v) >= squareLaw(v - 1));
+        CHECK(sCurve(v) >= sCurve(v - 1));
+    }
+    CHECK_EQ(sCurve(0), 0);
+    CHECK_EQ(sCurve(255), 255);
+    CHECK_EQ(squareLaw(255), 255);
+}
+
+static void testTableSharing()
+{
+    DmxCurves curves;
+    CHECK_EQ(curves.getNumTables(), 1);
+
+    // A custom table equal to the identity shares the linear table
+    uint8_t table[256];
+    for (int v = 0; v < 256; v++)
+    {
+        table[v] = v;
+    }
+    CHECK_EQ(curves.setChannelCurve(0, 10, DmxCurves::CUSTOM, table), ESP_OK);
+    CHECK_EQ(curves.getNumTables(), 1);
+
+    // Linear plus seven distinct tables fill all of them
+    for (int i = 0; i < MAX_CURVE_TABLES - 1; i++)
+    {
+        table[0] = 1 + i;
+        CHECK_EQ(curves.setChannelCurve(i * 10, 10, DmxCurves::CUSTOM, table), ESP_OK);
+    }
+    CHECK_EQ(curves.getNumTables(), MAX_CURVE_TABLES);
+    CHECK_EQ(curves.setChannelCurve(500, 1, DmxCurves::SQUARE_LAW, nullptr), ESP_ERR_NO_MEM);
+
+    // An existing table can still be assigned
+    table[0] = 3;
+    CHECK_EQ(curves.setChannelCurve(500, 1, DmxCurves::CUSTOM, table), ESP_OK);
+
+    // Channels set back to linear free their table for the next curve
+    CHECK_EQ(curves.setChannelCurve(0, 10, DmxCurves::LINEAR, nullptr), ESP_OK);
+    CHECK_EQ(curves.setChannelCurve(500, 1, DmxCurves::SQUARE_LAW, nullptr), ESP_OK);
+    CHECK_EQ(curves.getNumTables(), MAX_CURVE_TABLES);
+
+    DmxFrame frame;
+    fillFrame(frame, 0);
+    curves.apply(frame);
+    CHECK_EQ(frame.channels()[0], 0);
+    CHECK_EQ(frame.channels()[10], 2);
+    CHECK_EQ(frame.channels()[20], 3);
+    CHECK_EQ(frame.channels()[500], 0);
+    CHECK_EQ(frame.channels()[501], 0);
+}
+
+static void testArguments()
+{
+    DmxCurves curves;
+    CHECK_EQ(curves.setChannelCurve(0, 1, DmxCurves::CUSTOM, nullptr), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(curves.setChannelCurve(DMX_FRAME_CHANNELS, 0, DmxCurves::SQUARE_LAW, nullptr), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(curves.setChannelCurve(1, DMX_FRAME_CHANNELS, DmxCurves::SQUARE_LAW, nullptr), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(curves.setChannelCurve(0, DMX_FRAME_CHANNELS, DmxCurves::SQUARE_LAW, nullptr), ESP_OK);
+    CHECK_EQ(curves.getNumTables(), 2);
+}
+
+int main()
+{
+    testCurveTypes();
+    testTableSharing();
+    testArguments();
+    return testResult("DmxCurves");
+}
@@ -0,0 +1,182 @@
+#include "dmx_effects.hpp"
+#include "test_support.hpp"
+
+static const int64_t STEP_US = 100000;
+
+static DmxEffects::Parameters makeParameters(DmxEffects::Waveform waveform)
+{
+    DmxEffects::Parameters parameters = {};
+    parameters.waveform = waveform;
+    parameters.rateMilliHz = 1000;
+    parameters.phaseSpread = 16384;
+    parameters.depth = 255;
+    parameters.offset = 0;
+    parameters.width = 128;
+    parameters.fixtureChannels = 1;
+    return parameters;
+}
+
+static uint8_t effectValue(const DmxLayerStack &layers, uint16_t channel)
+{
+    return layers.getValue(DmxLayerStack::EFFECT, channel);
+}
+
+// Channels of one fixture share a phase, successive fixtures are phaseSpread apart
+static void testFixturePhases()
+{
+    DmxEffects effects;
+    DmxLayerStack layers;
+    DmxEffects::Parameters parameters = makeParameters(DmxEffects::RAMP);
+    parameters.fixtureChannels = 3;
+    CHECK_EQ(effects.setEffect(0, parameters), ESP_OK);
+    CHECK_EQ(effects.setEffectChannels(0, 10, 12, true), ESP_OK);
+    effects.apply(layers, 1);
+    effects.apply(layers, 1 + STEP_US);
+
+    // A tenth of a cycle, then a quarter cycle per fixture
+    const uint8_t expected[] = {25, 89, 153, 217};
+    for (uint16_t channel = 10; channel < 22; channel++)
+    {
+        CHECK_EQ(effectValue(layers, channel), expected[(channel - 10) / 3]);
+        CHECK(layers.isOwned(DmxLayerStack::EFFECT, channel));
+    }
+    CHECK(!layers.isOwned(DmxLayerStack::EFFECT, 9));
+    CHECK(!layers.isOwned(DmxLayerStack::EFFECT, 22));
+
+    // One channel per fixture spreads every channel
+    parameters.fixtureChannels = 1;
+    CHECK_EQ(effects.setEffect(0, parameters), ESP_OK);
+    effects.apply(layers, 1 + STEP_US);
+    CHECK_EQ(effectValue(layers, 10), 25);
+    CHECK_EQ(effectValue(layers, 11), 89);
+    CHECK_EQ(effectValue(layers, 14), 25);
+
+    // Phases wrap after a full cycle (the phase step is rounded down)
+    for (int step = 2; step <= 15; step++)
+    {
+        effects.apply(layers, 1 + step * STEP_US);
+    }
+    CHECK(effectValue(layers, 10) >= 127 && effectValue(layers, 10) <= 128);
+    CHECK(effectValue(layers, 11) >= 191 && effectValue(layers, 11) <= 192);
+}
+
+static void testWaveforms()
+{
+    DmxEffects effects;
+    DmxLayerStack layers;
+
+    DmxEffects::Parameters sine = makeParameters(DmxEffects::SINE);
+    CHECK_EQ(effects.setEffect(0, sine), ESP_OK);
+    effects.setEffectChannels(0, 0, 4, true);
+
+    DmxEffects::Parameters chase = makeParameters(DmxEffects::CHASE);
+    chase.phaseSpread = 32768;
+    CHECK_EQ(effects.setEffect(1, chase), ESP_OK);
+    effects.setEffectChannels(1, 100, 2, true);
+
+    // Random values stay within offset..offset + depth
+    DmxEffects::Parameters random = makeParameters(DmxEffects::RANDOM);
+    random.offset = 100;
+    random.depth = 50;
+    CHECK_EQ(effects.setEffect(2, random), ESP_OK);
+    effects.setEffectChannels(2, 200, 100, true);
+
+    effects.apply(layers, 1);
+    CHECK_EQ(effectValue(layers, 0), 128);
+    CHECK_EQ(effectValue(layers, 1), 255);
+    CHECK_EQ(effectValue(layers, 2), 128);
+    CHECK_EQ(effectValue(layers, 3), 0);
+    CHECK_EQ(effectValue(layers, 100), 255);
+    CHECK_EQ(effectValue(layers, 101), 0);
+
+    int distinct = 0;
+    for (int step = 0; step < 30; step++)
+    {
+        effects.apply(layers, 1 + step * STEP_US);
+        for (uint16_t channel = 200; channel < 300; channel++)
+        {
+            uint8_t value = effectValue(layers, channel);
+            CHECK(value >= 100 && value <= 150);
+            distinct += value != effectValue(layers, 200);
+        }
+    }
+    CHECK(distinct > 0);
+}
+
+// Channels driven by two effects take the highest value; stopped effects release their channels
+static void testOverlapAndStop()
+{
+    DmxEffects effects;
+    DmxLayerStack layers;
+    DmxEffects::Parameters low = makeParameters(DmxEffects::RAMP);
+    low.rateMilliHz = 0;
+    low.offset = 40;
+    DmxEffects::Parameters high = low;
+    high.offset = 90;
+    CHECK_EQ(effects.setEffect(0, high), ESP_OK);
+    CHECK_EQ(effects.setEffect(5, low), ESP_OK);
+    effects.setEffectChannels(0, 0, 8, true);
+    effects.setEffectChannels(5, 4, 8, true);
+    CHECK_EQ(effects.getNumActiveEffects(), 2);
+
+    effects.apply(layers, 1);
+    CHECK_EQ(effectValue(layers, 0), 90);
+    CHECK_EQ(effectValue(layers, 4), 90);
+    CHECK_EQ(effectValue(layers, 8), 40);
+
+    CHECK_EQ(effects.stopEffect(0), ESP_OK);
+    effects.apply(layers, 2);
+    CHECK(!layers.isOwned(DmxLayerStack::EFFECT, 0));
+    CHECK_EQ(effectValue(layers, 4), 40);
+
+    CHECK_EQ(effects.setEffectChannels(5, 0, 12, false), ESP_OK);
+    effects.apply(layers, 3);
+    CHECK(!layers.isOwned(DmxLayerStack::EFFECT, 8));
+
+    CHECK_EQ(effects.stopEffect(5), ESP_OK);
+    CHECK_EQ(effects.getNumActiveEffects(), 0);
+    effects.apply(layers, 4);
+    for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+    {
+        CHECK(!layers.isOwned(DmxLayerStack::EFFECT, channel));
+    }
+}
+
+static void testArguments()
+{
+    DmxEffects effects;
+    DmxEffects::Parameters parameters = makeParameters(DmxEffects::SINE);
+    CHECK_EQ(effects.setEffect(MAX_EFFECTS, parameters), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(effects.setEffectChannels(0, 0, 1, true), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(effects.stopEffect(MAX_EFFECTS), ESP_ERR_INVALID_ARG);
+
+    parameters.fixtureChannels = 0;
+    CHECK_EQ(effects.setEffect(0, parameters), ESP_ERR_INVALID_ARG);
+    parameters.fixtureChannels = 1;
+    parameters.rateMilliHz = DmxEffects::MAX_RATE_MILLI_HZ + 1;
+    CHECK_EQ(effects.setEffect(0, parameters), ESP_ERR_INVALID_ARG);
+    parameters.rateMilliHz = DmxEffects::MAX_RATE_MILLI_HZ;
+    parameters.waveform = DmxEffects::NUM_WAVEFORMS;
+    CHECK_EQ(effects.setEffect(0, parameters), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(effects.getNumActiveEffects(), 0);
+
+    parameters.waveform = DmxEffects::SINE;
+    CHECK_EQ(effects.setEffect(0, parameters), ESP_OK);
+    CHECK_EQ(effects.setEffectChannels(0, DMX_FRAME_CHANNELS - 1, 2, true), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(effects.addEffectMembers(0, nullptr), ESP_ERR_INVALID_ARG);
+    uint32_t members[DmxEffects::BITMAP_WORDS] = {};
+    members[DmxEffects::BITMAP_WORDS - 1] = 0x80000000;
+    CHECK_EQ(effects.addEffectMembers(0, members), ESP_OK);
+    DmxLayerStack layers;
+    effects.apply(layers, 1);
+    CHECK(layers.isOwned(DmxLayerStack::EFFECT, DMX_FRAME_CHANNELS - 1));
+}
+
+int main()
+{
+    testFixturePhases();
+    testWaveforms();
+    testOverlapAndStop();
+    testArguments();
+    return testResult("DmxEffects");
+}
@@ -0,0 +1,137 @@
+#include "dmx_layer_stack.hpp"
+#include "test_support.hpp"
+#include <cstring>
+
+// Preset on universe 1 and part of universe 2, effect, override and park on top with the default layer modes
+static void testDefaultLayers()
+{
+    DmxLayerStack stack;
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    memset(values, 100, sizeof(values));
+    CHECK_EQ(stack.setChannels(DmxLayerStack::BASE, 0, values, 512), ESP_OK);
+    CHECK_EQ(stack.setChannels(DmxLayerStack::BASE, 512, values, 100), ESP_OK);
+    uint8_t effect[3] = {50, 150, 0};
+    CHECK_EQ(stack.setChannels(DmxLayerStack::EFFECT, 10, effect, 3), ESP_OK);
+    CHECK_EQ(stack.setChannel(DmxLayerStack::OVERRIDE, 11, 20), ESP_OK);
+    CHECK_EQ(stack.setChannel(DmxLayerStack::PARK, 700, 77), ESP_OK);
+
+    DmxFrame frame;
+    stack.composite(frame);
+    CHECK_EQ(frame.channels()[9], 100);
+    CHECK_EQ(frame.channels()[10], 100); // Effect is HTP: below the preset
+    CHECK_EQ(frame.channels()[11], 20);  // Override is LTP: wins even when lower
+    CHECK_EQ(frame.channels()[12], 100);
+    CHECK_EQ(frame.channels()[700], 77);
+    CHECK_EQ(frame.channels()[800], 0);
+    CHECK_EQ(frame.universeLength[0], 512);
+    CHECK_EQ(frame.universeLength[1], 189);
+
+    // Releasing the override lets the effect show through again
+    CHECK_EQ(stack.releaseChannels(DmxLayerStack::OVERRIDE, 11, 1), ESP_OK);
+    stack.composite(frame);
+    CHECK_EQ(frame.channels()[11], 150);
+    CHECK(!stack.isOwned(DmxLayerStack::OVERRIDE, 11));
+    CHECK_EQ(stack.getValue(DmxLayerStack::OVERRIDE, 11), 0);
+
+    stack.releaseAll(DmxLayerStack::BASE);
+    stack.composite(frame);
+    CHECK_EQ(frame.channels()[9], 0);
+    CHECK_EQ(frame.channels()[11], 150);
+    CHECK_EQ(frame.universeLength[0], 13);
+}
+
+// Fully owned bitmap words take the fast path, partial words the per bit path: both must merge the same way
+static void testMergeModes()
+{
+    for (int mergeMode = DmxLayerStack::HTP; mergeMode <= DmxLayerStack::LTP; mergeMode++)
+    {
+        DmxLayerStack stack;
+        CHECK_EQ(stack.setLayerMode(DmxLayerStack::EFFECT, 10, (DmxLayerStack::MergeMode)mergeMode), ESP_OK);
+        uint8_t base[DMX_FRAME_CHANNELS];
+        uint8_t effect[DMX_FRAME_CHANNELS];
+        for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+        {
+            base[channel] = channel & 0xFF;
+            effect[channel] = 255 - (channel & 0xFF);
+        }
+        stack.setChannels(DmxLayerStack::BASE, 0, base, DMX_FRAME_CHANNELS);
+        stack.setChannels(DmxLayerStack::EFFECT, 0, effect, 64);
+        for (uint16_t channel = 64; channel < DMX_FRAME_CHANNELS; channel += 3)
+        {
+            stack.setChannel(DmxLayerStack::EFFECT, channel, effect[channel]);
+        }
+
+        DmxFrame frame;
+        stack.composite(frame);
+        for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+        {
+            bool owned = channel < 64 || (channel - 64) % 3 == 0;
+            uint8_t expected = base[channel];
+            if (owned)
+            {
+                expected = mergeMode == DmxLayerStack::LTP || effect[channel] > base[channel] ? effect[channel]
+                                                                                              : base[channel];
+            }
+            CHECK_EQ(frame.channels()[channel], expected);
+        }
+    }
+}
+
+// Raising the effect above the park layer reverses which one wins
+static void testPriorities()
+{
+    DmxLayerStack stack;
+    stack.setChannel(DmxLayerStack::PARK, 5, 10);
+    stack.setChannel(DmxLayerStack::EFFECT, 5, 200);
+    DmxFrame frame;
+    stack.composite(frame);
+    CHECK_EQ(frame.channels()[5], 10);
+
+    CHECK_EQ(stack.setLayerMode(DmxLayerStack::EFFECT, 255, DmxLayerStack::LTP), ESP_OK);
+    CHECK_EQ(stack.setLayerMode(DmxLayerStack::PARK, 100, DmxLayerStack::LTP), ESP_OK);
+    stack.composite(frame);
+    CHECK_EQ(frame.channels()[5], 200);
+}
+
+// Generators replace a whole layer through getValues() and setOwnedChannels()
+static void testOwnedBitmap()
+{
+    DmxLayerStack stack;
+    uint32_t owned[DmxLayerStack::BITMAP_WORDS] = {};
+    owned[0] = 0x80000001;
+    owned[20] = 0x00000010;
+    uint8_t *values = stack.getValues(DmxLayerStack::OVERRIDE);
+    values[0] = 1;
+    values[31] = 2;
+    values[644] = 3;
+    stack.setOwnedChannels(DmxLayerStack::OVERRIDE, owned);
+
+    DmxFrame frame;
+    stack.composite(frame);
+    CHECK_EQ(frame.channels()[0], 1);
+    CHECK_EQ(frame.channels()[31], 2);
+    CHECK_EQ(frame.channels()[644], 3);
+    CHECK_EQ(frame.universeLength[0], 32);
+    CHECK_EQ(frame.universeLength[1], 133);
+}
+
+static void testInvalidArguments()
+{
+    DmxLayerStack stack;
+    uint8_t values[2] = {};
+    CHECK_EQ(stack.setChannels(DmxLayerStack::BASE, 1023, values, 2), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(stack.setChannels(DmxLayerStack::NUM_LAYERS, 0, values, 1), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(stack.setChannels(DmxLayerStack::BASE, 0, nullptr, 1), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(stack.releaseChannels(DmxLayerStack::BASE, 1024, 1), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(stack.setLayerMode(DmxLayerStack::NUM_LAYERS, 0, DmxLayerStack::LTP), ESP_ERR_INVALID_ARG);
+}
+
+int main()
+{
+    testDefaultLayers();
+    testMergeModes();
+    testPriorities();
+    testOwnedBitmap();
+    testInvalidArguments();
+    return testResult("DmxLayerStack");
+}
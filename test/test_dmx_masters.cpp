@@ -0,0 +1,117 @@
+#include "dmx_masters.hpp"
+#include "test_support.hpp"
+#include <cstdlib>
+#include <cstring>
+
+// What the packed kernel must produce for one channel
+static uint8_t scaled(uint8_t value, uint8_t level) { return (value * (uint32_t)(level + (level >> 7))) >> 8; }
+
+// Channel n holds n & 255, so every value appears at every byte position of a frame word
+static void fillFrame(DmxFrame &frame)
+{
+    for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+    {
+        frame.channels()[channel] = channel & 0xFF;
+    }
+}
+
+// The grand master scales every channel: all levels against all values
+static void testGrandMaster()
+{
+    for (int level = 0; level <= 255; level++)
+    {
+        DmxMasters masters;
+        masters.setGrandMaster(level);
+        DmxFrame frame;
+        fillFrame(frame);
+        masters.apply(frame);
+        int mismatches = 0;
+        for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+        {
+            mismatches += frame.channels()[channel] != scaled(channel & 0xFF, level);
+        }
+        CHECK_EQ(mismatches, 0);
+    }
+}
+
+// A group scales its members only, whatever the membership pattern within a frame word; the grand master follows
+static void testGroups()
+{
+    srand(1);
+    for (int level = 0; level <= 255; level++)
+    {
+        DmxMasters masters;
+        bool member[DMX_FRAME_CHANNELS] = {};
+        CHECK_EQ(masters.setGroup(3, "Wash"), ESP_OK);
+        for (int range = 0; range < 40; range++)
+        {
+            uint16_t first = rand() % DMX_FRAME_CHANNELS;
+            uint16_t count = 1 + rand() % 40;
+            count = count < DMX_FRAME_CHANNELS - first ? count : DMX_FRAME_CHANNELS - first;
+            bool add = range % 4 != 3;
+            CHECK_EQ(masters.setGroupChannels(3, first, count, add), ESP_OK);
+            for (uint16_t channel = first; channel < first + count; channel++)
+            {
+                member[channel] = add;
+            }
+        }
+        CHECK_EQ(masters.setGroupLevel(3, level), ESP_OK);
+        uint8_t grandMaster = 255 - level / 2;
+        masters.setGrandMaster(grandMaster);
+
+        DmxFrame frame;
+        fillFrame(frame);
+        masters.apply(frame);
+        int mismatches = 0;
+        for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+        {
+            uint8_t value = channel & 0xFF;
+            uint8_t expected = scaled(member[channel] ? scaled(value, level) : value, grandMaster);
+            mismatches += frame.channels()[channel] != expected;
+        }
+        CHECK_EQ(mismatches, 0);
+    }
+
+    // Overlapping groups both apply; full levels leave the frame as it is
+    DmxMasters masters;
+    masters.setGroup(0, nullptr);
+    masters.setGroup(15, "All");
+    masters.setGroupChannels(0, 0, 64, true);
+    masters.setGroupChannels(15, 0, DMX_FRAME_CHANNELS, true);
+    DmxFrame frame;
+    fillFrame(frame);
+    masters.apply(frame);
+    for (uint16_t channel = 0; channel < DMX_FRAME_CHANNELS; channel++)
+    {
+        CHECK_EQ(frame.channels()[channel], channel & 0xFF);
+    }
+    masters.setGroupLevel(0, 128);
+    masters.setGroupLevel(15, 64);
+    masters.apply(frame);
+    CHECK_EQ(frame.channels()[10], scaled(scaled(10, 128), 64));
+    CHECK_EQ(frame.channels()[100], scaled(100, 64));
+}
+
+static void testArguments()
+{
+    DmxMasters masters;
+    CHECK_EQ(masters.setGroup(MAX_CHANNEL_GROUPS, "x"), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(masters.setGroupLevel(1, 10), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(masters.setGroupChannels(1, 0, 1, true), ESP_ERR_INVALID_ARG);
+    CHECK(masters.getGroupMembers(1) == nullptr);
+    CHECK_EQ(masters.setGroup(1, "A name longer than fifteen"), ESP_OK);
+    CHECK_EQ(strlen(masters.getGroupName(1)), DmxMasters::GROUP_NAME_SIZE - 1);
+    CHECK_EQ(masters.getGroupLevel(1), 255);
+    CHECK_EQ(masters.setGroupChannels(1, DMX_FRAME_CHANNELS - 1, 1, true), ESP_OK);
+    CHECK_EQ(masters.setGroupChannels(1, DMX_FRAME_CHANNELS - 1, 2, true), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(masters.setGroupChannels(1, DMX_FRAME_CHANNELS, 0, true), ESP_ERR_INVALID_ARG);
+    CHECK_EQ(masters.getGroupMembers(1)[DmxMasters::BITMAP_WORDS - 1], 0x80000000);
+}
+
+int main()
+{
+    testGrandMaster();
+    testGroups();
+    testArguments();
+    return testResult("DmxMasters");
+}
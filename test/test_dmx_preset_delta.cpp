@@ -0,0 +1,152 @@
+#include "dmx_preset_delta.hpp"
+#include "test_support.hpp"
+#include <random>
+
+static bool samePreset(const DmxPreset &a, const DmxPreset &b)
+{
+    for (uint8_t universe = 0; universe < 2; universe++)
+    {
+        if (a.getUniverseLength(universe) != b.getUniverseLength(universe) ||
+            memcmp(a.getUniverseData(universe), b.getUniverseData(universe), DMX_UNIVERSE_SIZE) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sparse changes on a common background, as between neighbouring presets of a show
+static void randomPreset(std::mt19937 &random, DmxPreset &preset, uint32_t changeOneIn)
+{
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    for (uint8_t universe = 0; universe < 2; universe++)
+    {
+        uint16_t length = random() % (DMX_UNIVERSE_SIZE + 1);
+        for (uint16_t channel = 0; channel < length; channel++)
+        {
+            values[channel] = random() % changeOneIn == 0 ? random() : 7;
+        }
+        preset.setUniverseData(universe, values, length);
+    }
+}
+
+static void testRoundTrip()
+{
+    std::mt19937 random(1);
+    for (int trial = 0; trial < 5000; trial++)
+    {
+        DmxPreset from;
+        DmxPreset to;
+        randomPreset(random, from, 4);
+        randomPreset(random, to, 1 + trial % 5);
+
+        uint8_t delta[DmxPresetDelta::MAX_SIZE];
+        size_t length = 0;
+        CHECK_EQ(DmxPresetDelta::encode(from, to, delta, sizeof(delta), length), ESP_OK);
+        CHECK(length <= DmxPresetDelta::MAX_SIZE);
+        CHECK_EQ(DmxPresetDelta::validate(delta, length), ESP_OK);
+
+        DmxPreset result;
+        result.copyFrom(from);
+        CHECK_EQ(DmxPresetDelta::apply(result, delta, length), ESP_OK);
+        CHECK(samePreset(result, to));
+    }
+}
+
+static void testUnchangedPreset()
+{
+    DmxPreset preset;
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    memset(values, 42, sizeof(values));
+    preset.setUniverseData(0, values, 100);
+
+    uint8_t delta[DmxPresetDelta::MAX_SIZE];
+    size_t length = 0;
+    CHECK_EQ(DmxPresetDelta::encode(preset, preset, delta, sizeof(delta), length), ESP_OK);
+    CHECK_EQ(length, DmxPresetDelta::HEADER_SIZE);
+}
+
+static void testKeepLength()
+{
+    DmxPreset preset;
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    memset(values, 1, sizeof(values));
+    preset.setUniverseData(0, values, 10);
+    preset.setUniverseData(1, values, 20);
+
+    // Universe 1 keeps its length but a run reaches beyond it, universe 2 keeps it as is
+    const uint8_t delta[] = {0xFF, 0xFF, 0xFF, 0xFF, 8, 0, 4, 0, 9, 9, 9, 9};
+    CHECK_EQ(DmxPresetDelta::apply(preset, delta, sizeof(delta)), ESP_OK);
+    CHECK_EQ(preset.getUniverseLength(0), 12);
+    CHECK_EQ(preset.getUniverseLength(1), 20);
+    CHECK_EQ(preset.getUniverseValue(0, 7), 1);
+    CHECK_EQ(preset.getUniverseValue(0, 8), 9);
+    CHECK_EQ(preset.getUniverseValue(0, 11), 9);
+}
+
+static void testInvalidDeltas()
+{
+    // Each is rejected by validate() and leaves the preset unchanged
+    const uint8_t tooShort[] = {0, 2};
+    // Universe length 513
+    const uint8_t tooLong[] = {0x01, 0x02, 0, 0};
+    // Run header cut short
+    const uint8_t truncatedRun[] = {16, 0, 0, 0, 0, 0, 4};
+    // 4 values announced, 2 sent
+    const uint8_t missingValues[] = {16, 0, 0, 0, 0, 0, 4, 0, 1, 2};
+    // Channels 14..17 of a universe of 16
+    const uint8_t beyondLength[] = {16, 0, 0, 0, 14, 0, 4, 0, 1, 2, 3, 4};
+    // Channels 510..513, across the universe boundary
+    const uint8_t crossesUniverse[] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFE, 1, 4, 0, 1, 2, 3, 4};
+    const uint8_t emptyRun[] = {16, 0, 0, 0, 0, 0, 0, 0};
+    // Frame channel 1024
+    const uint8_t thirdUniverse[] = {16, 0, 16, 0, 0, 4, 1, 0, 1};
+    struct
+    {
+        const uint8_t *delta;
+        size_t length;
+    } invalid[] = {{tooShort, sizeof(tooShort)}, {tooLong, sizeof(tooLong)}, {truncatedRun, sizeof(truncatedRun)},
+        {missingValues, sizeof(missingValues)}, {beyondLength, sizeof(beyondLength)},
+        {crossesUniverse, sizeof(crossesUniverse)}, {emptyRun, sizeof(emptyRun)},
+        {thirdUniverse, sizeof(thirdUniverse)}};
+
+    DmxPreset original;
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    memset(values, 5, sizeof(values));
+    original.setUniverseData(0, values, 300);
+    for (const auto &test : invalid)
+    {
+        CHECK(DmxPresetDelta::validate(test.delta, test.length) != ESP_OK);
+        DmxPreset preset;
+        preset.copyFrom(original);
+        CHECK(DmxPresetDelta::apply(preset, test.delta, test.length) != ESP_OK);
+        CHECK(samePreset(preset, original));
+    }
+    CHECK(DmxPresetDelta::validate(nullptr, 0) != ESP_OK);
+}
+
+static void testNoSpace()
+{
+    DmxPreset from;
+    DmxPreset to;
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    for (uint16_t channel = 0; channel < DMX_UNIVERSE_SIZE; channel++)
+    {
+        values[channel] = channel;
+    }
+    to.setUniverseData(0, values, DMX_UNIVERSE_SIZE);
+
+    uint8_t delta[64];
+    size_t length = 0;
+    CHECK(DmxPresetDelta::encode(from, to, delta, sizeof(delta), length) != ESP_OK);
+}
+
+int main()
+{
+    testRoundTrip();
+    testUnchangedPreset();
+    testKeepLength();
+    testInvalidDeltas();
+    testNoSpace();
+    return testResult("DmxPresetDelta");
+}
@@ -0,0 +1,149 @@
+#include "dmx_preset_record.hpp"
+#include "test_support.hpp"
+#include <random>
+
+static bool matches(const DmxPreset &preset, const Messages::PresetEventData &data)
+{
+    return strcmp(preset.getName(), data.name) == 0 && preset.getUniverseLength(0) == data.universe1Length &&
+           preset.getUniverseLength(1) == data.universe2Length &&
+           memcmp(preset.getUniverseData(0), data.universe1Data, data.universe1Length) == 0 &&
+           memcmp(preset.getUniverseData(1), data.universe2Data, data.universe2Length) == 0;
+}
+
+static void randomPresetData(std::mt19937 &random, Messages::PresetEventData &data, bool sparse)
+{
+    memset(&data, 0, sizeof(data));
+    int nameLength = random() % DMX_PRESET_NAME_SIZE;
+    for (int i = 0; i < nameLength; i++)
+    {
+        data.name[i] = 'a' + random() % 26;
+    }
+    data.universe1Length = random() % (DMX_UNIVERSE_SIZE + 1);
+    data.universe2Length = random() % (DMX_UNIVERSE_SIZE + 1);
+    for (uint16_t i = 0; i < DMX_UNIVERSE_SIZE; i++)
+    {
+        data.universe1Data[i] = sparse && random() % 8 ? 0 : random();
+        data.universe2Data[i] = sparse && random() % 8 ? 255 : random();
+    }
+}
+
+static void testRoundTrip()
+{
+    std::mt19937 random(4);
+    static Messages::PresetEventData data;
+    static DmxPreset preset;
+    uint8_t record[DmxPresetRecord::MAX_SIZE];
+    int packedSparse = 0;
+    int packedNoise = 0;
+    for (int trial = 0; trial < 4000; trial++)
+    {
+        bool sparse = trial % 2 == 0;
+        randomPresetData(random, data, sparse);
+        size_t size = DmxPresetRecord::encode(data, record, sizeof(record));
+        CHECK(size > 0 && size <= DmxPresetRecord::MAX_SIZE);
+        CHECK(DmxPresetRecord::getCrc(record, size) != 0);
+        CHECK_EQ(DmxPresetRecord::decode(record, size, preset), ESP_OK);
+        CHECK(matches(preset, data));
+        bool packed = record[0] == DmxPresetRecord::PACKED_RECORD_VERSION;
+        packedSparse += sparse && packed;
+        packedNoise += !sparse && packed;
+
+        // Encoding the decoded preset gives the same record
+        uint8_t again[DmxPresetRecord::MAX_SIZE];
+        CHECK_EQ(DmxPresetRecord::encode(preset, again, sizeof(again)), size);
+        CHECK(memcmp(again, record, size) == 0);
+    }
+    // Sparse universes are mostly stored packed, noise never is
+    CHECK(packedSparse > 1800);
+    CHECK_EQ(packedNoise, 0);
+}
+
+static void testCorruption()
+{
+    std::mt19937 random(5);
+    static Messages::PresetEventData data;
+    static DmxPreset preset;
+    uint8_t record[DmxPresetRecord::MAX_SIZE];
+    for (int trial = 0; trial < 4000; trial++)
+    {
+        randomPresetData(random, data, trial % 2 == 0);
+        size_t size = DmxPresetRecord::encode(data, record, sizeof(record));
+        record[random() % size] ^= 1 << (random() % 8);
+        CHECK_EQ(DmxPresetRecord::getCrc(record, size), 0);
+        CHECK(DmxPresetRecord::decode(record, size, preset) != ESP_OK);
+        // Truncated
+        CHECK_EQ(DmxPresetRecord::getCrc(record, size - 1), 0);
+    }
+}
+
+static void testNameAndCapacity()
+{
+    static Messages::PresetEventData data;
+    static DmxPreset preset;
+    memset(&data, 0, sizeof(data));
+    memset(data.name, 'n', sizeof(data.name)); // Not terminated
+    data.universe1Length = 3;
+    uint8_t record[DmxPresetRecord::MAX_SIZE];
+    size_t size = DmxPresetRecord::encode(data, record, sizeof(record));
+    CHECK_EQ(record[1], DMX_PRESET_NAME_SIZE - 1);
+    CHECK_EQ(DmxPresetRecord::decode(record, size, preset), ESP_OK);
+    CHECK_EQ(strlen(preset.getName()), DMX_PRESET_NAME_SIZE - 1);
+
+    CHECK_EQ(DmxPresetRecord::encode(data, record, size - 1), 0);
+    CHECK_EQ(DmxPresetRecord::encode(data, nullptr, sizeof(record)), 0);
+}
+
+// Raw Messages::PresetEventData of older firmware: number, 32-bit name pointer, universes with their lengths
+static void testLegacyBlob()
+{
+    uint8_t blob[DmxPresetRecord::LEGACY_SIZE];
+    memset(blob, 0, sizeof(blob));
+    blob[0] = 7;
+    blob[4] = 0x3C; // Name pointer, meaningless after a reboot
+    blob[7] = 0x3F;
+    for (int i = 0; i < 512; i++)
+    {
+        blob[8 + i] = i & 0xFF;
+        blob[522 + i] = 255 - (i & 0xFF);
+    }
+    blob[520] = 0x00; // Universe 1 length 256
+    blob[521] = 0x01;
+    blob[1034] = 24; // Universe 2 length 24
+    CHECK_EQ(DmxPresetRecord::getCrc(blob, sizeof(blob)), 0);
+
+    // Only migration decodes it, to the rest it is a record with a bad CRC
+    static DmxPreset preset;
+    CHECK_EQ(DmxPresetRecord::decode(blob, sizeof(blob), preset), ESP_ERR_INVALID_CRC);
+    preset.setName("old");
+    CHECK_EQ(DmxPresetRecord::decodeLegacy(blob, sizeof(blob), preset), ESP_OK);
+    CHECK_EQ(strlen(preset.getName()), 0);
+    CHECK_EQ(preset.getUniverseLength(0), 256);
+    CHECK_EQ(preset.getUniverseLength(1), 24);
+    CHECK_EQ(preset.getUniverseValue(0, 200), 200);
+    CHECK_EQ(preset.getUniverseValue(1, 23), 255 - 23);
+
+    // Migrated as a current record, the content stays the same
+    uint8_t record[DmxPresetRecord::MAX_SIZE];
+    size_t size = DmxPresetRecord::encode(preset, record, sizeof(record));
+    static DmxPreset migrated;
+    CHECK_EQ(DmxPresetRecord::decode(record, size, migrated), ESP_OK);
+    CHECK_EQ(migrated.getUniverseLength(0), 256);
+    CHECK(memcmp(migrated.getUniverseData(0), preset.getUniverseData(0), 256) == 0);
+    CHECK(memcmp(migrated.getUniverseData(1), preset.getUniverseData(1), 24) == 0);
+
+    // Lengths beyond a universe, another size or a valid record are not a legacy blob
+    blob[1035] = 0x02;
+    CHECK(DmxPresetRecord::decodeLegacy(blob, sizeof(blob), preset) != ESP_OK);
+    blob[1035] = 0;
+    CHECK(DmxPresetRecord::decodeLegacy(blob, sizeof(blob) - 1, preset) != ESP_OK);
+    CHECK(DmxPresetRecord::decodeLegacy(record, size, preset) != ESP_OK);
+}
+
+int main()
+{
+    testRoundTrip();
+    testCorruption();
+    testNameAndCapacity();
+    testLegacyBlob();
+    return testResult("DmxPresetRecord");
+}
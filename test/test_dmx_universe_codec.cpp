@@ -0,0 +1,144 @@
+#include "dmx_preset.hpp"
+#include "dmx_universe_codec.hpp"
+#include "test_support.hpp"
+#include <cstring>
+#include <random>
+
+// Worst case: one literal token per 128 values
+static const size_t PACK_CAPACITY = DMX_UNIVERSE_SIZE + DMX_UNIVERSE_SIZE / 128;
+
+static void checkRoundTrip(const uint8_t *values, uint16_t length)
+{
+    uint8_t packed[PACK_CAPACITY];
+    size_t packedLength = 0;
+    CHECK_EQ(DmxUniverseCodec::pack(values, length, packed, sizeof(packed), packedLength), ESP_OK);
+    CHECK(packedLength <= sizeof(packed));
+
+    // The decoder writes exactly length values and reads exactly the packed bytes
+    uint8_t unpacked[DMX_UNIVERSE_SIZE + 1];
+    memset(unpacked, 0xA5, sizeof(unpacked));
+    size_t consumed = 0;
+    CHECK_EQ(DmxUniverseCodec::unpack(packed, packedLength, unpacked, length, consumed), ESP_OK);
+    CHECK_EQ(consumed, packedLength);
+    CHECK(memcmp(unpacked, values, length) == 0);
+    CHECK_EQ(unpacked[length], 0xA5);
+}
+
+static void testRoundTrip()
+{
+    std::mt19937 random(2);
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    for (int trial = 0; trial < 3000; trial++)
+    {
+        uint16_t length = random() % (DMX_UNIVERSE_SIZE + 1);
+        switch (trial % 4)
+        {
+        case 0: // Noise
+            for (uint16_t i = 0; i < length; i++)
+            {
+                values[i] = random();
+            }
+            break;
+        case 1: // Runs
+            for (uint16_t i = 0; i < length; i++)
+            {
+                values[i] = i == 0 || random() % 12 == 0 ? random() : values[i - 1];
+            }
+            break;
+        case 2: // Identical fixtures with a few differences
+        {
+            uint16_t footprint = 1 + random() % 16;
+            for (uint16_t i = 0; i < length; i++)
+            {
+                values[i] = i < footprint || random() % 20 == 0 ? random() : values[i - footprint];
+            }
+        }
+        break;
+        default: // Used channels followed by unused ones
+            for (uint16_t i = 0; i < length; i++)
+            {
+                values[i] = i < length / 3 ? random() : 0;
+            }
+            break;
+        }
+        checkRoundTrip(values, length);
+    }
+}
+
+static void testCompression()
+{
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    memset(values, 0, sizeof(values));
+    uint8_t packed[PACK_CAPACITY];
+    size_t packedLength = 0;
+    CHECK_EQ(DmxUniverseCodec::pack(values, sizeof(values), packed, sizeof(packed), packedLength), ESP_OK);
+    CHECK(packedLength <= 16);
+
+    // 32 RGBW fixtures with the same setting
+    for (uint16_t i = 0; i < 128; i++)
+    {
+        values[i] = (uint8_t)(i % 4 * 60 + 15);
+    }
+    CHECK_EQ(DmxUniverseCodec::pack(values, 128, packed, sizeof(packed), packedLength), ESP_OK);
+    CHECK(packedLength <= 12);
+}
+
+static void testNoSpace()
+{
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    for (uint16_t i = 0; i < sizeof(values); i++)
+    {
+        values[i] = (uint8_t)(i * 37 + (i >> 3));
+    }
+    uint8_t packed[PACK_CAPACITY];
+    size_t packedLength = 0;
+    CHECK_EQ(DmxUniverseCodec::pack(values, sizeof(values), packed, 100, packedLength), ESP_ERR_INVALID_SIZE);
+    CHECK(DmxUniverseCodec::pack(nullptr, 0, packed, sizeof(packed), packedLength) != ESP_OK);
+}
+
+static void testInvalidInput()
+{
+    uint8_t values[DMX_UNIVERSE_SIZE];
+    memset(values, 3, sizeof(values));
+    uint8_t packed[PACK_CAPACITY];
+    size_t packedLength = 0;
+    CHECK_EQ(DmxUniverseCodec::pack(values, sizeof(values), packed, sizeof(packed), packedLength), ESP_OK);
+
+    // Cut short: the values are not all there
+    uint8_t unpacked[DMX_UNIVERSE_SIZE + 1];
+    size_t consumed = 0;
+    CHECK(DmxUniverseCodec::unpack(packed, packedLength - 1, unpacked, sizeof(values), consumed) != ESP_OK);
+
+    // A back reference before the start of the universe
+    const uint8_t badMatch[] = {0x00, 7, 0xC0, 5};
+    CHECK(DmxUniverseCodec::unpack(badMatch, sizeof(badMatch), unpacked, 4, consumed) != ESP_OK);
+
+    // Garbage never makes the decoder write beyond length or read beyond the input
+    std::mt19937 random(3);
+    uint8_t garbage[600];
+    for (int trial = 0; trial < 100000; trial++)
+    {
+        size_t garbageLength = random() % sizeof(garbage);
+        for (size_t i = 0; i < garbageLength; i++)
+        {
+            garbage[i] = random();
+        }
+        uint16_t length = random() % (DMX_UNIVERSE_SIZE + 1);
+        unpacked[length] = 0x5A;
+        consumed = 0;
+        if (DmxUniverseCodec::unpack(garbage, garbageLength, unpacked, length, consumed) == ESP_OK)
+        {
+            CHECK(consumed <= garbageLength);
+        }
+        CHECK_EQ(unpacked[length], 0x5A);
+    }
+}
+
+int main()
+{
+    testRoundTrip();
+    testCompression();
+    testNoSpace();
+    testInvalidInput();
+    return testResult("DmxUniverseCodec");
+}
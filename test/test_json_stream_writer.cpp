@@ -0,0 +1,154 @@
+#include "json_stream_writer.hpp"
+#include "test_support.hpp"
+#include <cstring>
+#include <string>
+
+struct Output
+{
+    std::string text;
+    size_t pieces = 0;
+    size_t largestPiece = 0;
+    size_t failAfter = (size_t)-1; // Pieces accepted before the sink fails
+};
+
+static esp_err_t collect(void *context, const char *data, size_t length)
+{
+    Output &output = *static_cast<Output *>(context);
+    if (output.pieces == output.failAfter)
+    {
+        return ESP_FAIL;
+    }
+    output.text.append(data, length);
+    output.pieces++;
+    output.largestPiece = length > output.largestPiece ? length : output.largestPiece;
+    return ESP_OK;
+}
+
+static void testDocument()
+{
+    Output output;
+    JsonStreamWriter json(collect, &output);
+    const uint8_t values[] = {0, 9, 10, 99, 100, 255};
+    json.beginObject();
+    json.key("index");
+    json.number(-2147483647 - 1);
+    json.key("max");
+    json.number(2147483647);
+    json.key("on");
+    json.boolean(true);
+    json.key("off");
+    json.boolean(false);
+    json.key("name");
+    json.string("a\"b\\c\n\x01\xc3\xa9");
+    json.key("empty");
+    json.beginArray();
+    json.endArray();
+    json.key("values");
+    json.uint8Array(values, sizeof(values));
+    json.key("list");
+    json.beginArray();
+    json.beginObject();
+    json.endObject();
+    json.number(0);
+    json.string(nullptr);
+    json.endArray();
+    json.endObject();
+    CHECK_EQ(json.flush(), ESP_OK);
+
+    const char *expected = "{\"index\":-2147483648,\"max\":2147483647,\"on\":true,\"off\":false,"
+                           "\"name\":\"a\\\"b\\\\c\\u000a\\u0001\xc3\xa9\",\"empty\":[],"
+                           "\"values\":[0,9,10,99,100,255],\"list\":[{},0,\"\"]}";
+    CHECK(output.text == expected);
+    if (output.text != expected)
+    {
+        fprintf(stderr, "got %s\n", output.text.c_str());
+    }
+}
+
+static void testEncodings()
+{
+    // RFC 4648 test vectors
+    const char *plain[] = {"", "f", "fo", "foo", "foob", "fooba", "foobar"};
+    const char *encoded[] = {"\"\"", "\"Zg==\"", "\"Zm8=\"", "\"Zm9v\"", "\"Zm9vYg==\"", "\"Zm9vYmE=\"",
+        "\"Zm9vYmFy\""};
+    for (int i = 0; i < 7; i++)
+    {
+        Output output;
+        JsonStreamWriter json(collect, &output);
+        json.base64(reinterpret_cast<const uint8_t *>(plain[i]), strlen(plain[i]));
+        json.flush();
+        CHECK(output.text == encoded[i]);
+    }
+
+    Output output;
+    JsonStreamWriter json(collect, &output);
+    const uint8_t values[] = {0x00, 0x0f, 0xa0, 0xff};
+    json.beginArray();
+    json.hex(values, sizeof(values));
+    json.base64(values, sizeof(values));
+    json.endArray();
+    json.flush();
+    CHECK(output.text == "[\"000fa0ff\",\"AA+g/w==\"]");
+}
+
+// A document far larger than the buffer arrives in order, in pieces no larger than the buffer
+static void testLargeDocument()
+{
+    Output output;
+    JsonStreamWriter json(collect, &output);
+    uint8_t values[512];
+    std::string expected = "[";
+    json.beginArray();
+    for (int preset = 0; preset < 50; preset++)
+    {
+        for (int i = 0; i < 512; i++)
+        {
+            values[i] = (uint8_t)(i * 7 + preset);
+        }
+        json.beginObject();
+        json.key("index");
+        json.number(preset);
+        json.key("universe1");
+        json.uint8Array(values, sizeof(values));
+        json.endObject();
+
+        expected += preset ? ",{\"index\":" : "{\"index\":";
+        expected += std::to_string(preset) + ",\"universe1\":[";
+        for (int i = 0; i < 512; i++)
+        {
+            expected += (i ? "," : "") + std::to_string(values[i]);
+        }
+        expected += "]}";
+    }
+    json.endArray();
+    expected += "]";
+    CHECK_EQ(json.flush(), ESP_OK);
+    CHECK(output.text == expected);
+    CHECK(output.pieces > 100);
+    CHECK(output.largestPiece <= 512);
+}
+
+static void testSinkError()
+{
+    Output output;
+    output.failAfter = 2;
+    JsonStreamWriter json(collect, &output);
+    uint8_t values[512] = {};
+    for (int i = 0; i < 10; i++)
+    {
+        json.uint8Array(values, sizeof(values));
+    }
+    // Nothing is handed to the sink after its first error
+    CHECK_EQ(json.getError(), ESP_FAIL);
+    CHECK_EQ(json.flush(), ESP_FAIL);
+    CHECK_EQ(output.pieces, 2);
+}
+
+int main()
+{
+    testDocument();
+    testEncodings();
+    testLargeDocument();
+    testSinkError();
+    return testResult("JsonStreamWriter");
+}
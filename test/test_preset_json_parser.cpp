@@ -0,0 +1,312 @@
+#include "dmx_presets.hpp"
+#include "json_stream_writer.hpp"
+#include "preset_json_parser.hpp"
+#include "test_support.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+struct Collect : PresetJsonParser::Handler
+{
+    std::vector<DmxPreset> presets;
+    size_t failAt = (size_t)-1; // Position at which the handler fails
+
+    esp_err_t onPreset(uint8_t position, const DmxPreset &preset) override
+    {
+        CHECK_EQ(position, presets.size());
+        if (position == failAt)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        presets.emplace_back();
+        presets.back().copyFrom(preset);
+        return ESP_OK;
+    }
+};
+
+static esp_err_t append(void *context, const char *data, size_t length)
+{
+    static_cast<std::string *>(context)->append(data, length);
+    return ESP_OK;
+}
+
+// Parses a document in pieces of 1..maxPiece bytes
+static esp_err_t parse(const std::string &document, Collect &collect, size_t maxPiece = 1 << 20,
+    PresetJsonParser::UniverseEncoding encoding = PresetJsonParser::UNIVERSE_ARRAY, bool singlePreset = false)
+{
+    PresetJsonParser parser(collect, encoding, singlePreset);
+    size_t offset = 0;
+    while (offset < document.size())
+    {
+        size_t length = 1 + rand() % maxPiece;
+        length = length < document.size() - offset ? length : document.size() - offset;
+        esp_err_t err = parser.feed(document.data() + offset, length);
+        if (err != ESP_OK)
+        {
+            return err;
+        }
+        offset += length;
+    }
+    return parser.finish();
+}
+
+static std::vector<DmxPreset> makePresets(int count)
+{
+    std::vector<DmxPreset> presets(count);
+    for (int i = 0; i < count; i++)
+    {
+        char name[DMX_PRESET_NAME_SIZE];
+        snprintf(name, sizeof(name), "Preset \"%d\"\t\xc3\xa9", i);
+        presets[i].setName(name);
+        uint8_t values[DMX_UNIVERSE_SIZE];
+        for (int channel = 0; channel < DMX_UNIVERSE_SIZE; channel++)
+        {
+            values[channel] = channel < 96 ? rand() : 0;
+        }
+        presets[i].setUniverseData(0, values, DMX_UNIVERSE_SIZE);
+        for (int channel = 0; channel < DMX_UNIVERSE_SIZE; channel++)
+        {
+            values[channel] = channel % 7 ? 255 : rand();
+        }
+        presets[i].setUniverseData(1, values, 1 + i % DMX_UNIVERSE_SIZE);
+    }
+    return presets;
+}
+
+// Writes presets the way GET /api/presets does
+static std::string writePresets(const std::vector<DmxPreset> &presets,
+    PresetJsonParser::UniverseEncoding encoding = PresetJsonParser::UNIVERSE_ARRAY)
+{
+    std::string document;
+    JsonStreamWriter json(append, &document);
+    json.beginArray();
+    for (size_t i = 0; i < presets.size(); i++)
+    {
+        json.beginObject();
+        json.key("index");
+        json.number(i);
+        json.key("name");
+        json.string(presets[i].getName());
+        for (uint8_t universe = 0; universe < 2; universe++)
+        {
+            json.key(universe == 0 ? "universe1" : "universe2");
+            const uint8_t *data = presets[i].getUniverseData(universe);
+            uint16_t length = presets[i].getUniverseLength(universe);
+            if (encoding == PresetJsonParser::UNIVERSE_BASE64)
+            {
+                json.base64(data, length);
+            }
+            else if (encoding == PresetJsonParser::UNIVERSE_HEX)
+            {
+                json.hex(data, length);
+            }
+            else
+            {
+                json.uint8Array(data, length);
+            }
+        }
+        json.endObject();
+    }
+    json.endArray();
+    json.flush();
+    return document;
+}
+
+// Parsed universes always have all channels, those not sent are 0
+static bool samePreset(const DmxPreset &parsed, const DmxPreset &sent)
+{
+    for (uint8_t universe = 0; universe < 2; universe++)
+    {
+        if (parsed.getUniverseLength(universe) != DMX_UNIVERSE_SIZE)
+        {
+            return false;
+        }
+        for (uint16_t channel = 0; channel < DMX_UNIVERSE_SIZE; channel++)
+        {
+            uint16_t length = sent.getUniverseLength(universe);
+            uint8_t expected = channel < length ? sent.getUniverseValue(universe, channel) : 0;
+            if (parsed.getUniverseValue(universe, channel) != expected)
+            {
+                return false;
+            }
+        }
+    }
+    return strcmp(parsed.getName(), sent.getName()) == 0;
+}
+
+static void testRoundTrip()
+{
+    const PresetJsonParser::UniverseEncoding encodings[] = {PresetJsonParser::UNIVERSE_ARRAY,
+        PresetJsonParser::UNIVERSE_BASE64, PresetJsonParser::UNIVERSE_HEX};
+    std::vector<DmxPreset> presets = makePresets(20);
+    for (PresetJsonParser::UniverseEncoding encoding : encodings)
+    {
+        std::string document = writePresets(presets, encoding);
+        for (size_t maxPiece : {1, 3, 64, 2000})
+        {
+            Collect collect;
+            CHECK_EQ(parse(document, collect, maxPiece, encoding), ESP_OK);
+            CHECK_EQ(collect.presets.size(), presets.size());
+            for (size_t i = 0; i < collect.presets.size() && i < presets.size(); i++)
+            {
+                CHECK(samePreset(collect.presets[i], presets[i]));
+            }
+        }
+    }
+
+    // Arrays of numbers are accepted with any encoding
+    std::string document = writePresets(presets);
+    Collect collect;
+    CHECK_EQ(parse(document, collect, 100, PresetJsonParser::UNIVERSE_HEX), ESP_OK);
+    CHECK_EQ(collect.presets.size(), presets.size());
+
+    std::vector<DmxPreset> most = makePresets(MAX_PRESETS);
+    Collect all;
+    CHECK_EQ(parse(writePresets(most), all, 4096), ESP_OK);
+    CHECK_EQ(all.presets.size(), MAX_PRESETS);
+}
+
+static void testSyntax()
+{
+    const char *emptyPreset = "{\"name\":\"\",\"universe1\":[],\"universe2\":[]}";
+    std::string two = std::string("[") + emptyPreset + "," + emptyPreset + "]";
+
+    Collect collect;
+    CHECK_EQ(parse(" \n" + two + "\t ", collect), ESP_OK);
+    CHECK_EQ(collect.presets.size(), 2);
+
+    // Unknown keys are skipped whatever their value
+    std::string unknown = "[{\"x\":{\"a\":[1,{\"b\":null}],\"c\":\"]}\"},\"universe1\":[1,2,3],\"y\":-1.5e3},"
+                          "{\"z\":[true,false]}]";
+    Collect skipped;
+    CHECK_EQ(parse(unknown, skipped, 2), ESP_OK);
+    CHECK_EQ(skipped.presets.size(), 2);
+    if (skipped.presets.size() == 2)
+    {
+        CHECK_EQ(skipped.presets[0].getUniverseValue(0, 2), 3);
+        CHECK_EQ(skipped.presets[0].getUniverseValue(0, 3), 0);
+    }
+
+    // Escapes in names, and truncation on a character boundary
+    std::string names = "[{\"name\":\"\\u00e9\\n\\ud83d\\ude00\"},"
+                        "{\"name\":\"123456789012345678901234567890\xc3\xa9\"}]";
+    Collect named;
+    CHECK_EQ(parse(names, named), ESP_OK);
+    if (named.presets.size() == 2)
+    {
+        CHECK(strcmp(named.presets[0].getName(), "\xc3\xa9\n\xf0\x9f\x98\x80") == 0);
+        CHECK(strcmp(named.presets[1].getName(), "123456789012345678901234567890") == 0);
+    }
+
+    const std::string invalid[] = {
+        "",
+        "[" + std::string(emptyPreset) + "]",               // Too few presets
+        two.substr(0, two.size() - 1),                      // Unterminated
+        two + "]",                                          // Trailing data
+        "[{\"universe1\":[256]},{}]",                       // Out of range
+        "[{\"universe1\":[-1]},{}]",                        //
+        "[{\"universe1\":[1.5]},{}]",                       // Not an integer
+        "[{\"universe1\":[1,]},{}]",                        // Trailing comma
+        "[{\"universe1\":\"AQID\"},{}]",                    // String with the array encoding
+        "[{\"name\":\"a},{}]",                              // Unterminated string
+        "[{\"name\" 1},{}]",                                // Missing colon
+        "[{},{}",                                           //
+        "{}",                                               // Not an array
+    };
+    for (const std::string &document : invalid)
+    {
+        Collect rejected;
+        CHECK(parse(document, rejected) != ESP_OK);
+    }
+
+    std::string tooMany = "[";
+    for (int i = 0; i <= MAX_PRESETS; i++)
+    {
+        tooMany += i ? ",{}" : "{}";
+    }
+    Collect rejected;
+    CHECK(parse(tooMany + "]", rejected) != ESP_OK);
+
+    std::string tooLong = "[{\"universe1\":[0";
+    for (int i = 0; i < DMX_UNIVERSE_SIZE; i++)
+    {
+        tooLong += ",0";
+    }
+    Collect overflow;
+    CHECK(parse(tooLong + "]},{}]", overflow) != ESP_OK);
+}
+
+static void testEncodedStrings()
+{
+    Collect base64;
+    CHECK_EQ(parse("[{\"universe1\":\"AQID\"},{\"universe1\":\"/w\"}]", base64, 1, PresetJsonParser::UNIVERSE_BASE64),
+        ESP_OK);
+    if (base64.presets.size() == 2)
+    {
+        CHECK_EQ(base64.presets[0].getUniverseValue(0, 0), 1);
+        CHECK_EQ(base64.presets[0].getUniverseValue(0, 2), 3);
+        CHECK_EQ(base64.presets[0].getUniverseValue(0, 3), 0);
+        CHECK_EQ(base64.presets[1].getUniverseValue(0, 0), 255);
+        CHECK_EQ(base64.presets[1].getUniverseValue(0, 1), 0);
+    }
+
+    Collect hex;
+    CHECK_EQ(parse("[{\"universe2\":\"00fF10\"},{}]", hex, 2, PresetJsonParser::UNIVERSE_HEX), ESP_OK);
+    if (hex.presets.size() == 2)
+    {
+        CHECK_EQ(hex.presets[0].getUniverseLength(1), DMX_UNIVERSE_SIZE);
+        CHECK_EQ(hex.presets[0].getUniverseValue(1, 1), 255);
+        CHECK_EQ(hex.presets[0].getUniverseValue(1, 2), 16);
+    }
+
+    Collect rejected;
+    CHECK(parse("[{\"universe1\":\"0\"},{}]", rejected, 1, PresetJsonParser::UNIVERSE_HEX) != ESP_OK);
+    CHECK(parse("[{\"universe1\":\"0g\"},{}]", rejected, 1, PresetJsonParser::UNIVERSE_HEX) != ESP_OK);
+    CHECK(parse("[{\"universe1\":\"A\"},{}]", rejected, 1, PresetJsonParser::UNIVERSE_BASE64) != ESP_OK);
+    CHECK(parse("[{\"universe1\":\"A*==\"},{}]", rejected, 1, PresetJsonParser::UNIVERSE_BASE64) != ESP_OK);
+}
+
+static void testSinglePreset()
+{
+    Collect collect;
+    CHECK_EQ(parse("{\"name\":\"One\",\"universe1\":[7]}", collect, 1, PresetJsonParser::UNIVERSE_ARRAY, true),
+        ESP_OK);
+    CHECK_EQ(collect.presets.size(), 1);
+    if (collect.presets.size() == 1)
+    {
+        CHECK(strcmp(collect.presets[0].getName(), "One") == 0);
+        CHECK_EQ(collect.presets[0].getUniverseValue(0, 0), 7);
+    }
+
+    Collect rejected;
+    CHECK(parse("[{},{}]", rejected, 1, PresetJsonParser::UNIVERSE_ARRAY, true) != ESP_OK);
+    CHECK(parse("{}{}", rejected, 1, PresetJsonParser::UNIVERSE_ARRAY, true) != ESP_OK);
+}
+
+static void testHandlerError()
+{
+    Collect collect;
+    collect.failAt = 1;
+    PresetJsonParser parser(collect);
+    std::string document = "[{},{},{}]";
+    CHECK(parser.feed(document.data(), document.size()) != ESP_OK);
+    CHECK(parser.isHandlerError());
+    CHECK_EQ(parser.getNumberOfPresets(), 1);
+
+    Collect invalid;
+    PresetJsonParser syntax(invalid);
+    CHECK(syntax.feed("[}", 2) != ESP_OK);
+    CHECK(!syntax.isHandlerError());
+}
+
+int main()
+{
+    srand(1);
+    testRoundTrip();
+    testSyntax();
+    testEncodedStrings();
+    testSinglePreset();
+    testHandlerError();
+    return testResult("PresetJsonParser");
+}
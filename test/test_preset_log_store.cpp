@@ -0,0 +1,102 @@
+#include "preset_log_test_support.hpp"
+
+static void testBasics()
+{
+    CHECK(FakeFlash::create(IMAGE, LABEL, PARTITION_SIZE));
+    PresetLogStore store;
+    CHECK(store.init("missing") != ESP_OK);
+    CHECK(!store.isOpen());
+    CHECK_EQ(store.init(LABEL), ESP_OK);
+    CHECK_EQ(store.getNumberOfPresets(), 0);
+    CHECK(!store.hasPreset(0));
+    CHECK(!store.hasPreset(MAX_PRESETS));
+
+    Bytes record = makeRecord(3, 1, true);
+    CHECK_EQ(store.writePreset(3, record.data(), record.size()), ESP_OK);
+    CHECK(store.writePreset(MAX_PRESETS, record.data(), record.size()) != ESP_OK);
+    CHECK(store.writePreset(4, record.data(), DmxPresetRecord::MAX_SIZE + 1) != ESP_OK);
+    uint8_t small[16];
+    size_t size = 0;
+    CHECK(store.readPreset(3, small, sizeof(small), size) != ESP_OK);
+    CHECK_EQ(store.writeNumberOfPresets(12), ESP_OK);
+
+    PresetLogStore *rebooted = reboot(nullptr);
+    Show expected;
+    expected.presets[3] = record;
+    expected.numberOfPresets = 12;
+    CHECK(readShow(*rebooted, true) == expected);
+    PresetLogStore::Stats stats = rebooted->getStats();
+    CHECK_EQ(stats.totalSectors, PARTITION_SIZE / 4096);
+    CHECK_EQ(stats.liveBytes, PresetLogStore::entrySize(record.size()) + PresetLogStore::entrySize(1));
+    delete rebooted;
+}
+
+// Random writes with compaction, rebooting after every round; every third round the power is cut at a random
+// write or erase, after which each preset must hold either its previous or its new record
+static void testWrites(bool mapped)
+{
+    CHECK(FakeFlash::create(IMAGE, LABEL, PARTITION_SIZE));
+    FakeFlash::setMappable(mapped);
+    Show model;
+    int cuts = 0;
+    uint32_t compactions = 0;
+    PresetLogStore *store = reboot(nullptr);
+    for (int round = 0; round < 60; round++)
+    {
+        CHECK(readShow(*store, mapped) == model);
+        Show previous = model;
+        int changed = -1;
+        FakeFlash::cutPowerAt(round % 3 == 2 ? rand() % 800 : -1, round);
+        try
+        {
+            if (round == 0)
+            {
+                CHECK_EQ(store->writeNumberOfPresets(MAX_PRESETS), ESP_OK);
+                model.numberOfPresets = MAX_PRESETS;
+            }
+            for (int write = 0; write < 300; write++)
+            {
+                int index = round == 0 ? write % MAX_PRESETS : rand() % MAX_PRESETS;
+                Bytes record = makeRecord(index, write, rand() % 4 == 0);
+                previous = model;
+                changed = index;
+                model.presets[index] = record;
+                CHECK_EQ(store->writePreset(index, record.data(), record.size()), ESP_OK);
+                if (rand() % 8 == 0 && store->needsCompaction())
+                {
+                    CHECK_EQ(store->compact(), ESP_OK);
+                }
+            }
+        }
+        catch (FakeFlash::PowerCut &)
+        {
+            cuts++;
+            compactions += store->getStats().compactions;
+            store = reboot(store);
+            Show found = readShow(*store, mapped);
+            CHECK(found == model || found == previous);
+            if (changed >= 0 && found == previous)
+            {
+                model = previous;
+            }
+        }
+        compactions += store->getStats().compactions;
+        store = reboot(store);
+    }
+    CHECK(readShow(*store, mapped) == model);
+    CHECK_EQ(cuts, 20);
+    CHECK(compactions > 0);
+    CHECK(store->getStats().freeSectors >= 2);
+    delete store;
+}
+
+
+int main()
+{
+    srand(1);
+    testBasics();
+    testWrites(true);
+    testWrites(false);
+    FakeFlash::close();
+    return testResult("PresetLogStore");
+}
@@ -0,0 +1,177 @@
+#include "preset_log_test_support.hpp"
+
+// Stages a show, possibly with writes outside the transaction, then commits or aborts it. A power cut at any flash
+// operation must leave either the show from before the transaction or the committed one, never a mix.
+static void testTransactions(bool mapped)
+{
+    CHECK(FakeFlash::create(IMAGE, LABEL, PARTITION_SIZE));
+    FakeFlash::setMappable(mapped);
+    Show model;
+    int version = 0;
+    int commits = 0;
+    int cuts = 0;
+    PresetLogStore *store = reboot(nullptr);
+    for (int round = 0; round < 300; round++)
+    {
+        Show after = model; // The show once the current operation is done
+        FakeFlash::cutPowerAt(rand() % 3 ? rand() % 1500 : -1, round);
+        try
+        {
+            for (int write = rand() % 10; write > 0; write--)
+            {
+                int index = rand() % MAX_PRESETS;
+                Bytes record = makeRecord(index, ++version, false);
+                after.presets[index] = record;
+                CHECK_EQ(store->writePreset(index, record.data(), record.size()), ESP_OK);
+                model = after;
+            }
+
+            CHECK_EQ(store->beginTransaction(), ESP_OK);
+            CHECK(store->isTransactionOpen());
+            Show staged = model;
+            std::vector<bool> inTransaction(MAX_PRESETS);
+            int count = rand() % 3 ? rand() % 60 : MAX_PRESETS;
+            bool large = rand() % 10 == 0;
+            esp_err_t err = ESP_OK;
+            for (int k = 0; k < count && err == ESP_OK; k++)
+            {
+                int index = count == MAX_PRESETS ? k : rand() % MAX_PRESETS;
+                Bytes record = makeRecord(index, ++version, large);
+                err = store->stagePreset(index, record.data(), record.size());
+                staged.presets[index] = record;
+                inTransaction[index] = true;
+
+                // Writes outside the transaction go on while it is open and survive it
+                int other = rand() % MAX_PRESETS;
+                if (rand() % 8 == 0 && !inTransaction[other])
+                {
+                    Bytes write = makeRecord(other, ++version, false);
+                    after.presets[other] = write;
+                    CHECK_EQ(store->writePreset(other, write.data(), write.size()), ESP_OK);
+                    model = after;
+                    staged.presets[other] = write;
+                }
+                if (rand() % 4 == 0 && store->needsCompaction())
+                {
+                    CHECK_EQ(store->compact(), ESP_OK);
+                }
+            }
+            // Readers keep seeing the current show while the transaction is open
+            CHECK(readShow(*store, mapped) == model);
+            staged.numberOfPresets = 1 + rand() % MAX_PRESETS;
+            if (err == ESP_OK)
+            {
+                err = store->stageNumberOfPresets(staged.numberOfPresets);
+            }
+
+            if (err != ESP_OK || rand() % 5 == 0)
+            {
+                store->abortTransaction();
+            }
+            else
+            {
+                after = staged;
+                if (store->commitTransaction() == ESP_OK)
+                {
+                    model = staged;
+                    commits++;
+                }
+                else
+                {
+                    after = model;
+                    store->abortTransaction();
+                }
+            }
+            CHECK(!store->isTransactionOpen());
+            CHECK(readShow(*store, mapped) == model);
+            if (rand() % 4 == 0)
+            {
+                store = reboot(store);
+            }
+        }
+        catch (FakeFlash::PowerCut &)
+        {
+            cuts++;
+            store = reboot(store);
+            Show found = readShow(*store, mapped);
+            CHECK(found == model || found == after);
+            model = found;
+        }
+
+        // A reboot never revives an aborted or unfinished transaction
+        if (round % 50 == 49)
+        {
+            store = reboot(store);
+            CHECK(readShow(*store, mapped) == model);
+        }
+    }
+    CHECK(commits > 50);
+    CHECK(cuts > 25);
+    delete store;
+}
+
+// Transaction ids wrap around after 0x7FFF transactions: a preset staged by the first transaction and never written
+// again, committed and aborted transactions past the wrap all must come back after a reboot as before it
+static void testTransactionIdWrap()
+{
+    CHECK(FakeFlash::create(IMAGE, LABEL, PARTITION_SIZE));
+    FakeFlash::setMappable(true);
+    Show model;
+    int version = 0;
+    PresetLogStore *store = reboot(nullptr);
+
+    CHECK_EQ(store->beginTransaction(), ESP_OK);
+    Bytes first = makeRecord(0, ++version, true);
+    CHECK_EQ(store->stagePreset(0, first.data(), first.size()), ESP_OK);
+    CHECK_EQ(store->stageNumberOfPresets(10), ESP_OK);
+    CHECK_EQ(store->commitTransaction(), ESP_OK);
+    model.presets[0] = first;
+    model.numberOfPresets = 10;
+
+    // Mostly empty transactions, which only use up ids
+    uint32_t compactions = 0;
+    for (int transaction = 1; transaction < 80000; transaction++)
+    {
+        CHECK_EQ(store->beginTransaction(), ESP_OK);
+        if (transaction % 997 == 0)
+        {
+            int index = 1 + transaction % 5;
+            Bytes record = makeRecord(index, ++version, false);
+            CHECK_EQ(store->stagePreset(index, record.data(), record.size()), ESP_OK);
+            CHECK_EQ(store->commitTransaction(), ESP_OK);
+            model.presets[index] = record;
+        }
+        else if (transaction % 1499 == 0)
+        {
+            Bytes record = makeRecord(7, ++version, false);
+            CHECK_EQ(store->stagePreset(7, record.data(), record.size()), ESP_OK);
+            store->abortTransaction();
+        }
+        else
+        {
+            store->abortTransaction();
+        }
+        if (transaction % 4999 == 0)
+        {
+            compactions += store->getStats().compactions;
+            store = reboot(store);
+            CHECK(readShow(*store, true) == model);
+        }
+    }
+    compactions += store->getStats().compactions;
+    store = reboot(store);
+    CHECK(readShow(*store, true) == model);
+    // Entries of old transactions were rewritten, there was no need to compact otherwise
+    CHECK(compactions > 0);
+    delete store;
+}
+
+int main()
+{
+    srand(1);
+    testTransactions(true);
+    testTransactions(false);
+    testTransactionIdWrap();
+    FakeFlash::close();
+    return testResult("PresetLogStore transactions");
+}
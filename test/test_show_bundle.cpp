@@ -0,0 +1,213 @@
+#include "show_bundle.hpp"
+#include "test_support.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+typedef std::vector<uint8_t> Bytes;
+
+struct Collect : ShowBundleReader::Handler
+{
+    std::vector<Bytes> presets = std::vector<Bytes>(256);
+    int numberOfPresets = -1;
+    int unknownRecords = 0;
+    Messages::ConfigurationEventData config = {};
+
+    esp_err_t onRecord(uint8_t type, uint8_t id, const uint8_t *payload, uint16_t length) override
+    {
+        switch (type)
+        {
+        case ShowBundle::CONFIGURATION:
+            return ShowBundle::decodeConfiguration(payload, length, config);
+        case ShowBundle::PRESET_COUNT:
+            numberOfPresets = length == 1 ? payload[0] : -1;
+            return ESP_OK;
+        case ShowBundle::PRESET:
+            // The importer checks the record CRC the same way
+            if (DmxPresetRecord::getCrc(payload, length) == 0)
+            {
+                return ESP_ERR_INVALID_CRC;
+            }
+            presets[id].assign(payload, payload + length);
+            return ESP_OK;
+        default:
+            unknownRecords++;
+            return ESP_OK;
+        }
+    }
+};
+
+static const Messages::ConfigurationEventData CONFIG = {true, 800, 1500};
+static const int NUMBER_OF_PRESETS = 40;
+
+static std::vector<Bytes> makePresets()
+{
+    std::vector<Bytes> presets(NUMBER_OF_PRESETS);
+    static Messages::PresetEventData preset;
+    uint8_t record[DmxPresetRecord::MAX_SIZE];
+    for (int i = 0; i < NUMBER_OF_PRESETS; i++)
+    {
+        memset(&preset, 0, sizeof(preset));
+        snprintf(preset.name, sizeof(preset.name), "P%d", i);
+        preset.universe1Length = DMX_UNIVERSE_SIZE;
+        preset.universe2Length = i * 12;
+        for (int channel = 0; channel < DMX_UNIVERSE_SIZE; channel++)
+        {
+            preset.universe1Data[channel] = rand();
+            preset.universe2Data[channel] = channel % 4 ? 0 : rand();
+        }
+        size_t size = DmxPresetRecord::encode(preset, record, sizeof(record));
+        CHECK(size > 0);
+        presets[i].assign(record, record + size);
+    }
+    return presets;
+}
+
+// The same sequence as the show export, with one chunk buffer; an unknown record type is added in the middle
+static Bytes writeShow(const std::vector<Bytes> &presets)
+{
+    Bytes file;
+    Bytes chunk(ShowBundle::MAX_RECORD_SIZE);
+    ShowBundleWriter writer;
+    auto append = [&](size_t size) {
+        CHECK(size > 0);
+        file.insert(file.end(), chunk.begin(), chunk.begin() + size);
+    };
+
+    append(writer.writeHeader(chunk.data(), chunk.size()));
+    uint8_t config[ShowBundle::CONFIGURATION_SIZE];
+    ShowBundle::encodeConfiguration(CONFIG, config);
+    append(writer.writeRecord(ShowBundle::CONFIGURATION, 0, config, sizeof(config), chunk.data(), chunk.size()));
+    uint8_t count = presets.size();
+    append(writer.writeRecord(ShowBundle::PRESET_COUNT, 0, &count, 1, chunk.data(), chunk.size()));
+    for (size_t i = 0; i < presets.size(); i++)
+    {
+        if (i == presets.size() / 2)
+        {
+            const uint8_t future[] = {1, 2, 3};
+            append(writer.writeRecord(0x42, 7, future, sizeof(future), chunk.data(), chunk.size()));
+            append(writer.writeRecord(0x43, 0, nullptr, 0, chunk.data(), chunk.size()));
+        }
+        append(writer.writeRecord(ShowBundle::PRESET, i, presets[i].data(), presets[i].size(), chunk.data(),
+            chunk.size()));
+    }
+    append(writer.writeEnd(chunk.data(), chunk.size()));
+    return file;
+}
+
+static esp_err_t readShow(const Bytes &file, size_t length, Collect &collect, size_t maxPiece, bool &complete)
+{
+    ShowBundleReader reader(collect);
+    size_t offset = 0;
+    esp_err_t err = ESP_OK;
+    while (offset < length && err == ESP_OK)
+    {
+        size_t piece = 1 + rand() % maxPiece;
+        piece = piece < length - offset ? piece : length - offset;
+        err = reader.feed(file.data() + offset, piece);
+        offset += piece;
+    }
+    complete = reader.isComplete();
+    return err;
+}
+
+static void testRoundTrip()
+{
+    std::vector<Bytes> presets = makePresets();
+    Bytes file = writeShow(presets);
+    for (size_t maxPiece : {1, 7, 1500, 1 << 20})
+    {
+        Collect collect;
+        bool complete = false;
+        CHECK_EQ(readShow(file, file.size(), collect, maxPiece, complete), ESP_OK);
+        CHECK(complete);
+        CHECK_EQ(collect.numberOfPresets, NUMBER_OF_PRESETS);
+        CHECK_EQ(collect.unknownRecords, 2);
+        CHECK(collect.config.switchPolarityInverted);
+        CHECK_EQ(collect.config.longPressThresholdMs, 800);
+        CHECK_EQ(collect.config.commitWindowMs, 1500);
+        for (int i = 0; i < NUMBER_OF_PRESETS; i++)
+        {
+            CHECK(collect.presets[i] == presets[i]);
+        }
+    }
+}
+
+static void testConfiguration()
+{
+    uint8_t payload[ShowBundle::CONFIGURATION_SIZE + 2] = {};
+    Messages::ConfigurationEventData config = {false, 0xFFFF, 0};
+    ShowBundle::encodeConfiguration(config, payload);
+    Messages::ConfigurationEventData decoded = {true, 0, 1};
+    // Newer files may append fields
+    CHECK_EQ(ShowBundle::decodeConfiguration(payload, sizeof(payload), decoded), ESP_OK);
+    CHECK(!decoded.switchPolarityInverted);
+    CHECK_EQ(decoded.longPressThresholdMs, 0xFFFF);
+    CHECK_EQ(decoded.commitWindowMs, 0);
+    CHECK_EQ(ShowBundle::decodeConfiguration(payload, ShowBundle::CONFIGURATION_SIZE - 1, decoded),
+        ESP_ERR_INVALID_SIZE);
+    CHECK_EQ(ShowBundle::decodeConfiguration(nullptr, 0, decoded), ESP_ERR_INVALID_SIZE);
+}
+
+static void testWriterLimits()
+{
+    ShowBundleWriter writer;
+    uint8_t out[ShowBundle::MAX_RECORD_SIZE + 1];
+    uint8_t payload[ShowBundle::MAX_PAYLOAD_SIZE + 1] = {};
+    CHECK_EQ(writer.writeHeader(out, ShowBundle::HEADER_SIZE - 1), 0);
+    CHECK_EQ(writer.writeRecord(ShowBundle::PRESET, 0, payload, 10, out, 13), 0);
+    CHECK_EQ(writer.writeRecord(ShowBundle::PRESET, 0, payload, sizeof(payload), out, sizeof(out)), 0);
+    CHECK_EQ(writer.writeRecord(ShowBundle::PRESET, 0, nullptr, 1, out, sizeof(out)), 0);
+    CHECK_EQ(writer.writeRecord(ShowBundle::PRESET, 0, payload, ShowBundle::MAX_PAYLOAD_SIZE, out, sizeof(out)),
+        ShowBundle::MAX_RECORD_SIZE);
+}
+
+// Every bit flip and every truncation must keep the show from completing
+static void testCorruption()
+{
+    std::vector<Bytes> presets = makePresets();
+    Bytes file = writeShow(presets);
+    for (int trial = 0; trial < 2000; trial++)
+    {
+        Bytes damaged = file;
+        size_t length = damaged.size();
+        if (trial % 2)
+        {
+            length = rand() % damaged.size();
+        }
+        else
+        {
+            damaged[rand() % damaged.size()] ^= 1 << (rand() % 8);
+        }
+        Collect collect;
+        bool complete = false;
+        esp_err_t err = readShow(damaged, length, collect, 4096, complete);
+        CHECK(err != ESP_OK || !complete);
+    }
+
+    // Nothing may follow the end record
+    Bytes longer = file;
+    longer.push_back(0);
+    Collect collect;
+    bool complete = false;
+    CHECK_EQ(readShow(longer, longer.size(), collect, 1 << 20, complete), ESP_ERR_INVALID_SIZE);
+
+    // An error is final
+    Bytes header(file.begin(), file.begin() + ShowBundle::HEADER_SIZE);
+    header[4]++;
+    Collect rejected;
+    ShowBundleReader reader(rejected);
+    CHECK_EQ(reader.feed(header.data(), header.size()), ESP_ERR_INVALID_VERSION);
+    CHECK(reader.feed(file.data(), file.size()) != ESP_OK);
+    CHECK(!reader.isComplete());
+}
+
+int main()
+{
+    srand(1);
+    testRoundTrip();
+    testConfiguration();
+    testWriterLimits();
+    testCorruption();
+    return testResult("ShowBundle");
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal checks for the host tests: a failed check is reported and counted, the test goes on, and main() returns
+// testResult() so CTest sees the failure
+inline int &testFailures()
+{
+    static int failures = 0;
+    return failures;
+}
+
+#define CHECK(condition)                                                                                              \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(condition))                                                                                              \
+        {                                                                                                              \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition);                              \
+            testFailures()++;                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                                                    \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        long long actualValue = (long long)(actual);                                                                   \
+        long long expectedValue = (long long)(expected);                                                               \
+        if (actualValue != expectedValue)                                                                              \
+        {                                                                                                              \
+            fprintf(stderr, "%s:%d: CHECK_EQ failed: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual,        \
+                actualValue, expectedValue);                                                                           \
+            testFailures()++;                                                                                          \
+        }                                                                                                              \
+    } while (0)
+
+inline int testResult(const char *name)
+{
+    printf("%s: %s\n", name, testFailures() == 0 ? "passed" : "FAILED");
+    return testFailures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""Measures how long short API requests take on the device while slow transfers are running.
+
+Without the async workers (main/web_server.cpp) a slow transfer holds the single httpd task, and every other request
+waits for it. With them, the API should answer in a few milliseconds whatever the transfers do. The script first
+probes the API on an idle server, then again while --downloads clients fetch --slow-path and read it at --read-rate
+bytes per second, like a phone on a weak WLAN. It prints the latency percentiles of both runs and the 503 answers
+(worker queue full).
+
+    tools/bench_api_latency.py http://192.168.4.1
+    tools/bench_api_latency.py http://192.168.4.1 --slow-path /api/presets --downloads 3 --read-rate 20000
+"""
+
+import argparse
+import http.client
+import statistics
+import threading
+import time
+import urllib.parse
+
+
+def connect(url):
+    parts = urllib.parse.urlsplit(url)
+    return http.client.HTTPConnection(parts.hostname, parts.port or 80, timeout=30)
+
+
+def slow_download(url, path, read_rate, stop):
+    """Fetches path again and again, reading the body at read_rate bytes per second"""
+    while not stop.is_set():
+        try:
+            connection = connect(url)
+            connection.request("GET", path, headers={"Accept-Encoding": "gzip"})
+            response = connection.getresponse()
+            while not stop.is_set():
+                block = response.read(1024)
+                if not block:
+                    break
+                time.sleep(len(block) / read_rate)
+            connection.close()
+        except OSError:
+            time.sleep(0.5)
+
+
+def probe(url, path, duration, interval):
+    """Latencies in milliseconds of GET path, one request at a time, and the number of 503 answers"""
+    latencies = []
+    unavailable = 0
+    end = time.monotonic() + duration
+    while time.monotonic() < end:
+        start = time.monotonic()
+        connection = connect(url)
+        try:
+            connection.request("GET", path)
+            response = connection.getresponse()
+            response.read()
+            if response.status == 503:
+                unavailable += 1
+            else:
+                latencies.append((time.monotonic() - start) * 1000)
+        except OSError:
+            unavailable += 1
+        finally:
+            connection.close()
+        time.sleep(interval)
+    return latencies, unavailable
+
+
+def report(name, latencies, unavailable):
+    if len(latencies) < 2:
+        print("%-28s %d answers, %d unavailable" % (name, len(latencies), unavailable))
+        return
+    percentiles = statistics.quantiles(latencies, n=100, method="inclusive")
+    print("%-28s %4d answers  p50 %7.1f ms  p99 %7.1f ms  max %7.1f ms  %d unavailable" % (
+        name, len(latencies), percentiles[49], percentiles[98], max(latencies), unavailable))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("url", help="base URL of the device, e.g. http://192.168.4.1")
+    parser.add_argument("--probe-path", default="/api/config", help="short request to time (default %(default)s)")
+    parser.add_argument("--slow-path", default="/api/show", help="transfer to keep running (default %(default)s)")
+    parser.add_argument("--downloads", type=int, default=2, help="concurrent slow transfers (default %(default)s)")
+    parser.add_argument("--read-rate", type=int, default=50000,
+                        help="bytes per second each transfer reads (default %(default)s)")
+    parser.add_argument("--duration", type=float, default=20, help="seconds per run (default %(default)s)")
+    parser.add_argument("--interval", type=float, default=0.05,
+                        help="seconds between probes (default %(default)s)")
+    args = parser.parse_args()
+
+    report("idle", *probe(args.url, args.probe_path, args.duration, args.interval))
+
+    stop = threading.Event()
+    downloads = [threading.Thread(target=slow_download, args=(args.url, args.slow_path, args.read_rate, stop))
+                 for _ in range(args.downloads)]
+    for download in downloads:
+        download.start()
+    time.sleep(1)
+    try:
+        report("%d slow %s" % (args.downloads, args.slow_path),
+               *probe(args.url, args.probe_path, args.duration, args.interval))
+    finally:
+        stop.set()
+        for download in downloads:
+            download.join()
+
+
+if __name__ == "__main__":
+    main()
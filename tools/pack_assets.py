@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+"""Packs the web UI build (ReactWebsite/dist) into the image of the assets partition.
+
+The web server maps the partition and serves files straight from it (see main/asset_pack.hpp for the layout): the
+index is sorted by path for a binary search and holds the content type, the ETag and the gzip variant of every file,
+so nothing is computed on the device. A gzip variant is only kept when it saves at least 10%; the file itself is then
+left out (every browser accepts gzip, other clients get 406) unless --identity is given, which roughly quadruples the
+size of the UI bundle.
+
+    tools/pack_assets.py ReactWebsite/dist build/assets.bin
+    parttool.py write_partition --partition-name assets --input build/assets.bin
+"""
+
+import argparse
+import gzip
+import hashlib
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b"DMXA"
+VERSION = 1
+HEADER_SIZE = 16
+ENTRY_SIZE = 32
+
+# Size of the assets partition in partitions.csv
+PARTITION_SIZE = 0x20000
+
+CONTENT_TYPES = {
+    ".html": "text/html",
+    ".js": "application/javascript",
+    ".css": "text/css",
+    ".json": "application/json",
+    ".png": "image/png",
+    ".jpg": "image/jpeg",
+    ".jpeg": "image/jpeg",
+    ".svg": "image/svg+xml",
+    ".ico": "image/x-icon",
+    ".woff2": "font/woff2",
+}
+
+
+def align(data):
+    data.extend(b"\0" * (-len(data) % 4))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("source", help="web UI build directory")
+    parser.add_argument("output", help="partition image to write")
+    parser.add_argument("--partition-size", type=lambda s: int(s, 0), default=PARTITION_SIZE,
+                        help="fail if the pack is larger (default 0x%x)" % PARTITION_SIZE)
+    parser.add_argument("--identity", action="store_true",
+                        help="also keep the uncompressed file when there is a gzip variant")
+    args = parser.parse_args()
+
+    files = []
+    for root, _, names in os.walk(args.source):
+        for name in names:
+            full = os.path.join(root, name)
+            path = "/" + os.path.relpath(full, args.source).replace(os.sep, "/")
+            files.append((path.encode(), full))
+    # Bytewise, as AssetPack::find compares
+    files.sort()
+    if len(files) > 0xFFFF:
+        sys.exit("too many files")
+
+    # Strings and data follow the index
+    body = bytearray()
+    strings = {}
+    base = HEADER_SIZE + len(files) * ENTRY_SIZE
+
+    def add_string(text):
+        if text not in strings:
+            strings[text] = base + len(body)
+            body.extend(text.encode() + b"\0")
+        return strings[text]
+
+    def add_data(data):
+        align(body)
+        offset = base + len(body)
+        body.extend(data)
+        return offset
+
+    entries = []
+    for path, full in files:
+        with open(full, "rb") as f:
+            data = f.read()
+        # mtime 0 keeps the output the same for the same input
+        compressed = gzip.compress(data, compresslevel=9, mtime=0)
+        has_gzip = len(compressed) < len(data) * 9 // 10
+        etag = hashlib.sha256(data).hexdigest()[:16]
+        content_type = CONTENT_TYPES.get(os.path.splitext(full)[1].lower(), "application/octet-stream")
+
+        # Offset and length 0 with a gzip variant: gzip only
+        entry = [add_string(path.decode()), add_string(content_type), add_string('"%s"' % etag), 0, 0, 0, 0, 0]
+        if not has_gzip or args.identity:
+            entry[4] = add_data(data)
+            entry[5] = len(data)
+        if has_gzip:
+            entry[3] = add_string('"%s-gz"' % etag)
+            entry[6] = add_data(compressed)
+            entry[7] = len(compressed)
+        entries.append(entry)
+        print("%-32s %-24s %8d bytes%s" % (path.decode(), content_type, len(data),
+                                           (", gzip %d bytes" % len(compressed) if has_gzip else "") +
+                                           (", gzip only" if has_gzip and not args.identity else "")))
+
+    align(body)
+    index = b"".join(struct.pack("<8I", *entry) for entry in entries)
+    size = HEADER_SIZE + len(index) + len(body)
+    crc = zlib.crc32(index + bytes(body)) & 0xFFFFFFFF
+    pack = struct.pack("<4sHHII", MAGIC, VERSION, len(entries), size, crc) + index + bytes(body)
+
+    print("%d files, %d bytes (partition %d bytes)" % (len(entries), size, args.partition_size))
+    if size > args.partition_size:
+        sys.exit("the pack does not fit the assets partition")
+    with open(args.output, "wb") as f:
+        f.write(pack)
+
+
+if __name__ == "__main__":
+    main()